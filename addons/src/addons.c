@@ -83,6 +83,7 @@ typedef struct
 
 	gchar *tasks_token_list;
 	gboolean tasks_scan_all_documents;
+	gboolean tasks_scan_project;
 
 	DocListSortMode doclist_sort_mode;
 
@@ -107,6 +108,8 @@ static void ao_document_before_save_cb(GObject *obj, GeanyDocument *doc, gpointe
 static void ao_document_close_cb(GObject *obj, GeanyDocument *doc, gpointer data);
 static void ao_document_reload_cb(GObject *obj, GeanyDocument *doc, gpointer data);
 static void ao_startup_complete_cb(GObject *obj, gpointer data);
+static void ao_project_open_cb(GObject *obj, GKeyFile *config, gpointer data);
+static void ao_project_close_cb(GObject *obj, gpointer data);
 
 gboolean ao_editor_notify_cb(GObject *object, GeanyEditor *editor,
 	SCNotification *nt, gpointer data);
@@ -124,6 +127,9 @@ PluginCallback plugin_callbacks[] =
 	{ "document-before-save", (GCallback) &ao_document_before_save_cb, TRUE, NULL },
 	{ "document-reload", (GCallback) &ao_document_reload_cb, TRUE, NULL },
 
+	{ "project-open", (GCallback) &ao_project_open_cb, TRUE, NULL },
+	{ "project-close", (GCallback) &ao_project_close_cb, TRUE, NULL },
+
 	{ "geany-startup-complete", (GCallback) &ao_startup_complete_cb, TRUE, NULL },
 
 	{ NULL, NULL, FALSE, NULL }
@@ -166,6 +172,7 @@ gboolean ao_editor_notify_cb(GObject *object, GeanyEditor *editor,
 {
 	ao_bookmark_list_update_marker(ao_info->bookmarklist, editor, nt);
 	ao_mark_word_check(ao_info->markword, editor, nt);
+	ao_tasks_editor_notify(ao_info->tasks, editor, nt);
 
 	return FALSE;
 }
@@ -229,6 +236,18 @@ static void ao_document_reload_cb(GObject *obj, GeanyDocument *doc, gpointer dat
 }
 
 
+static void ao_project_open_cb(GObject *obj, GKeyFile *config, gpointer data)
+{
+	ao_tasks_project_open(ao_info->tasks);
+}
+
+
+static void ao_project_close_cb(GObject *obj, gpointer data)
+{
+	ao_tasks_project_close(ao_info->tasks);
+}
+
+
 GtkWidget *ao_image_menu_item_new(const gchar *stock_id, const gchar *label)
 {
 	GtkWidget *item = gtk_image_menu_item_new_with_label(label);
@@ -261,6 +280,8 @@ void plugin_init(GeanyData *data)
 		"addons", "enable_tasks", TRUE);
 	ao_info->tasks_scan_all_documents = utils_get_setting_boolean(config,
 		"addons", "tasks_scan_all_documents", FALSE);
+	ao_info->tasks_scan_project = utils_get_setting_boolean(config,
+		"addons", "tasks_scan_project", FALSE);
 	ao_info->tasks_token_list = utils_get_setting_string(config,
 		"addons", "tasks_token_list", "TODO;FIXME");
 	ao_info->enable_systray = utils_get_setting_boolean(config,
@@ -278,6 +299,9 @@ void plugin_init(GeanyData *data)
 	ao_info->enable_enclose_words_auto = utils_get_setting_boolean(config, "addons",
 		"enable_enclose_words_auto", FALSE);
 
+	/* the tasks of the project files are read in a thread */
+	if (! g_thread_supported())
+		g_thread_init(NULL);
 	plugin_module_make_resident(geany_plugin);
 
 	ao_info->doclist = ao_doc_list_new(ao_info->enable_doclist, ao_info->doclist_sort_mode);
@@ -286,7 +310,8 @@ void plugin_init(GeanyData *data)
 	ao_info->bookmarklist = ao_bookmark_list_new(ao_info->enable_bookmarklist);
 	ao_info->markword = ao_mark_word_new(ao_info->enable_markword);
 	ao_info->tasks = ao_tasks_new(ao_info->enable_tasks,
-						ao_info->tasks_token_list, ao_info->tasks_scan_all_documents);
+						ao_info->tasks_token_list, ao_info->tasks_scan_all_documents,
+						ao_info->tasks_scan_project);
 
 	ao_blanklines_set_enable(ao_info->strip_trailing_blank_lines);
 
@@ -310,9 +335,14 @@ void plugin_init(GeanyData *data)
 
 static void ao_configure_tasks_toggled_cb(GtkToggleButton *togglebutton, gpointer data)
 {
-	gboolean sens = gtk_toggle_button_get_active(togglebutton);
+	gboolean sens = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
+		g_object_get_data(G_OBJECT(data), "check_tasks")));
+	gboolean scan_all = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
+		g_object_get_data(G_OBJECT(data), "check_tasks_scan_mode")));
 
 	gtk_widget_set_sensitive(g_object_get_data(G_OBJECT(data), "check_tasks_scan_mode"), sens);
+	gtk_widget_set_sensitive(g_object_get_data(G_OBJECT(data), "check_tasks_scan_project"),
+		sens && scan_all);
 	gtk_widget_set_sensitive(g_object_get_data(G_OBJECT(data), "entry_tasks_tokens"), sens);
 }
 
@@ -355,6 +385,8 @@ static void ao_configure_response_cb(GtkDialog *dialog, gint response, gpointer
 			g_object_get_data(G_OBJECT(dialog), "check_tasks"))));
 		ao_info->tasks_scan_all_documents = (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
 			g_object_get_data(G_OBJECT(dialog), "check_tasks_scan_mode"))));
+		ao_info->tasks_scan_project = (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
+			g_object_get_data(G_OBJECT(dialog), "check_tasks_scan_project"))));
 		g_free(ao_info->tasks_token_list);
 		ao_info->tasks_token_list = g_strdup(gtk_entry_get_text(GTK_ENTRY(
 			g_object_get_data(G_OBJECT(dialog), "entry_tasks_tokens"))));
@@ -384,6 +416,8 @@ static void ao_configure_response_cb(GtkDialog *dialog, gint response, gpointer
 		g_key_file_set_string(config, "addons", "tasks_token_list", ao_info->tasks_token_list);
 		g_key_file_set_boolean(config, "addons", "tasks_scan_all_documents",
 			ao_info->tasks_scan_all_documents);
+		g_key_file_set_boolean(config, "addons", "tasks_scan_project",
+			ao_info->tasks_scan_project);
 		g_key_file_set_boolean(config, "addons", "enable_systray", ao_info->enable_systray);
 		g_key_file_set_boolean(config, "addons", "enable_bookmarklist",
 			ao_info->enable_bookmarklist);
@@ -407,6 +441,7 @@ static void ao_configure_response_cb(GtkDialog *dialog, gint response, gpointer
 		g_object_set(ao_info->tasks,
 			"enable-tasks", ao_info->enable_tasks,
 			"scan-all-documents", ao_info->tasks_scan_all_documents,
+			"scan-project", ao_info->tasks_scan_project,
 			"tokens", ao_info->tasks_token_list,
 			NULL);
 		ao_blanklines_set_enable(ao_info->strip_trailing_blank_lines);
@@ -435,7 +470,7 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 	GtkWidget *check_doclist, *vbox_doclist, *frame_doclist;
 	GtkWidget *radio_doclist_name, *radio_doclist_tab_order, *radio_doclist_tab_order_reversed;
 	GtkWidget *check_bookmarklist, *check_markword, *frame_tasks, *vbox_tasks;
-	GtkWidget *check_tasks_scan_mode, *entry_tasks_tokens, *label_tasks_tokens, *tokens_hbox;
+	GtkWidget *check_tasks_scan_mode, *check_tasks_scan_project, *entry_tasks_tokens, *label_tasks_tokens, *tokens_hbox;
 	GtkWidget *check_blanklines, *check_xmltagging;
 	GtkWidget *check_enclose_words, *check_enclose_words_auto, *enclose_words_config_button, *enclose_words_hbox;
 
@@ -503,6 +538,16 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 		ao_info->tasks_scan_all_documents);
 	ui_widget_set_tooltip_text(check_tasks_scan_mode,
 		_("Whether to show the tasks of all open documents in the list or only those of the current document."));
+	g_signal_connect(check_tasks_scan_mode, "toggled",
+		G_CALLBACK(ao_configure_tasks_toggled_cb), dialog);
+
+	check_tasks_scan_project = gtk_check_button_new_with_label(
+		_("Show tasks of all project files"));
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_tasks_scan_project),
+		ao_info->tasks_scan_project);
+	ui_widget_set_tooltip_text(check_tasks_scan_project,
+		_("Whether to also show the tasks of the files of the open project which are not open. "
+		  "The files are read in the background."));
 
 	entry_tasks_tokens = gtk_entry_new();
 	if (NZV(ao_info->tasks_token_list))
@@ -520,6 +565,7 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 
 	vbox_tasks = gtk_vbox_new(FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox_tasks), check_tasks_scan_mode, FALSE, FALSE, 3);
+	gtk_box_pack_start(GTK_BOX(vbox_tasks), check_tasks_scan_project, FALSE, FALSE, 3);
 	gtk_box_pack_start(GTK_BOX(vbox_tasks), tokens_hbox, TRUE, TRUE, 3);
 
 	frame_tasks = gtk_frame_new(NULL);
@@ -585,6 +631,7 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 	g_object_set_data(G_OBJECT(dialog), "check_tasks", check_tasks);
 	g_object_set_data(G_OBJECT(dialog), "entry_tasks_tokens", entry_tasks_tokens);
 	g_object_set_data(G_OBJECT(dialog), "check_tasks_scan_mode", check_tasks_scan_mode);
+	g_object_set_data(G_OBJECT(dialog), "check_tasks_scan_project", check_tasks_scan_project);
 	g_object_set_data(G_OBJECT(dialog), "check_systray", check_systray);
 	g_object_set_data(G_OBJECT(dialog), "check_bookmarklist", check_bookmarklist);
 	g_object_set_data(G_OBJECT(dialog), "check_markword", check_markword);
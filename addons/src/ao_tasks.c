@@ -22,8 +22,10 @@
 
 
 #include <string.h>
+#include <sys/stat.h>
 #include <gtk/gtk.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 
 #ifdef HAVE_CONFIG_H
 	#include "config.h"
@@ -36,6 +38,13 @@
 #include <gdk/gdkkeysyms.h>
 
 
+#if ! GLIB_CHECK_VERSION(2, 22, 0)
+# define g_mapped_file_unref g_mapped_file_free
+#endif
+
+/* project files larger than this are not scanned for tasks */
+#define AO_TASKS_PROJECT_MAX_FILE_SIZE (8 * 1024 * 1024)
+
 typedef struct _AoTasksPrivate AoTasksPrivate;
 
 #define AO_TASKS_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), \
@@ -51,6 +60,69 @@ struct _AoTasksClass
 	GObjectClass parent_class;
 };
 
+/* Aho-Corasick automaton matching all tokens in a single pass over a line */
+typedef struct
+{
+	gint (*next)[256];	/* complete transition table */
+	gint *match;		/* lowest index of the tokens ending in each state, or G_MAXINT */
+} AoTasksMatcher;
+
+typedef struct
+{
+	gint line;
+	gchar *token;
+	gchar *text;
+	gchar *tooltip;
+	GtkTreeIter iter;	/* row in the store, list store iters persist */
+} AoTask;
+
+/* The tasks of a document shown in the list, sorted by line. The lines modified since the
+ * last scan are rescanned after a short delay. */
+typedef struct
+{
+	GeanyDocument *doc;
+	GPtrArray *tasks;
+	gint dirty_first;	/* -1 if nothing to rescan */
+	gint dirty_last;
+} AoDocTasks;
+
+/* The tasks of a project file, shown in the list while the file is not open */
+typedef struct
+{
+	gchar *display_name;
+	time_t mtime;
+	GPtrArray *tasks;
+	gboolean shown;
+} AoProjectFile;
+
+typedef struct
+{
+	gchar *filename;	/* UTF-8 */
+	time_t mtime;
+	GPtrArray *tasks;
+} AoProjectScanResult;
+
+/* A scan of the project files in a background thread. The results are passed back to the
+ * main loop in batches, only the files modified since the last scan are read. */
+typedef struct
+{
+	gint ref_count;
+	gint cancelled;
+	AoTasks *t;
+
+	gchar *base_path;		/* locale encoding */
+	GPatternSpec **patterns;
+	gchar **tokens;
+	AoTasksMatcher *matcher;
+	GHashTable *mtimes;		/* UTF-8 filename -> modification time of the cached files */
+	GHashTable *seen;		/* UTF-8 filenames of the files found */
+
+	GMutex *lock;			/* protects the fields below */
+	GSList *results;		/* newest first */
+	gboolean finished;
+	gboolean idle_pending;
+} AoProjectScan;
+
 struct _AoTasksPrivate
 {
 	gboolean enable_tasks;
@@ -64,8 +136,16 @@ struct _AoTasksPrivate
 	GtkWidget *popup_menu_delete_button;
 
 	gchar **tokens;
+	AoTasksMatcher *matcher;
 
 	gboolean scan_all_documents;
+	gboolean scan_project;
+
+	GHashTable *doc_tasks;
+	guint rescan_source_id;
+
+	GHashTable *project_files;
+	AoProjectScan *project_scan;
 
 	GHashTable *selected_tasks;
 	gint selected_task_line;
@@ -78,7 +158,8 @@ enum
 	PROP_0,
 	PROP_ENABLE_TASKS,
 	PROP_TOKENS,
-	PROP_SCAN_ALL_DOCUMENTS
+	PROP_SCAN_ALL_DOCUMENTS,
+	PROP_SCAN_PROJECT
 };
 
 enum
@@ -95,10 +176,122 @@ enum
 static void ao_tasks_finalize  			(GObject *object);
 static void ao_tasks_show				(AoTasks *t);
 static void ao_tasks_hide				(AoTasks *t);
+static void ao_tasks_clear				(AoTasks *t);
+static void ao_tasks_project_scan_start	(AoTasks *t);
+static void ao_tasks_project_scan_cancel	(AoTasks *t);
+static void ao_tasks_project_files_clear	(AoTasks *t);
+static void ao_tasks_project_file_refresh	(AoTasks *t, const gchar *filename);
 
 G_DEFINE_TYPE(AoTasks, ao_tasks, G_TYPE_OBJECT)
 
 
+static void ao_tasks_matcher_free(AoTasksMatcher *matcher)
+{
+	if (matcher == NULL)
+		return;
+
+	g_free(matcher->next);
+	g_free(matcher->match);
+	g_free(matcher);
+}
+
+
+static AoTasksMatcher *ao_tasks_matcher_new(gchar **tokens)
+{
+	AoTasksMatcher *matcher;
+	gint *fail, *queue;
+	gint n_states = 1, max_states = 1;
+	gint i, c, head, tail;
+
+	for (i = 0; tokens[i] != NULL; i++)
+		max_states += strlen(tokens[i]);
+
+	matcher = g_new(AoTasksMatcher, 1);
+	matcher->next = g_malloc(max_states * sizeof *matcher->next);
+	matcher->match = g_new(gint, max_states);
+	fail = g_new(gint, max_states);
+	queue = g_new(gint, max_states);
+
+	memset(matcher->next[0], -1, sizeof *matcher->next);
+	matcher->match[0] = G_MAXINT;
+
+	/* build the trie of the tokens */
+	for (i = 0; tokens[i] != NULL; i++)
+	{
+		const guchar *p;
+		gint state = 0;
+
+		for (p = (const guchar *) tokens[i]; *p; p++)
+		{
+			if (matcher->next[state][*p] == -1)
+			{
+				memset(matcher->next[n_states], -1, sizeof *matcher->next);
+				matcher->match[n_states] = G_MAXINT;
+				matcher->next[state][*p] = n_states++;
+			}
+			state = matcher->next[state][*p];
+		}
+		if (state != 0)
+			matcher->match[state] = MIN(matcher->match[state], i);
+	}
+
+	/* add the failure transitions, breadth first */
+	head = tail = 0;
+	for (c = 0; c < 256; c++)
+	{
+		gint child = matcher->next[0][c];
+
+		if (child == -1)
+			matcher->next[0][c] = 0;
+		else
+		{
+			fail[child] = 0;
+			queue[tail++] = child;
+		}
+	}
+	while (head < tail)
+	{
+		gint state = queue[head++];
+
+		matcher->match[state] = MIN(matcher->match[state], matcher->match[fail[state]]);
+		for (c = 0; c < 256; c++)
+		{
+			gint child = matcher->next[state][c];
+
+			if (child == -1)
+				matcher->next[state][c] = matcher->next[fail[state]][c];
+			else
+			{
+				fail[child] = matcher->next[fail[state]][c];
+				queue[tail++] = child;
+			}
+		}
+	}
+
+	g_free(fail);
+	g_free(queue);
+
+	return matcher;
+}
+
+
+/* Returns the index of the first token (in the tokens order) found in text, or -1 */
+static gint ao_tasks_matcher_match(AoTasksMatcher *matcher, const gchar *text, gint len)
+{
+	gint i, state = 0;
+	gint best = G_MAXINT;
+
+	for (i = 0; i < len && best > 0; i++)
+	{
+		state = matcher->next[state][(guchar) text[i]];
+		if (matcher->match[state] < best)
+			best = matcher->match[state];
+	}
+
+	return (best == G_MAXINT) ? -1 : best;
+}
+
+
 static void ao_tasks_set_property(GObject *object, guint prop_id,
 								  const GValue *value, GParamSpec *pspec)
 {
@@ -122,15 +315,39 @@ static void ao_tasks_set_property(GObject *object, guint prop_id,
 		case PROP_SCAN_ALL_DOCUMENTS:
 		{
 			priv->scan_all_documents = g_value_get_boolean(value);
+			if (! priv->scan_all_documents)
+				ao_tasks_project_scan_cancel(AO_TASKS(object));
+			break;
+		}
+		case PROP_SCAN_PROJECT:
+		{
+			priv->scan_project = g_value_get_boolean(value);
+			if (! priv->scan_project)
+			{
+				ao_tasks_project_scan_cancel(AO_TASKS(object));
+				ao_tasks_project_files_clear(AO_TASKS(object));
+			}
+			else if (priv->project_scan == NULL)
+				ao_tasks_project_scan_start(AO_TASKS(object));
 			break;
 		}
 		case PROP_TOKENS:
 		{
 			const gchar *t = g_value_get_string(value);
+			gchar *old_tokens = priv->tokens ? g_strjoinv(";", priv->tokens) : NULL;
 			if (! NZV(t))
 				t = "TODO;FIXME"; /* fallback */
+			/* the cached tasks of the project files depend on the tokens */
+			if (! utils_str_equal(old_tokens, t))
+			{
+				ao_tasks_project_scan_cancel(AO_TASKS(object));
+				ao_tasks_project_files_clear(AO_TASKS(object));
+			}
+			g_free(old_tokens);
 			g_strfreev(priv->tokens);
 			priv->tokens = g_strsplit(t, ";", -1);
+			ao_tasks_matcher_free(priv->matcher);
+			priv->matcher = ao_tasks_matcher_new(priv->tokens);
 			ao_tasks_update(AO_TASKS(object), NULL);
 			break;
 		}
@@ -159,6 +376,15 @@ static void ao_tasks_class_init(AoTasksClass *klass)
 									TRUE,
 									G_PARAM_WRITABLE));
 
+	g_object_class_install_property(g_object_class,
+									PROP_SCAN_PROJECT,
+									g_param_spec_boolean(
+									"scan-project",
+									"scan-project",
+									"Whether to show tasks for all project files",
+									FALSE,
+									G_PARAM_WRITABLE));
+
 	g_object_class_install_property(g_object_class,
 									PROP_ENABLE_TASKS,
 									g_param_spec_boolean(
@@ -188,8 +414,11 @@ static void ao_tasks_finalize(GObject *object)
 
 	priv = AO_TASKS_GET_PRIVATE(object);
 	g_strfreev(priv->tokens);
+	ao_tasks_matcher_free(priv->matcher);
 
 	ao_tasks_hide(AO_TASKS(object));
+	g_hash_table_destroy(priv->doc_tasks);
+	g_hash_table_destroy(priv->project_files);
 
 	if (priv->selected_tasks != NULL)
 		g_hash_table_destroy(priv->selected_tasks);
@@ -287,6 +516,8 @@ static void ao_tasks_hide(AoTasks *t)
 {
 	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
 
+	ao_tasks_project_scan_cancel(t);
+	ao_tasks_clear(t);
 	if (priv->page)
 	{
 		gtk_widget_destroy(priv->page);
@@ -497,102 +728,909 @@ void ao_tasks_activate(AoTasks *t)
 }
 
 
+static void ao_task_free(AoTask *task)
+{
+	g_free(task->token);
+	g_free(task->text);
+	g_free(task->tooltip);
+	g_free(task);
+}
+
+
+static void ao_doc_tasks_free(AoDocTasks *dt)
+{
+	g_ptr_array_foreach(dt->tasks, (GFunc) ao_task_free, NULL);
+	g_ptr_array_free(dt->tasks, TRUE);
+	g_free(dt);
+}
+
+
+static void ao_project_file_free(AoProjectFile *pf)
+{
+	if (pf->tasks != NULL)
+	{
+		g_ptr_array_foreach(pf->tasks, (GFunc) ao_task_free, NULL);
+		g_ptr_array_free(pf->tasks, TRUE);
+	}
+	g_free(pf->display_name);
+	g_free(pf);
+}
+
+
+static void ao_tasks_insert_task(AoTasks *t, AoTask *task, const gchar *filename,
+								 const gchar *display_name)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+
+	gtk_list_store_insert_with_values(priv->store, &task->iter, -1,
+		TLIST_COL_FILENAME, filename,
+		TLIST_COL_DISPLAY_FILENAME, display_name,
+		TLIST_COL_LINE, task->line + 1,
+		TLIST_COL_TOKEN, task->token,
+		TLIST_COL_NAME, task->text,
+		TLIST_COL_TOOLTIP, task->tooltip,
+		-1);
+}
+
+
+static void ao_project_file_show(AoTasks *t, const gchar *filename, AoProjectFile *pf)
+{
+	guint i;
+
+	if (pf->shown)
+		return;
+
+	for (i = 0; i < pf->tasks->len; i++)
+		ao_tasks_insert_task(t, g_ptr_array_index(pf->tasks, i), filename, pf->display_name);
+	pf->shown = TRUE;
+}
+
+
+static void ao_project_file_hide(AoTasks *t, AoProjectFile *pf)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	guint i;
+
+	if (! pf->shown)
+		return;
+
+	for (i = 0; i < pf->tasks->len; i++)
+	{
+		AoTask *task = g_ptr_array_index(pf->tasks, i);
+		gtk_list_store_remove(priv->store, &task->iter);
+	}
+	pf->shown = FALSE;
+}
+
+
+static AoDocTasks *ao_tasks_get_doc_tasks(AoTasks *t, GeanyDocument *doc)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	AoDocTasks *dt = g_hash_table_lookup(priv->doc_tasks, doc);
+
+	if (dt == NULL)
+	{
+		dt = g_new0(AoDocTasks, 1);
+		dt->doc = doc;
+		dt->tasks = g_ptr_array_new();
+		dt->dirty_first = -1;
+		g_hash_table_insert(priv->doc_tasks, doc, dt);
+	}
+	return dt;
+}
+
+
+/* removes all tasks, e.g. before the store gets cleared */
+static void ao_tasks_clear(AoTasks *t)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	GHashTableIter iter;
+	AoProjectFile *pf;
+
+	g_hash_table_remove_all(priv->doc_tasks);
+	if (priv->rescan_source_id != 0)
+	{
+		g_source_remove(priv->rescan_source_id);
+		priv->rescan_source_id = 0;
+	}
+
+	/* the tasks of the project files stay cached */
+	g_hash_table_iter_init(&iter, priv->project_files);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &pf))
+		pf->shown = FALSE;
+}
+
+
 void ao_tasks_remove(AoTasks *t, GeanyDocument *cur_doc)
 {
 	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
-	GtkTreeModel *model = GTK_TREE_MODEL(priv->store);
-	GtkTreeIter iter;
-	gchar *filename;
+	AoDocTasks *dt;
+	guint i;
 
 	if (! priv->active)
 		return;
 
-	if (gtk_tree_model_get_iter_first(model, &iter))
+	dt = g_hash_table_lookup(priv->doc_tasks, cur_doc);
+	if (dt != NULL)
+	{
+		for (i = 0; i < dt->tasks->len; i++)
+		{
+			AoTask *task = g_ptr_array_index(dt->tasks, i);
+			gtk_list_store_remove(priv->store, &task->iter);
+		}
+		g_hash_table_remove(priv->doc_tasks, cur_doc);
+	}
+
+	/* show the tasks of the file again if it is part of the project */
+	if (cur_doc->real_path != NULL)
+		ao_tasks_project_file_refresh(t, DOC_FILENAME(cur_doc));
+}
+
+
+/* returns the index of the first task at or after line */
+static guint ao_doc_tasks_find_line(AoDocTasks *dt, gint line)
+{
+	guint lo = 0, hi = dt->tasks->len;
+
+	while (lo < hi)
+	{
+		guint mid = (lo + hi) / 2;
+
+		if (((AoTask *) g_ptr_array_index(dt->tasks, mid))->line < line)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+/* Creates a task for the line of text, next_text is used as context for the tooltip and
+ * may be NULL. Doesn't use any state of AoTasks, so it can be called from the project scan
+ * thread. */
+static AoTask *create_task(gchar **tokens, gint token_index, gint line,
+						   const gchar *line_text, gint line_len,
+						   const gchar *next_text, gint next_len)
+{
+	const gchar *token = tokens[token_index];
+	gchar *line_buf, *task_start, *context;
+	AoTask *task;
+
+	line_buf = g_strstrip(g_strndup(line_text, line_len));
+	task_start = strstr(line_buf, token);
+	if (task_start == NULL)
+	{	/* the token spans leading or trailing whitespace */
+		g_free(line_buf);
+		return NULL;
+	}
+
+	/* skip the token and additional whitespace */
+	task_start += strlen(token);
+	while (*task_start == ' ' || *task_start == ':')
+		task_start++;
+	/* reset task_start in case there is no text following */
+	if (! NZV(task_start))
+		task_start = line_buf;
+
+	/* use the following line for the tooltip */
+	if (next_text != NULL)
+		context = g_strstrip(g_strndup(next_text, next_len));
+	else
+		context = g_strdup("");
+	setptr(context, g_strconcat(
+		_("Context:"), "\n", line_buf, "\n", context, NULL));
+
+	task = g_new0(AoTask, 1);
+	task->line = line;
+	task->token = g_strdup(token);
+	task->text = g_strdup(task_start);
+	task->tooltip = g_markup_escape_text(context, -1);
+
+	g_free(context);
+	g_free(line_buf);
+
+	return task;
+}
+
+
+static gboolean ao_task_equal(AoTask *a, AoTask *b)
+{
+	return utils_str_equal(a->token, b->token) &&
+		utils_str_equal(a->text, b->text) &&
+		utils_str_equal(a->tooltip, b->tooltip);
+}
+
+
+/* Scans the lines first to last of the document and applies the differences to the store */
+static void scan_lines(AoTasks *t, AoDocTasks *dt, gint first, gint last)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	ScintillaObject *sci = dt->doc->editor->sci;
+	const gchar *text;
+	gchar *display_name;
+	GPtrArray *tasks;
+	guint i, lo, hi;
+	gint line, line_count;
+
+	line_count = sci_get_line_count(sci);
+	first = MAX(first, 0);
+	last = MIN(last, line_count - 1);
+	if (first > last)
+		return;
+
+	text = (const gchar *) scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	display_name = document_get_basename_for_display(dt->doc, -1);
+
+	lo = ao_doc_tasks_find_line(dt, first);
+	hi = ao_doc_tasks_find_line(dt, last + 1);
+
+	tasks = g_ptr_array_sized_new(dt->tasks->len);
+	for (i = 0; i < lo; i++)
+		g_ptr_array_add(tasks, g_ptr_array_index(dt->tasks, i));
+
+	i = lo;
+	for (line = first; line <= last; line++)
 	{
-		gboolean has_next;
+		gint start = sci_get_position_from_line(sci, line);
+		gint end = sci_get_line_end_position(sci, line);
+		gint token_index = ao_tasks_matcher_match(priv->matcher, text + start, end - start);
+		AoTask *task = NULL, *old = NULL;
 
-		do
+		if (token_index >= 0)
 		{
-			gtk_tree_model_get(model, &iter, TLIST_COL_FILENAME, &filename, -1);
+			const gchar *next_text = NULL;
+			gint next_start = 0, next_end = 0;
 
-			if (utils_str_equal(filename, cur_doc->file_name))
-			{	/* gtk_list_store_remove() manages the iter and set it to the next row */
-				has_next = gtk_list_store_remove(priv->store, &iter);
+			if (line + 1 < line_count)
+			{
+				next_start = sci_get_position_from_line(sci, line + 1);
+				next_end = sci_get_line_end_position(sci, line + 1);
+				next_text = text + next_start;
 			}
-			else
-			{	/* if we didn't delete the row, we need to manage the iter manually */
-				has_next = gtk_tree_model_iter_next(model, &iter);
+			task = create_task(priv->tokens, token_index, line, text + start, end - start,
+				next_text, next_end - next_start);
+		}
+
+		/* remove the previous tasks up to this line */
+		for (; i < hi; i++)
+		{
+			old = g_ptr_array_index(dt->tasks, i);
+			if (old->line > line)
+				break;
+			if (old->line == line && task != NULL)
+			{
+				i++;
+				break;
 			}
-			g_free(filename);
+			gtk_list_store_remove(priv->store, &old->iter);
+			ao_task_free(old);
+			old = NULL;
+		}
+		if (old != NULL && old->line != line)
+			old = NULL;
+
+		if (task == NULL)
+			continue;
+
+		if (old == NULL)
+			ao_tasks_insert_task(t, task, DOC_FILENAME(dt->doc), display_name);
+		else if (ao_task_equal(old, task))
+		{	/* unchanged, keep the row */
+			ao_task_free(task);
+			task = old;
+		}
+		else
+		{
+			task->iter = old->iter;
+			gtk_list_store_set(priv->store, &task->iter,
+				TLIST_COL_TOKEN, task->token,
+				TLIST_COL_NAME, task->text,
+				TLIST_COL_TOOLTIP, task->tooltip,
+				-1);
+			ao_task_free(old);
 		}
-		while (has_next);
+		g_ptr_array_add(tasks, task);
+	}
+	/* tasks left after the last line found */
+	for (; i < hi; i++)
+	{
+		AoTask *old = g_ptr_array_index(dt->tasks, i);
+
+		gtk_list_store_remove(priv->store, &old->iter);
+		ao_task_free(old);
+	}
+
+	for (i = hi; i < dt->tasks->len; i++)
+		g_ptr_array_add(tasks, g_ptr_array_index(dt->tasks, i));
+
+	g_ptr_array_free(dt->tasks, TRUE);
+	dt->tasks = tasks;
+	g_free(display_name);
+}
+
+
+static void update_tasks_for_doc(AoTasks *t, GeanyDocument *doc)
+{
+	if (doc->is_valid)
+	{
+		AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+		AoDocTasks *dt = ao_tasks_get_doc_tasks(t, doc);
+		AoProjectFile *pf = g_hash_table_lookup(priv->project_files, DOC_FILENAME(doc));
+
+		/* the document's own tasks replace the ones read from disk */
+		if (pf != NULL)
+			ao_project_file_hide(t, pf);
+
+		dt->dirty_first = -1;
+		scan_lines(t, dt, 0, sci_get_line_count(doc->editor->sci) - 1);
 	}
 }
 
 
-static void create_task(AoTasks *t, GeanyDocument *doc, gint line, const gchar *token,
-						const gchar *line_buf, const gchar *task_start, const gchar *display_name)
+static void rescan_dirty_lines(gpointer key, AoDocTasks *dt, AoTasks *t)
+{
+	if (dt->dirty_first != -1 && dt->doc->is_valid)
+		scan_lines(t, dt, dt->dirty_first, dt->dirty_last);
+	dt->dirty_first = -1;
+}
+
+
+static gboolean rescan_dirty_lines_cb(gpointer t)
 {
 	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
-	gchar *context, *tooltip;
 
-	/* retrieve the following line and use it for the tooltip */
-	context = g_strstrip(sci_get_line(doc->editor->sci, line + 1));
-	setptr(context, g_strconcat(
-		_("Context:"), "\n", line_buf, "\n", context, NULL));
-	tooltip = g_markup_escape_text(context, -1);
+	g_hash_table_foreach(priv->doc_tasks, (GHFunc) rescan_dirty_lines, t);
+	priv->rescan_source_id = 0;
 
-	/* add the task into the list */
-	gtk_list_store_insert_with_values(priv->store, NULL, -1,
-		TLIST_COL_FILENAME, DOC_FILENAME(doc),
-		TLIST_COL_DISPLAY_FILENAME, display_name,
-		TLIST_COL_LINE, line + 1,
-		TLIST_COL_TOKEN, token,
-		TLIST_COL_NAME, task_start,
-		TLIST_COL_TOOLTIP, tooltip,
-		-1);
-	g_free(context);
-	g_free(tooltip);
+	return FALSE;
 }
 
 
-static void update_tasks_for_doc(AoTasks *t, GeanyDocument *doc)
+/* Keeps the line numbers of the tasks in sync with the document and schedules a rescan of
+ * the modified lines */
+void ao_tasks_editor_notify(AoTasks *t, GeanyEditor *editor, SCNotification *nt)
 {
-	gint lines, line;
-	gchar *line_buf, *display_name, *task_start;
-	gchar **token;
 	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	AoDocTasks *dt;
+	gint line, lines_added;
+	guint i;
 
-	if (doc->is_valid)
+	if (! priv->active || ! priv->enable_tasks || nt->nmhdr.code != SCN_MODIFIED ||
+		! (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+		return;
+
+	dt = g_hash_table_lookup(priv->doc_tasks, editor->document);
+	if (dt == NULL)
+		return;
+
+	line = sci_get_line_from_position(editor->sci, nt->position);
+	lines_added = nt->linesAdded;
+
+	if (lines_added != 0)
 	{
-		display_name = document_get_basename_for_display(doc, -1);
-		lines = sci_get_line_count(doc->editor->sci);
-		for (line = 0; line < lines; line++)
+		/* drop the tasks of deleted lines, they were joined into line */
+		i = ao_doc_tasks_find_line(dt, line + 1);
+		while (lines_added < 0 && i < dt->tasks->len)
+		{
+			AoTask *task = g_ptr_array_index(dt->tasks, i);
+
+			if (task->line > line - lines_added)
+				break;
+			gtk_list_store_remove(priv->store, &task->iter);
+			ao_task_free(task);
+			g_ptr_array_remove_index(dt->tasks, i);
+		}
+		/* move the following ones */
+		for (; i < dt->tasks->len; i++)
 		{
-			line_buf = g_strstrip(sci_get_line(doc->editor->sci, line));
-			token = priv->tokens;
-			while (*token != NULL)
+			AoTask *task = g_ptr_array_index(dt->tasks, i);
+
+			task->line += lines_added;
+			gtk_list_store_set(priv->store, &task->iter, TLIST_COL_LINE, task->line + 1, -1);
+		}
+		if (dt->dirty_first != -1)
+		{
+			if (dt->dirty_first > line)
+				dt->dirty_first = MAX(line, dt->dirty_first + lines_added);
+			if (dt->dirty_last > line)
+				dt->dirty_last = MAX(line, dt->dirty_last + lines_added);
+		}
+	}
+
+	/* the previous line shows the modified one in its tooltip */
+	if (dt->dirty_first == -1)
+	{
+		dt->dirty_first = line - 1;
+		dt->dirty_last = line + MAX(lines_added, 0);
+	}
+	else
+	{
+		dt->dirty_first = MIN(dt->dirty_first, line - 1);
+		dt->dirty_last = MAX(dt->dirty_last, line + MAX(lines_added, 0));
+	}
+
+	if (priv->rescan_source_id == 0)
+		priv->rescan_source_id = plugin_timeout_add(geany_plugin, 300, rescan_dirty_lines_cb, t);
+}
+
+
+/* Reads the tasks of a file on disk, returns an empty array for unreadable or binary files */
+static GPtrArray *scan_file(gchar **tokens, AoTasksMatcher *matcher, const gchar *locale_filename)
+{
+	GPtrArray *tasks = g_ptr_array_new();
+	GMappedFile *file = g_mapped_file_new(locale_filename, FALSE, NULL);
+	const gchar *text, *end, *p;
+	gsize len;
+	gint line = 0;
+
+	if (file == NULL)
+		return tasks;
+
+	text = g_mapped_file_get_contents(file);
+	len = g_mapped_file_get_length(file);
+	if (text == NULL || memchr(text, '\0', MIN(len, 4096)) != NULL)
+	{
+		g_mapped_file_unref(file);
+		return tasks;
+	}
+
+	end = text + len;
+	for (p = text; p < end; line++)
+	{
+		const gchar *eol = memchr(p, '\n', end - p);
+		const gchar *next = (eol != NULL) ? eol + 1 : end;
+		gint token_index;
+
+		if (eol == NULL)
+			eol = end;
+
+		token_index = ao_tasks_matcher_match(matcher, p, eol - p);
+		/* the store only takes UTF-8, skip lines in other encodings */
+		if (token_index >= 0 && g_utf8_validate(p, eol - p, NULL))
+		{
+			const gchar *next_eol = NULL;
+			AoTask *task;
+
+			if (next < end)
 			{
-				if (NZV(*token) && (task_start = strstr(line_buf, *token)) != NULL)
+				next_eol = memchr(next, '\n', end - next);
+				if (next_eol == NULL)
+					next_eol = end;
+				if (! g_utf8_validate(next, next_eol - next, NULL))
+					next_eol = NULL;
+			}
+			task = create_task(tokens, token_index, line, p, eol - p,
+				(next_eol != NULL) ? next : NULL, (next_eol != NULL) ? next_eol - next : 0);
+			if (task != NULL)
+				g_ptr_array_add(tasks, task);
+		}
+		p = next;
+	}
+
+	g_mapped_file_unref(file);
+	return tasks;
+}
+
+
+static gchar *get_project_base_path(void)
+{
+	GeanyProject *project = geany->app->project;
+	gchar *dir, *path, *locale_path;
+
+	if (g_path_is_absolute(project->base_path))
+		path = g_strdup(project->base_path);
+	else
+	{	/* relative to the project file */
+		dir = g_path_get_dirname(project->file_name);
+		path = NZV(project->base_path) ? g_build_filename(dir, project->base_path, NULL) : g_strdup(dir);
+		g_free(dir);
+	}
+	locale_path = utils_get_locale_from_utf8(path);
+	g_free(path);
+
+	return locale_path;
+}
+
+
+static GPatternSpec **project_patterns_new(void)
+{
+	gchar **file_patterns = geany->app->project->file_patterns;
+	guint i, len = (file_patterns != NULL) ? g_strv_length(file_patterns) : 0;
+	GPatternSpec **patterns = g_new(GPatternSpec *, len + 1);
+
+	for (i = 0; i < len; i++)
+		patterns[i] = g_pattern_spec_new(file_patterns[i]);
+	patterns[len] = NULL;
+
+	return patterns;
+}
+
+
+static void project_patterns_free(GPatternSpec **patterns)
+{
+	GPatternSpec **p;
+
+	for (p = patterns; *p != NULL; p++)
+		g_pattern_spec_free(*p);
+	g_free(patterns);
+}
+
+
+/* all files match if the project doesn't define any patterns */
+static gboolean project_patterns_match(GPatternSpec **patterns, const gchar *utf8_filename)
+{
+	gchar *basename;
+	gboolean ret = (*patterns == NULL);
+
+	basename = g_path_get_basename(utf8_filename);
+	for (; *patterns != NULL && ! ret; patterns++)
+		ret = g_pattern_match_string(*patterns, basename);
+	g_free(basename);
+
+	return ret;
+}
+
+
+static void project_scan_result_free(AoProjectScanResult *result)
+{
+	if (result->tasks != NULL)
+	{
+		g_ptr_array_foreach(result->tasks, (GFunc) ao_task_free, NULL);
+		g_ptr_array_free(result->tasks, TRUE);
+	}
+	g_free(result->filename);
+	g_free(result);
+}
+
+
+static void project_scan_unref(AoProjectScan *job)
+{
+	if (! g_atomic_int_dec_and_test(&job->ref_count))
+		return;
+
+	g_free(job->base_path);
+	project_patterns_free(job->patterns);
+	g_strfreev(job->tokens);
+	ao_tasks_matcher_free(job->matcher);
+	g_hash_table_destroy(job->mtimes);
+	g_hash_table_destroy(job->seen);
+	g_slist_foreach(job->results, (GFunc) project_scan_result_free, NULL);
+	g_slist_free(job->results);
+	g_mutex_free(job->lock);
+	g_free(job);
+}
+
+
+/* Replaces the cached tasks of a file with the ones of result */
+static void project_scan_apply(AoTasks *t, AoProjectScanResult *result, gboolean show)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	AoProjectFile *pf = g_hash_table_lookup(priv->project_files, result->filename);
+
+	if (pf == NULL)
+	{
+		pf = g_new0(AoProjectFile, 1);
+		pf->display_name = g_path_get_basename(result->filename);
+		g_hash_table_insert(priv->project_files, g_strdup(result->filename), pf);
+	}
+	else
+	{
+		ao_project_file_hide(t, pf);
+		g_ptr_array_foreach(pf->tasks, (GFunc) ao_task_free, NULL);
+		g_ptr_array_free(pf->tasks, TRUE);
+	}
+	pf->mtime = result->mtime;
+	pf->tasks = result->tasks;
+	result->tasks = NULL;
+
+	if (show)
+		ao_project_file_show(t, result->filename, pf);
+}
+
+
+/* open documents show their own tasks */
+static gboolean project_file_is_visible(AoTasksPrivate *priv, const gchar *filename)
+{
+	return priv->scan_all_documents && document_find_by_filename(filename) == NULL;
+}
+
+
+static gboolean remove_unseen_project_file(gpointer key, gpointer value, gpointer data)
+{
+	AoProjectScan *job = data;
+
+	if (g_hash_table_lookup(job->seen, key) != NULL)
+		return FALSE;
+
+	ao_project_file_hide(job->t, value);
+	return TRUE;
+}
+
+
+static gboolean project_scan_idle_cb(gpointer data)
+{
+	AoProjectScan *job = data;
+	GSList *results, *node;
+	gboolean finished;
+
+	g_mutex_lock(job->lock);
+	results = g_slist_reverse(job->results);
+	job->results = NULL;
+	finished = job->finished;
+	job->idle_pending = FALSE;
+	g_mutex_unlock(job->lock);
+
+	/* the AoTasks object may be gone already if the scan was cancelled */
+	if (! g_atomic_int_get(&job->cancelled))
+	{
+		AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(job->t);
+
+		for (node = results; node != NULL; node = node->next)
+		{
+			AoProjectScanResult *result = node->data;
+
+			project_scan_apply(job->t, result, project_file_is_visible(priv, result->filename));
+		}
+
+		if (finished)
+		{
+			g_hash_table_foreach_remove(priv->project_files, remove_unseen_project_file, job);
+			priv->project_scan = NULL;
+			project_scan_unref(job);
+		}
+	}
+
+	g_slist_foreach(results, (GFunc) project_scan_result_free, NULL);
+	g_slist_free(results);
+	project_scan_unref(job);
+
+	return FALSE;
+}
+
+
+/* Passes a result to the main loop, NULL signals the end of the scan */
+static void project_scan_post(AoProjectScan *job, AoProjectScanResult *result)
+{
+	g_mutex_lock(job->lock);
+	if (result != NULL)
+		job->results = g_slist_prepend(job->results, result);
+	else
+		job->finished = TRUE;
+	if (! job->idle_pending)
+	{
+		job->idle_pending = TRUE;
+		g_atomic_int_inc(&job->ref_count);
+		g_idle_add(project_scan_idle_cb, job);
+	}
+	g_mutex_unlock(job->lock);
+}
+
+
+static void project_scan_file(AoProjectScan *job, const gchar *locale_filename, struct stat *st)
+{
+	gchar *filename = utils_get_utf8_from_locale(locale_filename);
+	time_t *cached_mtime;
+	AoProjectScanResult *result;
+
+	if (! project_patterns_match(job->patterns, filename))
+	{
+		g_free(filename);
+		return;
+	}
+
+	g_hash_table_insert(job->seen, filename, filename);
+
+	cached_mtime = g_hash_table_lookup(job->mtimes, filename);
+	if (cached_mtime != NULL && *cached_mtime == st->st_mtime)
+		return;
+
+	result = g_new0(AoProjectScanResult, 1);
+	result->filename = g_strdup(filename);
+	result->mtime = st->st_mtime;
+	if (st->st_size <= AO_TASKS_PROJECT_MAX_FILE_SIZE)
+		result->tasks = scan_file(job->tokens, job->matcher, locale_filename);
+	else
+		result->tasks = g_ptr_array_new();
+
+	project_scan_post(job, result);
+}
+
+
+static gpointer project_scan_thread(gpointer data)
+{
+	AoProjectScan *job = data;
+	GQueue *dirs = g_queue_new();
+	gchar *dir;
+
+	g_queue_push_tail(dirs, g_strdup(job->base_path));
+	while ((dir = g_queue_pop_head(dirs)) != NULL)
+	{
+		GDir *d = NULL;
+		const gchar *name;
+
+		if (! g_atomic_int_get(&job->cancelled))
+			d = g_dir_open(dir, 0, NULL);
+		while (d != NULL && (name = g_dir_read_name(d)) != NULL &&
+			   ! g_atomic_int_get(&job->cancelled))
+		{
+			gchar *path;
+			struct stat st;
+
+			/* skip hidden files and directories, e.g. those of version control systems */
+			if (name[0] == '.')
+				continue;
+
+			path = g_build_filename(dir, name, NULL);
+			if (g_stat(path, &st) == 0)
+			{
+				if (S_ISDIR(st.st_mode))
 				{
-					/* skip the token and additional whitespace */
-					task_start += strlen(*token);
-					while (*task_start == ' ' || *task_start == ':')
-						task_start++;
-					/* reset task_start in case there is no text following */
-					if (! NZV(task_start))
-						task_start = line_buf;
-					/* create the task */
-					create_task(t, doc, line, *token, line_buf, task_start, display_name);
-					/* if we found a token, continue on next line */
-					break;
+					if (! g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+					{
+						g_queue_push_tail(dirs, path);
+						path = NULL;
+					}
 				}
-				token++;
+				else if (S_ISREG(st.st_mode))
+					project_scan_file(job, path, &st);
 			}
-			g_free(line_buf);
+			g_free(path);
 		}
-		g_free(display_name);
+		if (d != NULL)
+			g_dir_close(d);
+		g_free(dir);
 	}
+	g_queue_free(dirs);
+
+	if (! g_atomic_int_get(&job->cancelled))
+		project_scan_post(job, NULL);
+	project_scan_unref(job);
+
+	return NULL;
+}
+
+
+static gboolean project_scan_enabled(AoTasksPrivate *priv)
+{
+	return priv->active && priv->enable_tasks && priv->scan_all_documents &&
+		priv->scan_project && geany->app->project != NULL;
+}
+
+
+static void ao_tasks_project_scan_cancel(AoTasks *t)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+
+	if (priv->project_scan == NULL)
+		return;
+
+	g_atomic_int_set(&priv->project_scan->cancelled, TRUE);
+	project_scan_unref(priv->project_scan);
+	priv->project_scan = NULL;
+}
+
+
+/* Starts a scan of the project files, the tasks of the files not modified since the last
+ * scan are kept */
+static void ao_tasks_project_scan_start(AoTasks *t)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	AoProjectScan *job;
+	GHashTableIter iter;
+	gpointer key;
+	AoProjectFile *pf;
+
+	ao_tasks_project_scan_cancel(t);
+	if (! project_scan_enabled(priv))
+		return;
+
+	job = g_new0(AoProjectScan, 1);
+	job->ref_count = 2; /* one for us and one for the thread */
+	job->t = t;
+	job->base_path = get_project_base_path();
+	job->patterns = project_patterns_new();
+	job->tokens = g_strdupv(priv->tokens);
+	job->matcher = ao_tasks_matcher_new(job->tokens);
+	job->mtimes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	job->seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	job->lock = g_mutex_new();
+
+	g_hash_table_iter_init(&iter, priv->project_files);
+	while (g_hash_table_iter_next(&iter, &key, (gpointer *) &pf))
+		g_hash_table_insert(job->mtimes, g_strdup(key), g_memdup(&pf->mtime, sizeof pf->mtime));
+
+	if (g_thread_create(project_scan_thread, job, FALSE, NULL) == NULL)
+	{
+		job->ref_count = 1;
+		project_scan_unref(job);
+		return;
+	}
+	priv->project_scan = job;
+}
+
+
+static void ao_tasks_project_files_clear(AoTasks *t)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	GHashTableIter iter;
+	AoProjectFile *pf;
+
+	g_hash_table_iter_init(&iter, priv->project_files);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &pf))
+		ao_project_file_hide(t, pf);
+	g_hash_table_remove_all(priv->project_files);
+}
+
+
+/* Rereads the tasks of a single project file if it was modified, e.g. when its document
+ * gets closed after it was saved */
+static void ao_tasks_project_file_refresh(AoTasks *t, const gchar *filename)
+{
+	AoTasksPrivate *priv = AO_TASKS_GET_PRIVATE(t);
+	AoProjectFile *pf;
+	AoProjectScanResult result;
+	gchar *locale_filename;
+	struct stat st;
+
+	if (! project_scan_enabled(priv))
+		return;
+
+	pf = g_hash_table_lookup(priv->project_files, filename);
+	locale_filename = utils_get_locale_from_utf8(filename);
+
+	if (pf == NULL)
+	{	/* maybe a new file of the project */
+		gchar *base_path = get_project_base_path();
+		GPatternSpec **patterns = project_patterns_new();
+		gsize len = strlen(base_path);
+		gboolean in_project = strncmp(locale_filename, base_path, len) == 0 &&
+			G_IS_DIR_SEPARATOR(locale_filename[len]) &&
+			project_patterns_match(patterns, filename);
+
+		project_patterns_free(patterns);
+		g_free(base_path);
+		if (! in_project)
+		{
+			g_free(locale_filename);
+			return;
+		}
+	}
+
+	if (g_stat(locale_filename, &st) != 0 || ! S_ISREG(st.st_mode))
+	{
+		if (pf != NULL)
+		{
+			ao_project_file_hide(t, pf);
+			g_hash_table_remove(priv->project_files, filename);
+		}
+	}
+	else if (pf == NULL || pf->mtime != st.st_mtime)
+	{
+		result.filename = (gchar *) filename;
+		result.mtime = st.st_mtime;
+		if (st.st_size <= AO_TASKS_PROJECT_MAX_FILE_SIZE)
+			result.tasks = scan_file(priv->tokens, priv->matcher, locale_filename);
+		else
+			result.tasks = g_ptr_array_new();
+		project_scan_apply(t, &result, TRUE);
+	}
+	else
+		ao_project_file_show(t, filename, pf);
+
+	g_free(locale_filename);
+}
+
+
+void ao_tasks_project_open(AoTasks *t)
+{
+	ao_tasks_project_scan_start(t);
+}
+
+
+void ao_tasks_project_close(AoTasks *t)
+{
+	ao_tasks_project_scan_cancel(t);
+	ao_tasks_project_files_clear(t);
 }
 
 
@@ -606,6 +1644,7 @@ void ao_tasks_update_single(AoTasks *t, GeanyDocument *cur_doc)
 	if (! priv->scan_all_documents)
 	{
 		/* update */
+		ao_tasks_clear(t);
 		gtk_list_store_clear(priv->store);
 		ao_tasks_update(t, cur_doc);
 	}
@@ -667,6 +1706,7 @@ void ao_tasks_update(AoTasks *t, GeanyDocument *cur_doc)
 	if (! priv->scan_all_documents && cur_doc == NULL)
 	{
 		/* clear all */
+		ao_tasks_clear(t);
 		gtk_list_store_clear(priv->store);
 		/* get the current document */
 		cur_doc = document_get_current();
@@ -675,19 +1715,34 @@ void ao_tasks_update(AoTasks *t, GeanyDocument *cur_doc)
 	if (cur_doc != NULL)
 	{
 		/* TODO handle renaming of files, probably we need a new signal for this */
-		ao_tasks_remove(t, cur_doc);
 		update_tasks_for_doc(t, cur_doc);
 	}
 	else
 	{
 		guint i;
 		/* clear all */
+		ao_tasks_clear(t);
 		gtk_list_store_clear(priv->store);
 		/* iterate over all docs */
 		foreach_document(i)
 		{
 			update_tasks_for_doc(t, documents[i]);
 		}
+		/* show the cached tasks of the project files and look for modified ones */
+		if (project_scan_enabled(priv))
+		{
+			GHashTableIter iter;
+			gpointer key;
+			AoProjectFile *pf;
+
+			g_hash_table_iter_init(&iter, priv->project_files);
+			while (g_hash_table_iter_next(&iter, &key, (gpointer *) &pf))
+			{
+				if (project_file_is_visible(priv, key))
+					ao_project_file_show(t, key, pf);
+			}
+			ao_tasks_project_scan_start(t);
+		}
 	}
 	/* restore selection */
 	priv->ignore_selection_changed = TRUE;
@@ -711,6 +1766,13 @@ static void ao_tasks_init(AoTasks *self)
 	priv->page = NULL;
 	priv->popup_menu = NULL;
 	priv->tokens = NULL;
+	priv->matcher = NULL;
+	priv->doc_tasks = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify) ao_doc_tasks_free);
+	priv->rescan_source_id = 0;
+	priv->project_files = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) ao_project_file_free);
+	priv->project_scan = NULL;
 	priv->active = FALSE;
 	priv->ignore_selection_changed = FALSE;
 
@@ -723,10 +1785,12 @@ static void ao_tasks_init(AoTasks *self)
 }
 
 
-AoTasks *ao_tasks_new(gboolean enable, const gchar *tokens, gboolean scan_all_documents)
+AoTasks *ao_tasks_new(gboolean enable, const gchar *tokens, gboolean scan_all_documents,
+					  gboolean scan_project)
 {
 	return g_object_new(AO_TASKS_TYPE,
 		"scan-all-documents", scan_all_documents,
+		"scan-project", scan_project,
 		"tokens", tokens,
 		"enable-tasks", enable, NULL);
 }
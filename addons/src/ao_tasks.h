@@ -38,12 +38,16 @@ typedef struct _AoTasksClass	AoTasksClass;
 GType			ao_tasks_get_type		(void);
 AoTasks*		ao_tasks_new			(gboolean enable,
 										 const gchar *tokens,
-										 gboolean scan_all_documents);
+										 gboolean scan_all_documents,
+										 gboolean scan_project);
 void			ao_tasks_update			(AoTasks *t, GeanyDocument *cur_doc);
 void			ao_tasks_update_single	(AoTasks *t, GeanyDocument *cur_doc);
 void			ao_tasks_remove			(AoTasks *t, GeanyDocument *cur_doc);
 void			ao_tasks_activate		(AoTasks *t);
 void			ao_tasks_set_active		(AoTasks *t);
+void			ao_tasks_editor_notify	(AoTasks *t, GeanyEditor *editor, SCNotification *nt);
+void			ao_tasks_project_open	(AoTasks *t);
+void			ao_tasks_project_close	(AoTasks *t);
 
 G_END_DECLS
 
@@ -2,6 +2,9 @@ AC_DEFUN([GP_CHECK_GPROJECT],
 [
     GP_ARG_DISABLE([GProject], [yes])
     GP_STATUS_PLUGIN_ADD([GProject], [$enable_gproject])
+    dnl nanoseconds of the directory mtimes, for the project cache
+    AC_CHECK_MEMBERS([struct stat.st_mtim.tv_nsec], [], [],
+                     [[#include <sys/stat.h>]])
     AC_CONFIG_FILES([
         gproject/Makefile
         gproject/src/Makefile
@@ -10,5 +10,6 @@ AC_DEFUN([GP_CHECK_PRETTYPRINTER],
     AC_CONFIG_FILES([
         pretty-printer/Makefile
         pretty-printer/src/Makefile
+        pretty-printer/tests/Makefile
     ])
 ])
@@ -85,11 +85,13 @@ struct {
   GtkWidget    *view;
   GtkListStore *store;
   GtkTreeModel *sort;
+  /* storage for the casefolded keys of the rows in the store */
+  GStringChunk *keys;
   
   GtkTreePath  *last_path;
 } plugin_data = {
   NULL, NULL, NULL,
-  NULL, NULL,
+  NULL, NULL, NULL,
   NULL
 };
 
@@ -105,59 +107,109 @@ enum {
   COL_TYPE,
   COL_WIDGET,
   COL_DOCUMENT,
+  COL_KEY,    /* casefolded COL_PATH, owned by plugin_data.keys */
+  COL_SCORE,  /* score of the row against the current key */
   COL_COUNT
 };
 
 
+/* maximum number of project files shown in the panel at once */
+#define PROJECT_MAX_RESULTS 200
+/* maximum time spent walking the project directory per idle callback */
+#define PROJECT_WALK_SLICE  0.01 /* seconds */
+
 #define SEPARATORS        " -_/\\\"'"
 #define IS_SEPARATOR(c)   (strchr (SEPARATORS, (c)))
 #define next_separator(p) (strpbrk (p, SEPARATORS))
 
+/* working memory of get_score(), grown as needed */
+static struct {
+  gint  *data;
+  gsize  size;
+} score_buffer = { NULL, 0 };
+
 /* TODO: be more tolerant regarding unmatched character in the needle.
  * Right now, we implicitly accept unmatched characters at the end of the
  * needle but absolutely not at the start.  e.g. "xpy" won't match "python" at
- * all, though "pyx" will. */
-static inline gint
+ * all, though "pyx" will.
+ * 
+ * This is the number of characters of @needle that can be matched in order in
+ * @haystack, where a run of matched characters may only jump to the start of
+ * another word of @haystack.  It is computed bottom-up, one row of the
+ * (needle × haystack) table at a time, in O(needle × haystack) time. */
+static gint
 get_score (const gchar *needle,
            const gchar *haystack)
 {
+  gsize   n;
+  gsize   m;
+  gsize   i;
+  gsize   j;
+  gint   *next_sep;
+  gint   *row;
+  gint   *prev;
+  
   if (needle == NULL || haystack == NULL ||
       *needle == '\0' || *haystack == '\0') {
     return 0;
   }
   
-  if (IS_SEPARATOR (*haystack)) {
-    return get_score (needle, haystack + 1);
+  n = strlen (needle);
+  m = strlen (haystack);
+  
+  if (score_buffer.size < 3 * (m + 1)) {
+    score_buffer.size = 3 * (m + 1);
+    score_buffer.data = g_renew (gint, score_buffer.data, score_buffer.size);
   }
-
-  if (IS_SEPARATOR (*needle)) {
-    return get_score (needle + 1, next_separator (haystack));
+  next_sep  = score_buffer.data;
+  row       = next_sep + m + 1;
+  prev      = row + m + 1;
+  
+  /* next_sep[j] is the position of the first separator at or after j, so
+   * haystack[j] is a separator if next_sep[j] == j */
+  next_sep[m] = (gint) m;
+  for (j = m; j-- > 0; ) {
+    next_sep[j] = IS_SEPARATOR (haystack[j]) ? (gint) j : next_sep[j + 1];
   }
-
-  if (*needle == *haystack) {
-    gint a = get_score (needle + 1, haystack + 1) + 1;
-    gint b = get_score (needle, next_separator (haystack));
+  
+  /* prev[j] is the score of needle + i + 1 against haystack + j */
+  memset (prev, 0, (m + 1) * sizeof *prev);
+  for (i = n; i-- > 0; ) {
+    gboolean  needle_sep = IS_SEPARATOR (needle[i]) != NULL;
+    gint     *tmp;
     
-    return MAX (a, b);
-  } else {
-    return get_score (needle, next_separator (haystack));
+    row[m] = 0;
+    for (j = m; j-- > 0; ) {
+      if (next_sep[j] == (gint) j) {
+        row[j] = row[j + 1];
+      } else if (needle_sep) {
+        row[j] = prev[next_sep[j]];
+      } else if (needle[i] == haystack[j]) {
+        row[j] = MAX (prev[j + 1] + 1, row[next_sep[j]]);
+      } else {
+        row[j] = row[next_sep[j]];
+      }
+    }
+    
+    tmp = prev;
+    prev = row;
+    row = tmp;
   }
+  
+  return prev[0];
 }
 
-static gint
-key_score (const gchar *key_,
-           const gchar *text_)
+/* inserts the casefolded version of @path in the key storage */
+static const gchar *
+store_key (const gchar *path)
 {
-  gchar  *text  = g_utf8_casefold (text_, -1);
-  gchar  *key   = g_utf8_casefold (key_, -1);
-  gint    score;
+  gchar        *key = g_utf8_casefold (path, -1);
+  const gchar  *stored;
   
-  score = get_score (key, text);
-  
-  g_free (text);
+  stored = g_string_chunk_insert (plugin_data.keys, key);
   g_free (key);
   
-  return score;
+  return stored;
 }
 
 static const gchar *
@@ -336,6 +388,7 @@ store_populate_menu_items (GtkListStore  *store,
                                            COL_PATH, path,
                                            COL_TYPE, COL_TYPE_MENU_ITEM,
                                            COL_WIDGET, node->data,
+                                           COL_KEY, store_key (path),
                                            -1);
         
         g_free (label);
@@ -394,44 +447,414 @@ fill_store (GtkListStore *store)
                                        COL_PATH, DOC_FILENAME (documents[i]),
                                        COL_TYPE, COL_TYPE_FILE,
                                        COL_DOCUMENT, documents[i],
+                                       COL_KEY, store_key (DOC_FILENAME (documents[i])),
                                        -1);
     g_free (basename);
     g_free (label);
   }
 }
 
+/* Project files
+ * 
+ * The files under the base path of the open project are indexed in the
+ * background, then filtered on each key change.  Since a file matching a key
+ * completely also matches any prefix of that key, the matches of the previous
+ * key are narrowed down when the user types more characters.  Only the
+ * PROJECT_MAX_RESULTS best (shortest) matches get inserted in the store. */
+
+typedef struct {
+  const gchar  *path; /* UTF-8 absolute path */
+  const gchar  *key;  /* casefolded path relative to the project base path */
+} ProjectFile;
+
+static struct {
+  gchar        *base_path;  /* locale encoding, NULL if nothing is indexed */
+  GPtrArray    *files;
+  GStringChunk *strings;
+  GQueue        dirs;       /* directories left to walk, in locale encoding */
+  guint         walk_id;
+  
+  GPtrArray    *matches;    /* files completely matching matches_key */
+  gchar        *matches_key;
+} project_index = {
+  NULL, NULL, NULL,
+  G_QUEUE_INIT, 0,
+  NULL, NULL
+};
+
+static void
+project_index_reset_matches (void)
+{
+  if (project_index.matches) {
+    g_ptr_array_free (project_index.matches, TRUE);
+    project_index.matches = NULL;
+  }
+  g_free (project_index.matches_key);
+  project_index.matches_key = NULL;
+}
+
+/* removes the project files rows from the store */
+static void
+store_remove_project_files (GtkListStore *store)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (store);
+  GtkTreeIter   iter;
+  gboolean      valid;
+  
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  while (valid) {
+    gint            type;
+    GeanyDocument  *doc;
+    
+    gtk_tree_model_get (model, &iter, COL_TYPE, &type, COL_DOCUMENT, &doc, -1);
+    if (type == COL_TYPE_FILE && doc == NULL) {
+      valid = gtk_list_store_remove (store, &iter);
+    } else {
+      valid = gtk_tree_model_iter_next (model, &iter);
+    }
+  }
+}
+
+static void
+project_index_clear (void)
+{
+  gchar *dir;
+  
+  if (project_index.walk_id) {
+    g_source_remove (project_index.walk_id);
+    project_index.walk_id = 0;
+  }
+  while ((dir = g_queue_pop_head (&project_index.dirs)) != NULL) {
+    g_free (dir);
+  }
+  
+  project_index_reset_matches ();
+  /* the rows reference the strings we're about to free */
+  if (plugin_data.store) {
+    store_remove_project_files (plugin_data.store);
+  }
+  
+  if (project_index.files) {
+    g_ptr_array_foreach (project_index.files, (GFunc) g_free, NULL);
+    g_ptr_array_free (project_index.files, TRUE);
+    project_index.files = NULL;
+  }
+  if (project_index.strings) {
+    g_string_chunk_free (project_index.strings);
+    project_index.strings = NULL;
+  }
+  g_free (project_index.base_path);
+  project_index.base_path = NULL;
+}
+
+static void
+project_index_add_file (const gchar *locale_path)
+{
+  ProjectFile  *file = g_malloc (sizeof *file);
+  gchar        *path = utils_get_utf8_from_locale (locale_path);
+  gchar        *key;
+  
+  key = utils_get_utf8_from_locale (locale_path + strlen (project_index.base_path));
+  SETPTR (key, g_utf8_casefold (key, -1));
+  file->path = g_string_chunk_insert (project_index.strings, path);
+  file->key = g_string_chunk_insert (project_index.strings, key);
+  g_ptr_array_add (project_index.files, file);
+  
+  g_free (key);
+  g_free (path);
+}
+
+static void
+project_index_walk_dir (const gchar *dirname)
+{
+  GDir         *dir = g_dir_open (dirname, 0, NULL);
+  const gchar  *name;
+  
+  if (! dir) {
+    return;
+  }
+  while ((name = g_dir_read_name (dir)) != NULL) {
+    gchar *path;
+    
+    /* skip hidden files and directories, mostly VCS data */
+    if (*name == '.') {
+      continue;
+    }
+    
+    path = g_build_filename (dirname, name, NULL);
+    if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+      /* don't follow links to directories, they might loop */
+      if (! g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+        g_queue_push_tail (&project_index.dirs, path);
+        path = NULL;
+      }
+    } else {
+      project_index_add_file (path);
+    }
+    g_free (path);
+  }
+  g_dir_close (dir);
+}
+
+static void store_update_scores (void);
+
+static gboolean
+on_project_index_walk_idle (gpointer dummy)
+{
+  GTimer *timer = g_timer_new ();
+  gchar  *dir;
+  
+  while (g_timer_elapsed (timer, NULL) < PROJECT_WALK_SLICE &&
+         (dir = g_queue_pop_head (&project_index.dirs)) != NULL) {
+    project_index_walk_dir (dir);
+    g_free (dir);
+  }
+  g_timer_destroy (timer);
+  
+  if (! g_queue_is_empty (&project_index.dirs)) {
+    return TRUE;
+  }
+  
+  project_index.walk_id = 0;
+  /* show the complete results if the panel is in use */
+  if (plugin_data.panel && gtk_widget_get_visible (plugin_data.panel)) {
+    project_index_reset_matches ();
+    store_update_scores ();
+  }
+  
+  return FALSE;
+}
+
+/* (re)starts indexing the current project's files if not already done */
+static void
+project_index_update (void)
+{
+  GeanyProject *project = geany_data->app->project;
+  gchar        *base_path;
+  
+  if (! project || ! NZV (project->base_path)) {
+    project_index_clear ();
+    return;
+  }
+  
+  if (g_path_is_absolute (project->base_path)) {
+    base_path = utils_get_locale_from_utf8 (project->base_path);
+  } else {
+    gchar *dir = g_path_get_dirname (project->file_name);
+    
+    base_path = g_build_filename (dir, project->base_path, NULL);
+    SETPTR (base_path, utils_get_locale_from_utf8 (base_path));
+    g_free (dir);
+  }
+  /* so the relative paths don't start with a separator */
+  if (! g_str_has_suffix (base_path, G_DIR_SEPARATOR_S)) {
+    SETPTR (base_path, g_strconcat (base_path, G_DIR_SEPARATOR_S, NULL));
+  }
+  
+  if (project_index.base_path && strcmp (project_index.base_path, base_path) == 0) {
+    g_free (base_path);
+    return;
+  }
+  
+  project_index_clear ();
+  project_index.base_path = base_path;
+  project_index.files = g_ptr_array_new ();
+  project_index.strings = g_string_chunk_new (64 * 1024);
+  g_queue_push_tail (&project_index.dirs, g_strdup (base_path));
+  project_index.walk_id = g_idle_add (on_project_index_walk_idle, NULL);
+}
+
+/* whether @file is a better result than @other */
+static inline gboolean
+project_file_is_better (const ProjectFile *file,
+                        const ProjectFile *other)
+{
+  return strlen (file->key) < strlen (other->key);
+}
+
+/* keeps the @max best files in @heap, with the worst one on top */
+static void
+results_heap_add (GPtrArray    *heap,
+                  guint         max,
+                  ProjectFile  *file)
+{
+  gpointer *data;
+  guint     i;
+  
+  if (heap->len < max) {
+    g_ptr_array_add (heap, file);
+    /* sift up */
+    data = heap->pdata;
+    for (i = heap->len - 1; i > 0; i = (i - 1) / 2) {
+      if (! project_file_is_better (data[(i - 1) / 2], data[i])) {
+        break;
+      }
+      data[i] = data[(i - 1) / 2];
+      data[(i - 1) / 2] = file;
+    }
+  } else if (project_file_is_better (file, heap->pdata[0])) {
+    /* replace the worst one and sift down */
+    data = heap->pdata;
+    data[0] = file;
+    for (i = 0; 2 * i + 1 < heap->len; ) {
+      guint child = 2 * i + 1;
+      
+      if (child + 1 < heap->len &&
+          project_file_is_better (data[child], data[child + 1])) {
+        child++;
+      }
+      if (! project_file_is_better (data[i], data[child])) {
+        break;
+      }
+      data[i] = data[child];
+      data[child] = file;
+      i = child;
+    }
+  }
+}
+
+/* number of characters of @key that get_score() can match */
+static gint
+key_max_score (const gchar *key)
+{
+  gint score = 0;
+  
+  for (; *key; key++) {
+    if (! IS_SEPARATOR (*key)) {
+      score++;
+    }
+  }
+  
+  return score;
+}
+
+/* inserts the best project files matching @key (casefolded) in the store */
+static void
+store_populate_project_files (GtkListStore *store,
+                              const gchar  *key)
+{
+  GPtrArray  *candidates;
+  GPtrArray  *matches;
+  GPtrArray  *results;
+  gint        max_score;
+  guint       i;
+  
+  store_remove_project_files (store);
+  
+  if (! project_index.files || ! *key) {
+    project_index_reset_matches ();
+    return;
+  }
+  
+  /* a file matching the whole key also matches the previous key if it is a
+   * prefix of this one, so we only need to look at the previous matches */
+  if (project_index.matches && g_str_has_prefix (key, project_index.matches_key)) {
+    candidates = project_index.matches;
+  } else {
+    candidates = project_index.files;
+  }
+  
+  max_score = key_max_score (key);
+  matches = g_ptr_array_new ();
+  results = g_ptr_array_sized_new (PROJECT_MAX_RESULTS);
+  for (i = 0; i < candidates->len; i++) {
+    ProjectFile *file = g_ptr_array_index (candidates, i);
+    
+    if (get_score (key, file->key) == max_score) {
+      g_ptr_array_add (matches, file);
+      results_heap_add (results, PROJECT_MAX_RESULTS, file);
+    }
+  }
+  
+  project_index_reset_matches ();
+  project_index.matches = matches;
+  project_index.matches_key = g_strdup (key);
+  
+  for (i = 0; i < results->len; i++) {
+    ProjectFile  *file = g_ptr_array_index (results, i);
+    gchar        *locale_path;
+    gchar        *basename;
+    gchar        *label;
+    
+    /* open files are already in the list */
+    locale_path = utils_get_locale_from_utf8 (file->path);
+    if (document_find_by_filename (locale_path)) {
+      g_free (locale_path);
+      continue;
+    }
+    g_free (locale_path);
+    
+    basename = g_path_get_basename (file->path);
+    label = g_markup_printf_escaped ("<big>%s</big>\n"
+                                     "<small><i>%s</i></small>",
+                                     basename, file->path);
+    gtk_list_store_insert_with_values (store, NULL, -1,
+                                       COL_LABEL, label,
+                                       COL_PATH, file->path,
+                                       COL_TYPE, COL_TYPE_FILE,
+                                       COL_DOCUMENT, NULL,
+                                       COL_KEY, file->key,
+                                       -1);
+    g_free (basename);
+    g_free (label);
+  }
+  g_ptr_array_free (results, TRUE);
+}
+
 static gint
 sort_func (GtkTreeModel  *model,
            GtkTreeIter   *a,
            GtkTreeIter   *b,
            gpointer       dummy)
 {
-  gint          scorea;
-  gint          scoreb;
-  gchar        *patha;
-  gchar        *pathb;
-  gint          typea;
-  gint          typeb;
-  gint          type;
-  const gchar  *key = get_key (&type);
+  gint scorea;
+  gint scoreb;
   
-  gtk_tree_model_get (model, a, COL_PATH, &patha, COL_TYPE, &typea, -1);
-  gtk_tree_model_get (model, b, COL_PATH, &pathb, COL_TYPE, &typeb, -1);
+  gtk_tree_model_get (model, a, COL_SCORE, &scorea, -1);
+  gtk_tree_model_get (model, b, COL_SCORE, &scoreb, -1);
   
-  scorea = key_score (key, patha);
-  scoreb = key_score (key, pathb);
+  return scoreb - scorea;
+}
+
+/* scores all rows against the current key and re-sorts the view */
+static void
+store_update_scores (void)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (plugin_data.store);
+  GtkTreeIter   iter;
+  gint          type;
+  gchar        *key = g_utf8_casefold (get_key (&type), -1);
+  gboolean      valid;
   
-  if (! (typea & type)) {
-    scorea -= 0xf000;
+  /* unset the sort function so the sort model doesn't re-sort on every
+   * change, and sort everything at once after.  this also forces re-sorting
+   * the whole model, as GtkTreeSortable don't have a resort() API. */
+  gtk_tree_model_sort_reset_default_sort_func (GTK_TREE_MODEL_SORT (plugin_data.sort));
+  
+  if (type & COL_TYPE_FILE) {
+    store_populate_project_files (plugin_data.store, key);
+  } else {
+    store_remove_project_files (plugin_data.store);
   }
-  if (! (typeb & type)) {
-    scoreb -= 0xf000;
+  
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter)) {
+    const gchar  *row_key;
+    gint          row_type;
+    gint          score;
+    
+    gtk_tree_model_get (model, &iter, COL_KEY, &row_key, COL_TYPE, &row_type, -1);
+    score = get_score (key, row_key);
+    if (! (row_type & type)) {
+      score -= 0xf000;
+    }
+    gtk_list_store_set (plugin_data.store, &iter, COL_SCORE, score, -1);
   }
   
-  g_free (patha);
-  g_free (pathb);
+  gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (plugin_data.sort),
+                                           sort_func, NULL, NULL);
   
-  return scoreb - scorea;
+  g_free (key);
 }
 
 static gboolean
@@ -482,13 +905,7 @@ on_entry_text_notify (GObject    *object,
   GtkTreeView  *view  = GTK_TREE_VIEW (plugin_data.view);
   GtkTreeModel *model = gtk_tree_view_get_model (view);
   
-  /* we force re-sorting the whole model from how it was before, and the
-   * back to the new filter.  this is somewhat hackish but since we don't
-   * know the original sorting order, and GtkTreeSortable don't have a
-   * resort() API anyway. */
-  gtk_tree_model_sort_reset_default_sort_func (GTK_TREE_MODEL_SORT (model));
-  gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (model),
-                                           sort_func, NULL, NULL);
+  store_update_scores ();
   
   if (gtk_tree_model_get_iter_first (model, &iter)) {
     tree_view_set_cursor_from_iter (view, &iter);
@@ -515,6 +932,8 @@ on_panel_hide (GtkWidget *widget,
   gtk_tree_view_get_cursor (view, &plugin_data.last_path, NULL);
   
   gtk_list_store_clear (plugin_data.store);
+  g_string_chunk_clear (plugin_data.keys);
+  project_index_reset_matches ();
 }
 
 static void
@@ -524,7 +943,9 @@ on_panel_show (GtkWidget *widget,
   GtkTreePath *path;
   GtkTreeView *view = GTK_TREE_VIEW (plugin_data.view);
   
+  project_index_update ();
   fill_store (plugin_data.store);
+  store_update_scores ();
   
   gtk_widget_grab_focus (plugin_data.entry);
   
@@ -566,9 +987,21 @@ on_view_row_activated (GtkTreeView       *view,
         gint            page;
         
         gtk_tree_model_get (model, &iter, COL_DOCUMENT, &doc, -1);
-        page = document_get_notebook_page (doc);
-        gtk_notebook_set_current_page (GTK_NOTEBOOK (geany_data->main_widgets->notebook),
-                                       page);
+        if (doc) {
+          page = document_get_notebook_page (doc);
+          gtk_notebook_set_current_page (GTK_NOTEBOOK (geany_data->main_widgets->notebook),
+                                         page);
+        } else {
+          /* a project file */
+          gchar *path;
+          gchar *locale_path;
+          
+          gtk_tree_model_get (model, &iter, COL_PATH, &path, -1);
+          locale_path = utils_get_locale_from_utf8 (path);
+          document_open_file (locale_path, FALSE, NULL, NULL);
+          g_free (locale_path);
+          g_free (path);
+        }
         break;
       }
       
@@ -633,7 +1066,10 @@ create_panel (void)
                                           G_TYPE_STRING,
                                           G_TYPE_INT,
                                           GTK_TYPE_WIDGET,
-                                          G_TYPE_POINTER);
+                                          G_TYPE_POINTER,
+                                          G_TYPE_POINTER,
+                                          G_TYPE_INT);
+  plugin_data.keys = g_string_chunk_new (4096);
   
   plugin_data.sort = gtk_tree_model_sort_new_with_model (GTK_TREE_MODEL (plugin_data.store));
   gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (plugin_data.sort),
@@ -662,6 +1098,30 @@ create_panel (void)
   gtk_widget_show_all (frame);
 }
 
+/* the project files index is rebuilt next time the panel is shown */
+static void
+on_project_open_save (GObject  *object,
+                      GKeyFile *config,
+                      gpointer  dummy)
+{
+  /* on save, the base path may have changed */
+  project_index_clear ();
+}
+
+static void
+on_project_close (GObject  *object,
+                  gpointer  dummy)
+{
+  project_index_clear ();
+}
+
+PluginCallback plugin_callbacks[] = {
+  { "project-open",   G_CALLBACK (on_project_open_save),  TRUE, NULL },
+  { "project-save",   G_CALLBACK (on_project_open_save),  TRUE, NULL },
+  { "project-close",  G_CALLBACK (on_project_close),      TRUE, NULL },
+  { NULL, NULL, FALSE, NULL }
+};
+
 static void
 on_kb_show_panel (guint key_id)
 {
@@ -693,12 +1153,17 @@ plugin_init (GeanyData *data)
 void
 plugin_cleanup (void)
 {
+  project_index_clear ();
   if (plugin_data.panel) {
     gtk_widget_destroy (plugin_data.panel);
   }
   if (plugin_data.last_path) {
     gtk_tree_path_free (plugin_data.last_path);
   }
+  if (plugin_data.keys) {
+    g_string_chunk_free (plugin_data.keys);
+  }
+  g_free (score_buffer.data);
 }
 
 void
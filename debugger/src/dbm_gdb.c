@@ -50,6 +50,10 @@ extern GeanyData		*geany_data;
 /* GDB prompt */
 #define GDB_PROMPT "(gdb) \n"
 
+/* maximum number of commands written to GDB before reading their results,
+keeps the amount of data in the pipes below their capacity */
+#define MI_PIPELINE_DEPTH 32
+
 /* enumeration for GDB command execution status */
 typedef enum _result_class {
 	RC_DONE,
@@ -57,6 +61,13 @@ typedef enum _result_class {
 	RC_ERROR
 } result_class;
 
+/* structure to keep a pipelined command and its result */
+typedef struct _mi_command {
+	gchar *command;
+	result_class rc;
+	gchar *record;
+} mi_command;
+
 /* structure to keep async command data (command line, messages) */
 typedef struct _queue_item {
 	GString *message;
@@ -121,11 +132,13 @@ static gboolean file_refresh_needed = FALSE;
 /* current frame number */
 static int active_frame = 0;
 
+/* token of the last command sent by exec_sync_commands */
+static guint command_token = 0;
+
 /* forward declarations */
 static void stop(void);
 static variable* add_watch(gchar* expression);
-static void update_watches(void);
-static void update_autos(void);
+static void update_variables(void);
 static void update_files(void);
 
 /*
@@ -526,11 +539,8 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 
 				if (SR_BREAKPOINT_HIT == stop_reason || SR_END_STEPPING_RANGE == stop_reason)
 				{
-					/* update autos */
-					update_autos();
-			
-					/* update watches */
-					update_watches();
+					/* update autos and watches */
+					update_variables();
 			
 					/* update files */
 					if (file_refresh_needed)
@@ -633,80 +643,188 @@ static void exec_async_command(const gchar* command)
 }
 
 /*
- * execute "command" syncronously
- * i.e. reading output right
- * after execution
- */ 
-static result_class exec_sync_command(const gchar* command, gboolean wait4prompt, gchar** command_record)
+ * creates a command for exec_sync_commands, takes ownership of "command"
+ */
+static mi_command* mi_command_new(gchar *command)
 {
-	GList *lines, *iter;
-	result_class rc;
+	mi_command *cmd = g_malloc(sizeof(mi_command));
+	cmd->command = command;
+	cmd->rc = RC_ERROR;
+	cmd->record = NULL;
 
-#ifdef DEBUG_OUTPUT
-	dbg_cbs->send_message(command, "red");
-#endif
+	return cmd;
+}
 
-	/* write command to gdb input channel */
-	gdb_input_write_line(command);
-	
-	if (!wait4prompt)
-		return RC_DONE;
-	
-	lines = read_until_prompt();
+/*
+ * free memory occupied by a pipelined command
+ */
+static void mi_command_free(mi_command *cmd)
+{
+	g_free(cmd->command);
+	g_free(cmd->record);
+	g_free(cmd);
+}
 
-#ifdef DEBUG_OUTPUT
-	for (iter = lines; iter; iter = iter->next)
+/*
+ * free an array of pipelined commands
+ */
+static void free_commands(GPtrArray *commands)
+{
+	g_ptr_array_foreach(commands, (GFunc)mi_command_free, NULL);
+	g_ptr_array_free(commands, TRUE);
+}
+
+/*
+ * stores result class and record of a result record line ("^done,...") in "cmd"
+ */
+static void set_command_result(mi_command *cmd, gchar *line)
+{
+	gchar* coma = strchr(line, ',');
+	if (coma)
 	{
-		dbg_cbs->send_message((gchar*)iter->data, "red");
+		*coma = '\0';
+		coma++;
 	}
-#endif
+	else
+		coma = line + strlen(line);
 
-	rc = RC_ERROR;
+	g_free(cmd->record);
+	cmd->record = g_strdup(coma);
 
-	for (iter = lines; iter; iter = iter->next)
+	if (!strcmp(line, "^done"))
+		cmd->rc = RC_DONE;
+	else if (!strcmp(line, "^error"))
+	{
+		/* save error message */
+		gchar* msg = g_strcompress(strstr(coma, "msg=\"") + strlen("msg=\""));
+		g_strlcpy(err_message, msg, sizeof(err_message));
+		g_free(msg);
+
+		cmd->rc = RC_ERROR;
+	}
+	else if (!strcmp(line, "^exit"))
+		cmd->rc = RC_EXIT;
+	else
+		cmd->rc = RC_ERROR;
+}
+
+/*
+ * execute "commands" (array of mi_command) syncronously
+ * commands are tagged with tokens and written without waiting
+ * for the previous results, which are dispatched by their tokens
+ */
+static void exec_sync_commands(GPtrArray *commands)
+{
+	guint first_token = command_token + 1;
+	guint sent = 0, completed = 0;
+	GList *lines, *iter;
+
+	command_token += commands->len;
+
+	while (completed < commands->len)
 	{
-		gchar *line = (gchar*)iter->data;
+		gchar *line = NULL, *result;
+		gsize terminator;
+		guint token;
 
-		if ('^' == line[0])
+		/* keep the pipeline filled */
+		while (sent < commands->len && sent - completed < MI_PIPELINE_DEPTH)
 		{
-			gchar* coma = strchr(line, ',');
-			if (coma)
-			{
-				*coma = '\0';
-				coma++;
-			}
-			else
-				coma = line + strlen(line);
-			
-			if (command_record)
-			{
-				*command_record = (gchar*)g_malloc(strlen(coma) + 1);
-				strcpy(*command_record, coma);
-			}
-			
-			if (!strcmp(line, "^done"))
-				rc = RC_DONE;
-			else if (!strcmp(line, "^error"))
+			mi_command *cmd = (mi_command*)g_ptr_array_index(commands, sent);
+			gchar *tagged = g_strdup_printf("%u%s", first_token + sent, cmd->command);
+
+#ifdef DEBUG_OUTPUT
+			dbg_cbs->send_message(tagged, "red");
+#endif
+			gdb_input_write_line(tagged);
+			g_free(tagged);
+
+			sent++;
+		}
+
+		if (G_IO_STATUS_NORMAL != g_io_channel_read_line(gdb_ch_out, &line, NULL, &terminator, NULL))
+			break;
+
+		/* prompts are skipped, a stray one may be left by an asyncronous command */
+		if (!strcmp(GDB_PROMPT, line))
+		{
+			g_free(line);
+			continue;
+		}
+		line[terminator] = '\0';
+
+#ifdef DEBUG_OUTPUT
+		dbg_cbs->send_message(line, "red");
+#endif
+
+		token = strtoul(line, &result, 10);
+		if ('^' == *result)
+		{
+			if (result != line && token >= first_token && token - first_token < commands->len)
 			{
-				/* save error message */
-				gchar* msg = g_strcompress(strstr(coma, "msg=\"") + strlen("msg=\""));
-				strcpy(err_message, msg);
-				g_free(msg);
-				
-				rc = RC_ERROR;
+				set_command_result((mi_command*)g_ptr_array_index(commands, token - first_token), result);
+				completed++;
 			}
-			else if (!strcmp(line, "^exit"))
-				rc = RC_EXIT;
 		}
 		else if ('&' != line[0])
 		{
 			colorize_message (line);
 		}
+
+		g_free(line);
 	}
-	
-	g_list_foreach(lines, (GFunc)g_free, NULL);
-	g_list_free(lines);
-	
+
+	/* the prompt following the last result */
+	if (completed)
+	{
+		lines = read_until_prompt();
+		for (iter = lines; iter; iter = iter->next)
+		{
+			gchar *line = (gchar*)iter->data;
+			if ('&' != line[0])
+				colorize_message(line);
+		}
+		g_list_foreach(lines, (GFunc)g_free, NULL);
+		g_list_free(lines);
+	}
+}
+
+/*
+ * execute "command" syncronously
+ * i.e. reading output right
+ * after execution
+ */ 
+static result_class exec_sync_command(const gchar* command, gboolean wait4prompt, gchar** command_record)
+{
+	GPtrArray *commands;
+	mi_command *cmd;
+	result_class rc;
+
+	if (!wait4prompt)
+	{
+#ifdef DEBUG_OUTPUT
+		dbg_cbs->send_message(command, "red");
+#endif
+		/* write command to gdb input channel */
+		gdb_input_write_line(command);
+		return RC_DONE;
+	}
+
+	cmd = mi_command_new(g_strdup(command));
+	commands = g_ptr_array_new();
+	g_ptr_array_add(commands, cmd);
+
+	exec_sync_commands(commands);
+
+	rc = cmd->rc;
+	if (command_record)
+	{
+		*command_record = cmd->record;
+		cmd->record = NULL;
+	}
+
+	free_commands(commands);
+
 	return rc;
 }
 
@@ -1104,8 +1222,7 @@ static void set_active_frame(int frame_number)
 	if (RC_DONE == exec_sync_command(command, TRUE, NULL))
 	{
 		active_frame = frame_number;
-		update_autos();
-		update_watches();
+		update_variables();
 	}
 	g_free(command);
 }
@@ -1343,70 +1460,125 @@ static gchar *unescape(gchar *text)
 	return retval;
 }
 
+/*
+ * assigns value from a "value=" record, returns FALSE if there is none
+ */
+static gboolean set_variable_value(variable *var, gchar *record)
+{
+	gchar *pos, *value;
+
+	if (!record || !(pos = strstr(record, "value=\"")))
+		return FALSE;
+
+	pos += strlen("value=\"");
+	*(strrchr(pos, '\"')) = '\0';
+	value = unescape(pos);
+	g_string_assign(var->value, value);
+	g_free(value);
+
+	return TRUE;
+}
+
 /*
  * updates variables from vars list 
  */
 static void get_variables (GList *vars)
 {
-	while (vars)
+	GPtrArray *commands;
+	GList *iter, *unevaluated = NULL;
+	guint i;
+
+	if (!vars)
+		return;
+
+	/* path expressions, children numbers and types of all variables */
+	commands = g_ptr_array_new();
+	for (iter = vars; iter; iter = iter->next)
 	{
-		gchar command[1000];
-		
-		variable *var = (variable*)vars->data;
+		gchar *varname = ((variable*)iter->data)->internal->str;
 
-		gchar *varname = var->internal->str;
-		gchar *record = NULL;
-		gchar *pos;
-		gchar *expression;
-		int numchild;
-		gchar *value;
+		g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-info-path-expression \"%s\"", varname)));
+		g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-info-num-children \"%s\"", varname)));
+		g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-info-type \"%s\"", varname)));
+	}
+	exec_sync_commands(commands);
+
+	for (iter = vars, i = 0; iter; iter = iter->next, i += 3)
+	{
+		variable *var = (variable*)iter->data;
+		gchar *record, *pos;
 
 		/* path expression */
-		sprintf(command, "-var-info-path-expression \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		pos = strstr(record, "path_expr=\"") + strlen("path_expr=\"");
-		*(strrchr(pos, '\"')) = '\0';
-		expression = unescape(pos);
-		g_string_assign(var->expression, expression);
-		g_free(expression);
-		g_free(record);
-		
-		/* children number */
-		sprintf(command, "-var-info-num-children \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		pos = strstr(record, "numchild=\"") + strlen("numchild=\"");
-		*(strchr(pos, '\"')) = '\0';
-		numchild = atoi(pos);
-		var->has_children = numchild > 0;
-		g_free(record);
+		record = ((mi_command*)g_ptr_array_index(commands, i))->record;
+		if (record && (pos = strstr(record, "path_expr=\"")))
+		{
+			gchar *expression;
+
+			pos += strlen("path_expr=\"");
+			*(strrchr(pos, '\"')) = '\0';
+			expression = unescape(pos);
+			g_string_assign(var->expression, expression);
+			g_free(expression);
+		}
 
-		/* value */
-		sprintf(command, "-data-evaluate-expression \"%s\"", var->expression->str);
-		exec_sync_command(command, TRUE, &record);
-		pos = strstr(record, "value=\"");
-		if (!pos)
+		/* children number */
+		record = ((mi_command*)g_ptr_array_index(commands, i + 1))->record;
+		if (record && (pos = strstr(record, "numchild=\"")))
 		{
-			g_free(record);
-			sprintf(command, "-var-evaluate-expression \"%s\"", varname);
-			exec_sync_command(command, TRUE, &record);
-			pos = strstr(record, "value=\"");
+			pos += strlen("numchild=\"");
+			*(strchr(pos, '\"')) = '\0';
+			var->has_children = atoi(pos) > 0;
 		}
-		pos +=  + strlen("value=\"");
-		*(strrchr(pos, '\"')) = '\0';
-		value = unescape(pos);
-		g_string_assign(var->value, value);
-		g_free(value);
-		g_free(record);
 
 		/* type */
-		sprintf(command, "-var-info-type \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		pos = strstr(record, "type=\"") + strlen("type=\"");
-		*(strchr(pos, '\"')) = '\0';
-		g_string_assign(var->type, pos);
-		g_free(record);
+		record = ((mi_command*)g_ptr_array_index(commands, i + 2))->record;
+		if (record && (pos = strstr(record, "type=\"")))
+		{
+			pos += strlen("type=\"");
+			*(strchr(pos, '\"')) = '\0';
+			g_string_assign(var->type, pos);
+		}
+	}
+	free_commands(commands);
 
-		vars = vars->next;
+	/* values */
+	commands = g_ptr_array_new();
+	for (iter = vars; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+		g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-data-evaluate-expression \"%s\"", var->expression->str)));
+	}
+	exec_sync_commands(commands);
+
+	for (iter = vars, i = 0; iter; iter = iter->next, i++)
+	{
+		variable *var = (variable*)iter->data;
+		if (!set_variable_value(var, ((mi_command*)g_ptr_array_index(commands, i))->record))
+			unevaluated = g_list_append(unevaluated, var);
+	}
+	free_commands(commands);
+
+	/* values of the variables expressions of which cannot be evaluated */
+	if (unevaluated)
+	{
+		commands = g_ptr_array_new();
+		for (iter = unevaluated; iter; iter = iter->next)
+		{
+			variable *var = (variable*)iter->data;
+			g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-evaluate-expression \"%s\"", var->internal->str)));
+		}
+		exec_sync_commands(commands);
+
+		/* the variables are reused across stops, don't keep a value from a previous frame */
+		for (iter = unevaluated, i = 0; iter; iter = iter->next, i++)
+		{
+			variable *var = (variable*)iter->data;
+			if (!set_variable_value(var, ((mi_command*)g_ptr_array_index(commands, i))->record))
+				g_string_assign(var->value, "");
+		}
+
+		free_commands(commands);
+		g_list_free(unevaluated);
 	}
 }
 
@@ -1446,65 +1618,125 @@ static void update_files(void)
 	g_free(record);
 }
 
+/*
+ * adds a command creating a floating GDB variable for "var",
+ * which is reevaluated in the current frame by "-var-update"
+ */
+static void add_create_command(GPtrArray *commands, variable *var)
+{
+	gchar *escaped = g_strescape(var->name->str, NULL);
+	g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-create - @ \"%s\"", escaped)));
+	g_free(escaped);
+}
+
+/*
+ * assigns the internal name from a "-var-create" result,
+ * returns FALSE if the variable has not been created
+ */
+static gboolean set_created_variable(variable *var, mi_command *cmd)
+{
+	gchar *pos;
+
+	if (RC_DONE != cmd->rc)
+	{
+		var->evaluated = FALSE;
+		g_string_assign(var->internal, "");
+		return FALSE;
+	}
+
+	pos = strstr(cmd->record, "name=\"") + strlen("name=\"");
+	*strchr(pos, '\"') = '\0';
+	g_string_assign(var->internal, pos);
+	var->evaluated = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * reevaluates all GDB variables in the current frame,
+ * returns a set of the variables which are out of scope now
+ */
+static GHashTable* update_varobjs(void)
+{
+	GHashTable *stale = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	gchar *record = NULL, *pos;
+
+	if (RC_DONE == exec_sync_command("-var-update *", TRUE, &record))
+	{
+		pos = record;
+		while ( (pos = strstr(pos, "name=\"")) )
+		{
+			gchar *name;
+
+			pos += strlen("name=\"");
+			*(strchr(pos, '\"')) = '\0';
+			name = pos;
+			pos += strlen(pos) + 1;
+
+			/* in_scope is either "true", "false" or "invalid" */
+			if (g_str_has_prefix(pos, ",in_scope=\"") && !g_str_has_prefix(pos + strlen(",in_scope=\""), "true"))
+			{
+				gchar *key = g_strdup(name);
+				g_hash_table_insert(stale, key, key);
+			}
+		}
+	}
+	g_free(record);
+
+	return stale;
+}
+
 /*
  * updates watches list 
  */
-static void update_watches(void)
+static void update_watches(GHashTable *stale)
 {
-	gchar command[1000];
+	GPtrArray *commands = g_ptr_array_new();
+	GList *creating = NULL;
 	GList *updating = NULL;
 	GList *iter;
+	guint i;
 
-	/* delete all GDB variables */
+	/* delete GDB variables which went out of scope */
 	for (iter = watches; iter; iter = iter->next)
 	{
 		variable *var = (variable*)iter->data;
 		
-		if (var->internal->len)
+		if (var->internal->len && g_hash_table_lookup(stale, var->internal->str))
 		{
-			sprintf(command, "-var-delete %s", var->internal->str);
-			exec_sync_command(command, TRUE, NULL);
+			g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-delete %s", var->internal->str)));
+			variable_reset(var);
 		}
-		
-		/* reset all variables fields */
-		variable_reset(var);
 	}
 	
-	/* create GDB variables, adding successfully created
-	variables to the list then passed for updatind */
+	/* create GDB variables for the watches that don't have one,
+	existing variables are updated already */
+	i = commands->len;
 	for (iter = watches; iter; iter = iter->next)
 	{
 		variable *var = (variable*)iter->data;
-		gchar *record = NULL;
-		gchar *pos;
-		gchar *escaped;
-
-		/* try to create variable */
-		escaped = g_strescape(var->name->str, NULL);
-		sprintf(command, "-var-create - * \"%s\"", escaped);
-		g_free(escaped);
 
-		if (RC_DONE != exec_sync_command(command, TRUE, &record))
+		if (var->internal->len)
+			updating = g_list_append(updating, var);
+		else
 		{
-			/* do not include to updating list, move to next watch */
-			var->evaluated = FALSE;
-			g_string_assign(var->internal, "");
-			g_free(record);
-			
-			continue;
+			variable_reset(var);
+			add_create_command(commands, var);
+			creating = g_list_append(creating, var);
 		}
-		
-		/* find and assign internal name */
-		pos = strstr(record, "name=\"") + strlen("name=\"");
-		*strchr(pos, '\"') = '\0'; 
-		g_string_assign(var->internal, pos);
-		g_free(record);			
-		
-		var->evaluated = TRUE;
+	}
 
-		/* add to updating list */
-		updating = g_list_append(updating, var);
+	exec_sync_commands(commands);
+
+	/* add successfully created variables to the list then passed for updating */
+	for (iter = creating; iter; iter = iter->next, i++)
+	{
+		variable *var = (variable*)iter->data;
+		if (set_created_variable(var, (mi_command*)g_ptr_array_index(commands, i)))
+			updating = g_list_append(updating, var);
 	}
+	free_commands(commands);
+	g_list_free(creating);
 	
 	/* update watches */
 	get_variables(updating);
@@ -1516,83 +1748,112 @@ static void update_watches(void)
 /*
  * updates autos list 
  */
-static void update_autos(void)
+static void update_autos(GHashTable *stale)
 {
-	gchar command[1000];
-	GList *unevaluated = NULL, *iter;
-	const char *gdb_commands[2];
-	int i;
+	GPtrArray *commands;
+	GList *current = NULL, *creating = NULL, *evaluated = NULL, *unevaluated = NULL, *iter;
+	guint i;
 
-	/* remove all previous GDB variables for autos */
-	for (iter = autos; iter; iter = iter->next)
-	{
-		variable *var = (variable*)iter->data;
-		
-		sprintf(command, "-var-delete %s", var->internal->str);
-		exec_sync_command(command, TRUE, NULL);
-	}
+	/* get current autos */
+	commands = g_ptr_array_new();
+	g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-stack-list-arguments 0 %i %i", active_frame, active_frame)));
+	g_ptr_array_add(commands, mi_command_new(g_strdup("-stack-list-locals 0")));
+	exec_sync_commands(commands);
 
-	g_list_foreach(autos, (GFunc)variable_free, NULL);
-	g_list_free(autos);
-	autos = NULL;
-	
-	/* add current autos to the list */
-	
-	gdb_commands[0] = g_strdup_printf("-stack-list-arguments 0 %i %i", active_frame, active_frame);
-	gdb_commands[1] = "-stack-list-locals 0";
-	for (i = 0; i < sizeof (gdb_commands) / sizeof(*gdb_commands); i++)
+	for (i = 0; i < commands->len; i++)
 	{
-		gchar *record = NULL, *pos;
+		mi_command *cmd = (mi_command*)g_ptr_array_index(commands, i);
+		variable_type vt = i ? VT_LOCAL : VT_ARGUMENT;
+		gchar *pos;
 
-		result_class rc = exec_sync_command(gdb_commands[i], TRUE, &record);
-		if (RC_DONE != rc)
+		if (RC_DONE != cmd->rc)
 			break;
 
-		pos = record;
+		pos = cmd->record;
 		while ((pos = strstr(pos, "name=\"")))
 		{
-			variable *var;
-			gchar *create_record = NULL, *escaped;
+			variable *var = NULL;
 
 			pos += strlen("name=\"");
 			*(strchr(pos, '\"')) = '\0';
 
-			var = variable_new(pos, i ? VT_LOCAL : VT_ARGUMENT);
-
-			/* create new gdb variable */
-			escaped = g_strescape(pos, NULL);
-			sprintf(command, "-var-create - * \"%s\"", escaped);
-			g_free(escaped);
-
-			/* form new variable */
-			if (RC_DONE == exec_sync_command(command, TRUE, &create_record))
+			/* reuse GDB variable of the previous autos list */
+			for (iter = autos; iter; iter = iter->next)
 			{
-				gchar *intname = strstr(create_record, "name=\"") + strlen ("name=\"");
-				*strchr(intname, '\"') = '\0';
-				var->evaluated = TRUE;
-				g_string_assign(var->internal, intname);
-				autos = g_list_append(autos, var);
-
-				g_free(create_record);
+				variable *old = (variable*)iter->data;
+				if (old->vt == vt && old->internal->len && !strcmp(old->name->str, pos) &&
+					!g_hash_table_lookup(stale, old->internal->str))
+				{
+					var = old;
+					autos = g_list_delete_link(autos, iter);
+					break;
+				}
 			}
-			else
+			if (!var)
 			{
-				var->evaluated = FALSE;
-				g_string_assign(var->internal, "");
-				unevaluated = g_list_append(unevaluated, var);
+				var = variable_new(pos, vt);
+				creating = g_list_append(creating, var);
 			}
+			current = g_list_append(current, var);
 			
 			pos += strlen(pos) + 1;
 		}
-		g_free(record);
 	}
-	g_free((void*)gdb_commands[0]);
-	
+	free_commands(commands);
+
+	/* remove GDB variables for the autos left */
+	commands = g_ptr_array_new();
+	for (iter = autos; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+		if (var->internal->len)
+			g_ptr_array_add(commands, mi_command_new(g_strdup_printf("-var-delete %s", var->internal->str)));
+	}
+	g_list_foreach(autos, (GFunc)variable_free, NULL);
+	g_list_free(autos);
+	autos = NULL;
+
+	/* create new GDB variables */
+	i = commands->len;
+	for (iter = creating; iter; iter = iter->next)
+		add_create_command(commands, (variable*)iter->data);
+
+	exec_sync_commands(commands);
+
+	for (iter = creating; iter; iter = iter->next, i++)
+		set_created_variable((variable*)iter->data, (mi_command*)g_ptr_array_index(commands, i));
+	free_commands(commands);
+	g_list_free(creating);
+
+	for (iter = current; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+		if (var->evaluated)
+			evaluated = g_list_append(evaluated, var);
+		else
+			unevaluated = g_list_append(unevaluated, var);
+	}
+	g_list_free(current);
+
 	/* get values for the autos (without incorrect variables) */
-	get_variables(autos);
+	get_variables(evaluated);
 	
 	/* add incorrect variables */
-	autos = g_list_concat(autos, unevaluated);
+	autos = g_list_concat(evaluated, unevaluated);
+}
+
+/*
+ * updates autos and watches after the program stopped
+ * or the active frame has changed
+ */
+static void update_variables(void)
+{
+	GHashTable *stale = update_varobjs();
+
+	update_autos(stale);
+	update_watches(stale);
+
+	g_hash_table_destroy(stale);
 }
 
 /*
@@ -1698,7 +1959,7 @@ static variable* add_watch(gchar* expression)
 
 	/* try to create a variable */
 	escaped = g_strescape(expression, NULL);
-	sprintf(command, "-var-create - * \"%s\"", escaped);
+	sprintf(command, "-var-create - @ \"%s\"", escaped);
 	g_free(escaped);
 
 	if (RC_DONE != exec_sync_command(command, TRUE, &record))
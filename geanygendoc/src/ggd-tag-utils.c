@@ -127,11 +127,14 @@ ggd_tag_sort_by_line_to_list (const GPtrArray  *tags,
   g_return_val_if_fail (tags != NULL, NULL);
   g_return_val_if_fail (direction != 0, NULL);
   
+  /* prepend then sort rather than inserting each tag sorted, that is quadratic.
+   * Prepending keeps tags of the same line in the order the sorted insertion
+   * gave them since the sort is stable */
   GGD_PTR_ARRAY_FOR (tags, i, el) {
-    children = g_list_insert_sorted_with_data (children, el,
-                                               tag_cmp_by_line,
-                                               GINT_TO_POINTER (direction));
+    children = g_list_prepend (children, el);
   }
+  children = g_list_sort_with_data (children, tag_cmp_by_line,
+                                    GINT_TO_POINTER (direction));
   
   return children;
 }
@@ -191,6 +194,31 @@ ggd_tag_find_at_current_pos (GeanyDocument *doc)
   return tag;
 }
 
+/*
+ * scope_get_name:
+ * @scope: A scope, of the form a<sep>b<sep>c
+ * @separator: The scope separator
+ * 
+ * Gets the last element of a scope, that is the name of the tag that defines
+ * it.
+ * 
+ * Returns: A pointer inside @scope to its last element.
+ */
+static const gchar *
+scope_get_name (const gchar *scope,
+                const gchar *separator)
+{
+  const gchar  *name = scope;
+  const gchar  *tmp;
+  gsize         separator_len = strlen (separator);
+  
+  while ((tmp = strstr (name, separator)) != NULL) {
+    name = &tmp[separator_len];
+  }
+  
+  return name;
+}
+
 /**
  * ggd_tag_find_parent:
  * @tags: A #GPtrArray of #TMTag<!-- -->s containing @tag
@@ -216,19 +244,14 @@ ggd_tag_find_parent (const GPtrArray *tags,
   } else {
     gchar        *parent_scope = NULL;
     const gchar  *parent_name;
-    const gchar  *tmp;
     guint         i;
     TMTag        *el;
     const gchar  *separator;
     gsize         separator_len;
     
-    /* scope is of the form a<sep>b<sep>c */
-    parent_name = child->atts.entry.scope;
     separator = symbols_get_context_separator (geany_ft);
     separator_len = strlen (separator);
-    while ((tmp = strstr (parent_name, separator)) != NULL) {
-      parent_name = &tmp[separator_len];
-    }
+    parent_name = scope_get_name (child->atts.entry.scope, separator);
     /* if parent have scope */
     if (parent_name != child->atts.entry.scope) {
       /* the parent scope is the "dirname" of the child's scope */
@@ -565,3 +588,355 @@ ggd_tag_find_children (const GPtrArray *tags,
   return ggd_tag_find_children_filtered (tags, parent, geany_ft,
                                          depth, tm_tag_max_t);
 }
+
+
+/* an element of the line-sorted array of a #GgdTagIndex */
+typedef struct _GgdTagIndexEntry GgdTagIndexEntry;
+
+struct _GgdTagIndexEntry
+{
+  TMTag  *tag;
+  guint   position; /* position of the tag in the indexed array */
+};
+
+struct _GgdTagIndex
+{
+  const gchar  *separator;
+  GArray       *lines;    /* GgdTagIndexEntry<!-- -->s sorted by line */
+  GHashTable   *by_path;  /* a<sep>b<sep>name -> GPtrArray of tags */
+  GHashTable   *by_scope; /* a<sep>b -> GPtrArray of tags */
+};
+
+/*
+ * index_entry_cmp:
+ * @a: A #GgdTagIndexEntry
+ * @b: Another #GgdTagIndexEntry
+ * 
+ * Compares two #GgdTagIndexEntry<!-- -->s by their lines, and then by their
+ * reversed positions: this way the last entry that precedes a line is the first
+ * tag of the array at that line, which is what ggd_tag_find_from_line()
+ * returns.
+ * 
+ * Returns: A negative integer if @a comes before @b, a positive integer if it
+ *          comes after it, and 0 if they are equal.
+ */
+static gint
+index_entry_cmp (gconstpointer a,
+                 gconstpointer b)
+{
+  const GgdTagIndexEntry *e1 = a;
+  const GgdTagIndexEntry *e2 = b;
+  
+  if (e1->tag->atts.entry.line != e2->tag->atts.entry.line) {
+    return (e1->tag->atts.entry.line > e2->tag->atts.entry.line) ? 1 : -1;
+  } else if (e1->position != e2->position) {
+    return (e1->position < e2->position) ? 1 : -1;
+  } else {
+    return 0;
+  }
+}
+
+/* GDestroyNotify for the GPtrArray values of a #GgdTagIndex's tables */
+static void
+ptr_array_free_cb (gpointer ptr_array)
+{
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+/* appends @tag to the list of tags of @table under @key */
+static void
+index_table_add (GHashTable  *table,
+                 gchar       *key,
+                 TMTag       *tag)
+{
+  GPtrArray *tags;
+  
+  tags = g_hash_table_lookup (table, key);
+  if (tags) {
+    g_free (key);
+  } else {
+    tags = g_ptr_array_new ();
+    g_hash_table_insert (table, key, tags);
+  }
+  g_ptr_array_add (tags, tag);
+}
+
+/* gets the path of the scope @tag defines, that is its scope followed by its
+ * name. Free with g_free() */
+static gchar *
+tag_get_path (const TMTag *tag,
+              const gchar *separator)
+{
+  if (tag->atts.entry.scope) {
+    return g_strconcat (tag->atts.entry.scope, separator, tag->name, NULL);
+  } else {
+    return g_strdup (tag->name);
+  }
+}
+
+/**
+ * ggd_tag_index_new:
+ * @tags: A #GPtrArray of #TMTag<!-- -->s
+ * @geany_ft: The Geany's file type identifier for which tags were generated
+ * 
+ * Creates an index of @tags to find tags by line, parent and children without
+ * walking the whole array each time.
+ * The index functions return the same tags as their non-indexed versions
+ * (ggd_tag_find_from_line(), ggd_tag_find_parent(), etc.)
+ * 
+ * <note><para>The tags are not copied; then @tags must not change during the
+ * index's lifetime.</para></note>
+ * 
+ * Returns: A new #GgdTagIndex that should be freed with ggd_tag_index_free().
+ */
+GgdTagIndex *
+ggd_tag_index_new (const GPtrArray *tags,
+                   filetype_id      geany_ft)
+{
+  GgdTagIndex  *tag_index;
+  guint         i;
+  TMTag        *el;
+  
+  g_return_val_if_fail (tags != NULL, NULL);
+  
+  tag_index = g_slice_alloc (sizeof *tag_index);
+  tag_index->separator = symbols_get_context_separator (geany_ft);
+  tag_index->lines = g_array_sized_new (FALSE, FALSE,
+                                        sizeof (GgdTagIndexEntry), tags->len);
+  tag_index->by_path = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, ptr_array_free_cb);
+  tag_index->by_scope = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, ptr_array_free_cb);
+  GGD_PTR_ARRAY_FOR (tags, i, el) {
+    /* file tags are never parents nor found by line, but may be children */
+    if (! (el->type & tm_tag_file_t)) {
+      GgdTagIndexEntry entry;
+      
+      entry.tag = el;
+      entry.position = i;
+      g_array_append_val (tag_index->lines, entry);
+      index_table_add (tag_index->by_path,
+                       tag_get_path (el, tag_index->separator), el);
+    }
+    if (el->atts.entry.scope) {
+      index_table_add (tag_index->by_scope,
+                       g_strdup (el->atts.entry.scope), el);
+    }
+  }
+  g_array_sort (tag_index->lines, index_entry_cmp);
+  
+  return tag_index;
+}
+
+/**
+ * ggd_tag_index_free:
+ * @tag_index: A #GgdTagIndex
+ * 
+ * Frees a #GgdTagIndex. The indexed tags are not affected.
+ */
+void
+ggd_tag_index_free (GgdTagIndex *tag_index)
+{
+  g_return_if_fail (tag_index != NULL);
+  
+  g_array_free (tag_index->lines, TRUE);
+  g_hash_table_destroy (tag_index->by_path);
+  g_hash_table_destroy (tag_index->by_scope);
+  g_slice_free1 (sizeof *tag_index, tag_index);
+}
+
+/**
+ * ggd_tag_index_find_from_line:
+ * @tag_index: A #GgdTagIndex
+ * @line: Line for which find the tag
+ * 
+ * Finds the tag that applies for a given line, see ggd_tag_find_from_line().
+ * 
+ * Returns: A #TMTag, or %NULL if none found.
+ */
+TMTag *
+ggd_tag_index_find_from_line (const GgdTagIndex *tag_index,
+                              gulong             line)
+{
+  guint lo = 0;
+  guint hi;
+  
+  g_return_val_if_fail (tag_index != NULL, NULL);
+  
+  /* finds the first entry after @line */
+  hi = tag_index->lines->len;
+  while (lo < hi) {
+    guint             mid = lo + (hi - lo) / 2;
+    GgdTagIndexEntry *entry;
+    
+    entry = &g_array_index (tag_index->lines, GgdTagIndexEntry, mid);
+    if (entry->tag->atts.entry.line <= line) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  
+  if (lo > 0) {
+    return g_array_index (tag_index->lines, GgdTagIndexEntry, lo - 1).tag;
+  } else {
+    return NULL;
+  }
+}
+
+/**
+ * ggd_tag_index_find_parent:
+ * @tag_index: A #GgdTagIndex of the tags containing @child
+ * @child: A #TMTag, child of the tag to find
+ * 
+ * Finds the parent tag of a #TMTag, see ggd_tag_find_parent().
+ * 
+ * Returns: A #TMTag, or %NULL if @child have no parent.
+ */
+TMTag *
+ggd_tag_index_find_parent (const GgdTagIndex *tag_index,
+                           const TMTag       *child)
+{
+  TMTag *tag = NULL;
+  
+  g_return_val_if_fail (tag_index != NULL, NULL);
+  g_return_val_if_fail (child != NULL, NULL);
+  
+  if (child->atts.entry.scope) {
+    GPtrArray *candidates;
+    
+    /* the parent defines the child's scope */
+    candidates = g_hash_table_lookup (tag_index->by_path,
+                                      child->atts.entry.scope);
+    if (candidates) {
+      const gchar  *parent_name;
+      guint         i;
+      
+      /* the path of a tag whose name contains the separator may look like the
+       * scope, then check the name too */
+      parent_name = scope_get_name (child->atts.entry.scope,
+                                    tag_index->separator);
+      /* like ggd_tag_find_parent(), prefer the last matching tag */
+      for (i = candidates->len; ! tag && i > 0; i--) {
+        TMTag *el = g_ptr_array_index (candidates, i - 1);
+        
+        if (el->atts.entry.line <= child->atts.entry.line &&
+            utils_str_equal (el->name, parent_name)) {
+          tag = el;
+        }
+      }
+    }
+  }
+  
+  return tag;
+}
+
+/**
+ * ggd_tag_index_find_children_filtered:
+ * @tag_index: A #GgdTagIndex of the tags containing @parent
+ * @parent: Tag for which get children
+ * @depth: Maximum depth for children to be found (< 0 means infinite)
+ *         Value != 0 aren't honored for now, see ggd_tag_find_children().
+ * @filter: A logical OR of the TMTagType<!-- -->s to match
+ * 
+ * Finds children tags of a #TMTag that matches @matches, see
+ * ggd_tag_find_children_filtered().
+ * 
+ * Returns: The list of children found for @parent, sorted by line
+ */
+GList *
+ggd_tag_index_find_children_filtered (const GgdTagIndex *tag_index,
+                                      const TMTag       *parent,
+                                      gint               depth,
+                                      TMTagType          filter)
+{
+  GList      *children = NULL;
+  GPtrArray  *candidates;
+  gchar      *path;
+  
+  g_return_val_if_fail (tag_index != NULL, NULL);
+  g_return_val_if_fail (parent != NULL, NULL);
+  
+  /* children are in the scope the parent defines */
+  path = tag_get_path (parent, tag_index->separator);
+  candidates = g_hash_table_lookup (tag_index->by_scope, path);
+  if (candidates) {
+    guint   i;
+    TMTag  *el;
+    
+    GGD_PTR_ARRAY_FOR (candidates, i, el) {
+      if (el->type & filter &&
+          ggd_tag_index_find_parent (tag_index, el) == parent) {
+        children = g_list_insert_sorted_with_data (children, el,
+                                                   tag_cmp_by_line,
+                                                   GINT_TO_POINTER (GGD_SORT_ASC));
+      }
+    }
+  }
+  g_free (path);
+  
+  return children;
+}
+
+/**
+ * ggd_tag_index_find_children:
+ * @tag_index: A #GgdTagIndex of the tags containing @parent
+ * @parent: Tag for which get children
+ * @depth: Maximum depth for children to be found (< 0 means infinite)
+ * 
+ * Finds children tags of a #TMTag, see ggd_tag_find_children().
+ * 
+ * Returns: The list of children found for @parent, sorted by line
+ */
+GList *
+ggd_tag_index_find_children (const GgdTagIndex *tag_index,
+                             const TMTag       *parent,
+                             gint               depth)
+{
+  return ggd_tag_index_find_children_filtered (tag_index, parent, depth,
+                                               tm_tag_max_t);
+}
+
+/**
+ * ggd_tag_index_resolve_type_hierarchy:
+ * @tag_index: A #GgdTagIndex of the tags containing @tag
+ * @tag: A #TMTag to which get the type hierarchy
+ * 
+ * Gets the type hierarchy of a tag, see ggd_tag_resolve_type_hierarchy().
+ * 
+ * Returns: the tag's type hierarchy or %NULL if invalid.
+ */
+gchar *
+ggd_tag_index_resolve_type_hierarchy (const GgdTagIndex *tag_index,
+                                      const TMTag       *tag)
+{
+  gchar *scope = NULL;
+  
+  g_return_val_if_fail (tag_index != NULL, NULL);
+  g_return_val_if_fail (tag != NULL, NULL);
+  
+  if (tag->type & tm_tag_file_t) {
+    g_critical (_("Invalid tag"));
+  } else {
+    TMTag *parent_tag;
+    
+    parent_tag = ggd_tag_index_find_parent (tag_index, tag);
+    scope = g_strdup (ggd_tag_get_type_name (tag));
+    if (parent_tag) {
+      gchar *parent_scope;
+      
+      parent_scope = ggd_tag_index_resolve_type_hierarchy (tag_index,
+                                                           parent_tag);
+      if (parent_scope) {
+        gchar *tmp;
+        
+        tmp = g_strconcat (parent_scope, ".", scope, NULL);
+        g_free (scope);
+        scope = tmp;
+        g_free (parent_scope);
+      }
+    }
+  }
+  
+  return scope;
+}
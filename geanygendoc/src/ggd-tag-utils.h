@@ -43,6 +43,13 @@ GGD_BEGIN_PLUGIN_API
  */
 #define GGD_SORT_DESC (-1)
 
+/**
+ * GgdTagIndex:
+ * 
+ * An index of a tag array, see ggd_tag_index_new().
+ */
+typedef struct _GgdTagIndex GgdTagIndex;
+
 void          ggd_tag_sort_by_line            (GPtrArray *tags,
                                                gint       direction);
 GList        *ggd_tag_sort_by_line_to_list    (const GPtrArray  *tags,
@@ -71,6 +78,23 @@ const gchar  *ggd_tag_get_type_name           (const TMTag *tag);
 const gchar  *ggd_tag_type_get_name           (TMTagType  type);
 TMTagType     ggd_tag_type_from_name          (const gchar *name);
 
+GgdTagIndex  *ggd_tag_index_new                     (const GPtrArray *tags,
+                                                     filetype_id      geany_ft);
+void          ggd_tag_index_free                    (GgdTagIndex *tag_index);
+TMTag        *ggd_tag_index_find_from_line          (const GgdTagIndex *tag_index,
+                                                     gulong             line);
+TMTag        *ggd_tag_index_find_parent             (const GgdTagIndex *tag_index,
+                                                     const TMTag       *child);
+GList        *ggd_tag_index_find_children_filtered  (const GgdTagIndex *tag_index,
+                                                     const TMTag       *parent,
+                                                     gint               depth,
+                                                     TMTagType          filter);
+GList        *ggd_tag_index_find_children           (const GgdTagIndex *tag_index,
+                                                     const TMTag       *parent,
+                                                     gint               depth);
+gchar        *ggd_tag_index_resolve_type_hierarchy  (const GgdTagIndex *tag_index,
+                                                     const TMTag       *tag);
+
 
 GGD_END_PLUGIN_API
 G_END_DECLS
@@ -148,14 +148,13 @@ hash_table_env_push_list_cb (gpointer symbol,
 
 /* gets the environment for a particular tag */
 static CtplEnviron *
-get_env_for_tag (GgdFileType   *ft,
-                 GgdDocSetting *setting,
-                 GeanyDocument *doc,
-                 const TMTag   *tag)
+get_env_for_tag (GgdFileType       *ft,
+                 GgdDocSetting     *setting,
+                 const GgdTagIndex *tag_index,
+                 const TMTag       *tag)
 {
   CtplEnviron  *env;
   GList        *children = NULL;
-  GPtrArray    *tag_array = doc->tm_file->tags_array;
   gboolean      returns;
   
   env = ctpl_environ_new ();
@@ -178,8 +177,7 @@ get_env_for_tag (GgdFileType   *ft,
                strcmp ("void", tag->atts.entry.var_type) == 0);
   ctpl_environ_push_int (env, "returns", returns);
   /* get direct children tags */
-  children = ggd_tag_find_children (tag_array, tag,
-                                    FILETYPE_ID (doc->file_type), 0);
+  children = ggd_tag_index_find_children (tag_index, tag, 0);
   if (setting->merge_children) {
     CtplValue *v;
     
@@ -230,11 +228,11 @@ get_env_for_tag (GgdFileType   *ft,
 
 /* parses the template @tpl with the environment of @tag */
 static gchar *
-get_comment (GgdFileType   *ft,
-             GgdDocSetting *setting,
-             GeanyDocument *doc,
-             const TMTag   *tag,
-             gint          *cursor_offset)
+get_comment (GgdFileType       *ft,
+             GgdDocSetting     *setting,
+             const GgdTagIndex *tag_index,
+             const TMTag       *tag,
+             gint              *cursor_offset)
 {
   gchar *comment = NULL;
   
@@ -242,7 +240,7 @@ get_comment (GgdFileType   *ft,
     GError      *err = NULL;
     CtplEnviron *env;
     
-    env = get_env_for_tag (ft, setting, doc, tag);
+    env = get_env_for_tag (ft, setting, tag_index, tag);
     ctpl_environ_merge (env, ft->user_env, FALSE);
     if (! ctpl_environ_add_from_string (env, GGD_OPT_environ, &err)) {
       msgwin_status_add (_("Failed to add global environment, skipping: %s"),
@@ -327,10 +325,11 @@ adjust_start_line (ScintillaObject *sci,
 
 /* inserts the comment for @tag in @sci according to @setting */
 static gboolean
-do_insert_comment (GeanyDocument   *doc,
-                   const TMTag     *tag,
-                   GgdFileType     *ft,
-                   GgdDocSetting   *setting)
+do_insert_comment (GeanyDocument     *doc,
+                   const GgdTagIndex *tag_index,
+                   const TMTag       *tag,
+                   GgdFileType       *ft,
+                   GgdDocSetting     *setting)
 {
   gboolean          success = FALSE;
   gchar            *comment;
@@ -338,7 +337,7 @@ do_insert_comment (GeanyDocument   *doc,
   ScintillaObject  *sci = doc->editor->sci;
   GPtrArray        *tag_array = doc->tm_file->tags_array;
   
-  comment = get_comment (ft, setting, doc, tag, &cursor_offset);
+  comment = get_comment (ft, setting, tag_index, tag, &cursor_offset);
   if (comment) {
     gint pos = 0;
     
@@ -378,24 +377,22 @@ do_insert_comment (GeanyDocument   *doc,
  * Since a policy may forward documenting to a parent, tag that actually applies
  * is returned in @real_tag. */
 static GgdDocSetting *
-get_setting_from_tag (GgdDocType     *doctype,
-                      GeanyDocument  *doc,
-                      const TMTag    *tag,
-                      const TMTag   **real_tag)
+get_setting_from_tag (GgdDocType         *doctype,
+                      const GgdTagIndex  *tag_index,
+                      const TMTag        *tag,
+                      const TMTag       **real_tag)
 {
   GgdDocSetting  *setting;
   gchar          *hierarchy;
   gint            nth_child;
-  GPtrArray      *tag_array = doc->tm_file->tags_array;
-  filetype_id     geany_ft = FILETYPE_ID (doc->file_type);
   
-  hierarchy = ggd_tag_resolve_type_hierarchy (tag_array, geany_ft, tag);
+  hierarchy = ggd_tag_index_resolve_type_hierarchy (tag_index, tag);
   /*g_debug ("type hierarchy for tag %s is: %s", tag->name, hierarchy);*/
   setting = ggd_doc_type_resolve_setting (doctype, hierarchy, &nth_child);
   *real_tag = tag;
   if (setting) {
     for (; nth_child > 0; nth_child--) {
-      *real_tag = ggd_tag_find_parent (tag_array, geany_ft, *real_tag);
+      *real_tag = ggd_tag_index_find_parent (tag_index, *real_tag);
     }
   }
   g_free (hierarchy);
@@ -447,6 +444,7 @@ get_config (GeanyDocument  *doc,
  * @doc: A #GeanyDocument in which insert comments
  * @filetype: The #GgdFileType to use
  * @doctype: The #GgdDocType to use
+ * @tag_index: A #GgdTagIndex of the document's tags
  * @sorted_tag_list: A list of tag to document. This list must be sorted by
  *                   tag's line.
  * 
@@ -456,10 +454,11 @@ get_config (GeanyDocument  *doc,
  * Returns: %TRUE on success, %FALSE otherwise.
  */
 static gboolean
-insert_multiple_comments (GeanyDocument *doc,
-                          GgdFileType   *filetype,
-                          GgdDocType    *doctype,
-                          GList         *sorted_tag_list)
+insert_multiple_comments (GeanyDocument     *doc,
+                          GgdFileType       *filetype,
+                          GgdDocType        *doctype,
+                          const GgdTagIndex *tag_index,
+                          GList             *sorted_tag_list)
 {
   gboolean          success = FALSE;
   GList            *node;
@@ -475,9 +474,9 @@ insert_multiple_comments (GeanyDocument *doc,
     GgdDocSetting  *setting;
     const TMTag    *tag = node->data;
     
-    setting = get_setting_from_tag (doctype, doc, tag, &tag);
+    setting = get_setting_from_tag (doctype, tag_index, tag, &tag);
     if (setting && ! g_hash_table_lookup (tag_done_table, tag)) {
-      if (! do_insert_comment (doc, tag, filetype, setting)) {
+      if (! do_insert_comment (doc, tag_index, tag, filetype, setting)) {
         success = FALSE;
         break;
       } else {
@@ -517,17 +516,22 @@ ggd_insert_comment (GeanyDocument  *doc,
 {
   gboolean          success = FALSE;
   const TMTag      *tag = NULL;
-  GPtrArray        *tag_array = NULL;
+  GgdTagIndex      *tag_index = NULL;
   GgdFileType      *filetype = NULL;
   GgdDocType       *doctype = NULL;
   
   g_return_val_if_fail (DOC_VALID (doc), FALSE);
   
+  if (doc->tm_file) {
+    tag_index = ggd_tag_index_new (doc->tm_file->tags_array,
+                                   FILETYPE_ID (doc->file_type));
+  }
+  
  again:
   
-  if (doc->tm_file) {
-    tag_array = doc->tm_file->tags_array;
-    tag = ggd_tag_find_from_line (tag_array, line + 1 /* it is a SCI line */);
+  if (tag_index) {
+    tag = ggd_tag_index_find_from_line (tag_index,
+                                        line + 1 /* it is a SCI line */);
   }
   if (! tag || (tag->type & tm_tag_file_t)) {
     msgwin_status_add (_("No valid tag at line %d."), line);
@@ -536,7 +540,7 @@ ggd_insert_comment (GeanyDocument  *doc,
       GgdDocSetting  *setting;
       GList          *tag_list = NULL;
       
-      setting = get_setting_from_tag (doctype, doc, tag, &tag);
+      setting = get_setting_from_tag (doctype, tag_index, tag, &tag);
       if (setting && setting->policy == GGD_POLICY_PASS) {
         /* We want to completely skip this tag, so try previous line instead
          * FIXME: this implementation is kinda ugly... */
@@ -544,17 +548,20 @@ ggd_insert_comment (GeanyDocument  *doc,
         goto again;
       }
       if (setting && setting->autodoc_children) {
-        tag_list = ggd_tag_find_children_filtered (tag_array, tag,
-                                                   FILETYPE_ID (doc->file_type),
-                                                   0, setting->matches);
+        tag_list = ggd_tag_index_find_children_filtered (tag_index, tag, 0,
+                                                         setting->matches);
       }
       /* we assume that a parent always comes before any children, then simply add
        * it at the end */
       tag_list = g_list_append (tag_list, (gpointer)tag);
-      success = insert_multiple_comments (doc, filetype, doctype, tag_list);
+      success = insert_multiple_comments (doc, filetype, doctype, tag_index,
+                                          tag_list);
       g_list_free (tag_list);
     }
   }
+  if (tag_index) {
+    ggd_tag_index_free (tag_index);
+  }
   
   return success;
 }
@@ -581,14 +588,20 @@ ggd_insert_all_comments (GeanyDocument *doc,
   if (! doc->tm_file) {
     msgwin_status_add (_("No tags in the document"));
   } else if (get_config (doc, doc_type, &filetype, &doctype)) {
-    GList    *tag_list;
+    GList        *tag_list;
+    GgdTagIndex  *tag_index;
     
     /* get a sorted list of tags to be sure to insert by the end of the
      * document, then we don't modify the element's position of tags we'll work
      * on */
     tag_list = ggd_tag_sort_by_line_to_list (doc->tm_file->tags_array,
                                              GGD_SORT_DESC);
-    success = insert_multiple_comments (doc, filetype, doctype, tag_list);
+    /* index the tags once rather than walking them for each tag's parents */
+    tag_index = ggd_tag_index_new (doc->tm_file->tags_array,
+                                   FILETYPE_ID (doc->file_type));
+    success = insert_multiple_comments (doc, filetype, doctype, tag_index,
+                                        tag_list);
+    ggd_tag_index_free (tag_index);
     g_list_free (tag_list);
   }
   
@@ -40,7 +40,8 @@ typedef struct
 	/* trigger codes */
 	guint keyval;
 	guint state;
-	GSList *MacroEvents;
+	/* array of MacroEvent, kept contiguous so replaying is a simple walk through memory */
+	GArray *MacroEvents;
 } Macro;
 
 /* structure to hold details of Macro for macro editor */
@@ -191,9 +192,15 @@ static gulong key_release_signal_id;
 static GtkWidget *Record_Macro_menu_item=NULL;
 static GtkWidget *Stop_Record_Macro_menu_item=NULL;
 static GtkWidget *Edit_Macro_menu_item=NULL;
+static GtkWidget *Repeat_Macro_menu_item=NULL;
 static Macro *RecordingMacro=NULL;
 static GSList *mList=NULL;
 static gboolean bMacrosHaveChanged=FALSE;
+/* last settings used in the repeat macro dialog */
+static gint iRepeatTimes=10;
+static gboolean bRepeatUntilFails=FALSE;
+/* most times a macro is repeated until it fails, so a macro that never fails can't hang Geany */
+static const gint iMaxRepeatUntilFails=100000;
 
 /* default config file */
 const gchar default_config[] =
@@ -202,16 +209,16 @@ const gchar default_config[] =
 	"Question_Macro_Overwrite = true\n"
 	"[Macros]";
 
-/* clear macro events list and free up any memory they are using */
-static GSList * ClearMacroList(GSList *gsl)
+/* clear macro events array and free up any memory they are using */
+static void ClearMacroList(GArray *ga)
 {
 	MacroEvent *me;
-	GSList * gslTemp=gsl;
+	guint i;
 
-	/* free data held in GSLIST structure */
-	while(gslTemp!=NULL)
+	/* free strings held by events */
+	for(i=0;i<ga->len;i++)
 	{
-		me=gslTemp->data;
+		me=&g_array_index(ga,MacroEvent,i);
 		/* check to see if it's a message that has string attached, and free it if so
 		 * lparam might be NULL for SCI_SEARCHNEXT or SCI_SEARCHPREV but g_free is ok
 		 * with this
@@ -220,15 +227,36 @@ static GSList * ClearMacroList(GSList *gsl)
 		   me->message==SCI_SEARCHNEXT ||
 		   me->message==SCI_SEARCHPREV)
 			g_free((void*)(me->lparam));
-
-		g_free((void*)(gslTemp->data));
-		gslTemp=g_slist_next(gslTemp);
 	}
 
-	/* free SLIST structure */
-	g_slist_free(gsl);
+	/* empty array, but keep memory ready for new events */
+	g_array_set_size(ga,0);
+}
 
-	return NULL;
+
+/* add event to end of macro events array. If bMerge is set then text inserted straight after
+ * text that was inserted by the previous event is added to that event, so that typed text is
+ * replayed with one SCI_REPLACESEL rather than one for every character
+*/
+static void AddMacroEvent(GArray *ga,MacroEvent *me,gboolean bMerge)
+{
+	MacroEvent *meLast;
+	gchar *cTemp;
+
+	if(bMerge && me->message==SCI_REPLACESEL && ga->len>0)
+	{
+		meLast=&g_array_index(ga,MacroEvent,ga->len-1);
+		if(meLast->message==SCI_REPLACESEL)
+		{
+			cTemp=g_strconcat((gchar*)(meLast->lparam),(gchar*)(me->lparam),NULL);
+			g_free((gchar*)(meLast->lparam));
+			g_free((gchar*)(me->lparam));
+			meLast->lparam=(glong)cTemp;
+			return;
+		}
+	}
+
+	g_array_append_val(ga,*me);
 }
 
 
@@ -240,7 +268,7 @@ static Macro * CreateMacro(void)
 	if((m=(Macro*)(g_malloc(sizeof *m)))!=NULL)
 	{
 		m->name=NULL;
-		m->MacroEvents=NULL;
+		m->MacroEvents=g_array_new(FALSE,FALSE,sizeof(MacroEvent));
 		return m;
 	}
 	return NULL;
@@ -255,6 +283,7 @@ static Macro * FreeMacro(Macro *m)
 
 	g_free(m->name);
 	ClearMacroList(m->MacroEvents);
+	g_array_free(m->MacroEvents,TRUE);
 	g_free(m);
 
 	return NULL;
@@ -330,56 +359,102 @@ static void ClearAllMacros(void)
 }
 
 
-/* Repeat a macro to the editor */
-static void ReplayMacro(Macro *m)
+/* Repeat a macro to the editor. The macro is run iRepeat times, or if bUntilFails is set until a
+ * search in it fails, until a run changes neither the cursor position nor the document length, or
+ * (for macros without searches) until a run leaves the cursor on the last line without having
+ * moved it off that line. All runs are a single undo action
+*/
+static void ReplayMacro(Macro *m,gint iRepeat,gboolean bUntilFails)
 {
 	MacroEvent *me;
-	GSList *gsl=m->MacroEvents;
 	ScintillaObject* sci=document_get_current()->editor->sci;
-	gchar *clipboardcontents;
-	gboolean bFoundAnchor=FALSE;
+	gchar *clipboardcontents=NULL;
+	gboolean bFoundAnchor,bHasSearch=FALSE,bStop=FALSE;
+	gboolean bSearch;
+	glong lResult;
+	gint iRun,iLine,iPos,iLength;
+	guint i;
+
+	/* see if macro has any searches to tell when to stop */
+	for(i=0;i<m->MacroEvents->len;i++)
+	{
+		me=&g_array_index(m->MacroEvents,MacroEvent,i);
+		if(me->message==SCI_SEARCHNEXT || me->message==SCI_SEARCHPREV)
+			bHasSearch=TRUE;
+	}
 
 	scintilla_send_message(sci,SCI_BEGINUNDOACTION,0,0);
 
-	while(gsl!=NULL)
+	for(iRun=0;iRun<iRepeat && bStop==FALSE;iRun++)
 	{
-		me=gsl->data;
+		bFoundAnchor=FALSE;
+		iLine=sci_get_current_line(sci);
+		iPos=sci_get_current_position(sci);
+		iLength=sci_get_length(sci);
 
-		/* make not if anchor has been found */
-		if(me->message==SCI_SEARCHANCHOR)
-			bFoundAnchor=TRUE;
-
-		/* possibility that user edited macros might not have anchor before search */
-		if((me->message==SCI_SEARCHNEXT || me->message==SCI_SEARCHPREV) &&
-		   bFoundAnchor==FALSE)
+		for(i=0;i<m->MacroEvents->len;i++)
 		{
-			scintilla_send_message(sci,SCI_SEARCHANCHOR,0,0);
-			bFoundAnchor=TRUE;
-		}
+			me=&g_array_index(m->MacroEvents,MacroEvent,i);
+			bSearch=(me->message==SCI_SEARCHNEXT || me->message==SCI_SEARCHPREV);
 
-		/* search might use clipboard to look for: check & hanndle */
-		if((me->message==SCI_SEARCHNEXT || me->message==SCI_SEARCHPREV) &&
-		   ((gchar*)me->lparam)==NULL)
-		{
-			clipboardcontents=gtk_clipboard_wait_for_text(gtk_clipboard_get(
-			                  GDK_SELECTION_CLIPBOARD));
-			/* ensure there is something in the clipboard */
-			if(clipboardcontents==NULL)
+			/* make not if anchor has been found */
+			if(me->message==SCI_SEARCHANCHOR)
+				bFoundAnchor=TRUE;
+
+			/* possibility that user edited macros might not have anchor before search */
+			if(bSearch && bFoundAnchor==FALSE)
 			{
-				dialogs_show_msgbox(GTK_MESSAGE_INFO,_("No text in clipboard!"));
-				break;
+				scintilla_send_message(sci,SCI_SEARCHANCHOR,0,0);
+				bFoundAnchor=TRUE;
+			}
+
+			/* search might use clipboard to look for: check & hanndle. Only read clipboard once
+			 * however many times macro is repeated
+			*/
+			if(bSearch && ((gchar*)me->lparam)==NULL)
+			{
+				if(clipboardcontents==NULL)
+					clipboardcontents=gtk_clipboard_wait_for_text(gtk_clipboard_get(
+					                  GDK_SELECTION_CLIPBOARD));
+				/* ensure there is something in the clipboard */
+				if(clipboardcontents==NULL)
+				{
+					dialogs_show_msgbox(GTK_MESSAGE_INFO,_("No text in clipboard!"));
+					bStop=TRUE;
+					break;
+				}
+
+				lResult=scintilla_send_message(sci,me->message,me->wparam,
+				                               (glong)clipboardcontents);
 			}
+			else
+				lResult=scintilla_send_message(sci,me->message,me->wparam,me->lparam);
 
-			scintilla_send_message(sci,me->message,me->wparam,(glong)clipboardcontents);
+			/* stop repeating if search has failed */
+			if(bUntilFails && bSearch && lResult==-1)
+			{
+				bStop=TRUE;
+				break;
+			}
 		}
-		else
-			scintilla_send_message(sci,me->message,me->wparam,me->lparam);
 
-		/* move to next macro event */
-		gsl=g_slist_next(gsl);
+		/* without searches, stop when can't get past last line */
+		if(bUntilFails && bHasSearch==FALSE && iLine==sci_get_current_line(sci) &&
+		   iLine==sci_get_line_count(sci)-1)
+			bStop=TRUE;
+
+		/* stop when a run neither moves the cursor nor changes the document length, as it is then
+		 * most likely stuck, e.g. a search that keeps matching the same place */
+		if(bUntilFails && iPos==sci_get_current_position(sci) && iLength==sci_get_length(sci))
+			bStop=TRUE;
 	}
 
 	scintilla_send_message(sci,SCI_ENDUNDOACTION,0,0);
+
+	if(bUntilFails && bStop==FALSE)
+		ui_set_statusbar(TRUE,_("Macro stopped after being run %d times"),iRun);
+
+	g_free(clipboardcontents);
 }
 
 
@@ -411,14 +486,11 @@ static gchar * MakeStringSaveable(gchar *s)
 }
 
 
-/* create a macro event from an array of stings. This command may move past more than one array
+/* fill in a macro event from an array of stings. This command may move past more than one array
  * entry if the macro event details require it
 */
-static MacroEvent * GetMacroEventFromString(gchar **s,gint *k)
+static void GetMacroEventFromString(gchar **s,gint *k,MacroEvent *me)
 {
-	MacroEvent *me;
-
-	me=g_new0(MacroEvent,1);
 	/* get event number */
 	me->message=strtoll(s[(*k)++],NULL,10);
 
@@ -451,9 +523,6 @@ static MacroEvent * GetMacroEventFromString(gchar **s,gint *k)
 			me->lparam=0;
 			break;
 	}
-
-	/* return MacroEvent object */
-	return me;
 }
 
 
@@ -520,7 +589,7 @@ static gboolean DocumentPresent(void)
 /* check editor notifications and remember editor events */
 static gboolean Notification_Handler(GObject *obj,GeanyEditor *ed,SCNotification *nt,gpointer ud)
 {
-	MacroEvent *me;
+	MacroEvent me;
 	gint i;
 
 	/* ignore non macro recording messages */
@@ -549,17 +618,16 @@ static gboolean Notification_Handler(GObject *obj,GeanyEditor *ed,SCNotification
 		}
 
 	}
-	me=g_new0(MacroEvent,1);
-	me->message=nt->message;
-	me->wparam=nt->wParam;
+	me.message=nt->message;
+	me.wparam=nt->wParam;
 	/* Special handling for text in lparam */
-	me->lparam=(me->message==SCI_SEARCHNEXT ||
-	            me->message==SCI_SEARCHPREV ||
-	            me->message==SCI_REPLACESEL)
+	me.lparam=(me.message==SCI_SEARCHNEXT ||
+	           me.message==SCI_SEARCHPREV ||
+	           me.message==SCI_REPLACESEL)
 		?((glong) g_strdup((gchar *)(nt->lParam))) : nt->lParam;
 
-	/* more efficient to create reverse list and reverse it at the end */
-	RecordingMacro->MacroEvents=g_slist_prepend(RecordingMacro->MacroEvents,me);
+	/* characters typed one after another are stored as a single insertion */
+	AddMacroEvent(RecordingMacro->MacroEvents,&me,TRUE);
 
 	return FALSE;
 }
@@ -614,9 +682,9 @@ static void SaveSettings(void)
 	gchar *data;
 	gchar *cKey;
 	gchar *pcTemp;
-	gint i,k;
+	gint i;
+	guint k;
 	GSList *gsl=mList;
-	GSList *gslTemp;
 	gchar **pszMacroStrings;
 	Macro *m;
 
@@ -651,14 +719,10 @@ static void SaveSettings(void)
 			* first generate list of all macrodetails
 			*/
 			pszMacroStrings=(gchar **)
-				(g_malloc(sizeof(gchar *)*(g_slist_length(m->MacroEvents)+1)));
-			gslTemp=m->MacroEvents;
-			k=0;
-			while(gslTemp!=NULL)
-			{
-				pszMacroStrings[k++]=MacroEventToString((MacroEvent*)(gslTemp->data));
-				gslTemp=g_slist_next(gslTemp);
-			}
+				(g_malloc(sizeof(gchar *)*(m->MacroEvents->len+1)));
+			for(k=0;k<m->MacroEvents->len;k++)
+				pszMacroStrings[k]=MacroEventToString(&g_array_index(m->MacroEvents,MacroEvent,
+				                                                     k));
 
 			/* null terminate array for g_strfreev to work */
 			pszMacroStrings[k]=NULL;
@@ -711,6 +775,7 @@ static void LoadSettings(void)
 	gchar *config_file=NULL;
 	GKeyFile *config=NULL;
 	Macro *m;
+	MacroEvent me;
 	gchar **pcMacroCommands;
 
 	/* Make config_file hold directory name of settings file */
@@ -762,14 +827,15 @@ static void LoadSettings(void)
 		pcMacroCommands=g_strsplit(pcTemp,",",0);
 		/* can now free up pcTemp */
 		g_free(pcTemp);
-		/* now go through macro data generating macros */
-		for(k=0,m->MacroEvents=NULL;pcMacroCommands[k]!=NULL;)
-			m->MacroEvents=g_slist_prepend(m->MacroEvents,
-			                               GetMacroEventFromString(pcMacroCommands,
-		                                       &k));
-
-		/* list created in reverse as more efficient, now turn it around */
-		m->MacroEvents=g_slist_reverse(m->MacroEvents);
+		/* now go through macro data generating macros. Macros saved by older versions have
+		 * an event for each typed character, so merge them as they're loaded
+		*/
+		for(k=0;pcMacroCommands[k]!=NULL;)
+		{
+			GetMacroEventFromString(pcMacroCommands,&k,&me);
+			AddMacroEvent(m->MacroEvents,&me,TRUE);
+		}
+
 		/* macro now complete, add it to the list */
 		AddMacroToList(m);
 		/* free up memory used by pcMacroCommands */
@@ -865,6 +931,9 @@ _("Then press Record. "),
 _("What you do in the editor is then recorded until you select Stop Recording Macro from the Tools\
  menu. "),
 _("Simply pressing the specified key combination will re-run the macro. "),
+_("To run a macro many times in one go, select Repeat Macro from the Tools menu, choose the macro a\
+nd either how many times to run it, or to keep running it until a search in it fails or it reaches\
+ the end of the document. All the changes made can be undone in one step. "),
 _("To edit the macros you have, select Edit Macro from the Tools menu. "),
 _("You can select a macro and delete it, or re-record it. "),
 _("You can also click on a macro's name and change it, or the key combination and re-define that a\
@@ -928,7 +997,8 @@ static gboolean Key_Released_CallBack(GtkWidget *widget, GdkEventKey *ev, gpoint
 	/* if it's a macro trigger then run macro */
 	if(m!=NULL)
 	{
-		ReplayMacro(m);
+		if(DocumentPresent())
+			ReplayMacro(m,1,FALSE);
 /* ?is this needed */
 /*    g_signal_stop_emission_by_name((GObject *)widget,"key-release-event"); */
 		return TRUE;
@@ -1193,8 +1263,6 @@ static void StartRecordingMacro(void)
 static void StopRecordingMacro(void)
 {
 	scintilla_send_message(document_get_current()->editor->sci,SCI_STOPRECORD,0,0);
-	/* Recorded in reverse as more efficient */
-	RecordingMacro->MacroEvents=g_slist_reverse(RecordingMacro->MacroEvents);
 	/* add macro to list */
 	AddMacroToList(RecordingMacro);
 	/* set ready to record new macro (don't free as macro has been saved in macrolist) */
@@ -1237,6 +1305,79 @@ static void DoMacroRecording(GtkMenuItem *menuitem, gpointer gdata)
 }
 
 
+/* ask which macro to run and how often, then run it */
+static void DoRepeatMacro(GtkMenuItem *menuitem, gpointer gdata)
+{
+	GtkWidget *dialog,*hbox,*gtkl,*combo,*spin,*rbTimes,*rbUntil;
+	GSList *gsl;
+	Macro *m=NULL;
+
+	/* can't run macro if in an empty editor */
+	if(!DocumentPresent())
+		return;
+
+	if(mList==NULL)
+	{
+		dialogs_show_msgbox(GTK_MESSAGE_INFO,_("There are no macros to repeat"));
+		return;
+	}
+
+	/* create dialog box */
+	dialog=gtk_dialog_new_with_buttons(_("Repeat Macro"),
+		GTK_WINDOW(geany->main_widgets->window),
+		GTK_DIALOG_DESTROY_WITH_PARENT,
+		NULL);
+
+	/* create buttons */
+	gtk_dialog_add_button(GTK_DIALOG(dialog),_("_Run"),GTK_RESPONSE_OK);
+	gtk_dialog_add_button(GTK_DIALOG(dialog),_("_Cancel"),GTK_RESPONSE_CANCEL);
+
+	/* create box to hold macro choice and label */
+	hbox=gtk_hbox_new(FALSE,0);
+	gtk_container_add(GTK_CONTAINER(GTK_DIALOG(dialog)->vbox),hbox);
+
+	gtkl=gtk_label_new(_("Macro:"));
+	gtk_box_pack_start(GTK_BOX(hbox),gtkl,FALSE,FALSE,2);
+
+	combo=gtk_combo_box_new_text();
+	for(gsl=mList;gsl!=NULL;gsl=g_slist_next(gsl))
+		gtk_combo_box_append_text(GTK_COMBO_BOX(combo),((Macro*)(gsl->data))->name);
+	gtk_combo_box_set_active(GTK_COMBO_BOX(combo),0);
+	gtk_box_pack_start(GTK_BOX(hbox),combo,TRUE,TRUE,2);
+
+	/* create box to hold number of times to repeat */
+	hbox=gtk_hbox_new(FALSE,0);
+	gtk_container_add(GTK_CONTAINER(GTK_DIALOG(dialog)->vbox),hbox);
+
+	rbTimes=gtk_radio_button_new_with_label(NULL,_("Number of times:"));
+	gtk_box_pack_start(GTK_BOX(hbox),rbTimes,FALSE,FALSE,2);
+
+	spin=gtk_spin_button_new_with_range(1,G_MAXINT,1);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin),iRepeatTimes);
+	gtk_box_pack_start(GTK_BOX(hbox),spin,FALSE,FALSE,2);
+
+	rbUntil=gtk_radio_button_new_with_label_from_widget(GTK_RADIO_BUTTON(rbTimes),
+		_("Until a search fails or the end of the document is reached"));
+	gtk_container_add(GTK_CONTAINER(GTK_DIALOG(dialog)->vbox),rbUntil);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(rbUntil),bRepeatUntilFails);
+
+	gtk_widget_show_all(GTK_DIALOG(dialog)->vbox);
+
+	if(gtk_dialog_run(GTK_DIALOG(dialog))==GTK_RESPONSE_OK)
+	{
+		m=g_slist_nth_data(mList,gtk_combo_box_get_active(GTK_COMBO_BOX(combo)));
+		iRepeatTimes=gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+		bRepeatUntilFails=gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(rbUntil));
+	}
+
+	/* tidy up */
+	gtk_widget_destroy(dialog);
+
+	if(m!=NULL && DocumentPresent())
+		ReplayMacro(m,bRepeatUntilFails ? iMaxRepeatUntilFails : iRepeatTimes,bRepeatUntilFails);
+}
+
+
 /* handle a change in a macro name in the edit macro dialog */
 static void Name_Render_Edited_CallBack(GtkCellRendererText *cell,gchar *iter_id,gchar *new_text,
                                         gpointer data)
@@ -1720,9 +1861,9 @@ static void EditMacroElements(Macro *m)
 	GtkListStore *ls;
 	GtkTreePath *gtkPath;
 	gint i;
-	GSList *gsl=m->MacroEvents;
+	guint k;
 	gchar *cTitle,*cTemp,*cTemp2;
-	MacroEvent *me;
+	MacroEvent *me,meNew;
 	GtkListStore *lsCombo;
 	MacroDetailEntry *mde;
 	gboolean bHaveIter;
@@ -1736,9 +1877,9 @@ static void EditMacroElements(Macro *m)
 	*/
 	ls=gtk_list_store_new(4,G_TYPE_STRING,G_TYPE_UINT,G_TYPE_POINTER,G_TYPE_POINTER);
 
-	while(gsl!=NULL)
+	for(k=0;k<m->MacroEvents->len;k++)
 	{
- 		me=(MacroEvent*)(gsl->data);
+		me=&g_array_index(m->MacroEvents,MacroEvent,k);
 		i=0;
 		while(MacroDetails[i].description!=NULL)
 		{
@@ -1766,7 +1907,6 @@ static void EditMacroElements(Macro *m)
 		}
 
 		gtk_list_store_set(ls,&iter,0,cTemp,2,&(MacroDetails[i]),3,cTemp2,-1);
-		gsl=g_slist_next(gsl);
 	}
 
 	/* create list store for combo renderer */
@@ -1946,7 +2086,7 @@ static void EditMacroElements(Macro *m)
 		if(i==GEANY_MACRO_BUTTON_APPLY)
 		{
 			/* clear old macro */
-			m->MacroEvents=ClearMacroList(m->MacroEvents);
+			ClearMacroList(m->MacroEvents);
 
 			/* go through list adding macro events */
 			bHaveIter=gtk_tree_model_get_iter_first(GTK_TREE_MODEL(ls),&iter);
@@ -1956,36 +2096,31 @@ static void EditMacroElements(Macro *m)
 				gtk_tree_model_get(GTK_TREE_MODEL(ls),&iter,2,&mde,3,&cTemp,-1);
 
 				/* create new macro event */
-				me=g_new0(MacroEvent,1);
-
-				me->message=mde->message;
-				me->lparam=0;
-				me->wparam=0;
+				meNew.message=mde->message;
+				meNew.lparam=0;
+				meNew.wparam=0;
 
 				/* Special handling for text inserting, duplicate inserted string */
-				if(me->message==SCI_REPLACESEL)
-					me->lparam=(glong)((cTemp!=NULL)?g_strdup(cTemp):g_strdup(""));
+				if(meNew.message==SCI_REPLACESEL)
+					meNew.lparam=(glong)((cTemp!=NULL)?g_strdup(cTemp):g_strdup(""));
 
 				/* Special handling for search */
-				if(me->message==SCI_SEARCHNEXT || me->message==SCI_SEARCHPREV)
+				if(meNew.message==SCI_SEARCHNEXT || meNew.message==SCI_SEARCHPREV)
 				{
 					cTemp2=strchr(cTemp,',');
 					cTemp2++;
 
-					me->lparam=(glong)(((*cTemp2)==0)?NULL:g_strdup(cTemp2));
-					me->wparam=strtoll(cTemp,NULL,10);
+					meNew.lparam=(glong)(((*cTemp2)==0)?NULL:g_strdup(cTemp2));
+					meNew.wparam=strtoll(cTemp,NULL,10);
 				}
 
-				/* more efficient to create reverse list and reverse it at the end */
-				m->MacroEvents=g_slist_prepend(m->MacroEvents,me);
+				/* keep events as the user has arranged them */
+				AddMacroEvent(m->MacroEvents,&meNew,FALSE);
 
 				/* get next event */
 				bHaveIter=gtk_tree_model_iter_next(GTK_TREE_MODEL(ls),&iter);
 			}
 
-			/* was more efficient to record in reverse direction, so now reverse */
-			m->MacroEvents=g_slist_reverse(m->MacroEvents);
-
 			break;
 		}
 
@@ -2274,6 +2409,12 @@ void plugin_init(GeanyData *data)
 	gtk_container_add(GTK_CONTAINER(geany->main_widgets->tools_menu),Edit_Macro_menu_item);
 	g_signal_connect(Edit_Macro_menu_item,"activate",G_CALLBACK(DoEditMacro),NULL);
 
+	/* add Repeat Macro menu entry */
+	Repeat_Macro_menu_item=gtk_menu_item_new_with_mnemonic(_("Re_peat Macro..."));
+	gtk_widget_show(Repeat_Macro_menu_item);
+	gtk_container_add(GTK_CONTAINER(geany->main_widgets->tools_menu),Repeat_Macro_menu_item);
+	g_signal_connect(Repeat_Macro_menu_item,"activate",G_CALLBACK(DoRepeatMacro),NULL);
+
 	/* set key press monitor handle */
 	key_release_signal_id=g_signal_connect(geany->main_widgets->window,"key-release-event",
 										G_CALLBACK(Key_Released_CallBack),NULL);
@@ -2294,6 +2435,7 @@ void plugin_cleanup(void)
 	gtk_widget_destroy(Record_Macro_menu_item);
 	gtk_widget_destroy(Stop_Record_Macro_menu_item);
 	gtk_widget_destroy(Edit_Macro_menu_item);
+	gtk_widget_destroy(Repeat_Macro_menu_item);
 
 	/* Clear any macros that are recording */
 	RecordingMacro=FreeMacro(RecordingMacro);
@@ -45,7 +45,6 @@ typedef struct FileData
 	gchar *pcFolding;     /* holds which folds are open and which not */
 	gint LastChangedTime; /* time file was last changed by this editor */
 	gchar *pcBookmarks;   /* holds non-numbered bookmarks */
-	struct FileData * NextNode;
 } FileData;
 
 
@@ -68,7 +67,7 @@ static gboolean bRememberBookmarks=TRUE;
 
 /* internal variables */
 static gint iShiftNumbers[]={41,33,34,163,36,37,94,38,42,40};
-static FileData *fdKnownFilesSettings=NULL;
+static GHashTable *htKnownFilesSettings=NULL; /* filename ("" if none) -> FileData */
 static gulong key_release_signal_id;
 
 /* default config file */
@@ -300,62 +299,93 @@ static const gchar ** aszMarkerImages[]=
 };
 
 
+static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename);
+
+
+/* free memory used by FileData structure */
+static void FreeFileData(FileData *fd)
+{
+	/* free filename */
+	g_free(fd->pcFileName);
+	/* free folding & bookmark information if present */
+	g_free(fd->pcFolding);
+	g_free(fd->pcBookmarks);
+	/* free memory block */
+	g_free(fd);
+}
+
+
+/* return name of file holding the details for a file. Each file's details are kept in their own
+ * small file, named after a checksum of the filename, so that saving one doesn't mean rewriting
+ * the details of every file ever edited. Resultant string needs to be freed
+*/
+static gchar * GetFileDetailsRecordName(gchar *pcFileName)
+{
+	gchar *pcChecksum,*pcRecordName,*pcTemp;
+
+	pcChecksum=g_compute_checksum_for_string(G_CHECKSUM_MD5,pcFileName,-1);
+	pcTemp=g_strconcat(pcChecksum,".conf",NULL);
+	pcRecordName=g_build_filename(geany->app->configdir,"plugins","Geany_Numbered_Bookmarks",
+	                              "files",pcTemp,NULL);
+	g_free(pcTemp);
+	g_free(pcChecksum);
+
+	return pcRecordName;
+}
+
+
+/* load details for a file from it's record in the central settings directory, if it has one */
+static void LoadFileDetailsRecord(gchar *pcFileName)
+{
+	gchar *config_file;
+	GKeyFile *config;
+
+	config_file=GetFileDetailsRecordName(pcFileName);
+	config=g_key_file_new();
+
+	if(g_key_file_load_from_file(config,config_file,G_KEY_FILE_KEEP_COMMENTS,NULL))
+		LoadIndividualSetting(config,-1,pcFileName);
+
+	g_free(config_file);
+	g_key_file_free(config);
+}
+
+
 /* return a FileData structure for a file
- * if not come across this file before then create one, otherwise return existing structure with
- * data in it
+ * if not come across this file before then create one and load any details saved for it,
+ * otherwise return existing structure with data in it
  * returns NULL on error
 */
 static FileData * GetFileData(gchar *pcFileName)
 {
-	FileData *fdTemp=fdKnownFilesSettings;
+	FileData *fd;
 	gint i;
 
-	/* First handle if main pointer doesn't point to anything */
-	if(fdTemp==NULL)
-	{
-		if((fdKnownFilesSettings=(FileData*)(g_malloc(sizeof *fdTemp)))!=NULL)
-		{
-			fdKnownFilesSettings->pcFileName=g_strdup(pcFileName);
-			for(i=0;i<10;i++)
-				fdKnownFilesSettings->iBookmark[i]=-1;
-
-			/* don't need to initiate iBookmarkLinePos */
-			fdKnownFilesSettings->pcFolding=NULL;
-			fdKnownFilesSettings->LastChangedTime=-1;
-			fdKnownFilesSettings->pcBookmarks=NULL;
-			fdKnownFilesSettings->NextNode=NULL;
-		}
-		return fdKnownFilesSettings;
-	}
+	/* look file up in known files */
+	fd=g_hash_table_lookup(htKnownFilesSettings,(pcFileName==NULL)?"":pcFileName);
+	if(fd!=NULL)
+		return fd;
 
-	/* move through chain to the correct entry or the end of a chain */
-	while(TRUE)
-	{
-		/* if have found relavent FileData, then exit */
-		if(utils_str_equal(pcFileName,fdTemp->pcFileName)==TRUE)
-			return fdTemp;
+	/* not come across this file so far, so create new entry */
+	if((fd=(FileData*)(g_malloc(sizeof *fd)))==NULL)
+		return NULL;
 
-		/* if end of chain, then add new entry, and return it. */
-		if(fdTemp->NextNode==NULL)
-		{
-			if((fdTemp->NextNode=(FileData*)(g_malloc(sizeof *fdTemp)))!=NULL)
-			{
-				fdTemp->NextNode->pcFileName=g_strdup(pcFileName);
-				for(i=0;i<10;i++)
-					fdTemp->NextNode->iBookmark[i]=-1;
-
-				/* don't need to initiate iBookmarkLinePos */
-				fdTemp->NextNode->pcFolding=NULL;
-				fdTemp->NextNode->LastChangedTime=-1;
-				fdTemp->NextNode->pcBookmarks=NULL;
-				fdTemp->NextNode->NextNode=NULL;
-			}
-			return fdTemp->NextNode;
+	fd->pcFileName=g_strdup(pcFileName);
+	for(i=0;i<10;i++)
+		fd->iBookmark[i]=-1;
 
-		}
-		fdTemp=fdTemp->NextNode;
+	/* don't need to initiate iBookmarkLinePos */
+	fd->pcFolding=NULL;
+	fd->LastChangedTime=-1;
+	fd->pcBookmarks=NULL;
 
-	}
+	g_hash_table_insert(htKnownFilesSettings,g_strdup((pcFileName==NULL)?"":pcFileName),fd);
+
+	/* only now need any saved details for this file */
+	if(pcFileName!=NULL)
+		LoadFileDetailsRecord(pcFileName);
+
+	return fd;
 }
 
 
@@ -459,14 +489,12 @@ static gboolean SaveIndividualSetting(GKeyFile *gkf,FileData *fd,gint iNumber,gc
 }
 
 
-/* save settings (preferences, file data such as fold states, marker positions) */
-static void SaveSettings(gchar *filename)
+/* save settings (preferences) */
+static void SaveSettings(void)
 {
 	GKeyFile *config=NULL;
 	gchar *config_file=NULL,*config_dir=NULL;
 	gchar *data;
-	FileData* fdTemp=fdKnownFilesSettings;
-	gint i=0;
 
 	/* create new config from default settings */
 	config=g_key_file_new();
@@ -480,16 +508,6 @@ static void SaveSettings(gchar *filename)
 	if(FileDetailsSuffix!=NULL)
 		g_key_file_set_string(config,"Settings","File_Details_Suffix",FileDetailsSuffix);
 
-	/* now save file data */
-	while(fdTemp!=NULL)
-	{
-		/* if this entry has data needing saveing then save it and increment the counter */
-		if(SaveIndividualSetting(config,fdTemp,i,fdTemp->pcFileName))
-			i++;
-
-		fdTemp=fdTemp->NextNode;
-	}
-
 	/* turn config into data */
 	data=g_key_file_to_data(config,NULL,NULL);
 
@@ -509,23 +527,22 @@ static void SaveSettings(gchar *filename)
 	g_free(config_file);
 	g_key_file_free(config);
 	g_free(data);
+}
 
-	/* now consider if not purely saving file settings to main settings file */
-	/* return if not saving data with file */
-	if(filename==NULL || WhereToSaveFileDetails==0)
-		return;
+
+/* save details of one file into the given settings file, or delete the settings file if there is
+ * nothing to save
+*/
+static void SaveFileDetailsTo(FileData *fd,gchar *config_file,gchar *Filename)
+{
+	GKeyFile *config;
+	gchar *data;
 
 	/* setup keyfile to hold values */
 	config=g_key_file_new();
 
-	/* get pointer to data we're saving */
-	fdTemp=GetFileData(filename);
-
-	/* calculate settings filename */
-	config_file=g_strdup_printf("%s%s",filename,FileDetailsSuffix);
-
 	/* if nothing to save then delete any old data */
-	if(SaveIndividualSetting(config,fdTemp,-1,NULL)==FALSE)
+	if(SaveIndividualSetting(config,fd,-1,Filename)==FALSE)
 		g_remove(config_file);
 	/* otherwise save the data */
 	else
@@ -538,12 +555,41 @@ static void SaveSettings(gchar *filename)
 		g_free(data);
 	}
 
-	/* free memory */
-	g_free(config_file);
 	g_key_file_free(config);
 }
 
 
+/* save file data such as fold states, marker positions for a file. Only the file's own record
+ * is written
+*/
+static void SaveFileDetails(FileData *fd,gboolean bAlsoLocal)
+{
+	gchar *config_file,*config_dir;
+
+	if(fd->pcFileName==NULL)
+		return;
+
+	/* save to central record (filename is kept in it to help identify it) */
+	config_file=GetFileDetailsRecordName(fd->pcFileName);
+	config_dir=g_path_get_dirname(config_file);
+	/* ensure directory exists */
+	g_mkdir_with_parents(config_dir,0755);
+	SaveFileDetailsTo(fd,config_file,fd->pcFileName);
+	g_free(config_dir);
+	g_free(config_file);
+
+	/* now consider if not purely saving file settings to central settings */
+	/* return if not saving data with file */
+	if(bAlsoLocal==FALSE || WhereToSaveFileDetails==0)
+		return;
+
+	/* calculate settings filename */
+	config_file=g_strdup_printf("%s%s",fd->pcFileName,FileDetailsSuffix);
+	SaveFileDetailsTo(fd,config_file,NULL);
+	g_free(config_file);
+}
+
+
 /* load individual file details. return TRUE if data there, FALSE if there isn't */
 static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename)
 {
@@ -582,6 +628,7 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 
 	/* get folding data */
 	pcKey[0]='B';
+	g_free(fd->pcFolding);
 	if(bRememberFolds==TRUE)
 		fd->pcFolding=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
 	else
@@ -629,6 +676,7 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 
 	/* get non-numbered bookmarks */
 	pcKey[0]='F';
+	g_free(fd->pcBookmarks);
 	if(bRememberBookmarks==TRUE)
 		fd->pcBookmarks=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
 	else
@@ -642,7 +690,14 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 }
 
 
-/* load settings (preferences, file data, and macro data) */
+/* save the record of a file loaded from an old style settings file */
+static void MigrateFileDetails(gpointer key,gpointer value,gpointer user_data)
+{
+	SaveFileDetails((FileData*)value,FALSE);
+}
+
+
+/* load settings (preferences). Details of files are loaded when the file is first needed */
 static void LoadSettings(void)
 {
 	gint i;
@@ -675,11 +730,19 @@ static void LoadSettings(void)
 	FileDetailsSuffix=utils_get_setting_string(config,"Settings","File_Details_Suffix",
 	                                           ".gnbs.conf");
 
-	/* extract data about files */
+	/* older versions kept data about all files in the settings file: if that's what we have, move
+	 * it to individual records and rewrite the settings file without it
+	*/
 	i=0;
 	while(LoadIndividualSetting(config,i,NULL))
 		i++;
 
+	if(i>0)
+	{
+		g_hash_table_foreach(htKnownFilesSettings,MigrateFileDetails,NULL);
+		SaveSettings();
+	}
+
 	/* free memory */
 	g_free(config_dir);
 	g_free(config_file);
@@ -1144,8 +1207,8 @@ static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_dat
 	if(stat(doc->file_name,&sBuf)==0)
 		fd->LastChangedTime=sBuf.st_mtime;
 
-	/* save settings */
-	SaveSettings(doc->file_name);
+	/* save details of this file */
+	SaveFileDetails(fd,TRUE);
 }
 
 
@@ -1200,7 +1263,7 @@ static void on_configure_response(GtkDialog *dialog, gint response, gpointer use
 
 	/* now save new settings if they have changed */
 	if(bSettingsHaveChanged)
-		SaveSettings(NULL);
+		SaveSettings();
 }
 
 
@@ -1469,6 +1532,10 @@ void plugin_init(GeanyData *data)
 	gint i,k,iResults=0;
 	GdkKeymapKey *gdkkmkResults;
 
+	/* create store of file details */
+	htKnownFilesSettings=g_hash_table_new_full(g_str_hash,g_str_equal,g_free,
+	                                           (GDestroyNotify)FreeFileData);
+
 	/* Load settings */
 	LoadSettings();
 
@@ -1535,8 +1602,6 @@ void plugin_cleanup(void)
 	gint k;
 	guint i;
 	ScintillaObject* sci;
-	FileData *fdTemp=fdKnownFilesSettings;
-	FileData *fdTemp2;
 	guint32 *markers;
 
 	/* uncouple keypress monitor */
@@ -1555,19 +1620,8 @@ void plugin_cleanup(void)
 		}
 
 	/* Clear memory used to hold file details */
-	while(fdTemp!=NULL)
-	{
-		/* free filename */
-		g_free(fdTemp->pcFileName);
-		/* free folding & bookmark information if present */
-		g_free(fdTemp->pcFolding);
-		g_free(fdTemp->pcBookmarks);
-
-		fdTemp2=fdTemp->NextNode;
-		/* free memory block  */
-		g_free(fdTemp);
-		fdTemp=fdTemp2;
-	}
+	g_hash_table_destroy(htKnownFilesSettings);
+	htKnownFilesSettings=NULL;
 
 	/* free memory used for settings */
 	g_free(FileDetailsSuffix);
@@ -28,6 +28,11 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <unistd.h>
+#include <time.h>
+#ifdef G_OS_UNIX
+#include <sys/types.h>
+#include <signal.h>
+#endif
 
 #ifdef HAVE_CONFIG_H
 	#include "config.h"
@@ -62,6 +67,7 @@ static gboolean set_maximize_commit_dialog;
 static gboolean set_external_diff;
 static gboolean set_editor_menu_entries;
 static gboolean set_menubar_entry;
+static gboolean set_diff_markers;
 
 static gchar *config_file;
 
@@ -78,6 +84,9 @@ static gchar *lang;
 
 static GSList *VC = NULL;
 
+/* the thread running the GUI */
+static GThread *main_thread = NULL;
+
 /* The addresses of these strings act as enums, their contents are not used. */
 /* absolute path dirname of file */
 const gchar ABS_DIRNAME[] = "*ABS_DIRNAME*";
@@ -114,6 +123,7 @@ static GtkWidget *menu_entry = NULL;
 
 
 static void registrate(void);
+static void reset_diff_markers(void);
 static void add_menuitems_to_editor_menu(void);
 static void remove_menuitems_from_editor_menu(void);
 
@@ -242,19 +252,180 @@ find_dir(const gchar * filename, const char *find, gboolean recursive)
 }
 
 
-static const VC_RECORD *
-find_vc(const char *filename)
+/* Repository cache.
+ * vc_dirs maps a directory to the repository it belongs to (NULL when it is
+ * not versioned) and vc_repos maps a repository base directory to its VC and
+ * the set of files it tracks. The tracked files are listed by one command and
+ * only listed again after the repository index changed, so most lookups do not
+ * touch the file system at all. */
+typedef struct _VcRepo
+{
+	const VC_RECORD *vc;
+	gchar *base_dir;
+	GHashTable *files;
+	GFileMonitor *monitor;
+} VcRepo;
+
+typedef struct _VcDir
+{
+	VcRepo *repo;
+	time_t checked;
+} VcDir;
+
+/* directories are checked again after this many seconds, to notice a repository
+ * created or removed around them */
+#define VC_DIR_RECHECK_TIMEOUT 30
+
+static GHashTable *vc_repos = NULL;
+static GHashTable *vc_dirs = NULL;
+
+static void
+free_vc_repo(VcRepo * repo)
+{
+	if (repo->monitor)
+	{
+		g_file_monitor_cancel(repo->monitor);
+		g_object_unref(repo->monitor);
+	}
+	if (repo->files)
+		g_hash_table_destroy(repo->files);
+	g_free(repo->base_dir);
+	g_free(repo);
+}
+
+static void
+clear_vc_cache(void)
+{
+	if (vc_dirs)
+	{
+		g_hash_table_destroy(vc_dirs);
+		vc_dirs = NULL;
+	}
+	if (vc_repos)
+	{
+		g_hash_table_destroy(vc_repos);
+		vc_repos = NULL;
+	}
+}
+
+static void
+vc_index_changed(G_GNUC_UNUSED GFileMonitor * monitor, G_GNUC_UNUSED GFile * file,
+		 G_GNUC_UNUSED GFile * other_file, G_GNUC_UNUSED GFileMonitorEvent event_type,
+		 gpointer user_data)
+{
+	VcRepo *repo = user_data;
+
+	if (repo->files)
+	{
+		g_hash_table_destroy(repo->files);
+		repo->files = NULL;
+	}
+}
+
+static VcRepo *
+get_vc_repo(const VC_RECORD * vc, const gchar * dir)
+{
+	VcRepo *repo;
+	gchar *base_dir;
+	gchar *index;
+	GFile *file;
+
+	base_dir = vc->get_base_dir(dir);
+	if (!base_dir)
+		base_dir = g_strdup(dir);
+
+	repo = g_hash_table_lookup(vc_repos, base_dir);
+	if (repo)
+	{
+		g_free(base_dir);
+		return repo;
+	}
+
+	repo = g_new0(VcRepo, 1);
+	repo->vc = vc;
+	repo->base_dir = base_dir;
+	/* without a monitor the file list could go stale, so it is not used */
+	if (vc->get_tracked_files && vc->get_index_file)
+	{
+		index = vc->get_index_file(base_dir);
+		if (index)
+		{
+			file = g_file_new_for_path(index);
+			repo->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+			if (repo->monitor)
+				g_signal_connect(repo->monitor, "changed", G_CALLBACK(vc_index_changed), repo);
+			g_object_unref(file);
+			g_free(index);
+		}
+	}
+	g_hash_table_insert(vc_repos, base_dir, repo);
+	return repo;
+}
+
+static VcRepo *
+find_vc_repo(const gchar * dir)
 {
 	GSList *tmp;
+	VcDir *entry;
+	time_t now = time(NULL);
+
+	if (!vc_dirs)
+	{
+		vc_repos = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+						 (GDestroyNotify) free_vc_repo);
+		vc_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	}
+
+	entry = g_hash_table_lookup(vc_dirs, dir);
+	if (entry && now - entry->checked < VC_DIR_RECHECK_TIMEOUT)
+		return entry->repo;
 
+	if (!entry)
+	{
+		entry = g_new0(VcDir, 1);
+		g_hash_table_insert(vc_dirs, g_strdup(dir), entry);
+	}
+	entry->checked = now;
+	entry->repo = NULL;
 	for (tmp = VC; tmp != NULL; tmp = g_slist_next(tmp))
 	{
-		if (((VC_RECORD *) tmp->data)->in_vc(filename))
+		if (((VC_RECORD *) tmp->data)->in_vc(dir))
 		{
-			return (VC_RECORD *) tmp->data;
+			entry->repo = get_vc_repo((VC_RECORD *) tmp->data, dir);
+			break;
 		}
 	}
-	return NULL;
+	return entry->repo;
+}
+
+static const VC_RECORD *
+find_vc(const char *filename)
+{
+	VcRepo *repo;
+	gchar *dir;
+	gboolean is_dir;
+
+	is_dir = g_file_test(filename, G_FILE_TEST_IS_DIR);
+	if (is_dir)
+		dir = g_strdup(filename);
+	else
+		dir = g_path_get_dirname(filename);
+	repo = find_vc_repo(dir);
+	g_free(dir);
+
+	if (!repo)
+		return NULL;
+	if (is_dir)
+		return repo->vc;
+
+	if (repo->monitor)
+	{
+		if (!repo->files)
+			repo->files = repo->vc->get_tracked_files(repo->base_dir);
+		if (repo->files)
+			return g_hash_table_lookup(repo->files, filename) ? repo->vc : NULL;
+	}
+	return repo->vc->in_vc(filename) ? repo->vc : NULL;
 }
 
 static void *
@@ -437,7 +608,7 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 		       const gchar * message)
 {
 	gint exit_code;
-	GString *tmp;
+	gsize len;
 	GSList *cur;
 	GSList *largv = get_cmd(argv, dir, filename, list, message);
 	GError *error = NULL;
@@ -472,8 +643,10 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 		if (error)
 		{
 			g_warning("geanyvc: s_spawn_sync error: %s", error->message);
-			ui_set_statusbar(FALSE, _("geanyvc: s_spawn_sync error: %s"),
-					 error->message);
+			/* the change markers read committed versions in a worker thread */
+			if (g_thread_self() == main_thread)
+				ui_set_statusbar(FALSE, _("geanyvc: s_spawn_sync error: %s"),
+						 error->message);
 			g_error_free(error);
 		}
 
@@ -481,10 +654,8 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 		   UTF-8 because internally Geany always needs UTF-8 */
 		if (std_out && *std_out)
 		{
-			tmp = g_string_new(*std_out);
-			utils_string_replace_all(tmp, "\r\n", "\n");
-			utils_string_replace_all(tmp, "\r", "\n");
-			setptr(*std_out, g_string_free(tmp, FALSE));
+			len = normalize_line_endings(*std_out, strlen(*std_out));
+			(*std_out)[len] = '\0';
 
 			if (!g_utf8_validate(*std_out, -1, NULL))
 			{
@@ -499,10 +670,8 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 		}
 		if (std_err && *std_err)
 		{
-			tmp = g_string_new(*std_err);
-			utils_string_replace_all(tmp, "\r\n", "\n");
-			utils_string_replace_all(tmp, "\r", "\n");
-			setptr(*std_err, g_string_free(tmp, FALSE));
+			len = normalize_line_endings(*std_err, strlen(*std_err));
+			(*std_err)[len] = '\0';
 
 			if (!g_utf8_validate(*std_err, -1, NULL))
 			{
@@ -521,11 +690,34 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 	return exit_code;
 }
 
+static gchar *
+get_command_dir(const VC_RECORD * vc, const gchar * filename, gint cmd)
+{
+	gchar *dir = NULL;
+
+	if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_FILE)
+	{
+		if (g_file_test(filename, G_FILE_TEST_IS_DIR))
+			dir = g_strdup(filename);
+		else
+			dir = g_path_get_dirname(filename);
+	}
+	else if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_BASE)
+	{
+		dir = vc->get_base_dir(filename);
+	}
+	else
+	{
+		g_warning("geanyvc: unknown startdir type: %d", vc->commands[cmd].startdir);
+	}
+	return dir;
+}
+
 static gint
 execute_command(const VC_RECORD * vc, gchar ** std_out, gchar ** std_err, const gchar * filename,
 		gint cmd, GSList * list, const gchar * message)
 {
-	gchar *dir = NULL;
+	gchar *dir;
 	gint ret;
 
 	if (std_out)
@@ -538,26 +730,354 @@ execute_command(const VC_RECORD * vc, gchar ** std_out, gchar ** std_err, const
 		return vc->commands[cmd].function(std_out, std_err, filename, list, message);
 	}
 
-	if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_FILE)
+	dir = get_command_dir(vc, filename, cmd);
+	ret = execute_custom_command(dir, vc->commands[cmd].command, vc->commands[cmd].env, std_out,
+				     std_err, filename, list, message);
+	g_free(dir);
+	return ret;
+}
+
+
+/* Asynchronous commands.
+ * The output of the last command in the spec is read while the command runs and appended to
+ * the output document a line at a time, so long logs, diffs and updates do not block the UI.
+ * Only one command runs at a time, it can be cancelled from the menu and is stopped once its
+ * output reaches VC_OUTPUT_LIMIT. */
+#define VC_OUTPUT_LIMIT (16 * 1024 * 1024)
+
+typedef struct _VcJob
+{
+	GSList *largv;		/* commands not finished yet, the output of the last one is shown */
+	gchar *dir;
+	const gchar **env;
+	GPid pid;
+	guint child_watch;
+	GIOChannel *channel;
+	guint io_watch;
+	gboolean running;	/* current command did not exit yet */
+	gboolean cancelled;
+	gboolean truncated;
+	GString *pending;	/* output not shown yet, it does not end with a complete line */
+	gsize normalized;	/* leading bytes of pending with normalized line endings */
+	gsize shown;
+	gboolean have_doc;
+	gchar *name;
+	gchar *encoding;
+	GeanyFiletype *ftype;
+	gint line;
+	const gchar *empty_message;
+	gchar *reload_filename;
+} VcJob;
+
+static VcJob *running_job = NULL;
+
+static void vc_job_next(VcJob * job);
+
+static void
+vc_job_kill(VcJob * job)
+{
+#ifdef G_OS_UNIX
+	if (job->running)
+		kill(job->pid, SIGTERM);
+#endif
+}
+
+static void
+vc_job_free(VcJob * job)
+{
+	if (job->io_watch)
+		g_source_remove(job->io_watch);
+	if (job->channel)
+		g_io_channel_unref(job->channel);
+	if (job->child_watch)
+	{
+		g_source_remove(job->child_watch);
+		vc_job_kill(job);
+		g_spawn_close_pid(job->pid);
+	}
+	g_slist_foreach(job->largv, (GFunc) g_strfreev, NULL);
+	g_slist_free(job->largv);
+	g_string_free(job->pending, TRUE);
+	g_free(job->dir);
+	g_free(job->name);
+	g_free(job->encoding);
+	g_free(job->reload_filename);
+	g_free(job);
+}
+
+static void
+vc_job_cancel(VcJob * job)
+{
+	job->cancelled = TRUE;
+	vc_job_kill(job);
+}
+
+static void
+vc_job_show(VcJob * job, const gchar * text, gsize len)
+{
+	GeanyDocument *doc;
+	gchar *chunk = g_strndup(text, len);
+
+	if (!g_utf8_validate(chunk, -1, NULL))
 	{
-		if (g_file_test(filename, G_FILE_TEST_IS_DIR))
-			dir = g_strdup(filename);
-		else
-			dir = g_path_get_dirname(filename);
+		setptr(chunk, encodings_convert_to_utf8(chunk, len, NULL));
+		if (!chunk)
+			return;
 	}
-	else if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_BASE)
+
+	if (!job->have_doc)
 	{
-		dir = vc->get_base_dir(filename);
+		show_output(chunk, job->name, job->encoding, job->ftype, job->line);
+		job->have_doc = TRUE;
 	}
 	else
 	{
-		g_warning("geanyvc: unknown startdir type: %d", vc->commands[cmd].startdir);
+		doc = document_find_by_filename(job->name);
+		/* the output document was closed, nobody reads the rest */
+		if (!doc)
+			vc_job_cancel(job);
+		else
+			scintilla_send_message(doc->editor->sci, SCI_APPENDTEXT, strlen(chunk),
+					       (sptr_t) chunk);
 	}
+	g_free(chunk);
+}
 
-	ret = execute_custom_command(dir, vc->commands[cmd].command, vc->commands[cmd].env, std_out,
-				     std_err, filename, list, message);
-	g_free(dir);
-	return ret;
+/* Show the complete lines of the pending output, or all of it at the end */
+static void
+vc_job_flush(VcJob * job, gboolean all)
+{
+	gchar *str = job->pending->str;
+	/* the bytes normalized by the previous calls hold no line break, or they would have been
+	 * shown, so only the new ones are searched and long lines are not scanned again */
+	gsize scanned = job->normalized;
+	gsize keep_cr;
+	gsize len;
+	gsize end;
+
+	/* a trailing CR may be the first half of a CR LF pair split between reads */
+	keep_cr = (!all && job->pending->len > 0 && str[job->pending->len - 1] == '\r') ? 1 : 0;
+	len = normalize_line_endings(str + job->normalized,
+				     job->pending->len - keep_cr - job->normalized);
+	if (keep_cr)
+		str[job->normalized + len] = '\r';
+	job->normalized += len;
+	g_string_truncate(job->pending, job->normalized + keep_cr);
+
+	end = job->normalized;
+	if (!all)
+	{
+		while (end > scanned && str[end - 1] != '\n')
+			end--;
+		if (end == scanned)
+			return;
+	}
+	if (end == 0)
+		return;
+
+	vc_job_show(job, str, end);
+	job->shown += end;
+	g_string_erase(job->pending, 0, end);
+	job->normalized -= end;
+}
+
+static void
+vc_job_output(VcJob * job, const gchar * buf, gsize len)
+{
+	if (job->cancelled)
+		return;
+
+	if (job->shown + job->pending->len + len > VC_OUTPUT_LIMIT)
+	{
+		g_string_append_len(job->pending, buf, VC_OUTPUT_LIMIT - job->shown - job->pending->len);
+		vc_job_flush(job, FALSE);
+		g_string_truncate(job->pending, 0);
+		job->normalized = 0;
+		job->truncated = TRUE;
+		vc_job_cancel(job);
+		ui_set_statusbar(FALSE, _("geanyvc: the output is longer than %d MB, the command was stopped."),
+				 VC_OUTPUT_LIMIT / (1024 * 1024));
+		return;
+	}
+	g_string_append_len(job->pending, buf, len);
+	vc_job_flush(job, FALSE);
+}
+
+static gboolean
+vc_job_read(GIOChannel * channel, GIOCondition condition, gpointer data)
+{
+	VcJob *job = data;
+	gchar buf[16384];
+	gsize len = 0;
+	GIOStatus status = G_IO_STATUS_EOF;
+
+	if (condition & (G_IO_IN | G_IO_PRI))
+	{
+		status = g_io_channel_read_chars(channel, buf, sizeof(buf), &len, NULL);
+		if (len > 0)
+			vc_job_output(job, buf, len);
+		if (status == G_IO_STATUS_NORMAL || status == G_IO_STATUS_AGAIN)
+			return TRUE;
+	}
+
+	/* end of output */
+	job->io_watch = 0;
+	g_io_channel_unref(job->channel);
+	job->channel = NULL;
+	if (!job->running)
+		vc_job_next(job);
+	return FALSE;
+}
+
+static void
+vc_job_exited(GPid pid, G_GNUC_UNUSED gint status, gpointer data)
+{
+	VcJob *job = data;
+
+	g_spawn_close_pid(pid);
+	job->child_watch = 0;
+	job->running = FALSE;
+	if (!job->channel)
+		vc_job_next(job);
+}
+
+static gboolean
+vc_job_spawn(VcJob * job)
+{
+	gboolean last = (job->largv->next == NULL);
+	gint out_fd;
+	GError *error = NULL;
+
+	if (!g_spawn_async_with_pipes(job->dir, job->largv->data, (gchar **) job->env,
+				      G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+				      (last ? 0 : G_SPAWN_STDOUT_TO_DEV_NULL) |
+				      G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &job->pid, NULL,
+				      last ? &out_fd : NULL, NULL, &error))
+	{
+		g_warning("geanyvc: s_spawn_async error: %s", error->message);
+		ui_set_statusbar(FALSE, _("geanyvc: s_spawn_async error: %s"), error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	job->running = TRUE;
+	job->child_watch = g_child_watch_add(job->pid, vc_job_exited, job);
+	if (last)
+	{
+		job->channel = g_io_channel_unix_new(out_fd);
+		g_io_channel_set_encoding(job->channel, NULL, NULL);
+		g_io_channel_set_flags(job->channel, G_IO_FLAG_NONBLOCK, NULL);
+		g_io_channel_set_close_on_unref(job->channel, TRUE);
+		job->io_watch = g_io_add_watch(job->channel, G_IO_IN | G_IO_PRI | G_IO_HUP | G_IO_ERR,
+					       vc_job_read, job);
+	}
+	return TRUE;
+}
+
+static void
+vc_job_finish(VcJob * job)
+{
+	GeanyDocument *doc;
+
+	if (!job->cancelled)
+		vc_job_flush(job, TRUE);
+
+	doc = job->have_doc ? document_find_by_filename(job->name) : NULL;
+	if (doc)
+	{
+		/* the output was appended in pieces, make it look like it was loaded at once */
+		scintilla_send_message(doc->editor->sci, SCI_EMPTYUNDOBUFFER, 0, 0);
+		scintilla_send_message(doc->editor->sci, SCI_SETSAVEPOINT, 0, 0);
+		document_set_text_changed(doc, set_changed_flag);
+		if (job->line > 0)
+			sci_goto_line(doc->editor->sci, job->line, TRUE);
+	}
+	else if (!job->cancelled && job->empty_message)
+	{
+		ui_set_statusbar(FALSE, "%s", job->empty_message);
+	}
+
+	if (job->reload_filename)
+	{
+		/* an update, the base versions of the files may have changed */
+		reset_diff_markers();
+		doc = document_find_by_filename(job->reload_filename);
+		if (doc)
+			document_reload_file(doc, NULL);
+	}
+	if (job->cancelled && !job->truncated)
+		ui_set_statusbar(FALSE, _("geanyvc: the command was cancelled."));
+
+	running_job = NULL;
+	vc_job_free(job);
+}
+
+/* Start the next command of the spec, or finish when all of them are done */
+static void
+vc_job_next(VcJob * job)
+{
+	if (job->largv)
+	{
+		g_strfreev(job->largv->data);
+		job->largv = g_slist_delete_link(job->largv, job->largv);
+	}
+	if (job->cancelled || !job->largv || !vc_job_spawn(job))
+		vc_job_finish(job);
+}
+
+/*
+ * Execute command without waiting for it and show its output in document @name as it arrives
+ *
+ * @encoding, @ftype, @line - as for show_output
+ * @empty_message - shown in the statusbar if the command has no output, can be NULL
+ * @reload_filename - document to reload when the command is done, can be NULL
+ */
+static void
+execute_command_async(const VC_RECORD * vc, const gchar * filename, gint cmd, const gchar * name,
+		      const gchar * encoding, GeanyFiletype * ftype, gint line,
+		      const gchar * empty_message, const gchar * reload_filename)
+{
+	gchar *text = NULL;
+	gchar *dir;
+	GeanyDocument *doc;
+	VcJob *job;
+
+	if (running_job)
+	{
+		ui_set_statusbar(FALSE, _("geanyvc: another command is still running."));
+		return;
+	}
+
+	/* custom functions can only be run synchronously */
+	if (vc->commands[cmd].function)
+	{
+		execute_command(vc, &text, NULL, filename, cmd, NULL, NULL);
+		if (reload_filename && (doc = document_find_by_filename(reload_filename)) != NULL)
+			document_reload_file(doc, NULL);
+		if (NZV(text))
+			show_output(text, name, encoding, ftype, line);
+		else if (empty_message)
+			ui_set_statusbar(FALSE, "%s", empty_message);
+		g_free(text);
+		return;
+	}
+
+	dir = get_command_dir(vc, filename, cmd);
+	job = g_new0(VcJob, 1);
+	job->largv = get_cmd(vc->commands[cmd].command, dir, filename, NULL, NULL);
+	job->dir = dir;
+	job->env = vc->commands[cmd].env;
+	job->pending = g_string_new(NULL);
+	job->name = g_strdup(name);
+	job->encoding = g_strdup(encoding);
+	job->ftype = ftype;
+	job->line = line;
+	job->empty_message = empty_message;
+	job->reload_filename = g_strdup(reload_filename);
+
+	running_job = job;
+	if (!job->largv || !vc_job_spawn(job))
+		vc_job_finish(job);
 }
 
 /* Callback if menu item for a single file was activated */
@@ -582,64 +1102,61 @@ vcdiff_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoint
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
+	if (!(set_external_diff && get_external_diff_viewer()))
+	{
+		name = g_strconcat(doc->file_name, ".vc.diff", NULL);
+		execute_command_async(vc, doc->file_name, VC_COMMAND_DIFF_FILE, name, doc->encoding,
+				      NULL, 0, _("No changes were made."), NULL);
+		g_free(name);
+		return;
+	}
+
 	execute_command(vc, &text, NULL, doc->file_name, VC_COMMAND_DIFF_FILE, NULL, NULL);
 	if (text)
 	{
-		if (set_external_diff && get_external_diff_viewer())
-		{
-			g_free(text);
-
-			/*  1) rename file to file.geany.~NEW~
-			   2) revert file
-			   3) rename file to file.geanyvc.~BASE~
-			   4) rename file.geany.~NEW~ to origin file
-			   5) show diff
-			 */
-			localename = utils_get_locale_from_utf8(doc->file_name);
+		g_free(text);
 
-			new = g_strconcat(doc->file_name, ".geanyvc.~NEW~", NULL);
-			setptr(new, utils_get_locale_from_utf8(new));
+		/*  1) rename file to file.geany.~NEW~
+		   2) revert file
+		   3) rename file to file.geanyvc.~BASE~
+		   4) rename file.geany.~NEW~ to origin file
+		   5) show diff
+		 */
+		localename = utils_get_locale_from_utf8(doc->file_name);
 
-			old = g_strconcat(doc->file_name, ".geanyvc.~BASE~", NULL);
-			setptr(old, utils_get_locale_from_utf8(old));
+		new = g_strconcat(doc->file_name, ".geanyvc.~NEW~", NULL);
+		setptr(new, utils_get_locale_from_utf8(new));
 
-			if (g_rename(localename, new) != 0)
-			{
-				g_warning(_
-					  ("geanyvc: vcdiff_file_activated: Unable to rename '%s' to '%s'"),
-					  localename, new);
-				goto end;
-			}
+		old = g_strconcat(doc->file_name, ".geanyvc.~BASE~", NULL);
+		setptr(old, utils_get_locale_from_utf8(old));
 
-			execute_command(vc, NULL, NULL, doc->file_name,
-					VC_COMMAND_REVERT_FILE, NULL, NULL);
+		if (g_rename(localename, new) != 0)
+		{
+			g_warning(_
+				  ("geanyvc: vcdiff_file_activated: Unable to rename '%s' to '%s'"),
+				  localename, new);
+			goto end;
+		}
 
-			if (g_rename(localename, old) != 0)
-			{
-				g_warning(_
-					  ("geanyvc: vcdiff_file_activated: Unable to rename '%s' to '%s'"),
-					  localename, old);
-				g_rename(new, localename);
-				goto end;
-			}
-			g_rename(new, localename);
+		execute_command(vc, NULL, NULL, doc->file_name,
+				VC_COMMAND_REVERT_FILE, NULL, NULL);
 
-			vc_external_diff(old, localename);
-			g_unlink(old);
-		      end:
-			g_free(old);
-			g_free(new);
-			g_free(localename);
-			return;
-		}
-		else
+		if (g_rename(localename, old) != 0)
 		{
-			name = g_strconcat(doc->file_name, ".vc.diff", NULL);
-			show_output(text, name, doc->encoding, NULL, 0);
-			g_free(text);
-			g_free(name);
+			g_warning(_
+				  ("geanyvc: vcdiff_file_activated: Unable to rename '%s' to '%s'"),
+				  localename, old);
+			g_rename(new, localename);
+			goto end;
 		}
+		g_rename(new, localename);
 
+		vc_external_diff(old, localename);
+		g_unlink(old);
+	      end:
+		g_free(old);
+		g_free(new);
+		g_free(localename);
 	}
 	else
 	{
@@ -653,7 +1170,7 @@ vcdiff_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoint
 static void
 vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 {
-	gchar *text = NULL;
+	gchar *name;
 	gchar *dir;
 	gint flags = GPOINTER_TO_INT(data);
 	const VC_RECORD *vc;
@@ -682,26 +1199,16 @@ vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 		return;
 	g_return_if_fail(dir);
 
-	execute_command(vc, &text, NULL, dir, VC_COMMAND_DIFF_DIR, NULL, NULL);
-	if (text)
-	{
-		gchar *name;
-		name = g_strconcat(dir, ".vc.diff", NULL);
-		show_output(text, name, doc->encoding, NULL, 0);
-		g_free(text);
-		g_free(name);
-	}
-	else
-	{
-		ui_set_statusbar(FALSE, _("No changes were made."));
-	}
+	name = g_strconcat(dir, ".vc.diff", NULL);
+	execute_command_async(vc, dir, VC_COMMAND_DIFF_DIR, name, doc->encoding, NULL, 0,
+			      _("No changes were made."), NULL);
+	g_free(name);
 	g_free(dir);
 }
 
 static void
 vcblame_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -711,24 +1218,15 @@ vcblame_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer g
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, doc->file_name, VC_COMMAND_BLAME, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-BLAME*", NULL,
-			doc->file_type, sci_get_current_line(doc->editor->sci));
-		g_free(text);
-	}
-	else
-	{
-		ui_set_statusbar(FALSE, _("No history available"));
-	}
+	execute_command_async(vc, doc->file_name, VC_COMMAND_BLAME, "*VC-BLAME*", NULL,
+			      doc->file_type, sci_get_current_line(doc->editor->sci),
+			      _("No history available"), NULL);
 }
 
 
 static void
 vclog_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *output = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -738,19 +1236,14 @@ vclog_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointe
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &output, NULL, doc->file_name, VC_COMMAND_LOG_FILE, NULL, NULL);
-	if (output)
-	{
-		show_output(output, "*VC-LOG*", NULL, NULL, 0);
-		g_free(output);
-	}
+	execute_command_async(vc, doc->file_name, VC_COMMAND_LOG_FILE, "*VC-LOG*", NULL, NULL, 0,
+			      NULL, NULL);
 }
 
 static void
 vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
 	gchar *base_name = NULL;
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -762,12 +1255,8 @@ vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	vc = find_vc(base_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, base_name, VC_COMMAND_LOG_DIR, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-LOG*", NULL, NULL, 0);
-		g_free(text);
-	}
+	execute_command_async(vc, base_name, VC_COMMAND_LOG_DIR, "*VC-LOG*", NULL, NULL, 0, NULL,
+			      NULL);
 
 	g_free(base_name);
 }
@@ -775,7 +1264,6 @@ vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 static void
 vclog_basedir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 	gchar *basedir;
@@ -789,12 +1277,7 @@ vclog_basedir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoi
 	basedir = vc->get_base_dir(doc->file_name);
 	g_return_if_fail(basedir);
 
-	execute_command(vc, &text, NULL, basedir, VC_COMMAND_LOG_DIR, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-LOG*", NULL, NULL, 0);
-		g_free(text);
-	}
+	execute_command_async(vc, basedir, VC_COMMAND_LOG_DIR, "*VC-LOG*", NULL, NULL, 0, NULL, NULL);
 	g_free(basedir);
 }
 
@@ -803,7 +1286,6 @@ static void
 vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
 	gchar *base_name = NULL;
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -820,12 +1302,8 @@ vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	vc = find_vc(base_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, base_name, VC_COMMAND_STATUS, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-STATUS*", NULL, NULL, 0);
-		g_free(text);
-	}
+	execute_command_async(vc, base_name, VC_COMMAND_STATUS, "*VC-STATUS*", NULL, NULL, 0, NULL,
+			      NULL);
 
 	g_free(base_name);
 }
@@ -833,7 +1311,7 @@ vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 static void
 vcshow_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *output = NULL;
+	gchar *name;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -843,22 +1321,38 @@ vcshow_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoint
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &output, NULL, doc->file_name, VC_COMMAND_SHOW, NULL, NULL);
-	if (output)
+	name = g_strconcat(doc->file_name, ".vc.orig", NULL);
+	execute_command_async(vc, doc->file_name, VC_COMMAND_SHOW, name, doc->encoding,
+			      doc->file_type, 0, NULL, NULL);
+	g_free(name);
+}
+
+static gboolean
+ask_question(const gchar * question, const gchar * subject, gint flags)
+{
+	GtkWidget *dialog;
+	gint result;
+
+	if ((flags & FLAG_FORCE_ASK) || set_add_confirmation)
 	{
-		gchar *name;
-		name = g_strconcat(doc->file_name, ".vc.orig", NULL);
-		show_output(output, name, doc->encoding, doc->file_type, 0);
-		g_free(name);
-		g_free(output);
+		dialog = gtk_message_dialog_new(GTK_WINDOW(geany->main_widgets->window),
+						GTK_DIALOG_DESTROY_WITH_PARENT,
+						GTK_MESSAGE_QUESTION,
+						GTK_BUTTONS_YES_NO, question, subject);
+		result = gtk_dialog_run(GTK_DIALOG(dialog));
+		gtk_widget_destroy(dialog);
+	}
+	else
+	{
+		result = GTK_RESPONSE_YES;
 	}
+	return (result == GTK_RESPONSE_YES);
 }
 
 static gboolean
 command_with_question_activated(gchar ** text, gint cmd, const gchar * question, gint flags)
 {
-	GtkWidget *dialog;
-	gint result;
+	gboolean result;
 	gchar *dir;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
@@ -880,23 +1374,9 @@ command_with_question_activated(gchar ** text, gint cmd, const gchar * question,
 		document_save_file(doc, FALSE);
 	}
 
-	if ((flags & FLAG_FORCE_ASK) || set_add_confirmation)
-	{
-		dialog = gtk_message_dialog_new(GTK_WINDOW(geany->main_widgets->window),
-						GTK_DIALOG_DESTROY_WITH_PARENT,
-						GTK_MESSAGE_QUESTION,
-						GTK_BUTTONS_YES_NO, question,
-						(flags & (FLAG_DIR | FLAG_BASEDIR) ? dir :
-						 doc->file_name));
-		result = gtk_dialog_run(GTK_DIALOG(dialog));
-		gtk_widget_destroy(dialog);
-	}
-	else
-	{
-		result = GTK_RESPONSE_YES;
-	}
-
-	if (result == GTK_RESPONSE_YES)
+	result = ask_question(question, (flags & (FLAG_DIR | FLAG_BASEDIR) ? dir : doc->file_name),
+			      flags);
+	if (result)
 	{
 		if (flags & FLAG_FILE)
 			execute_command(vc, text, NULL, doc->file_name, cmd, NULL, NULL);
@@ -906,7 +1386,7 @@ command_with_question_activated(gchar ** text, gint cmd, const gchar * question,
 			document_reload_file(doc, NULL);
 	}
 	g_free(dir);
-	return (result == GTK_RESPONSE_YES);
+	return result;
 }
 
 static void
@@ -944,10 +1424,19 @@ vcremove_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	}
 }
 
+static void
+vccancel_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
+{
+	if (running_job)
+		vc_job_cancel(running_job);
+}
+
 static void
 vcupdate_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *text = NULL;
+	gchar *dir;
+	gchar *base_dir;
+	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
 	doc = document_get_current();
@@ -958,15 +1447,19 @@ vcupdate_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 		document_save_file(doc, FALSE);
 	}
 
-	if (command_with_question_activated(&text, VC_COMMAND_UPDATE,
-					    _("Do you really want to update?"), FLAG_BASEDIR))
-	{
-		document_reload_file(doc, NULL);
+	dir = g_path_get_dirname(doc->file_name);
+	vc = find_vc(dir);
+	base_dir = vc ? vc->get_base_dir(dir) : NULL;
+	g_free(dir);
+	g_return_if_fail(base_dir);
 
-		if (NZV(text))
-			show_output(text, "*VC-UPDATE*", NULL, NULL, 0);
-		g_free(text);
+	if (ask_question(_("Do you really want to update?"), base_dir, FLAG_BASEDIR))
+	{
+		/* the document is reloaded when the update is done */
+		execute_command_async(vc, base_dir, VC_COMMAND_UPDATE, "*VC-UPDATE*", NULL, NULL, 0,
+				      NULL, doc->file_name);
 	}
+	g_free(base_dir);
 }
 
 enum
@@ -1018,142 +1511,85 @@ get_commit_files_foreach(GtkTreeModel * model, G_GNUC_UNUSED GtkTreePath * path,
 	return FALSE;
 }
 
-static gboolean
-get_commit_diff_foreach(GtkTreeModel * model, G_GNUC_UNUSED GtkTreePath * path, GtkTreeIter * iter,
-			gpointer data)
+/* The diff of a file is only created when the file is selected in the commit dialog and kept
+ * for the lifetime of the dialog, so the dialog opens at once however big the changes are. */
+static const gchar *
+get_commit_file_diff(GtkTreeView * treeview, const gchar * filename)
 {
-	GString *diff = data;
-	gboolean commit;
-	gchar *filename;
-	gchar *tmp = NULL;
-	gchar *status;
+	GHashTable *diffs = g_object_get_data(G_OBJECT(treeview), "diffs");
+	gpointer diff = NULL;
+	gchar *text = NULL;
 	const VC_RECORD *vc;
 
-	gtk_tree_model_get(model, iter, COLUMN_COMMIT, &commit, -1);
-	if (!commit)
-		return FALSE;
-
-	gtk_tree_model_get(model, iter, COLUMN_STATUS, &status, -1);
-
-	if (! utils_str_equal(status, FILE_STATUS_MODIFIED))
-	{
-		g_free(status);
-		return FALSE;
-	}
-
-	gtk_tree_model_get(model, iter, COLUMN_PATH, &filename, -1);
+	if (g_hash_table_lookup_extended(diffs, filename, NULL, &diff))
+		return diff;
 
 	vc = find_vc(filename);
-	g_return_val_if_fail(vc, FALSE);
+	if (vc)
+		execute_command(vc, &text, NULL, filename, VC_COMMAND_DIFF_FILE, NULL, NULL);
+	if (!text)
+		g_warning("error: geanyvc: get_commit_file_diff: empty diff output");
+	g_hash_table_insert(diffs, g_strdup(filename), text);
+	return text;
+}
 
-	execute_command(vc, &tmp, NULL, filename, VC_COMMAND_DIFF_FILE, NULL, NULL);
-	if (tmp)
-	{
-		/* We temporarily add the filename to the diff output for parsing the diff output later,
-		 * after we have finished parsing, we apply the tag "invisible" which hides the text. */
-		g_string_append_printf(diff, "VC_DIFF%s\n", filename);
-		g_string_append(diff, tmp);
-		g_free(tmp);
-	}
-	else
+static const gchar *
+get_diff_tag(const gchar * line)
+{
+	switch (*line)
 	{
-		g_warning("error: geanyvc: get_commit_diff_foreach: empty diff output");
+		case '-':
+			return "deleted";
+		case '+':
+			return "added";
+		case ' ':
+			return NULL;
+		default:
+			return "default";
 	}
-	g_free(filename);
-	return FALSE;
 }
 
-static gchar *
-get_commit_diff(GtkTreeView * treeview)
+static void
+apply_diff_tag(GtkTextBuffer * buffer, const gchar * tagname, gint start_offset, gint end_offset)
 {
-	GtkTreeModel *model = gtk_tree_view_get_model(treeview);
-	GString *ret = g_string_new(NULL);
+	GtkTextIter start, end;
 
-	gtk_tree_model_foreach(model, get_commit_diff_foreach, ret);
+	if (!tagname || start_offset == end_offset)
+		return;
 
-	return g_string_free(ret, FALSE);
+	gtk_text_buffer_get_iter_at_offset(buffer, &start, start_offset);
+	gtk_text_buffer_get_iter_at_offset(buffer, &end, end_offset);
+	gtk_text_buffer_apply_tag_by_name(buffer, tagname, &start, &end);
 }
 
+/* Colour the diff in a single pass, character offsets are counted along the way and one tag is
+ * applied to each run of lines of the same kind. */
 static void
 set_diff_buff(GtkTextBuffer * buffer, const gchar * txt)
 {
-	GtkTextIter start, end;
-	GtkTextMark *mark;
-	gchar *filename;
-	const gchar *tagname = "";
-	const gchar *c, *p = txt;
+	const gchar *tagname;
+	const gchar *run_tagname = NULL;
+	const gchar *p, *next;
+	gint offset = 0;
+	gint run_offset = 0;
 
 	gtk_text_buffer_set_text(buffer, txt, -1);
 
-	gtk_text_buffer_get_start_iter(buffer, &start);
-	gtk_text_buffer_get_end_iter(buffer, &end);
-
-	gtk_text_buffer_remove_all_tags(buffer, &start, &end);
-
-	while (p)
+	for (p = txt; *p; p = next)
 	{
-		c = NULL;
-		if (*p == '-')
-		{
-			tagname = "deleted";
-		}
-		else if (*p == '+')
-		{
-			tagname = "added";
-		}
-		else if (*p == ' ')
-		{
-			tagname = "";
-		}
-		else if (strncmp(p, "VC_DIFF", 7) == 0)
-		{	/* Lines starting with VC_DIFF are special and were added by our code to tell about
-			 * filename to which the following diff lines belong. We use this file to create
-			 * text marks which we then later use to scroll to if the corresponding file has been
-			 * selected in the commit dialog's files list. */
-			tagname = "invisible";
-			c = strchr(p + 7, '\n');
-		}
-		else
-		{
-			tagname = "default";
-		}
-		gtk_text_buffer_get_iter_at_offset(buffer, &start,
-						   g_utf8_pointer_to_offset(txt, p));
-
-		if (c)
-		{	/* create the mark *after* the start iter has been updated */
-			filename = g_strndup(p + 7, c - p - 7);
-			/* delete old text marks */
-			mark = gtk_text_buffer_get_mark(buffer, filename);
-			if (mark)
-				gtk_text_buffer_delete_mark(buffer, mark);
-			/* create a new one */
-			gtk_text_buffer_create_mark(buffer, filename, &start, TRUE);
-			g_free(filename);
-		}
+		next = strchr(p, '\n');
+		next = next ? next + 1 : p + strlen(p);
 
-		p = strchr(p, '\n');
-		if (p)
+		tagname = get_diff_tag(p);
+		if (!utils_str_equal(tagname, run_tagname))
 		{
-			if (*tagname)
-			{
-				gtk_text_buffer_get_iter_at_offset(buffer, &end,
-						g_utf8_pointer_to_offset(txt, p + 1));
-				gtk_text_buffer_apply_tag_by_name(buffer, tagname, &start, &end);
-			}
-			p++;
+			apply_diff_tag(buffer, run_tagname, run_offset, offset);
+			run_tagname = tagname;
+			run_offset = offset;
 		}
+		offset += g_utf8_strlen(p, next - p);
 	}
-}
-
-static void
-refresh_diff_view(GtkTreeView *treeview)
-{
-	gchar *diff;
-	GtkWidget *diffView = ui_lookup_widget(GTK_WIDGET(treeview), "textDiff");
-	diff = get_commit_diff(GTK_TREE_VIEW(treeview));
-	set_diff_buff(gtk_text_view_get_buffer(GTK_TEXT_VIEW(diffView)), diff);
-	g_free(diff);
+	apply_diff_tag(buffer, run_tagname, run_offset, offset);
 }
 
 static void
@@ -1164,13 +1600,10 @@ commit_toggled(G_GNUC_UNUSED GtkCellRendererToggle * cell, gchar * path_str, gpo
 	GtkTreeIter iter;
 	GtkTreePath *path = gtk_tree_path_new_from_string(path_str);
 	gboolean fixed;
-	gchar *filename;
-	GtkTextView *diffView = GTK_TEXT_VIEW(ui_lookup_widget(GTK_WIDGET(treeview), "textDiff"));
-	GtkTextMark *mark;
 
 	/* get toggled iter */
 	gtk_tree_model_get_iter(model, &iter, path);
-	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &fixed, COLUMN_PATH, &filename, -1);
+	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &fixed, -1);
 
 	/* do something with the value */
 	fixed ^= 1;
@@ -1178,18 +1611,8 @@ commit_toggled(G_GNUC_UNUSED GtkCellRendererToggle * cell, gchar * path_str, gpo
 	/* set new value */
 	gtk_list_store_set(GTK_LIST_STORE(model), &iter, COLUMN_COMMIT, fixed, -1);
 
-	if (! fixed)
-	{
-		mark = gtk_text_buffer_get_mark(gtk_text_view_get_buffer(diffView), filename);
-		if (mark)
-			gtk_text_buffer_delete_mark(gtk_text_view_get_buffer(diffView), mark);
-	}
-
-	refresh_diff_view(treeview);
-
 	/* clean up */
 	gtk_tree_path_free(path);
-	g_free(filename);
 }
 
 static gboolean
@@ -1208,8 +1631,6 @@ commit_all_toggled_cb(GtkToggleButton *check_box, gpointer treeview)
 	gint toggled = gtk_toggle_button_get_active(check_box);
 
 	gtk_tree_model_foreach(model, toggle_all_commit_files, &toggled);
-
-	refresh_diff_view(treeview);
 }
 
 static void
@@ -1270,21 +1691,20 @@ static void commit_tree_selection_changed_cb(GtkTreeSelection *sel, GtkTextView
 {
 	GtkTreeModel *model;
 	GtkTreeIter iter;
-	GtkTextMark *mark;
 	gchar *path;
-	gboolean set;
+	gchar *status;
+	const gchar *diff = NULL;
 
 	if (! gtk_tree_selection_get_selected(sel, &model, &iter))
 		return;
 
-	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &set, COLUMN_PATH, &path, -1);
+	gtk_tree_model_get(model, &iter, COLUMN_STATUS, &status, COLUMN_PATH, &path, -1);
 
-	if (set)
-	{
-		mark = gtk_text_buffer_get_mark(gtk_text_view_get_buffer(textview), path);
-		if (mark)
-			gtk_text_view_scroll_to_mark(textview, mark, 0.0, TRUE, 0.0, 0.0);
-	}
+	if (utils_str_equal(status, FILE_STATUS_MODIFIED))
+		diff = get_commit_file_diff(gtk_tree_selection_get_tree_view(sel), path);
+	set_diff_buff(gtk_text_view_get_buffer(textview), diff ? diff : "");
+
+	g_free(status);
 	g_free(path);
 }
 
@@ -1477,7 +1897,7 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 
 	gchar *dir;
 	gchar *message;
-	gchar *diff;
+	GtkTreeIter iter;
 
 	gint height;
 
@@ -1508,7 +1928,9 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	/* add columns to the tree view */
 	add_commit_columns(GTK_TREE_VIEW(treeview));
 
-	diff = get_commit_diff(GTK_TREE_VIEW(treeview));
+	g_object_set_data_full(G_OBJECT(treeview), "diffs",
+			       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free),
+			       (GDestroyNotify) g_hash_table_destroy);
 	diffbuf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(diffView));
 
 	gtk_text_buffer_create_tag(diffbuf, "deleted", "foreground-gdk",
@@ -1520,10 +1942,10 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	gtk_text_buffer_create_tag(diffbuf, "default", "foreground-gdk",
 				   get_diff_color(doc, SCE_DIFF_POSITION), NULL);
 
-	gtk_text_buffer_create_tag(diffbuf, "invisible", "invisible",
-				   TRUE, NULL);
-
-	set_diff_buff(diffbuf, diff);
+	/* show the diff of the first file */
+	if (gtk_tree_model_get_iter_first(model, &iter))
+		gtk_tree_selection_select_iter(
+			gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview)), &iter);
 
 	if (set_maximize_commit_dialog)
 	{
@@ -1578,6 +2000,7 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 		{
 			execute_command(vc, NULL, NULL, dir, VC_COMMAND_COMMIT, selected_files,
 					message);
+			reset_diff_markers();
 			free_text_list(selected_files);
 		}
 		g_free(message);
@@ -1586,7 +2009,291 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	gtk_widget_destroy(commit);
 	free_commit_list(lst);
 	g_free(dir);
-	g_free(diff);
+}
+
+/* Change markers.
+ * Lines changed since the last commit are marked in the editor margin. The committed version
+ * of a file is fetched once and kept, the buffer is compared with it in a worker thread a
+ * moment after the last edit. */
+#define DIFF_MARKERS_DELAY 500
+
+/* numbered bookmarks and the debugger take the first free markers, so use the last ones */
+#define VC_MARKER_ADDED 22
+#define VC_MARKER_MODIFIED 23
+#define VC_MARKER_DELETED 24
+
+typedef struct _DiffMarkersJob
+{
+	gint session;
+	GeanyDocument *doc;
+	gchar *filename;
+	gint generation;
+	const VC_RECORD *vc;	/* set if the base has to be read by the thread */
+	gint bases_generation;
+	gchar *base;
+	gchar *text;
+	GArray *hunks;
+} DiffMarkersJob;
+
+static GHashTable *diff_bases = NULL;	/* filename -> committed text, or NULL */
+/* changed when diff_bases is reset, so bases read meanwhile are not stored */
+static gint diff_bases_generation = 0;
+static guint diff_markers_timer = 0;
+static GeanyDocument *diff_markers_doc = NULL;
+/* changed on unload, so results of jobs still running are dropped */
+static gint diff_markers_session = 0;
+
+/* buffer modifications are counted, the markers are up to date if they were computed for the
+ * current count */
+static gint
+get_sci_counter(ScintillaObject * sci, const gchar * key)
+{
+	return GPOINTER_TO_INT(g_object_get_data(G_OBJECT(sci), key));
+}
+
+static void
+set_sci_counter(ScintillaObject * sci, const gchar * key, gint value)
+{
+	g_object_set_data(G_OBJECT(sci), key, GINT_TO_POINTER(value));
+}
+
+static void
+clear_diff_markers(ScintillaObject * sci)
+{
+	scintilla_send_message(sci, SCI_MARKERDELETEALL, VC_MARKER_ADDED, 0);
+	scintilla_send_message(sci, SCI_MARKERDELETEALL, VC_MARKER_MODIFIED, 0);
+	scintilla_send_message(sci, SCI_MARKERDELETEALL, VC_MARKER_DELETED, 0);
+}
+
+static void
+define_diff_marker(ScintillaObject * sci, gint marker, gint style)
+{
+	const GeanyLexerStyle *s = highlighting_get_style(GEANY_FILETYPES_DIFF, style);
+
+	scintilla_send_message(sci, SCI_MARKERDEFINE, marker, SC_MARK_LEFTRECT);
+	scintilla_send_message(sci, SCI_MARKERSETBACK, marker, s->foreground);
+}
+
+static void
+show_diff_markers(ScintillaObject * sci, GArray * hunks)
+{
+	guint i;
+	gint line;
+	gint marker;
+	gint line_count = sci_get_line_count(sci);
+	LineDiffHunk *hunk;
+
+	define_diff_marker(sci, VC_MARKER_ADDED, SCE_DIFF_ADDED);
+	define_diff_marker(sci, VC_MARKER_MODIFIED, SCE_DIFF_POSITION);
+	define_diff_marker(sci, VC_MARKER_DELETED, SCE_DIFF_DELETED);
+	clear_diff_markers(sci);
+
+	for (i = 0; i < hunks->len; i++)
+	{
+		hunk = &g_array_index(hunks, LineDiffHunk, i);
+		if (hunk->new_count == 0)
+		{
+			/* mark the line following the removed ones */
+			line = MIN(hunk->new_start, line_count - 1);
+			scintilla_send_message(sci, SCI_MARKERADD, line, VC_MARKER_DELETED);
+			continue;
+		}
+		marker = (hunk->old_count == 0) ? VC_MARKER_ADDED : VC_MARKER_MODIFIED;
+		for (line = hunk->new_start; line < hunk->new_start + hunk->new_count; line++)
+			scintilla_send_message(sci, SCI_MARKERADD, line, marker);
+	}
+}
+
+static void
+free_diff_markers_job(DiffMarkersJob * job)
+{
+	if (job->hunks)
+		g_array_free(job->hunks, TRUE);
+	g_free(job->filename);
+	g_free(job->base);
+	g_free(job->text);
+	g_free(job);
+}
+
+static gboolean
+diff_markers_done(gpointer data)
+{
+	DiffMarkersJob *job = data;
+	ScintillaObject *sci;
+
+	if (job->session != diff_markers_session)
+	{
+		free_diff_markers_job(job);
+		return FALSE;
+	}
+
+	/* a base read by the thread is kept unless the bases were reset meanwhile */
+	if (job->vc && job->bases_generation == diff_bases_generation &&
+	    !g_hash_table_lookup_extended(diff_bases, job->filename, NULL, NULL))
+		g_hash_table_insert(diff_bases, g_strdup(job->filename), g_strdup(job->base));
+
+	/* drop the result if the document changed or was closed meanwhile */
+	if (set_diff_markers && DOC_VALID(job->doc) &&
+	    utils_str_equal(job->doc->file_name, job->filename))
+	{
+		sci = job->doc->editor->sci;
+		if (get_sci_counter(sci, "geanyvc-generation") == job->generation)
+		{
+			if (job->hunks)
+				show_diff_markers(sci, job->hunks);
+			else
+				clear_diff_markers(sci);
+			set_sci_counter(sci, "geanyvc-diffed", job->generation + 1);
+		}
+	}
+	free_diff_markers_job(job);
+	return FALSE;
+}
+
+/* Reads the committed version first if it is not known yet, it can take a while */
+static gpointer
+diff_markers_thread(gpointer data)
+{
+	DiffMarkersJob *job = data;
+
+	if (job->vc)
+	{
+		execute_command(job->vc, &job->base, NULL, job->filename, VC_COMMAND_SHOW, NULL, NULL);
+		if (job->base)
+			job->base[normalize_line_endings(job->base, strlen(job->base))] = '\0';
+	}
+	if (job->base)
+		job->hunks = linediff_compare(job->base, job->text);
+	g_idle_add(diff_markers_done, job);
+	return NULL;
+}
+
+static void
+update_diff_markers(GeanyDocument * doc)
+{
+	DiffMarkersJob *job;
+	ScintillaObject *sci;
+	const VC_RECORD *vc = NULL;
+	gpointer base = NULL;
+	gsize len;
+
+	if (!set_diff_markers || !DOC_VALID(doc) || !doc->file_name ||
+	    !g_path_is_absolute(doc->file_name))
+		return;
+
+	sci = doc->editor->sci;
+	if (!g_hash_table_lookup_extended(diff_bases, doc->file_name, NULL, &base))
+	{
+		/* the committed version is read by the thread, only look up the VC here */
+		vc = find_vc(doc->file_name);
+		if (!vc || !(vc->commands[VC_COMMAND_SHOW].command ||
+			     vc->commands[VC_COMMAND_SHOW].function))
+		{
+			g_hash_table_insert(diff_bases, g_strdup(doc->file_name), NULL);
+			vc = NULL;
+		}
+	}
+	if (!base && !vc)
+	{
+		clear_diff_markers(sci);
+		return;
+	}
+
+	job = g_new0(DiffMarkersJob, 1);
+	job->session = diff_markers_session;
+	job->doc = doc;
+	job->filename = g_strdup(doc->file_name);
+	job->generation = get_sci_counter(sci, "geanyvc-generation");
+	job->vc = vc;
+	job->bases_generation = diff_bases_generation;
+	job->base = g_strdup(base);
+	job->text = sci_get_contents(sci, -1);
+	len = normalize_line_endings(job->text, strlen(job->text));
+	job->text[len] = '\0';
+
+	/* without a thread, do it now */
+	if (!g_thread_create(diff_markers_thread, job, FALSE, NULL))
+		diff_markers_thread(job);
+}
+
+static gboolean
+diff_markers_timeout(G_GNUC_UNUSED gpointer data)
+{
+	diff_markers_timer = 0;
+	update_diff_markers(diff_markers_doc);
+	return FALSE;
+}
+
+static void
+queue_diff_markers(GeanyDocument * doc)
+{
+	if (diff_markers_timer)
+		g_source_remove(diff_markers_timer);
+	diff_markers_doc = doc;
+	diff_markers_timer = g_timeout_add(DIFF_MARKERS_DELAY, diff_markers_timeout, NULL);
+}
+
+/* Forget the committed versions, e.g. after a commit, and update the current document */
+static void
+reset_diff_markers(void)
+{
+	guint i;
+	GeanyDocument *doc;
+
+	if (diff_bases)
+		g_hash_table_remove_all(diff_bases);
+	diff_bases_generation++;
+	foreach_document(i)
+	{
+		set_sci_counter(documents[i]->editor->sci, "geanyvc-diffed", 0);
+		if (!set_diff_markers)
+			clear_diff_markers(documents[i]->editor->sci);
+	}
+
+	doc = document_get_current();
+	if (set_diff_markers && doc)
+		queue_diff_markers(doc);
+}
+
+static gboolean
+on_editor_notify(G_GNUC_UNUSED GObject * object, GeanyEditor * editor, SCNotification * nt,
+		 G_GNUC_UNUSED gpointer data)
+{
+	gint generation;
+
+	if (set_diff_markers && nt->nmhdr.code == SCN_MODIFIED &&
+	    (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+	{
+		generation = get_sci_counter(editor->sci, "geanyvc-generation") + 1;
+		set_sci_counter(editor->sci, "geanyvc-generation", generation);
+		queue_diff_markers(editor->document);
+	}
+	return FALSE;
+}
+
+static void
+on_document_activate(G_GNUC_UNUSED GObject * object, GeanyDocument * doc,
+		     G_GNUC_UNUSED gpointer data)
+{
+	ScintillaObject *sci = doc->editor->sci;
+
+	/* only diff documents that changed since their markers were set */
+	if (set_diff_markers &&
+	    get_sci_counter(sci, "geanyvc-diffed") !=
+	    get_sci_counter(sci, "geanyvc-generation") + 1)
+		queue_diff_markers(doc);
+}
+
+static void
+on_document_save(G_GNUC_UNUSED GObject * object, GeanyDocument * doc,
+		 G_GNUC_UNUSED gpointer data)
+{
+	/* the file may have been saved under a new name */
+	if (set_diff_markers)
+	{
+		set_sci_counter(doc->editor->sci, "geanyvc-diffed", 0);
+		queue_diff_markers(doc);
+	}
 }
 
 static GtkWidget *menu_vc_diff_file = NULL;
@@ -1605,6 +2312,7 @@ static GtkWidget *menu_vc_remove_file = NULL;
 static GtkWidget *menu_vc_update = NULL;
 static GtkWidget *menu_vc_commit = NULL;
 static GtkWidget *menu_vc_show_file = NULL;
+static GtkWidget *menu_vc_cancel = NULL;
 
 static void
 update_menu_items(void)
@@ -1654,6 +2362,8 @@ update_menu_items(void)
 	gtk_widget_set_sensitive(menu_vc_commit, d_have_vc);
 
 	gtk_widget_set_sensitive(menu_vc_show_file, f_have_vc);
+
+	gtk_widget_set_sensitive(menu_vc_cancel, running_job != NULL);
 }
 
 
@@ -1720,6 +2430,7 @@ static struct
 	GtkWidget *cb_external_diff;
 	GtkWidget *cb_editor_menu_entries;
 	GtkWidget *cb_attach_to_menubar;
+	GtkWidget *cb_diff_markers;
 	GtkWidget *cb_cvs;
 	GtkWidget *cb_git;
 	GtkWidget *cb_svn;
@@ -1756,6 +2467,8 @@ on_configure_response(G_GNUC_UNUSED GtkDialog * dialog, gint response,
 			gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets.cb_editor_menu_entries));
 		set_menubar_entry =
 			gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets.cb_attach_to_menubar));
+		set_diff_markers =
+			gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets.cb_diff_markers));
 
 		enable_cvs = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets.cb_cvs));
 		enable_git = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets.cb_git));
@@ -1778,6 +2491,7 @@ on_configure_response(G_GNUC_UNUSED GtkDialog * dialog, gint response,
 				       set_maximize_commit_dialog);
 		g_key_file_set_boolean(config, "VC", "set_editor_menu_entries", set_editor_menu_entries);
 		g_key_file_set_boolean(config, "VC", "attach_to_menubar", set_menubar_entry);
+		g_key_file_set_boolean(config, "VC", "set_diff_markers", set_diff_markers);
 
 		g_key_file_set_boolean(config, "VC", "enable_cvs", enable_cvs);
 		g_key_file_set_boolean(config, "VC", "enable_git", enable_git);
@@ -1815,6 +2529,7 @@ on_configure_response(G_GNUC_UNUSED GtkDialog * dialog, gint response,
 		g_key_file_free(config);
 
 		registrate();
+		reset_diff_markers();
 	}
 }
 
@@ -1883,6 +2598,14 @@ plugin_configure(GtkDialog * dialog)
 		set_menubar_entry);
 	gtk_box_pack_start(GTK_BOX(vbox), widgets.cb_attach_to_menubar, TRUE, FALSE, 2);
 
+	widgets.cb_diff_markers = gtk_check_button_new_with_label(_("Mark changed lines"));
+	ui_widget_set_tooltip_text(widgets.cb_diff_markers,
+			     _("Mark the lines added, changed or removed since the last commit "
+			       "in the editor margin."));
+	gtk_button_set_focus_on_click(GTK_BUTTON(widgets.cb_diff_markers), FALSE);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widgets.cb_diff_markers), set_diff_markers);
+	gtk_box_pack_start(GTK_BOX(vbox), widgets.cb_diff_markers, TRUE, FALSE, 2);
+
 	widgets.cb_cvs = gtk_check_button_new_with_label(_("Enable CVS"));
 	gtk_button_set_focus_on_click(GTK_BUTTON(widgets.cb_cvs), FALSE);
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widgets.cb_cvs), enable_cvs);
@@ -1965,6 +2688,8 @@ load_config(void)
 		TRUE);
 	set_menubar_entry = utils_get_setting_boolean(config, "VC", "attach_to_menubar",
 		FALSE);
+	set_diff_markers = utils_get_setting_boolean(config, "VC", "set_diff_markers",
+		FALSE);
 
 #ifdef USE_GTKSPELL
 	lang = g_key_file_get_string(config, "VC", "spellchecking_language", &error);
@@ -1989,6 +2714,7 @@ registrate(void)
 		g_slist_free(VC);
 		VC = NULL;
 	}
+	clear_vc_cache();
 	REGISTER_VC(GIT, enable_git);
 	REGISTER_VC(SVN, enable_svn);
 	REGISTER_VC(CVS, enable_cvs);
@@ -2249,6 +2975,20 @@ plugin_init(G_GNUC_UNUSED GeanyData * data)
 	load_config();
 	registrate();
 
+	/* change markers are computed in a worker thread */
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+	main_thread = g_thread_self();
+	plugin_module_make_resident(geany_plugin);
+
+	diff_bases = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	plugin_signal_connect(geany_plugin, NULL, "editor-notify", FALSE,
+			      G_CALLBACK(on_editor_notify), NULL);
+	plugin_signal_connect(geany_plugin, NULL, "document-activate", FALSE,
+			      G_CALLBACK(on_document_activate), NULL);
+	plugin_signal_connect(geany_plugin, NULL, "document-save", FALSE,
+			      G_CALLBACK(on_document_save), NULL);
+
 
 	if (set_menubar_entry == TRUE)
 	{
@@ -2305,6 +3045,14 @@ plugin_init(G_GNUC_UNUSED GeanyData * data)
 
 	g_signal_connect(menu_vc_commit, "activate", G_CALLBACK(vccommit_activated), NULL);
 
+	/* Stop a running command */
+	menu_vc_cancel = gtk_menu_item_new_with_mnemonic(_("C_ancel Running Command"));
+	gtk_container_add(GTK_CONTAINER(menu_vc_menu), menu_vc_cancel);
+	ui_widget_set_tooltip_text(menu_vc_cancel,
+				   _("Stop the version control command that is still running."));
+
+	g_signal_connect(menu_vc_cancel, "activate", G_CALLBACK(vccancel_activated), NULL);
+
 	gtk_widget_show_all(menu_vc);
 
 	/* initialize keybindings */
@@ -2322,9 +3070,27 @@ plugin_init(G_GNUC_UNUSED GeanyData * data)
 void
 plugin_cleanup(void)
 {
+	guint i;
+
+	if (running_job)
+	{
+		vc_job_free(running_job);
+		running_job = NULL;
+	}
+
+	if (diff_markers_timer)
+		g_source_remove(diff_markers_timer);
+	diff_markers_timer = 0;
+	diff_markers_session++;
+	foreach_document(i)
+		clear_diff_markers(documents[i]->editor->sci);
+	g_hash_table_destroy(diff_bases);
+	diff_bases = NULL;
+
 	remove_menuitems_from_editor_menu();
 	gtk_widget_destroy(menu_entry);
 	g_slist_free(VC);
 	VC = NULL;
+	clear_vc_cache();
 	g_free(config_file);
 }
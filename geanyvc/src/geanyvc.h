@@ -117,6 +117,10 @@ typedef struct _VC_RECORD
 	/* check if file in VC */
 	gboolean(*in_vc) (const gchar * path);
 	GSList *(*get_commit_files) (const gchar * dir);
+	/* set of absolute names of tracked files, optional */
+	GHashTable *(*get_tracked_files) (const gchar * base_dir);
+	/* absolute name of a file changed whenever the tracked files change, NULL if unknown */
+	gchar *(*get_index_file) (const gchar * base_dir);
 } VC_RECORD;
 
 typedef struct _CommitItem
@@ -136,8 +140,22 @@ extern const gchar *NO_ENV[];
 const gchar *get_external_diff_viewer(void);
 void vc_external_diff(const gchar * src, const gchar * dest);
 
+/* linediff.c */
+/* lines old_start..old_start+old_count-1 of the old text were replaced by lines
+ * new_start..new_start+new_count-1 of the new text, line numbers start at 0 */
+typedef struct _LineDiffHunk
+{
+	gint old_start;
+	gint old_count;
+	gint new_start;
+	gint new_count;
+} LineDiffHunk;
+
+GArray *linediff_compare(const gchar * old_text, const gchar * new_text);
+
 /* utils.c */
 gchar *normpath(const gchar * filename);
+gsize normalize_line_endings(gchar * text, gsize len);
 gchar *get_full_path(const gchar * location, const gchar * path);
 gchar *get_relative_path(const gchar * location, const gchar * path);
 
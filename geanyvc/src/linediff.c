@@ -0,0 +1,292 @@
+/*
+ *      linediff.c - Plugin to geany light IDE to work with vc
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Line based diff using Myers' O(ND) algorithm in linear space. It only uses GLib, so it can
+ * run in a worker thread.
+ * pretty-printer/src/TextDiff.c has a copy of the comparison, keep fixes in sync. */
+
+#include <string.h>
+
+#include <geanyplugin.h>
+#include "geanyvc.h"
+
+/* Give up looking for common lines between parts that differ by more than this many lines and
+ * treat them as one change, to bound the time spent on completely rewritten files. */
+#define LINEDIFF_MAX_COST 1024
+
+typedef struct _LineDiff
+{
+	const gint *a;		/* line ids of the old text */
+	const gint *b;		/* line ids of the new text */
+	GArray *hunks;
+} LineDiff;
+
+static void compare(LineDiff * ld, gint a0, gint a1, gint b0, gint b1);
+
+static void
+add_hunk(LineDiff * ld, gint a0, gint a1, gint b0, gint b1)
+{
+	LineDiffHunk *last;
+	LineDiffHunk hunk;
+
+	if (a0 == a1 && b0 == b1)
+		return;
+
+	/* the halves of a bisection meet where one change ends and the next one begins */
+	if (ld->hunks->len > 0)
+	{
+		last = &g_array_index(ld->hunks, LineDiffHunk, ld->hunks->len - 1);
+		if (last->old_start + last->old_count == a0 && last->new_start + last->new_count == b0)
+		{
+			last->old_count += a1 - a0;
+			last->new_count += b1 - b0;
+			return;
+		}
+	}
+
+	hunk.old_start = a0;
+	hunk.old_count = a1 - a0;
+	hunk.new_start = b0;
+	hunk.new_count = b1 - b0;
+	g_array_append_val(ld->hunks, hunk);
+}
+
+/* Find the middle snake of the shortest edit script by searching forward and backward at the
+ * same time, then compare the parts before and after it. */
+static void
+bisect(LineDiff * ld, gint a0, gint a1, gint b0, gint b1)
+{
+	const gint *a = ld->a + a0;
+	const gint *b = ld->b + b0;
+	gint n = a1 - a0;
+	gint m = b1 - b0;
+	gint max_d = (n + m + 1) / 2;
+	gint v_offset = max_d;
+	gint v_length = 2 * max_d + 2;
+	gint delta = n - m;
+	gboolean front = (delta % 2 != 0);
+	gint k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+	gint *v1, *v2;
+	gint d, k1, k2, i;
+	gint x1, y1, x2, y2;
+
+	v1 = g_new(gint, v_length);
+	v2 = g_new(gint, v_length);
+	for (i = 0; i < v_length; i++)
+	{
+		v1[i] = -1;
+		v2[i] = -1;
+	}
+	v1[v_offset + 1] = 0;
+	v2[v_offset + 1] = 0;
+
+	for (d = 0; d < max_d && d < LINEDIFF_MAX_COST; d++)
+	{
+		/* forward path */
+		for (k1 = -d + k1start; k1 <= d - k1end; k1 += 2)
+		{
+			gint k1_offset = v_offset + k1;
+
+			if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1]))
+				x1 = v1[k1_offset + 1];
+			else
+				x1 = v1[k1_offset - 1] + 1;
+			y1 = x1 - k1;
+			while (x1 < n && y1 < m && a[x1] == b[y1])
+			{
+				x1++;
+				y1++;
+			}
+			v1[k1_offset] = x1;
+			if (x1 > n)
+				k1end += 2;
+			else if (y1 > m)
+				k1start += 2;
+			else if (front)
+			{
+				gint k2_offset = v_offset + delta - k1;
+
+				if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1 &&
+				    x1 >= n - v2[k2_offset])
+					goto split;
+			}
+		}
+
+		/* reverse path */
+		for (k2 = -d + k2start; k2 <= d - k2end; k2 += 2)
+		{
+			gint k2_offset = v_offset + k2;
+
+			if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1]))
+				x2 = v2[k2_offset + 1];
+			else
+				x2 = v2[k2_offset - 1] + 1;
+			y2 = x2 - k2;
+			while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1])
+			{
+				x2++;
+				y2++;
+			}
+			v2[k2_offset] = x2;
+			if (x2 > n)
+				k2end += 2;
+			else if (y2 > m)
+				k2start += 2;
+			else if (!front)
+			{
+				gint k1_offset = v_offset + delta - k2;
+
+				if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1)
+				{
+					x1 = v1[k1_offset];
+					y1 = v_offset + x1 - k1_offset;
+					if (x1 >= n - x2)
+						goto split;
+				}
+			}
+		}
+	}
+
+	/* no common lines at all, or too many differences */
+	g_free(v1);
+	g_free(v2);
+	add_hunk(ld, a0, a1, b0, b1);
+	return;
+
+      split:
+	g_free(v1);
+	g_free(v2);
+	compare(ld, a0, a0 + x1, b0, b0 + y1);
+	compare(ld, a0 + x1, a1, b0 + y1, b1);
+}
+
+static void
+compare(LineDiff * ld, gint a0, gint a1, gint b0, gint b1)
+{
+	/* common prefix and suffix, usually most of the file */
+	while (a0 < a1 && b0 < b1 && ld->a[a0] == ld->b[b0])
+	{
+		a0++;
+		b0++;
+	}
+	while (a0 < a1 && b0 < b1 && ld->a[a1 - 1] == ld->b[b1 - 1])
+	{
+		a1--;
+		b1--;
+	}
+
+	if (a0 == a1 || b0 == b1)
+		add_hunk(ld, a0, a1, b0, b1);
+	else
+		bisect(ld, a0, a1, b0, b1);
+}
+
+/* Give equal lines equal ids, so lines are compared as integers */
+static gint *
+get_line_ids(GHashTable * ids, gchar ** lines, gint * count)
+{
+	gint i;
+	gint n = g_strv_length(lines);
+	gint *ret = g_new(gint, n + 1);
+	gpointer id;
+
+	for (i = 0; i < n; i++)
+	{
+		id = g_hash_table_lookup(ids, lines[i]);
+		if (!id)
+		{
+			id = GINT_TO_POINTER(g_hash_table_size(ids) + 1);
+			g_hash_table_insert(ids, lines[i], id);
+		}
+		ret[i] = GPOINTER_TO_INT(id);
+	}
+	*count = n;
+	return ret;
+}
+
+/*
+ * Compare two texts line by line
+ *
+ * @return - array of LineDiffHunk, ordered by line
+ */
+GArray *
+linediff_compare(const gchar * old_text, const gchar * new_text)
+{
+	LineDiff ld;
+	GHashTable *ids = g_hash_table_new(g_str_hash, g_str_equal);
+	gchar **old_lines = g_strsplit(old_text, "\n", -1);
+	gchar **new_lines = g_strsplit(new_text, "\n", -1);
+	gint *a, *b;
+	gint n, m;
+
+	a = get_line_ids(ids, old_lines, &n);
+	b = get_line_ids(ids, new_lines, &m);
+
+	ld.a = a;
+	ld.b = b;
+	ld.hunks = g_array_new(FALSE, FALSE, sizeof(LineDiffHunk));
+	compare(&ld, 0, n, 0, m);
+
+	g_free(a);
+	g_free(b);
+	g_hash_table_destroy(ids);
+	g_strfreev(old_lines);
+	g_strfreev(new_lines);
+
+	return ld.hunks;
+}
+
+
+#ifdef UNITTESTS
+#include <check.h>
+
+START_TEST(test_linediff_compare)
+{
+	GArray *hunks;
+	LineDiffHunk *h;
+
+	hunks = linediff_compare("a\nb\nc\nd\n", "a\nB\nc\nd\ne\n");
+	fail_unless(hunks->len == 2, "expected: 2 hunks, get %d\n", hunks->len);
+	h = &g_array_index(hunks, LineDiffHunk, 0);
+	fail_unless(h->old_start == 1 && h->old_count == 1 && h->new_start == 1 && h->new_count == 1,
+		    "expected: 1,1 -> 1,1, get %d,%d -> %d,%d\n",
+		    h->old_start, h->old_count, h->new_start, h->new_count);
+	h = &g_array_index(hunks, LineDiffHunk, 1);
+	fail_unless(h->old_start == 4 && h->old_count == 0 && h->new_start == 4 && h->new_count == 1,
+		    "expected: 4,0 -> 4,1, get %d,%d -> %d,%d\n",
+		    h->old_start, h->old_count, h->new_start, h->new_count);
+	g_array_free(hunks, TRUE);
+
+	hunks = linediff_compare("a\nb\n", "a\nb\n");
+	fail_unless(hunks->len == 0, "expected: 0 hunks, get %d\n", hunks->len);
+	g_array_free(hunks, TRUE);
+}
+
+END_TEST;
+
+
+TCase *
+linediff_test_case_create(void)
+{
+	TCase *tc_linediff = tcase_create("linediff");
+	tcase_add_test(tc_linediff, test_linediff_compare);
+	return tc_linediff;
+}
+
+
+#endif
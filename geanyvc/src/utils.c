@@ -138,6 +138,31 @@ get_relative_path(const gchar * location, const gchar * path)
 	return ret;
 }
 
+/* Convert CR LF and lone CR line endings to LF in one pass. The text is changed in place and
+ * the new length is returned, the text is not NUL terminated at it.
+ */
+gsize
+normalize_line_endings(gchar * text, gsize len)
+{
+	gchar *src = text;
+	gchar *dst = text;
+	gchar *end = text + len;
+
+	while (src < end)
+	{
+		if (*src == '\r')
+		{
+			*dst++ = '\n';
+			src++;
+			if (src < end && *src == '\n')
+				src++;
+		}
+		else
+			*dst++ = *src++;
+	}
+	return dst - text;
+}
+
 
 #ifdef UNITTESTS
 #include <check.h>
@@ -156,12 +181,26 @@ START_TEST(test_get_relative_path)
 
 END_TEST;
 
+START_TEST(test_normalize_line_endings)
+{
+	gchar text[] = "a\r\nb\rc\n\r\r\nd";
+	gsize len;
+
+	len = normalize_line_endings(text, strlen(text));
+	text[len] = '\0';
+	fail_unless(strcmp(text, "a\nb\nc\n\n\nd") == 0, "expected: \"a\\nb\\nc\\n\\n\\nd\", get \"%s\"\n",
+		    text);
+}
+
+END_TEST;
+
 
 TCase *
 utils_test_case_create(void)
 {
 	TCase *tc_utils = tcase_create("utils");
 	tcase_add_test(tc_utils, test_get_relative_path);
+	tcase_add_test(tc_utils, test_normalize_line_endings);
 	return tc_utils;
 }
 
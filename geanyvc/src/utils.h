@@ -23,5 +23,6 @@
 gchar *normpath(const gchar * filename);
 gchar *get_full_path(const gchar * location, const gchar * path);
 gchar *get_relative_path(const gchar * location, const gchar * path);
+gsize normalize_line_endings(gchar * text, gsize len);
 
 #endif
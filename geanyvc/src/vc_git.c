@@ -24,11 +24,40 @@
 #include "geanyvc.h"
 
 extern GeanyData *geany_data;
+extern GeanyFunctions *geany_functions;
 
+/* The nearest directory with a .git. In submodules and linked worktrees .git is
+ * a file naming the real git directory, so it is not searched as a directory. */
 static gchar *
 get_base_dir(const gchar * path)
 {
-	return find_subdir_path(path, ".git");
+	gchar *base;
+	gchar *base_prev = NULL;
+	gchar *git;
+	gboolean found = FALSE;
+
+	if (g_file_test(path, G_FILE_TEST_IS_DIR))
+		base = g_strdup(path);
+	else
+		base = g_path_get_dirname(path);
+
+	while (!base_prev || strcmp(base, base_prev) != 0)
+	{
+		git = g_build_filename(base, ".git", NULL);
+		found = g_file_test(git, G_FILE_TEST_EXISTS);
+		g_free(git);
+		if (found)
+			break;
+		g_free(base_prev);
+		base_prev = base;
+		base = g_path_get_dirname(base);
+	}
+
+	g_free(base_prev);
+	if (found)
+		return base;
+	g_free(base);
+	return NULL;
 }
 
 static gint
@@ -254,7 +283,7 @@ get_commit_files_git(const gchar * file)
 	const gchar *argv[] = { "git", "status", NULL };
 	const gchar *env[] = { "PAGES=cat", NULL };
 	gchar *std_out = NULL;
-	gchar *base_dir = find_subdir_path(file, ".git");
+	gchar *base_dir = get_base_dir(file);
 	GSList *ret = NULL;
 
 	g_return_val_if_fail(base_dir, NULL);
@@ -273,10 +302,85 @@ get_commit_files_git(const gchar * file)
 	return ret;
 }
 
+/* List all files in the index with one "git ls-files -z" run. The output is
+ * NUL separated and therefore read without execute_custom_command(), which
+ * treats it as text. */
+static GHashTable *
+get_tracked_files_git(const gchar * base_dir)
+{
+	const gchar *argv[] = { "git", "ls-files", "-z", NULL };
+	gchar *std_out = NULL;
+	gint exit_code = 0;
+	GError *error = NULL;
+	GHashTable *files;
+	const gchar *p;
+
+	if (!utils_spawn_sync(base_dir, (gchar **) argv, NULL,
+			      G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL,
+			      &std_out, NULL, &exit_code, &error))
+	{
+		g_warning("geanyvc: s_spawn_sync error: %s", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	if (exit_code != 0 || !std_out)
+	{
+		g_free(std_out);
+		return NULL;
+	}
+
+	files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	/* the last name is followed by its own NUL and the string terminator */
+	for (p = std_out; *p; p += strlen(p) + 1)
+	{
+		g_hash_table_insert(files, g_build_filename(base_dir, p, NULL), GINT_TO_POINTER(1));
+	}
+	g_free(std_out);
+
+	return files;
+}
+
+/* The index is in the git directory, which is either .git or the one named by
+ * the "gitdir: <path>" line of a .git file. */
+static gchar *
+get_index_file_git(const gchar * base_dir)
+{
+	gchar *git = g_build_filename(base_dir, ".git", NULL);
+	gchar *contents = NULL;
+	gchar *git_dir = NULL;
+	gchar *index = NULL;
+
+	if (g_file_test(git, G_FILE_TEST_IS_DIR))
+	{
+		git_dir = git;
+		git = NULL;
+	}
+	else if (g_file_get_contents(git, &contents, NULL, NULL) &&
+		 g_str_has_prefix(contents, "gitdir:"))
+	{
+		const gchar *path = g_strstrip(contents + strlen("gitdir:"));
+
+		if (g_path_is_absolute(path))
+			git_dir = g_strdup(path);
+		else
+			git_dir = g_build_filename(base_dir, path, NULL);
+	}
+
+	if (git_dir && g_file_test(git_dir, G_FILE_TEST_IS_DIR))
+		index = g_build_filename(git_dir, "index", NULL);
+
+	g_free(git_dir);
+	g_free(contents);
+	g_free(git);
+	return index;
+}
+
 VC_RECORD VC_GIT = {
 	commands,
 	"git",
 	get_base_dir,
 	in_vc_git,
 	get_commit_files_git,
+	get_tracked_files_git,
+	get_index_file_git,
 };
@@ -184,6 +184,11 @@ PluginCallback plugin_callbacks[] = {
 
 void plugin_init(G_GNUC_UNUSED GeanyData * data)
 {
+	/* the project is scanned in threads */
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+	plugin_module_make_resident(geany_plugin);
+
 	gprj_menu_init();
 	gprj_sidebar_init();
 }
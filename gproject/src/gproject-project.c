@@ -17,6 +17,8 @@
  */
 
 #include <sys/time.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <gdk/gdkkeysyms.h>
 #include <glib/gstdio.h>
 
@@ -27,6 +29,7 @@
 
 #include "gproject-utils.h"
 #include "gproject-project.h"
+#include "gproject-sidebar.h"
 
 extern GeanyPlugin *geany_plugin;
 extern GeanyData *geany_data;
@@ -52,8 +55,70 @@ typedef struct
 	DeferredTagOpType type;
 } DeferredTagOp;
 
-static GSList *file_tag_deferred_op_queue = NULL;
+/* Time spent processing queued tag operations per idle callback, in seconds */
+#define DEFERRED_OP_TIME_SLICE 0.05
+
+/* The operations are processed in the queue order, urgent ones are pushed at the head.
+ * There is at most one operation per file, the table maps the file names to their link
+ * in the queue. */
+static GQueue file_tag_deferred_op_queue = G_QUEUE_INIT;
+static GHashTable *file_tag_deferred_op_table = NULL;
 static gboolean flush_queued = FALSE;
+static gboolean flush_progress_shown = FALSE;
+
+/* number of threads scanning the project directories */
+#define SCAN_THREADS 4
+
+#define CACHE_HEADER "GProject cache 2"
+
+#define NSEC_PER_SEC G_GINT64_CONSTANT(1000000000)
+
+/* A directory modified this close to the time it was read might have been modified again
+ * without its mtime changing (timestamps are rounded to the second, or even to two seconds on
+ * FAT), so its cached contents aren't used. */
+#define CACHE_MTIME_MARGIN (2 * NSEC_PER_SEC)
+
+/* the caches of projects not opened for that many days are removed */
+#define CACHE_MAX_AGE_DAYS 30
+
+/* The contents of a scanned directory. The directories of the last scan are stored in a
+ * cache file, and the contents of a directory which wasn't modified since (same mtime)
+ * are taken from there without reading the directory. */
+typedef struct
+{
+	gint64 mtime;				/* nanoseconds */
+	gint64 scanned;				/* when the directory was read, nanoseconds */
+	GPtrArray *files;			/* real paths of the project files, UTF-8 */
+	GPtrArray *subdirs;			/* scanned subdirectories, locale */
+} DirCacheEntry;
+
+/* The project directories are scanned by a thread pool: every directory is a task which
+ * pushes its subdirectories to the pool, so idle threads pick up the remaining work.
+ * The file list is built in a new table which replaces g_prj->file_tag_table in the main
+ * thread once the whole tree has been scanned. */
+typedef struct
+{
+	GThreadPool *pool;
+	GSList *patterns;
+	GSList *ignored_dirs_patterns;
+	gchar *cache_key;
+	gchar *cache_filename;		/* locale */
+	gchar *project_file_name;
+	GHashTable *old_dir_cache;	/* loaded by the first task, read only by the others */
+	gint64 start_time;			/* nanoseconds */
+	gboolean cache_loaded;
+
+	GMutex *mutex;				/* protects file_tag_table, dir_cache and pushing to pool */
+	GHashTable *file_tag_table;
+	GHashTable *dir_cache;
+
+	gint pending;				/* directories queued or being scanned, atomic */
+	gint file_num;				/* files found so far, atomic */
+	gint cancelled;				/* atomic */
+	guint progress_id;
+} ScanJob;
+
+static ScanJob *scan_job = NULL;
 
 
 static void deferred_op_free(DeferredTagOp* op, G_GNUC_UNUSED gpointer user_data)
@@ -65,10 +130,17 @@ static void deferred_op_free(DeferredTagOp* op, G_GNUC_UNUSED gpointer user_data
 
 static void deferred_op_queue_clean(void)
 {
-	g_slist_foreach(file_tag_deferred_op_queue, (GFunc)deferred_op_free, NULL);
-	g_slist_free(file_tag_deferred_op_queue);
-	file_tag_deferred_op_queue = NULL;
-        flush_queued = FALSE;
+	g_queue_foreach(&file_tag_deferred_op_queue, (GFunc)deferred_op_free, NULL);
+	g_queue_clear(&file_tag_deferred_op_queue);
+	if (file_tag_deferred_op_table)
+		g_hash_table_remove_all(file_tag_deferred_op_table);
+
+	/* a scheduled flush stops by itself with the queue empty */
+	if (flush_progress_shown)
+	{
+		ui_progress_bar_stop();
+		flush_progress_shown = FALSE;
+	}
 }
 
 
@@ -139,24 +211,84 @@ static void deferred_op_queue_dispatch(DeferredTagOp* op, G_GNUC_UNUSED gpointer
 
 static gboolean deferred_op_queue_flush(G_GNUC_UNUSED gpointer data)
 {
-	g_slist_foreach(file_tag_deferred_op_queue,
-					(GFunc)deferred_op_queue_dispatch, NULL);
-	deferred_op_queue_clean();
+	GTimer *timer;
+	DeferredTagOp *op;
+
+	timer = g_timer_new();
+	while (g_timer_elapsed(timer, NULL) < DEFERRED_OP_TIME_SLICE &&
+		(op = g_queue_pop_head(&file_tag_deferred_op_queue)) != NULL)
+	{
+		g_hash_table_remove(file_tag_deferred_op_table, op->filename);
+		deferred_op_queue_dispatch(op, NULL);
+		deferred_op_free(op, NULL);
+	}
+	g_timer_destroy(timer);
+
+	if (!g_queue_is_empty(&file_tag_deferred_op_queue))
+	{
+		/* it takes a while, show what's going on */
+		if (!flush_progress_shown)
+		{
+			ui_progress_bar_start(_("Generating tags"));
+			flush_progress_shown = TRUE;
+		}
+		ui_set_statusbar(FALSE, _("Generating tags: %u files left..."),
+			g_queue_get_length(&file_tag_deferred_op_queue));
+		return TRUE;
+	}
+
+	if (flush_progress_shown)
+	{
+		ui_progress_bar_stop();
+		ui_set_statusbar(FALSE, _("Tags generated."));
+		flush_progress_shown = FALSE;
+	}
 	flush_queued = FALSE;
 
-	return FALSE; /* returning false removes this callback; it is a one-shot */
+	return FALSE;
 }
 
 
-static void deferred_op_queue_enqueue(gchar* filename, DeferredTagOpType type)
+/* urgent operations are processed before the others */
+static void deferred_op_queue_enqueue(const gchar* filename, DeferredTagOpType type,
+		gboolean urgent)
 {
 	DeferredTagOp * op;
+	GList *link;
 
-	op = (DeferredTagOp *) g_new0(DeferredTagOp, 1);
-	op->type = type;
-	op->filename = g_strdup(filename);
+	if (!file_tag_deferred_op_table)
+		file_tag_deferred_op_table = g_hash_table_new(g_str_hash, g_str_equal);
 
-	file_tag_deferred_op_queue = g_slist_prepend(file_tag_deferred_op_queue,op);
+	link = g_hash_table_lookup(file_tag_deferred_op_table, filename);
+	if (link)
+	{
+		/* only the last operation on a file matters */
+		op = link->data;
+		op->type = type;
+		if (urgent)
+		{
+			g_queue_unlink(&file_tag_deferred_op_queue, link);
+			g_queue_push_head_link(&file_tag_deferred_op_queue, link);
+		}
+	}
+	else
+	{
+		op = (DeferredTagOp *) g_new0(DeferredTagOp, 1);
+		op->type = type;
+		op->filename = g_strdup(filename);
+
+		if (urgent)
+		{
+			g_queue_push_head(&file_tag_deferred_op_queue, op);
+			link = file_tag_deferred_op_queue.head;
+		}
+		else
+		{
+			g_queue_push_tail(&file_tag_deferred_op_queue, op);
+			link = file_tag_deferred_op_queue.tail;
+		}
+		g_hash_table_insert(file_tag_deferred_op_table, op->filename, link);
+	}
 
 	if (!flush_queued)
 	{
@@ -166,20 +298,422 @@ static void deferred_op_queue_enqueue(gchar* filename, DeferredTagOpType type)
 }
 
 
-/* path - absolute path in locale, returned list in locale */
-static GSList *get_file_list(const gchar * path, GSList *patterns, GSList *ignored_dirs_patterns)
+/* files in the directories of the open documents are likely to be used soon */
+static void enqueue_file_tag(gchar *filename, TagObject *obj, GHashTable *open_dirs)
+{
+	gchar *dirname = g_path_get_dirname(filename);
+
+	deferred_op_queue_enqueue(filename, DeferredTagOpAdd,
+		g_hash_table_lookup(open_dirs, dirname) != NULL);
+	g_free(dirname);
+}
+
+
+static void enqueue_all_file_tags(void)
+{
+	GHashTable *open_dirs;
+	gint i;
+
+	open_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	foreach_document(i)
+	{
+		if (documents[i]->file_name)
+			g_hash_table_insert(open_dirs, g_path_get_dirname(documents[i]->file_name),
+				GINT_TO_POINTER(TRUE));
+	}
+
+	g_hash_table_foreach(g_prj->file_tag_table, (GHFunc)enqueue_file_tag, open_dirs);
+
+	g_hash_table_destroy(open_dirs);
+}
+
+
+static DirCacheEntry *dir_cache_entry_new(gint64 mtime, gint64 scanned)
+{
+	DirCacheEntry *entry = g_new(DirCacheEntry, 1);
+
+	entry->mtime = mtime;
+	entry->scanned = scanned;
+	entry->files = g_ptr_array_new();
+	entry->subdirs = g_ptr_array_new();
+
+	return entry;
+}
+
+
+static void dir_cache_entry_free(DirCacheEntry *entry)
+{
+	g_ptr_array_foreach(entry->files, (GFunc) g_free, NULL);
+	g_ptr_array_free(entry->files, TRUE);
+	g_ptr_array_foreach(entry->subdirs, (GFunc) g_free, NULL);
+	g_ptr_array_free(entry->subdirs, TRUE);
+	g_free(entry);
+}
+
+
+static GHashTable *dir_cache_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) dir_cache_entry_free);
+}
+
+
+static gint64 get_current_time_ns(void)
+{
+	GTimeVal now;
+
+	g_get_current_time(&now);
+	return now.tv_sec * NSEC_PER_SEC + now.tv_usec * 1000;
+}
+
+
+static gint64 get_mtime_ns(const struct stat *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	return st->st_mtim.tv_sec * NSEC_PER_SEC + st->st_mtim.tv_nsec;
+#else
+	return st->st_mtime * NSEC_PER_SEC;
+#endif
+}
+
+
+/* locale */
+static gchar *get_cache_dir(void)
+{
+	return g_build_filename(geany_data->app->configdir, "plugins", "gproject", NULL);
+}
+
+
+/* locale */
+static gchar *get_cache_filename(void)
+{
+	gchar *checksum, *name, *dirname, *filename;
+
+	checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5,
+		geany_data->app->project->file_name, -1);
+	name = g_strconcat(checksum, ".cache", NULL);
+	dirname = get_cache_dir();
+	filename = g_build_filename(dirname, name, NULL);
+	g_free(dirname);
+	g_free(name);
+	g_free(checksum);
+
+	return filename;
+}
+
+
+/* identifies the settings the cached scan depends on */
+static gchar *get_cache_key(void)
+{
+	gchar *file_patterns, *ignored_dirs_patterns, *key;
+
+	file_patterns = geany_data->app->project->file_patterns ?
+		g_strjoinv(" ", geany_data->app->project->file_patterns) : g_strdup("");
+	ignored_dirs_patterns = g_strjoinv(" ", g_prj->ignored_dirs_patterns);
+	key = g_strdup_printf("%s|%s|%s", geany_data->app->project->base_path,
+		file_patterns, ignored_dirs_patterns);
+	setptr(key, g_compute_checksum_for_string(G_CHECKSUM_MD5, key, -1));
+	g_free(file_patterns);
+	g_free(ignored_dirs_patterns);
+
+	return key;
+}
+
+
+/* Cache file format, one entry per line:
+ *   header, project file name, cache key, then for each directory
+ *   "D<tab>mtime<tab>time read<tab>path" followed by "F<tab>path" for its files and
+ *   "S<tab>path" for its subdirectories. Directories with a newline in their path or in
+ *   the path of one of their entries aren't stored. */
+static GHashTable *dir_cache_load(const gchar *filename, const gchar *key)
+{
+	GHashTable *cache;
+	DirCacheEntry *entry = NULL;
+	gchar *contents;
+	gchar **lines;
+	gint i;
+
+	if (!g_file_get_contents(filename, &contents, NULL, NULL))
+		return NULL;
+
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	if (!lines[0] || strcmp(lines[0], CACHE_HEADER) != 0 || !lines[1] ||
+		!lines[2] || strcmp(lines[2], key) != 0)
+	{
+		g_strfreev(lines);
+		return NULL;
+	}
+
+	cache = dir_cache_new();
+	for (i = 3; lines[i] != NULL; i++)
+	{
+		gchar *line = lines[i];
+
+		if (line[0] == '\0' || line[1] != '\t')
+			continue;
+
+		if (line[0] == 'D')
+		{
+			gchar *scanned_str, *path;
+			gint64 mtime, scanned;
+
+			mtime = g_ascii_strtoll(line + 2, &scanned_str, 10);
+			if (*scanned_str != '\t')
+			{
+				entry = NULL;
+				continue;
+			}
+			scanned = g_ascii_strtoll(scanned_str + 1, &path, 10);
+			if (*path != '\t')
+			{
+				entry = NULL;
+				continue;
+			}
+			entry = dir_cache_entry_new(mtime, scanned);
+			g_hash_table_insert(cache, g_strdup(path + 1), entry);
+		}
+		else if (entry && line[0] == 'F')
+			g_ptr_array_add(entry->files, g_strdup(line + 2));
+		else if (entry && line[0] == 'S')
+			g_ptr_array_add(entry->subdirs, g_strdup(line + 2));
+	}
+	g_strfreev(lines);
+
+	return cache;
+}
+
+
+static gboolean paths_have_newline(GPtrArray *paths)
+{
+	guint i;
+
+	for (i = 0; i < paths->len; i++)
+	{
+		if (strchr(g_ptr_array_index(paths, i), '\n'))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+static void write_dir_cache_entry(const gchar *path, DirCacheEntry *entry, GString *str)
+{
+	guint i;
+
+	/* would break the line based format, the directory is just read again the next time */
+	if (strchr(path, '\n') || paths_have_newline(entry->files) ||
+		paths_have_newline(entry->subdirs))
+		return;
+
+	g_string_append_printf(str, "D\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\n",
+		entry->mtime, entry->scanned, path);
+	for (i = 0; i < entry->files->len; i++)
+		g_string_append_printf(str, "F\t%s\n", (gchar *) g_ptr_array_index(entry->files, i));
+	for (i = 0; i < entry->subdirs->len; i++)
+		g_string_append_printf(str, "S\t%s\n", (gchar *) g_ptr_array_index(entry->subdirs, i));
+}
+
+
+static void dir_cache_save(GHashTable *cache, const gchar *filename,
+	const gchar *project_file_name, const gchar *key)
+{
+	gchar *dirname;
+	GString *str;
+
+	dirname = g_path_get_dirname(filename);
+	utils_mkdir(dirname, TRUE);
+
+	str = g_string_sized_new(64 * 1024);
+	g_string_append_printf(str, "%s\n%s\n%s\n", CACHE_HEADER, project_file_name, key);
+	g_hash_table_foreach(cache, (GHFunc) write_dir_cache_entry, str);
+
+	if (!g_file_set_contents(filename, str->str, str->len, NULL))
+		g_warning("Failed to write the project cache %s", filename);
+
+	g_string_free(str, TRUE);
+	g_free(dirname);
+}
+
+
+/* Reads the header and the project file name of a cache file.
+ * Returns: the project file name, or NULL if the file isn't a cache of this version */
+static gchar *read_cache_project(const gchar *filename)
+{
+	GIOChannel *channel;
+	gchar *line, *project = NULL;
+	gsize terminator;
+
+	channel = g_io_channel_new_file(filename, "r", NULL);
+	if (!channel)
+		return NULL;
+	g_io_channel_set_encoding(channel, NULL, NULL);
+
+	if (g_io_channel_read_line(channel, &line, NULL, &terminator, NULL) == G_IO_STATUS_NORMAL)
+	{
+		line[terminator] = '\0';
+		if (strcmp(line, CACHE_HEADER) == 0 &&
+			g_io_channel_read_line(channel, &project, NULL, &terminator, NULL) == G_IO_STATUS_NORMAL)
+			project[terminator] = '\0';
+		g_free(line);
+	}
+	g_io_channel_unref(channel);
+
+	return project;
+}
+
+
+/* Removes the caches of projects which were deleted or weren't opened for a long time, and
+ * those of older versions */
+static void dir_cache_remove_stale(void)
+{
+	gchar *dirname, *current = NULL;
+	const gchar *name;
+	GDir *dir;
+	time_t now = time(NULL);
+
+	dirname = get_cache_dir();
+	dir = g_dir_open(dirname, 0, NULL);
+	if (!dir)
+	{
+		g_free(dirname);
+		return;
+	}
+
+	if (geany_data->app->project)
+		current = get_cache_filename();
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		gchar *filename, *project;
+		gboolean stale = TRUE;
+		struct stat st;
+
+		if (!g_str_has_suffix(name, ".cache"))
+			continue;
+
+		filename = g_build_filename(dirname, name, NULL);
+		if (g_strcmp0(filename, current) == 0 || g_stat(filename, &st) != 0)
+		{
+			g_free(filename);
+			continue;
+		}
+
+		project = read_cache_project(filename);
+		if (project && now - st.st_mtime < CACHE_MAX_AGE_DAYS * 24 * 60 * 60)
+		{
+			gchar *locale_project = utils_get_locale_from_utf8(project);
+
+			stale = !g_file_test(locale_project, G_FILE_TEST_IS_REGULAR);
+			g_free(locale_project);
+		}
+		if (stale)
+			g_unlink(filename);
+
+		g_free(project);
+		g_free(filename);
+	}
+
+	g_dir_close(dir);
+	g_free(current);
+	g_free(dirname);
+}
+
+
+static void scan_job_free(ScanJob *job)
+{
+	g_slist_foreach(job->patterns, (GFunc) g_pattern_spec_free, NULL);
+	g_slist_free(job->patterns);
+
+	g_slist_foreach(job->ignored_dirs_patterns, (GFunc) g_pattern_spec_free, NULL);
+	g_slist_free(job->ignored_dirs_patterns);
+
+	if (job->file_tag_table)
+		g_hash_table_destroy(job->file_tag_table);
+	if (job->old_dir_cache)
+		g_hash_table_destroy(job->old_dir_cache);
+	g_hash_table_destroy(job->dir_cache);
+	g_free(job->cache_key);
+	g_free(job->cache_filename);
+	g_free(job->project_file_name);
+	g_mutex_free(job->mutex);
+	g_free(job);
+}
+
+
+static gboolean scan_job_finished(ScanJob *job)
+{
+	/* all the tasks are done, this doesn't block */
+	if (job->pool)
+		g_thread_pool_free(job->pool, FALSE, TRUE);
+	job->pool = NULL;
+
+	if (g_atomic_int_get(&job->cancelled))
+	{
+		scan_job_free(job);
+		return FALSE;
+	}
+
+	if (job->progress_id)
+		g_source_remove(job->progress_id);
+	ui_progress_bar_stop();
+	ui_set_statusbar(FALSE, _("Project scanned: %d files found."),
+		g_atomic_int_get(&job->file_num));
+	scan_job = NULL;
+
+	if (g_prj)
+	{
+		/* generate_tags might just have been disabled, remove any tag */
+		g_hash_table_foreach(g_prj->file_tag_table, (GHFunc)workspace_remove_tag, NULL);
+		g_hash_table_destroy(g_prj->file_tag_table);
+		g_prj->file_tag_table = job->file_tag_table;
+		job->file_tag_table = NULL;
+
+		deferred_op_queue_clean();
+
+		if (g_prj->generate_tags)
+			enqueue_all_file_tags();
+
+		gprj_sidebar_update(TRUE);
+	}
+
+	scan_job_free(job);
+
+	return FALSE;
+}
+
+
+/* path - absolute path in locale, takes ownership */
+static void scan_job_push_dir(ScanJob *job, gchar *path)
+{
+	/* the pool can't be used anymore once the job is cancelled */
+	g_mutex_lock(job->mutex);
+	if (!g_atomic_int_get(&job->cancelled))
+	{
+		g_atomic_int_inc(&job->pending);
+		g_thread_pool_push(job->pool, path, NULL);
+	}
+	else
+		g_free(path);
+	g_mutex_unlock(job->mutex);
+}
+
+
+/* path - absolute path in locale */
+static void read_dir(ScanJob *job, const gchar *path, DirCacheEntry *entry)
 {
-	GSList *list = NULL;
 	GDir *dir;
 
 	dir = g_dir_open(path, 0, NULL);
 	if (!dir)
-		return NULL;
+		return;
 
 	while (TRUE)
 	{
 		const gchar *name;
 		gchar *filename;
+		struct stat st;
 
 		name = g_dir_read_name(dir);
 		if (!name)
@@ -187,86 +721,161 @@ static GSList *get_file_list(const gchar * path, GSList *patterns, GSList *ignor
 
 		filename = g_build_filename(path, name, NULL);
 
-		if (g_file_test(filename, G_FILE_TEST_IS_DIR))
+		if (g_stat(filename, &st) != 0)
 		{
-			GSList *lst;
+			g_free(filename);
+			continue;
+		}
 
-			if (patterns_match(ignored_dirs_patterns, name))
+		if (S_ISDIR(st.st_mode))
+		{
+			if (!patterns_match(job->ignored_dirs_patterns, name))
 			{
-				g_free(filename);
-				continue;
+				g_ptr_array_add(entry->subdirs, filename);
+				filename = NULL;
 			}
-
-			lst = get_file_list(filename, patterns, ignored_dirs_patterns);
-			if (lst)
-				list = g_slist_concat(list, lst);
-			g_free(filename);
 		}
-		else if (g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+		else if (S_ISREG(st.st_mode) && patterns_match(job->patterns, name))
 		{
-			if (patterns_match(patterns, name))
-				list = g_slist_prepend(list, filename);
-			else
-				g_free(filename);
+			gchar *real_path = tm_get_real_path(filename);
+
+			if (real_path)
+			{
+				setptr(real_path, utils_get_utf8_from_locale(real_path));
+				g_ptr_array_add(entry->files, real_path);
+			}
 		}
+		g_free(filename);
 	}
 
 	g_dir_close(dir);
-
-	return list;
 }
 
 
-void gprj_project_rescan(void)
+/* path - absolute path in locale, runs in a pool thread */
+static void scan_dir(gchar *path, ScanJob *job)
 {
-	GSList *pattern_list = NULL;
-	GSList *ignored_dirs_list = NULL;
-	GSList *lst;
-	GSList *elem;
-
-	if (!g_prj)
-		return;
-
-	if (g_prj->generate_tags)
-		g_hash_table_foreach(g_prj->file_tag_table, (GHFunc)workspace_remove_tag, NULL);
-	g_hash_table_destroy(g_prj->file_tag_table);
-	g_prj->file_tag_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	DirCacheEntry *entry = NULL;
+	struct stat st;
+	guint i;
 
-	deferred_op_queue_clean();
+	/* the first task, no other one is queued before it pushes the subdirectories */
+	if (!job->cache_loaded)
+	{
+		job->old_dir_cache = dir_cache_load(job->cache_filename, job->cache_key);
+		job->cache_loaded = TRUE;
+	}
 
-	pattern_list = get_precompiled_patterns(geany_data->app->project->file_patterns);
+	if (!g_atomic_int_get(&job->cancelled) && g_stat(path, &st) == 0)
+	{
+		DirCacheEntry *cached = NULL;
 
-	ignored_dirs_list = get_precompiled_patterns(g_prj->ignored_dirs_patterns);
+		entry = dir_cache_entry_new(get_mtime_ns(&st), job->start_time);
+		if (job->old_dir_cache)
+			cached = g_hash_table_lookup(job->old_dir_cache, path);
 
-	lst = get_file_list(geany_data->app->project->base_path, pattern_list, ignored_dirs_list);
+		/* the list of entries of a directory only changes with its mtime */
+		if (cached && cached->mtime == entry->mtime &&
+			cached->scanned - cached->mtime > CACHE_MTIME_MARGIN)
+		{
+			entry->scanned = cached->scanned;
+			for (i = 0; i < cached->files->len; i++)
+				g_ptr_array_add(entry->files, g_strdup(g_ptr_array_index(cached->files, i)));
+			for (i = 0; i < cached->subdirs->len; i++)
+				g_ptr_array_add(entry->subdirs, g_strdup(g_ptr_array_index(cached->subdirs, i)));
+		}
+		else
+			read_dir(job, path, entry);
+	}
 
-	for (elem = lst; elem != NULL; elem = g_slist_next(elem))
+	if (entry)
 	{
-		char *path;
-		TagObject *obj;
-
-		obj = g_new0(TagObject, 1);
-		obj->tag = NULL;
+		for (i = 0; i < entry->subdirs->len; i++)
+			scan_job_push_dir(job, g_strdup(g_ptr_array_index(entry->subdirs, i)));
 
-		path = tm_get_real_path(elem->data);
-		if (path)
+		g_mutex_lock(job->mutex);
+		for (i = 0; i < entry->files->len; i++)
 		{
-			setptr(path, utils_get_utf8_from_locale(path));
-			g_hash_table_insert(g_prj->file_tag_table, path, obj);
+			g_hash_table_insert(job->file_tag_table,
+				g_strdup(g_ptr_array_index(entry->files, i)), g_new0(TagObject, 1));
+			g_atomic_int_inc(&job->file_num);
 		}
+		g_hash_table_insert(job->dir_cache, path, entry);
+		g_mutex_unlock(job->mutex);
 	}
+	else
+		g_free(path);
 
-	if (g_prj->generate_tags)
-		g_hash_table_foreach(g_prj->file_tag_table, (GHFunc)workspace_add_tag, NULL);
+	/* the last directory finishes the job, the cache isn't used by any task anymore */
+	if (g_atomic_int_dec_and_test(&job->pending))
+	{
+		if (!g_atomic_int_get(&job->cancelled))
+			dir_cache_save(job->dir_cache, job->cache_filename, job->project_file_name,
+				job->cache_key);
+		g_idle_add((GSourceFunc)scan_job_finished, job);
+	}
+}
+
+
+static gboolean scan_job_progress(ScanJob *job)
+{
+	ui_set_statusbar(FALSE, _("Scanning project: %d files found..."),
+		g_atomic_int_get(&job->file_num));
+
+	return TRUE;
+}
 
-	g_slist_foreach(lst, (GFunc) g_free, NULL);
-	g_slist_free(lst);
 
-	g_slist_foreach(pattern_list, (GFunc) g_pattern_spec_free, NULL);
-	g_slist_free(pattern_list);
+static void scan_job_cancel(void)
+{
+	ScanJob *job = scan_job;
+
+	if (!job)
+		return;
+
+	scan_job = NULL;
+	if (job->progress_id)
+		g_source_remove(job->progress_id);
+	ui_progress_bar_stop();
+
+	/* the queued directories are skipped and the running ones aren't waited for (they can
+	 * take long on slow file systems); the last one queues scan_job_finished() which frees
+	 * the pool and the job - the module is resident so this may happen after cleanup */
+	g_mutex_lock(job->mutex);
+	g_atomic_int_set(&job->cancelled, TRUE);
+	g_mutex_unlock(job->mutex);
+}
+
+
+void gprj_project_rescan(void)
+{
+	ScanJob *job;
+
+	if (!g_prj)
+		return;
 
-	g_slist_foreach(ignored_dirs_list, (GFunc) g_pattern_spec_free, NULL);
-	g_slist_free(ignored_dirs_list);
+	scan_job_cancel();
+	/* the queued operations are about the old file list */
+	deferred_op_queue_clean();
+
+	job = g_new0(ScanJob, 1);
+	job->patterns = get_precompiled_patterns(geany_data->app->project->file_patterns);
+	job->ignored_dirs_patterns = get_precompiled_patterns(g_prj->ignored_dirs_patterns);
+	job->cache_key = get_cache_key();
+	job->cache_filename = get_cache_filename();
+	job->project_file_name = g_strdup(geany_data->app->project->file_name);
+	job->start_time = get_current_time_ns();
+	job->mutex = g_mutex_new();
+	job->file_tag_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	job->dir_cache = dir_cache_new();
+	job->pending = 1;
+	job->pool = g_thread_pool_new((GFunc)scan_dir, job, SCAN_THREADS, FALSE, NULL);
+	scan_job = job;
+
+	ui_progress_bar_start(_("Scanning project"));
+	job->progress_id = plugin_timeout_add(geany_plugin, 250, (GSourceFunc)scan_job_progress, job);
+
+	g_thread_pool_push(job->pool, g_strdup(geany_data->app->project->base_path), NULL);
 }
 
 
@@ -468,10 +1077,15 @@ void gprj_project_close(void)
 {
 	g_return_if_fail(g_prj);
 
+	scan_job_cancel();
+
 	if (g_prj->generate_tags)
 		g_hash_table_foreach(g_prj->file_tag_table, (GHFunc)workspace_remove_tag, NULL);
 
 	deferred_op_queue_clean();
+	if (file_tag_deferred_op_table)
+		g_hash_table_destroy(file_tag_deferred_op_table);
+	file_tag_deferred_op_table = NULL;
 
 	g_free(g_prj->source_patterns);
 	g_free(g_prj->header_patterns);
@@ -479,6 +1093,8 @@ void gprj_project_close(void)
 
 	g_hash_table_destroy(g_prj->file_tag_table);
 
+	dir_cache_remove_stale();
+
 	g_free(g_prj);
 	g_prj = NULL;
 }
@@ -486,13 +1102,13 @@ void gprj_project_close(void)
 
 void gprj_project_add_file_tag(gchar *filename)
 {
-	deferred_op_queue_enqueue(filename, DeferredTagOpAdd);
+	deferred_op_queue_enqueue(filename, DeferredTagOpAdd, TRUE);
 }
 
 
 void gprj_project_remove_file_tag(gchar *filename)
 {
-	deferred_op_queue_enqueue(filename, DeferredTagOpRemove);
+	deferred_op_queue_enqueue(filename, DeferredTagOpRemove, TRUE);
 }
 
 
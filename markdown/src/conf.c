@@ -39,7 +39,8 @@
   "font_point_size=12\n" \
   "code_font_point_size=12\n" \
   "bg_color=#fff\n" \
-  "fg_color=#000\n"
+  "fg_color=#000\n" \
+  "update_delay=250\n"
 
 #define MARKDOWN_HTML_TEMPLATE \
   "<html>\n" \
@@ -73,6 +74,7 @@ enum
   PROP_BG_COLOR,
   PROP_FG_COLOR,
   PROP_VIEW_POS,
+  PROP_UPDATE_DELAY,
   PROP_LAST
 };
 
@@ -96,6 +98,7 @@ struct _MarkdownConfigPrivate
     GtkWidget *bg_color_button;
     GtkWidget *fg_color_button;
     GtkWidget *tmpl_file_button;
+    GtkWidget *update_delay_spin;
   } widgets;
 };
 
@@ -213,6 +216,11 @@ markdown_config_set_property(GObject *obj, guint prop_id, const GValue *value, G
         (gint) g_value_get_uint(value));
       save_later = TRUE;
       break;
+    case PROP_UPDATE_DELAY:
+      g_key_file_set_integer(conf->priv->kf, "view", "update_delay",
+        (gint) g_value_get_uint(value));
+      save_later = TRUE;
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, prop_id, pspec);
       break;
@@ -251,7 +259,7 @@ markdown_config_get_uint_key(MarkdownConfig *conf, const gchar *group,
   if (error) {
     g_debug("Config read failed: %s", error->message);
     g_error_free(error); error = NULL;
-    out_uint = 12;
+    out_uint = default_value;
   }
 
   return out_uint;
@@ -332,6 +340,13 @@ markdown_config_get_property(GObject *obj, guint prop_id, GValue *value, GParamS
       g_value_set_uint(value, view_pos);
       break;
     }
+    case PROP_UPDATE_DELAY:
+    {
+      guint update_delay;
+      update_delay = markdown_config_get_uint_key(conf, "view", "update_delay", 250);
+      g_value_set_uint(value, update_delay);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, prop_id, pspec);
       break;
@@ -368,6 +383,9 @@ markdown_config_class_init(MarkdownConfigClass *klass)
     "Notebook where the view will be positioned", 0,
     MARKDOWN_CONFIG_VIEW_POS_MAX-1, (guint) MARKDOWN_CONFIG_VIEW_POS_SIDEBAR,
     G_PARAM_READWRITE);
+  md_props[PROP_UPDATE_DELAY] = g_param_spec_uint("update-delay", "UpdateDelay",
+    "Milliseconds to wait after the last edit before updating the preview",
+    0, 10000, 250, G_PARAM_READWRITE);
 
   g_object_class_install_properties(g_object_class, PROP_LAST, md_props);
 }
@@ -494,7 +512,7 @@ on_dialog_response(MarkdownConfig *conf, gint response_id, GtkDialog *dialog)
     gboolean pos_sidebar = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wid));
     gchar *bg_color, *fg_color;
     gchar *tmpl_file = NULL, *fnt = NULL, *code_fnt = NULL;
-    guint fnt_size = 0, code_fnt_size = 0;
+    guint fnt_size = 0, code_fnt_size = 0, update_delay;
     const gchar *font_desc;
     MarkdownConfigViewPos view_pos;
 
@@ -511,6 +529,9 @@ on_dialog_response(MarkdownConfig *conf, gint response_id, GtkDialog *dialog)
 
     tmpl_file = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(conf->priv->widgets.tmpl_file_button));
 
+    update_delay = (guint) gtk_spin_button_get_value_as_int(
+      GTK_SPIN_BUTTON(conf->priv->widgets.update_delay_spin));
+
     g_object_set(conf,
                  "font-name", fnt,
                  "font-point-size", fnt_size,
@@ -520,6 +541,7 @@ on_dialog_response(MarkdownConfig *conf, gint response_id, GtkDialog *dialog)
                  "bg-color", bg_color,
                  "fg-color", fg_color,
                  "template-file", tmpl_file,
+                 "update-delay", update_delay,
                  NULL);
 
     g_free(fnt);
@@ -535,7 +557,7 @@ GtkWidget *markdown_config_gui(MarkdownConfig *conf, GtkDialog *dialog)
   GSList *grp = NULL;
   GtkWidget *table, *label, *hbox, *wid;
   gchar *tmpl_file=NULL, *fnt=NULL, *code_fnt=NULL, *bg=NULL, *fg=NULL;
-  guint view_pos=0, fnt_sz=0, code_fnt_sz=0;
+  guint view_pos=0, fnt_sz=0, code_fnt_sz=0, update_delay=0;
 
   g_object_get(conf,
                "view-pos", &view_pos,
@@ -546,9 +568,10 @@ GtkWidget *markdown_config_gui(MarkdownConfig *conf, GtkDialog *dialog)
                "bg-color", &bg,
                "fg-color", &fg,
                "template-file", &tmpl_file,
+               "update-delay", &update_delay,
                NULL);
 
-  table = gtk_table_new(6, 2, FALSE);
+  table = gtk_table_new(7, 2, FALSE);
   gtk_table_set_col_spacings(GTK_TABLE(table), 6);
   gtk_table_set_row_spacings(GTK_TABLE(table), 6);
   conf->priv->widgets.table = table;
@@ -667,6 +690,25 @@ GtkWidget *markdown_config_gui(MarkdownConfig *conf, GtkDialog *dialog)
     g_free(tmpl_file);
   }
 
+  { /* UPDATE DELAY */
+    label = gtk_label_new(_("Update Delay:"));
+    gtk_misc_set_alignment(GTK_MISC(label), 0.0, 0.5);
+    gtk_table_attach(GTK_TABLE(table), label, 0, 1, 6, 7, GTK_FILL, GTK_FILL, 0, 0);
+
+    hbox = gtk_hbox_new(FALSE, 6);
+
+    wid = gtk_spin_button_new_with_range(0, 10000, 50);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(wid), update_delay);
+    conf->priv->widgets.update_delay_spin = wid;
+    gtk_box_pack_start(GTK_BOX(hbox), wid, FALSE, TRUE, 0);
+
+    label = gtk_label_new(_("milliseconds"));
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, TRUE, 0);
+
+    gtk_table_attach(GTK_TABLE(table), hbox, 1, 2, 6, 7, GTK_FILL | GTK_EXPAND,
+      GTK_FILL, 0, 0);
+  }
+
   conf->priv->dlg_handle = g_signal_connect_swapped(dialog, "response",
     G_CALLBACK(on_dialog_response), conf);
 
@@ -705,3 +747,11 @@ void markdown_config_set_view_pos(MarkdownConfig *conf, MarkdownConfigViewPos vi
   g_return_if_fail(MARKDOWN_IS_CONFIG(conf));
   g_object_set(conf, "view-pos", view_pos, NULL);
 }
+
+guint markdown_config_get_update_delay(MarkdownConfig *conf)
+{
+  guint update_delay;
+  g_return_val_if_fail(MARKDOWN_IS_CONFIG(conf), 0);
+  g_object_get(conf, "update-delay", &update_delay, NULL);
+  return update_delay;
+}
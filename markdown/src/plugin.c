@@ -51,9 +51,11 @@ PLUGIN_SET_INFO("Markdown",
 /* Global data */
 static MarkdownViewer *g_viewer = NULL;
 static GtkWidget *g_scrolled_win = NULL;
+static guint g_update_handle = 0;
 
 /* Forward declarations */
 static void update_markdown_viewer(MarkdownViewer *viewer);
+static void queue_update_markdown_viewer(MarkdownViewer *viewer);
 static gboolean on_editor_notify(GObject *obj, GeanyEditor *editor, SCNotification *notif, MarkdownViewer *viewer);
 static void on_document_signal(GObject *obj, GeanyDocument *doc, MarkdownViewer *viewer);
 static void on_document_filetype_set(GObject *obj, GeanyDocument *doc, GeanyFiletype *ft_old, MarkdownViewer *viewer);
@@ -69,6 +71,11 @@ void plugin_init(GeanyData *data)
   GtkWidget *viewer;
   GtkNotebook *nb;
 
+  /* The Markdown is compiled to HTML in a worker thread. */
+  if (!g_thread_supported()) {
+    g_thread_init(NULL);
+  }
+
   /* Setup the config object which is needed by the view. */
   conf_fn = g_build_filename(geany->app->configdir, "plugins", "markdown",
     "markdown.conf", NULL);
@@ -122,6 +129,10 @@ void plugin_init(GeanyData *data)
 /* Cleanup resources on plugin unload. */
 void plugin_cleanup(void)
 {
+  if (g_update_handle != 0) {
+    g_source_remove(g_update_handle);
+    g_update_handle = 0;
+  }
   gtk_widget_destroy(g_scrolled_win);
 }
 
@@ -151,6 +162,12 @@ update_markdown_viewer(MarkdownViewer *viewer)
 {
   GeanyDocument *doc = document_get_current();
 
+  /* Any pending delayed update is covered by this one. */
+  if (g_update_handle != 0) {
+    g_source_remove(g_update_handle);
+    g_update_handle = 0;
+  }
+
   if (DOC_VALID(doc) && g_strcmp0(doc->file_type->name, "Markdown") == 0) {
     gchar *text;
     text = (gchar*) scintilla_send_message(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0);
@@ -163,6 +180,34 @@ update_markdown_viewer(MarkdownViewer *viewer)
   markdown_viewer_queue_update(viewer);
 }
 
+static gboolean
+on_update_timeout(MarkdownViewer *viewer)
+{
+  g_update_handle = 0;
+  update_markdown_viewer(viewer);
+  return FALSE;
+}
+
+/* Like update_markdown_viewer() but waits until the text stopped changing
+ * for the configured delay, so that the document isn't copied and
+ * re-rendered on every keystroke. */
+static void
+queue_update_markdown_viewer(MarkdownViewer *viewer)
+{
+  MarkdownConfig *conf = NULL;
+  guint delay;
+
+  g_object_get(viewer, "config", &conf, NULL);
+  delay = markdown_config_get_update_delay(conf);
+  g_object_unref(conf);
+
+  if (g_update_handle != 0) {
+    g_source_remove(g_update_handle);
+  }
+  g_update_handle = g_timeout_add(delay,
+    (GSourceFunc) on_update_timeout, viewer);
+}
+
 /* Return TRUE if event is a buffer modification that inserts or deletes
  * text and which caused a text changed length greater than 0. */
 #define IS_MOD_NOTIF(nt) (nt->nmhdr.code == SCN_MODIFIED && \
@@ -175,7 +220,7 @@ static gboolean on_editor_notify(GObject *obj, GeanyEditor *editor,
   SCNotification *notif, MarkdownViewer *viewer)
 {
   if (IS_MOD_NOTIF(notif)) {
-    update_markdown_viewer(viewer);
+    queue_update_markdown_viewer(viewer);
   }
   return FALSE; /* Allow others to handle this event too */
 }
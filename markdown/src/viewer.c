@@ -19,6 +19,7 @@
  * MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <gtk/gtk.h>
 #include <webkit/webkitwebview.h>
 #include "markdown.h"
@@ -27,6 +28,16 @@
 
 #define MD_ENC_MAX 256
 
+/* Comments marking the start of each rendered block in the preview page,
+ * and the end of the last one. Comments don't change the structure the
+ * template's CSS sees, unlike wrapping each block in an element. */
+#define MD_BLOCK_MARK "markdown-block"
+#define MD_END_MARK "markdown-end"
+
+/* Status text set by the patching script when the page doesn't hold the
+ * blocks it expects, e.g. after following a link. */
+#define MD_RELOAD_STATUS "markdown-reload"
+
 enum
 {
   PROP_0,
@@ -36,16 +47,35 @@ enum
   N_PROPERTIES
 };
 
+/* A Markdown to HTML compilation running in a worker thread. The job
+ * owns a snapshot of the text so the editor can keep changing while it
+ * runs, and is freed by the idle callback that delivers the result. */
+typedef struct
+{
+  MarkdownViewer *viewer; /* NULL once the viewer is gone */
+  gchar *text;
+  GPtrArray *blocks;      /* the top-level HTML blocks */
+  GArray *hashes;         /* and a hash of each of them */
+} MarkdownRenderJob;
+
 struct _MarkdownViewerPrivate
 {
   MarkdownConfig *conf;
   gulong load_handle;
+  gulong status_handle;
   guint update_handle;
   gulong prop_handle;
   GString *text;
   gchar enc[MD_ENC_MAX];
   gdouble vscroll_pos;
   gdouble hscroll_pos;
+  MarkdownRenderJob *job;
+  gboolean render_queued;
+  GPtrArray *blocks;      /* the blocks currently in the page */
+  GArray *hashes;
+  gboolean page_loaded;   /* the page is loaded and can be patched */
+  gboolean page_loading;  /* our page is being loaded */
+  gboolean reload_needed; /* the template or encoding changed */
 };
 
 static void markdown_viewer_finalize (GObject *object);
@@ -84,6 +114,9 @@ markdown_viewer_set_property(GObject *obj, guint prop_id, const GValue *value, G
       update_internal_text(self, g_value_get_string(value));
       break;
     case PROP_ENCODING:
+      if (g_strcmp0(self->priv->enc, g_value_get_string(value)) != 0) {
+        self->priv->reload_needed = TRUE;
+      }
       strncpy(self->priv->enc, g_value_get_string(value), MD_ENC_MAX);
       break;
     default:
@@ -135,6 +168,15 @@ markdown_viewer_class_init(MarkdownViewerClass *klass)
   g_object_class_install_properties(g_object_class, N_PROPERTIES, viewer_props);
 }
 
+static void
+free_html_blocks(GPtrArray *blocks)
+{
+  if (blocks) {
+    g_ptr_array_foreach(blocks, (GFunc) g_free, NULL);
+    g_ptr_array_free(blocks, TRUE);
+  }
+}
+
 static void
 markdown_viewer_finalize(GObject *object)
 {
@@ -148,6 +190,18 @@ markdown_viewer_finalize(GObject *object)
   if (self->priv->text) {
     g_string_free(self->priv->text, TRUE);
   }
+  if (self->priv->update_handle != 0) {
+    g_source_remove(self->priv->update_handle);
+  }
+  /* A render still running in the background is left to finish on its
+   * own, its result is just dropped. */
+  if (self->priv->job) {
+    self->priv->job->viewer = NULL;
+  }
+  free_html_blocks(self->priv->blocks);
+  if (self->priv->hashes) {
+    g_array_free(self->priv->hashes, TRUE);
+  }
   G_OBJECT_CLASS(markdown_viewer_parent_class)->finalize(object);
 }
 
@@ -158,6 +212,15 @@ markdown_viewer_init(MarkdownViewer *self)
 }
 
 
+static void
+on_config_notify(MarkdownViewer *self, GParamSpec *pspec, MarkdownConfig *conf)
+{
+  /* The settings are substituted in the page template, so it needs to be
+   * loaded again rather than patched. */
+  self->priv->reload_needed = TRUE;
+  markdown_viewer_queue_update(self);
+}
+
 GtkWidget *
 markdown_viewer_new(MarkdownConfig *conf)
 {
@@ -167,28 +230,11 @@ markdown_viewer_new(MarkdownConfig *conf)
 
   /* Cause the view to be updated whenever the config changes. */
   self->priv->prop_handle = g_signal_connect_swapped(self->priv->conf, "notify",
-      G_CALLBACK(markdown_viewer_queue_update), self);
+      G_CALLBACK(on_config_notify), self);
 
   return GTK_WIDGET(self);
 }
 
-static void
-replace_all(MarkdownViewer *self,
-            GString *haystack,
-            const gchar *needle,
-            const gchar *replacement)
-{
-  gchar *ptr;
-  gsize needle_len = strlen(needle);
-
-  /* For each occurrence of needle in haystack */
-  while ((ptr = strstr(haystack->str, needle)) != NULL) {
-    goffset offset = ptr - haystack->str;
-    g_string_erase(haystack, offset, needle_len);
-    g_string_insert(haystack, offset, replacement);
-  }
-}
-
 static gchar *
 template_replace(MarkdownViewer *self, const gchar *html_text)
 {
@@ -198,7 +244,9 @@ template_replace(MarkdownViewer *self, const gchar *html_text)
   gchar *bg_color = NULL, *fg_color = NULL;
   gchar font_pt_size[10] = { 0 };
   gchar code_font_pt_size[10] = { 0 };
-  GString *tmpl;
+  const gchar *tmpl, *ptr;
+  GString *out;
+  gsize html_len;
 
   { /* Read all the configuration settings into strings */
     g_object_get(self->priv->conf,
@@ -214,30 +262,78 @@ template_replace(MarkdownViewer *self, const gchar *html_text)
     g_snprintf(code_font_pt_size, 10, "%d", code_font_point_size);
   }
 
-  /* Load the template into a GString to be modified in place */
-  tmpl = g_string_new(markdown_config_get_template_text(self->priv->conf));
+  tmpl = markdown_config_get_template_text(self->priv->conf);
+  if (!tmpl) {
+    tmpl = "@@markdown@@";
+  }
+
+  html_len = strlen(html_text);
+  out = g_string_sized_new(strlen(tmpl) + html_len);
+
+  /* Copy the template over in a single pass, substituting each
+   * @@placeholder@@ as it is found. Substituted values are never scanned
+   * again, so the Markdown may itself contain placeholder-like text. */
+  ptr = tmpl;
+  while (*ptr) {
+    const gchar *start = strstr(ptr, "@@");
+    const gchar *end, *name, *value = NULL;
+    gssize value_len = -1;
+
+    if (!start) {
+      g_string_append(out, ptr);
+      break;
+    }
+    g_string_append_len(out, ptr, start - ptr);
+
+    name = start + 2;
+    end = strstr(name, "@@");
+    if (end) {
+      gsize name_len = end - name;
+
+#define MD_PLACEHOLDER_IS(s) \
+  (name_len == sizeof(s) - 1 && strncmp(name, (s), name_len) == 0)
+      if (MD_PLACEHOLDER_IS("markdown")) {
+        value = html_text;
+        value_len = (gssize) html_len;
+      } else if (MD_PLACEHOLDER_IS("font_name")) {
+        value = font_name;
+      } else if (MD_PLACEHOLDER_IS("code_font_name")) {
+        value = code_font_name;
+      } else if (MD_PLACEHOLDER_IS("font_point_size")) {
+        value = font_pt_size;
+      } else if (MD_PLACEHOLDER_IS("code_font_point_size")) {
+        value = code_font_pt_size;
+      } else if (MD_PLACEHOLDER_IS("bg_color")) {
+        value = bg_color;
+      } else if (MD_PLACEHOLDER_IS("fg_color")) {
+        value = fg_color;
+      }
+#undef MD_PLACEHOLDER_IS
+    }
 
-  replace_all(self, tmpl, "@@font_name@@", font_name);
-  replace_all(self, tmpl, "@@code_font_name@@", code_font_name);
-  replace_all(self, tmpl, "@@font_point_size@@", font_pt_size);
-  replace_all(self, tmpl, "@@code_font_point_size@@", code_font_pt_size);
-  replace_all(self, tmpl, "@@bg_color@@", bg_color);
-  replace_all(self, tmpl, "@@fg_color@@", fg_color);
-  replace_all(self, tmpl, "@@markdown@@", html_text);
+    if (value) {
+      g_string_append_len(out, value, value_len);
+      ptr = end + 2;
+    } else {
+      /* Not a known placeholder, keep the '@' and look again from the
+       * next character. */
+      g_string_append_c(out, *start);
+      ptr = start + 1;
+    }
+  }
 
   g_free(font_name);
   g_free(code_font_name);
   g_free(bg_color);
   g_free(fg_color);
 
-  return g_string_free(tmpl, FALSE);
+  return g_string_free(out, FALSE);
 }
 
-static gboolean
+static void
 push_scroll_pos(MarkdownViewer *self)
 {
   GtkWidget *parent;
-  gboolean pushed = FALSE;
 
   parent = gtk_widget_get_parent(GTK_WIDGET(self));
   if (GTK_IS_SCROLLED_WINDOW(parent)) {
@@ -246,103 +342,502 @@ push_scroll_pos(MarkdownViewer *self)
     self->priv->vscroll_pos = gtk_adjustment_get_value(adj);
     adj = gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(parent));
     self->priv->hscroll_pos = gtk_adjustment_get_value(adj);
-    pushed = TRUE;
   }
+}
 
-  return pushed;
+static void
+pop_scroll_pos(MarkdownViewer *self)
+{
+  gchar *script;
+
+  /* Let the page scroll itself once its layout is done instead of waiting
+   * for it to be drawn. */
+  script = g_strdup_printf("window.scrollTo(%d, %d);",
+    (gint) self->priv->hscroll_pos, (gint) self->priv->vscroll_pos);
+  webkit_web_view_execute_script(WEBKIT_WEB_VIEW(self), script);
+  g_free(script);
 }
 
+static void
+on_webview_load_status_notify(WebKitWebView *view, GParamSpec *pspec,
+  MarkdownViewer *self)
+{
+  WebKitLoadStatus load_status;
+
+  g_object_get(view, "load-status", &load_status, NULL);
+
+  switch (load_status) {
+    case WEBKIT_LOAD_PROVISIONAL:
+      /* Whatever is loading, maybe a page the user followed a link to,
+       * replaces the blocks. */
+      self->priv->page_loaded = FALSE;
+      break;
+    case WEBKIT_LOAD_FINISHED:
+      /* When the webkit is done loading our page, reset the scroll
+       * position. */
+      if (self->priv->page_loading) {
+        self->priv->page_loading = FALSE;
+        self->priv->page_loaded = TRUE;
+        pop_scroll_pos(self);
+      }
+      break;
+    case WEBKIT_LOAD_FAILED:
+      self->priv->page_loading = FALSE;
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+on_webview_status_bar_text_changed(WebKitWebView *view, const gchar *text,
+  MarkdownViewer *self)
+{
+  if (g_strcmp0(text, MD_RELOAD_STATUS) == 0) {
+    self->priv->page_loaded = FALSE;
+  }
+}
+
+/* Elements that start a new block when found at the top level of the
+ * compiled HTML, anything else is grouped with its neighbours. */
+static const gchar *const block_tags[] = {
+  "address", "article", "aside", "blockquote", "center", "dd", "div", "dl",
+  "dt", "fieldset", "figure", "footer", "form", "h1", "h2", "h3", "h4",
+  "h5", "h6", "header", "hr", "li", "nav", "ol", "p", "pre", "section",
+  "table", "ul", NULL
+};
+
+/* Elements that never have a closing tag. */
+static const gchar *const void_tags[] = {
+  "area", "base", "br", "col", "embed", "hr", "img", "input", "link",
+  "meta", "param", "source", "wbr", NULL
+};
+
 static gboolean
-pop_scroll_pos(MarkdownViewer *self)
+html_tag_in(const gchar *name, const gchar *const *tags)
 {
-  GtkWidget *parent;
-  gboolean popped = FALSE;
+  for (; *tags; tags++) {
+    if (strcmp(name, *tags) == 0) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
 
-  /* first process any pending events, like drawing of the webview */
-  while (gtk_events_pending()) {
-    gtk_main_iteration();
+/* Copies the lower-cased name of the tag starting at p (just past the '<'
+ * or '</') into name. */
+static void
+html_tag_name(const gchar *p, gchar *name, gsize size)
+{
+  gsize len = 0;
+  while (g_ascii_isalnum(p[len]) && len + 1 < size) {
+    name[len] = g_ascii_tolower(p[len]);
+    len++;
   }
+  name[len] = '\0';
+}
 
-  parent = gtk_widget_get_parent(GTK_WIDGET(self));
-  if (GTK_IS_SCROLLED_WINDOW(parent)) {
-    GtkAdjustment *adj;
-    adj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(parent));
-    gtk_adjustment_set_value(adj, self->priv->vscroll_pos);
-    adj = gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(parent));
-    gtk_adjustment_set_value(adj, self->priv->hscroll_pos);
-    /* process any new events, like making sure the new scroll position
-     * takes effect. */
-    while (gtk_events_pending()) {
-      gtk_main_iteration();
+/* Returns a pointer just past the end of the tag starting at p. */
+static const gchar *
+html_skip_tag(const gchar *p)
+{
+  gchar quote = 0;
+
+  for (p++; *p; p++) {
+    if (quote) {
+      if (*p == quote) {
+        quote = 0;
+      }
+    } else if (*p == '"' || *p == '\'') {
+      quote = *p;
+    } else if (*p == '>') {
+      return p + 1;
     }
-    popped = TRUE;
   }
 
-  return popped;
+  return p;
+}
+
+/* Returns a pointer just past the closing tag of the raw text element
+ * (script or style) whose contents start at p. */
+static const gchar *
+html_skip_raw_text(const gchar *p, const gchar *name)
+{
+  gsize len = strlen(name);
+
+  while ((p = strchr(p, '<')) != NULL) {
+    if (p[1] == '/' && g_ascii_strncasecmp(p + 2, name, len) == 0) {
+      return html_skip_tag(p);
+    }
+    p++;
+  }
+
+  return NULL;
+}
+
+static gboolean
+html_is_tag_start(const gchar *p)
+{
+  return p[0] == '<' &&
+    (g_ascii_isalpha(p[1]) || p[1] == '/' || p[1] == '!' || p[1] == '?');
+}
+
+/* Returns a pointer just past the top-level item (a whole element, a
+ * comment or a run of text) starting at p. */
+static const gchar *
+html_skip_item(const gchar *p, gboolean *is_block)
+{
+  gchar name[16];
+  gint depth = 0;
+
+  *is_block = FALSE;
+
+  if (!html_is_tag_start(p)) {
+    for (p++; *p && !html_is_tag_start(p); p++);
+    return p;
+  }
+
+  while (*p) {
+    const gchar *end;
+
+    if (!html_is_tag_start(p)) {
+      p++;
+      continue;
+    }
+
+    if (strncmp(p, "<!--", 4) == 0) {
+      end = strstr(p + 4, "-->");
+      p = end ? end + 3 : p + strlen(p);
+    } else if (p[1] == '/') {
+      p = html_skip_tag(p);
+      depth--;
+    } else if (p[1] == '!' || p[1] == '?') {
+      p = html_skip_tag(p);
+    } else {
+      html_tag_name(p + 1, name, sizeof(name));
+      if (depth == 0) {
+        *is_block = html_tag_in(name, block_tags);
+      }
+      end = html_skip_tag(p);
+      if (strcmp(name, "script") == 0 || strcmp(name, "style") == 0) {
+        end = html_skip_raw_text(end, name);
+        p = end ? end : p + strlen(p);
+      } else if (html_tag_in(name, void_tags) ||
+                 (end - p > 2 && end[-1] == '>' && end[-2] == '/')) {
+        p = end;
+      } else {
+        p = end;
+        depth++;
+      }
+    }
+
+    if (depth <= 0) {
+      break;
+    }
+  }
+
+  return p;
 }
 
 static void
-on_webview_load_status_notify(WebKitWebView *view, GParamSpec *pspec,
-  MarkdownViewer *self)
+add_html_block(GPtrArray *blocks, const gchar *start, const gchar *end)
 {
-  WebKitLoadStatus load_status;
+  while (end > start && g_ascii_isspace(end[-1])) {
+    end--;
+  }
+  if (end > start) {
+    g_ptr_array_add(blocks, g_strndup(start, end - start));
+  }
+}
 
-  g_object_get(view, "load-status", &load_status, NULL);
+/* Splits the compiled HTML into its top-level blocks. Block-level elements
+ * each make a block of their own, runs of anything else between them are
+ * kept together so inline content isn't broken up. */
+static GPtrArray *
+split_html_blocks(const gchar *html)
+{
+  GPtrArray *blocks = g_ptr_array_new();
+  const gchar *p = html, *run = NULL;
+
+  while (*p) {
+    const gchar *end;
+    gboolean is_block;
+
+    if (!run && g_ascii_isspace(*p)) {
+      p++;
+      continue;
+    }
 
-  /* When the webkit is done loading, reset the scroll position. */
-  if (load_status == WEBKIT_LOAD_FINISHED) {
-    pop_scroll_pos(self);
+    end = html_skip_item(p, &is_block);
+    if (is_block) {
+      if (run) {
+        add_html_block(blocks, run, p);
+        run = NULL;
+      }
+      add_html_block(blocks, p, end);
+    } else if (!run) {
+      run = p;
+    }
+    p = end;
+  }
+
+  if (run) {
+    add_html_block(blocks, run, p);
   }
+
+  return blocks;
 }
 
-static gchar *
-markdown_viewer_get_html(MarkdownViewer *self)
+static void
+append_js_string(GString *script, const gchar *str)
 {
-  gchar *md_as_html, *html = NULL;
+  g_string_append_c(script, '"');
+  for (; *str; str++) {
+    switch (*str) {
+      case '"':  g_string_append(script, "\\\""); break;
+      case '\\': g_string_append(script, "\\\\"); break;
+      case '\n': g_string_append(script, "\\n"); break;
+      case '\r': g_string_append(script, "\\r"); break;
+      case '\xe2':
+        /* U+2028 and U+2029 end lines in JavaScript strings */
+        if (str[1] == '\x80' && (str[2] == '\xa8' || str[2] == '\xa9')) {
+          g_string_append(script, str[2] == '\xa8' ? "\\u2028" : "\\u2029");
+          str += 2;
+          break;
+        }
+        /* fall through */
+      default:
+        g_string_append_c(script, *str);
+        break;
+    }
+  }
+  g_string_append_c(script, '"');
+}
 
-  /* Ensure the internal buffer is created */
-  if (!self->priv->text) {
-    update_internal_text(self, "");
+/* Loads the whole page, used the first time and whenever the template
+ * changes. Each block is preceded by a marker so it can be replaced later. */
+static void
+markdown_viewer_load_page(MarkdownViewer *self)
+{
+  static const gchar *base_uri = "file://.";
+  GString *body;
+  gchar *html;
+  guint i;
+
+  body = g_string_new(NULL);
+  for (i = 0; i < self->priv->blocks->len; i++) {
+    g_string_append(body, "<!--" MD_BLOCK_MARK "-->");
+    g_string_append(body, g_ptr_array_index(self->priv->blocks, i));
+  }
+  g_string_append(body, "<!--" MD_END_MARK "-->");
+
+  html = template_replace(self, body->str);
+  g_string_free(body, TRUE);
+
+  /* Keep the position of the page that is shown, not that of one still
+   * loading. */
+  if (self->priv->page_loaded) {
+    push_scroll_pos(self);
+  }
+  self->priv->page_loaded = FALSE;
+  self->priv->page_loading = TRUE;
+  self->priv->reload_needed = FALSE;
+
+  /* Connect a signal handler (only needed once) to restore the scroll
+   * position once the webview is reloaded. */
+  if (self->priv->load_handle == 0) {
+    self->priv->load_handle =
+      g_signal_connect_swapped(WEBKIT_WEB_VIEW(self), "notify::load-status",
+        G_CALLBACK(on_webview_load_status_notify), self);
   }
+  if (self->priv->status_handle == 0) {
+    self->priv->status_handle =
+      g_signal_connect(WEBKIT_WEB_VIEW(self), "status-bar-text-changed",
+        G_CALLBACK(on_webview_status_bar_text_changed), self);
+  }
+
+  webkit_web_view_load_string(WEBKIT_WEB_VIEW(self), html, "text/html",
+    self->priv->enc, base_uri);
+
+  g_free(html);
+}
+
+static gboolean
+html_block_equal(GPtrArray *blocks1, GArray *hashes1, guint i,
+  GPtrArray *blocks2, GArray *hashes2, guint j)
+{
+  return g_array_index(hashes1, guint, i) == g_array_index(hashes2, guint, j) &&
+    strcmp(g_ptr_array_index(blocks1, i), g_ptr_array_index(blocks2, j)) == 0;
+}
+
+/* Replaces the blocks shown with new ones. Only the range between the
+ * unchanged leading and trailing blocks is sent to the page, which is
+ * usually just the block being edited, so the page isn't reloaded and
+ * keeps its scroll position. */
+static void
+markdown_viewer_set_blocks(MarkdownViewer *self, GPtrArray *blocks, GArray *hashes)
+{
+  GPtrArray *old_blocks = self->priv->blocks;
+  GArray *old_hashes = self->priv->hashes;
+
+  self->priv->blocks = blocks;
+  self->priv->hashes = hashes;
 
-  md_as_html = mkd_compile_document(self->priv->text->str, 0);
-  if (md_as_html) {
-    html = template_replace(self, md_as_html);
-    g_free(md_as_html);
+  if (!old_blocks || !self->priv->page_loaded || self->priv->reload_needed) {
+    markdown_viewer_load_page(self);
+  } else {
+    guint old_len = old_blocks->len, new_len = blocks->len;
+    guint prefix = 0, suffix = 0;
+
+    while (prefix < old_len && prefix < new_len &&
+           html_block_equal(old_blocks, old_hashes, prefix, blocks, hashes, prefix)) {
+      prefix++;
+    }
+    while (suffix < old_len - prefix && suffix < new_len - prefix &&
+           html_block_equal(old_blocks, old_hashes, old_len - suffix - 1,
+             blocks, hashes, new_len - suffix - 1)) {
+      suffix++;
+    }
+
+    if (prefix + suffix < old_len || prefix + suffix < new_len) {
+      GString *script;
+      guint i;
+
+      /* Finds the block markers, removes the nodes of the changed blocks
+       * and parses the new ones in their place, each after its marker. */
+      script = g_string_new("(function() {var h = [");
+      for (i = prefix; i < new_len - suffix; i++) {
+        if (i > prefix) {
+          g_string_append_c(script, ',');
+        }
+        append_js_string(script, g_ptr_array_index(blocks, i));
+      }
+      g_string_append_printf(script, "], m = [], w, n, r, d, i;"
+        "w = document.createTreeWalker(document, NodeFilter.SHOW_COMMENT, null, false);"
+        "while ((n = w.nextNode())) {"
+        "if (n.data == \"" MD_BLOCK_MARK "\" || n.data == \"" MD_END_MARK "\") m.push(n);"
+        "}"
+        "if (m.length != %u) {"
+        "window.status = \"" MD_RELOAD_STATUS "\";"
+        "window.status = \"\";"
+        "return;"
+        "}"
+        "for (i = %u; i < %u; i++) {"
+        "for (n = m[i]; n && n != m[i + 1]; n = r) {"
+        "r = n.nextSibling;"
+        "n.parentNode.removeChild(n);"
+        "}}"
+        "r = m[%u];"
+        "for (i = 0; i < h.length; i++) {"
+        "d = document.createElement(\"div\");"
+        "d.innerHTML = \"<!--" MD_BLOCK_MARK "-->\" + h[i];"
+        "while (d.firstChild) r.parentNode.insertBefore(d.firstChild, r);"
+        "}})();", old_len + 1, prefix, old_len - suffix, old_len - suffix);
+
+      webkit_web_view_execute_script(WEBKIT_WEB_VIEW(self), script->str);
+      g_string_free(script, TRUE);
+
+      /* The page doesn't hold our blocks anymore, show them again. */
+      if (!self->priv->page_loaded) {
+        markdown_viewer_load_page(self);
+      }
+    }
   }
 
-  return html;
+  free_html_blocks(old_blocks);
+  if (old_hashes) {
+    g_array_free(old_hashes, TRUE);
+  }
 }
 
+static void markdown_viewer_start_render(MarkdownViewer *self);
+
 static gboolean
-markdown_viewer_update_view(MarkdownViewer *self)
+on_render_finished(MarkdownRenderJob *job)
 {
-  gchar *html = markdown_viewer_get_html(self);
+  MarkdownViewer *self = job->viewer;
 
-  push_scroll_pos(self);
+  if (self) {
+    self->priv->job = NULL;
 
-  if (html) {
-    static const gchar *base_uri = "file://.";
+    markdown_viewer_set_blocks(self, job->blocks, job->hashes);
+    job->blocks = NULL;
+    job->hashes = NULL;
 
-    /* Connect a signal handler (only needed once) to restore the scroll
-     * position once the webview is reloaded. */
-    if (self->priv->load_handle == 0) {
-      self->priv->load_handle =
-        g_signal_connect_swapped(WEBKIT_WEB_VIEW(self), "notify::load-status",
-          G_CALLBACK(on_webview_load_status_notify), self);
+    /* The text changed while compiling, go again with the new snapshot. */
+    if (self->priv->render_queued) {
+      self->priv->render_queued = FALSE;
+      markdown_viewer_start_render(self);
     }
+  }
 
-    webkit_web_view_load_string(WEBKIT_WEB_VIEW(self), html, "text/html",
-      self->priv->enc, base_uri);
+  g_free(job->text);
+  free_html_blocks(job->blocks);
+  if (job->hashes) {
+    g_array_free(job->hashes, TRUE);
+  }
+  g_slice_free(MarkdownRenderJob, job);
+
+  return FALSE;
+}
+
+static void
+render_job_run(MarkdownRenderJob *job)
+{
+  gchar *html;
+  guint i;
 
-    g_free(html);
+  html = mkd_compile_document(job->text, 0);
+  job->blocks = split_html_blocks(html ? html : "");
+  g_free(html);
+
+  job->hashes = g_array_sized_new(FALSE, FALSE, sizeof(guint), job->blocks->len);
+  for (i = 0; i < job->blocks->len; i++) {
+    guint hash = g_str_hash(g_ptr_array_index(job->blocks, i));
+    g_array_append_val(job->hashes, hash);
   }
+}
 
-  if (self->priv->update_handle != 0) {
-    g_source_remove(self->priv->update_handle);
+static gpointer
+render_thread(MarkdownRenderJob *job)
+{
+  render_job_run(job);
+  g_idle_add((GSourceFunc) on_render_finished, job);
+  return NULL;
+}
+
+static void
+markdown_viewer_start_render(MarkdownViewer *self)
+{
+  MarkdownRenderJob *job;
+  GError *error = NULL;
+
+  job = g_slice_new0(MarkdownRenderJob);
+  job->viewer = self;
+  job->text = g_strdup(self->priv->text ? self->priv->text->str : "");
+  self->priv->job = job;
+
+  if (!g_thread_create((GThreadFunc) render_thread, job, FALSE, &error)) {
+    g_warning("Unable to create Markdown render thread: %s", error->message);
+    g_error_free(error); error = NULL;
+    render_job_run(job);
+    on_render_finished(job);
   }
+}
+
+static gboolean
+markdown_viewer_update_view(MarkdownViewer *self)
+{
   self->priv->update_handle = 0;
 
+  /* Only one compilation runs at a time (discount keeps some global
+   * state), any update requested meanwhile is picked up once it finishes. */
+  if (self->priv->job) {
+    self->priv->render_queued = TRUE;
+  } else {
+    markdown_viewer_start_render(self);
+  }
+
   return FALSE; /* When used as an idle handler, says to remove the source */
 }
 
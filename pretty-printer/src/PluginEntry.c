@@ -43,10 +43,23 @@ PLUGIN_KEY_GROUP(prettyprinter, 1)
 
 static GtkWidget* main_menu_item = NULL; /*the main menu of the plugin*/
 
+/* the formatted XML, indented at the level of the selection */
+typedef struct
+{
+    GString* text;
+    const char* indentation; /* put after each line break */
+    char lineBreak; /* last char of the line breaks */
+}
+FormattingOutput;
+
 /* declaration of the functions */
 static void xml_format(GtkMenuItem *menuitem, gpointer gdata);
 static void kb_run_xml_pretty_print(G_GNUC_UNUSED guint key_id);
 static void config_closed(GtkWidget* configWidget, gint response, gpointer data);
+static bool append_to_output(const char* data, int length, void* userData);
+static bool is_valid_xml(const char* buffer, int length);
+static bool get_selected_range(ScintillaObject* sco, int* start, int* end, char** indentation, bool* indentFirstLine);
+static void apply_formatting(ScintillaObject* sco, int start, int end, const char* text, int length);
 
 void plugin_init(GeanyData *data);
 void plugin_cleanup(void);
@@ -115,9 +128,14 @@ void xml_format(GtkMenuItem* menuitem, gpointer gdata)
     GeanyDocument* doc = document_get_current();
     GeanyEditor* editor;
     ScintillaObject* sco;
-    int length;
-    char* buffer;
-    xmlDoc* parsedDocument;
+    int start;
+    int end;
+    const char* buffer;
+    char* indentation;
+    bool indentFirstLine;
+    bool wholeDocument;
+    FormattingOutput output;
+    PrettyPrintingOptions options;
     int result;
     int xOffset;
     GeanyFiletype* fileType;
@@ -130,44 +148,146 @@ void xml_format(GtkMenuItem* menuitem, gpointer gdata)
     /* default printing options */
     if (prettyPrintingOptions == NULL) { prettyPrintingOptions = createDefaultPrettyPrintingOptions(); }
 
-    /* prepare the buffer that will contain the text
-     * from the scintilla object */
-    length = sci_get_length(sco)+1;
-    buffer = (char*)malloc(length*sizeof(char));
-    if (buffer == NULL) { exit(-1); } /* malloc error */
-
-    /* retrieves the text */
-    sci_get_text(sco, length, buffer);
+    /* formats the selected XML if any, otherwise the whole document */
+    wholeDocument = !sci_has_selection(sco);
+    if (wholeDocument)
+    {
+        start = 0;
+        end = sci_get_length(sco);
+        indentation = g_strdup("");
+        indentFirstLine = FALSE;
+    }
+    else if (!get_selected_range(sco, &start, &end, &indentation, &indentFirstLine))
+    {
+        return; /* only whites are selected */
+    }
 
-    /* checks if the data is an XML format */
-    parsedDocument = xmlParseDoc((unsigned char*)buffer);
+    /* reads the text directly from the scintilla object,
+     * it is not modified before the end of the formatting */
+    buffer = (const char*)scintilla_send_message(sco, SCI_GETCHARACTERPOINTER, 0, 0);
 
     /* this is not a valid xml => exit with an error message */
-    if(parsedDocument == NULL)
+    if (!is_valid_xml(buffer+start, end-start))
     {
-        dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Unable to parse the content as XML."));
+        g_free(indentation);
+        if (wholeDocument) { dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Unable to parse the content as XML.")); }
+        else { dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Unable to parse the selection as XML.")); }
         return;
     }
 
-    /* free all */
-    xmlFreeDoc(parsedDocument);
+    /* a selection is formatted with the line breaks of the rest of the document */
+    options = *prettyPrintingOptions;
+    if (!wholeDocument) { options.newLineChars = editor_get_eol_char(editor); }
 
     /* process pretty-printing */
-    result = processXMLPrettyPrinting(&buffer, &length, prettyPrintingOptions);
+    output.text = g_string_sized_new(end-start);
+    output.indentation = indentation;
+    output.lineBreak = options.newLineChars[strlen(options.newLineChars)-1];
+    if (indentFirstLine) { g_string_append(output.text, indentation); }
+    result = processXMLPrettyPrintingStream(buffer+start, end-start, &options, append_to_output, &output);
     if (result != PRETTY_PRINTING_SUCCESS)
     {
+        g_string_free(output.text, TRUE);
+        g_free(indentation);
         dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Unable to process PrettyPrinting on the specified XML because some features are not supported.\n\nSee Help > Debug messages for more details..."));
         return;
     }
 
     /* updates the document */
-    sci_set_text(sco, buffer);
+    apply_formatting(sco, start, end, output.text->str, output.text->len);
+    g_string_free(output.text, TRUE);
+    g_free(indentation);
 
     /* set the line */
     xOffset = scintilla_send_message(sco, SCI_GETXOFFSET, 0, 0);
     scintilla_send_message(sco, SCI_LINESCROLL, -xOffset, 0); /* TODO update with the right function-call for geany-0.19 */
 
     /* sets the type */
-    fileType = filetypes_index(GEANY_FILETYPES_XML);
-    document_set_filetype(doc, fileType);
+    if (wholeDocument)
+    {
+        fileType = filetypes_index(GEANY_FILETYPES_XML);
+        document_set_filetype(doc, fileType);
+    }
+}
+
+/*========================================== FORMATTING ==================================================================*/
+
+bool append_to_output(const char* data, int length, void* userData)
+{
+    FormattingOutput* output = (FormattingOutput*)userData;
+    const char* end = data+length;
+    const char* lineEnd;
+
+    /* indents each new line */
+    while (output->indentation[0] != '\0' &&
+           (lineEnd = memchr(data, output->lineBreak, end-data)) != NULL)
+    {
+        g_string_append_len(output->text, data, lineEnd+1-data);
+        g_string_append(output->text, output->indentation);
+        data = lineEnd+1;
+    }
+    g_string_append_len(output->text, data, end-data);
+
+    return TRUE;
+}
+
+bool is_valid_xml(const char* buffer, int length)
+{
+    /* only checks the content, without building the whole tree */
+    xmlTextReaderPtr reader = xmlReaderForMemory(buffer, length, NULL, NULL, 0);
+    int status;
+
+    if (reader == NULL) { return FALSE; }
+    do { status = xmlTextReaderRead(reader); } while (status == 1);
+    xmlFreeTextReader(reader);
+
+    return status == 0;
+}
+
+bool get_selected_range(ScintillaObject* sco, int* start, int* end, char** indentation, bool* indentFirstLine)
+{
+    int line;
+    int lineStart;
+    int indentEnd;
+
+    /* the whites around the selected XML are left untouched */
+    *start = sci_get_selection_start(sco);
+    *end = sci_get_selection_end(sco);
+    while (*start < *end && g_ascii_isspace(sci_get_char_at(sco, *start))) { ++*start; }
+    while (*end > *start && g_ascii_isspace(sci_get_char_at(sco, *end-1))) { --*end; }
+    if (*start == *end) { return FALSE; }
+
+    /* the formatted lines get the indentation of the first one */
+    line = sci_get_line_from_position(sco, *start);
+    lineStart = sci_get_position_from_line(sco, line);
+    indentEnd = scintilla_send_message(sco, SCI_GETLINEINDENTPOSITION, line, 0);
+    *indentation = sci_get_contents_range(sco, lineStart, indentEnd);
+
+    /* if the XML begins the line, the line is formatted from its beginning */
+    *indentFirstLine = (*start == indentEnd);
+    if (*indentFirstLine) { *start = lineStart; }
+
+    return TRUE;
+}
+
+void apply_formatting(ScintillaObject* sco, int start, int end, const char* text, int length)
+{
+    /* only the changed parts are replaced, so the markers, folds and styles of the rest are kept */
+    const char* oldText = (const char*)scintilla_send_message(sco, SCI_GETCHARACTERPOINTER, 0, 0);
+    GArray* hunks = computeTextDiff(oldText+start, end-start, text, length);
+    guint i;
+
+    sci_start_undo_action(sco);
+
+    /* from the end, so that the offsets of the previous changes are still valid */
+    for (i=hunks->len ; i>0 ; --i)
+    {
+        TextDiffHunk* hunk = &g_array_index(hunks, TextDiffHunk, i-1);
+        scintilla_send_message(sco, SCI_SETTARGETSTART, start+hunk->oldStart, 0);
+        scintilla_send_message(sco, SCI_SETTARGETEND, start+hunk->oldStart+hunk->oldLength, 0);
+        scintilla_send_message(sco, SCI_REPLACETARGET, hunk->newLength, (sptr_t)(text+hunk->newStart));
+    }
+
+    sci_end_undo_action(sco);
+    g_array_free(hunks, TRUE);
 }
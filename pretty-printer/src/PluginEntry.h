@@ -31,8 +31,10 @@
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include "PrettyPrinter.h"
 #include "ConfigUI.h"
+#include "TextDiff.h"
 
 /*========================================== PROPERTIES ========================================================*/
 
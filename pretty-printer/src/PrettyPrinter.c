@@ -16,70 +16,95 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <limits.h>
+
 #include "PrettyPrinter.h"
 
+#ifdef HAVE_GLIB
+# if !GLIB_CHECK_VERSION(2, 22, 0)
+#  define g_mapped_file_unref g_mapped_file_free
+# endif
+#endif
+
+/*======================= DEFINES ======================================================================*/
+
+#define PP_OUTPUT_CHUNK_SIZE 65536                               /* size from which the output is given to the writer */
+#define PP_OUTPUT_KEEP 16                                        /* number of chars kept in the output after a write (some of them are looked back) */
+
+/*============================================ PRIVATE PROPERTIES ======================================*/
+
+/* those are variables that are shared by the functions and
+ * shouldn't be altered. Each pretty-printing has its own context,
+ * so several XML can be processed at the same time. */
+
+typedef struct
+{
+    int result;                                                   /* result of the pretty printing */
+    char* xmlPrettyPrinted;                                       /* new buffer for the formatted XML */
+    int xmlPrettyPrintedLength;                                   /* buffer size */
+    int xmlPrettyPrintedIndex;                                    /* buffer index (position of the next char to insert) */
+    const char* inputBuffer;                                      /* input buffer */
+    int inputBufferLength;                                        /* input buffer size */
+    int inputBufferIndex;                                         /* input buffer index (position of the next char to read into the input string) */
+    int currentDepth;                                             /* current depth (for indentation) */
+    char* currentNodeName;                                        /* current node name */
+    bool appendIndentation;                                       /* if the indentation must be added (with a line break before) */
+    bool lastNodeOpen;                                            /* defines if the last action was a not opening or not */
+    PrettyPrintingOptions* options;                               /* options of PrettyPrinting */
+    PrettyPrintingWriter writer;                                  /* receives the formatted XML by chunks (NULL to keep it all in the buffer) */
+    void* writerData;                                             /* data given to the writer */
+}
+PrettyPrintingContext;
+
 /*======================= FUNCTIONS ====================================================================*/
 
 /* error reporting functions */
 static void PP_ERROR(const char* fmt, ...) G_GNUC_PRINTF(1,2);  /* prints an error message */
 
 /* xml pretty printing functions */
-static void putCharInBuffer(char charToAdd);                     /* put a char into the new char buffer */
-static void putCharsInBuffer(const char* charsToAdd);            /* put the chars into the new char buffer */
-static void putNextCharsInBuffer(int nbChars);                   /* put the next nbChars of the input buffer into the new buffer */
-static int readWhites(bool considerLineBreakAsWhite);            /* read the next whites into the input buffer */
-static char readNextChar(void);                                  /* read the next char into the input buffer; */
-static char getNextChar(void);                                   /* returns the next char but do not increase the input buffer index (use readNextChar for that) */
-static char getPreviousInsertedChar(void);                       /* returns the last inserted char into the new buffer */
+static int prettyPrint(PrettyPrintingContext* ctx, const char* xml, int length, PrettyPrintingOptions* ppOptions, int outputLength); /* process the pretty-printing into the output buffer of the context */
+static bool ensureBufferSize(PrettyPrintingContext* ctx, int nbChars); /* ensure that nbChars can be put into the new char buffer */
+static void flushBuffer(PrettyPrintingContext* ctx, bool lastChunk); /* give the formatted chars to the writer (if any) */
+static void putCharInBuffer(PrettyPrintingContext* ctx, char charToAdd); /* put a char into the new char buffer */
+static void putCharsInBuffer(PrettyPrintingContext* ctx, const char* charsToAdd); /* put the chars into the new char buffer */
+static void putNextCharsInBuffer(PrettyPrintingContext* ctx, int nbChars); /* put the next nbChars of the input buffer into the new buffer */
+static int countCharsUntil(PrettyPrintingContext* ctx, const char* stopChars); /* count the next chars of the input buffer that are not one of stopChars */
+static int readWhites(PrettyPrintingContext* ctx, bool considerLineBreakAsWhite); /* read the next whites into the input buffer */
+static char readNextChar(PrettyPrintingContext* ctx);           /* read the next char into the input buffer; */
+static char getNextChar(PrettyPrintingContext* ctx);            /* returns the next char but do not increase the input buffer index (use readNextChar for that) */
+static char getCharAt(PrettyPrintingContext* ctx, int index);   /* returns the char at index into the input buffer ('\0' if out of it) */
+static char getPreviousInsertedChar(PrettyPrintingContext* ctx); /* returns the last inserted char into the new buffer */
 static bool isWhite(char c);                                     /* check if the specified char is a white */
 static bool isSpace(char c);                                     /* check if the specified char is a space */
 static bool isLineBreak(char c);                                 /* check if the specified char is a new line */
 static bool isQuote(char c);                                     /* check if the specified char is a quote (simple or double) */
-static int putNewLine(void);                                     /* put a new line into the new char buffer with the correct number of whites (indentation) */
-static bool isInlineNodeAllowed(void);                           /* check if it is possible to have an inline node */
-static bool isOnSingleLine(int skip, char stop1, char stop2);    /* check if the current node data is on one line (for inlining) */
-static void resetBackwardIndentation(bool resetLineBreak);       /* reset the indentation for the current depth (just reset the index in fact) */
-                                                             
+static int putNewLine(PrettyPrintingContext* ctx);              /* put a new line into the new char buffer with the correct number of whites (indentation) */
+static bool isInlineNodeAllowed(PrettyPrintingContext* ctx);    /* check if it is possible to have an inline node */
+static bool isOnSingleLine(PrettyPrintingContext* ctx, int skip, char stop1, char stop2); /* check if the current node data is on one line (for inlining) */
+static void resetBackwardIndentation(PrettyPrintingContext* ctx, bool resetLineBreak); /* reset the indentation for the current depth (just reset the index in fact) */
+
 /* specific parsing functions */
-static int processElements(void);                                /* returns the number of elements processed */
-static void processElementAttribute(void);                       /* process on attribute of a node */
-static void processElementAttributes(void);                      /* process all the attributes of a node */
-static void processHeader(void);                                 /* process the header <?xml version="..." ?> */
-static void processNode(void);                                   /* process an XML node */
-static void processTextNode(void);                               /* process a text node */
-static void processComment(void);                                /* process a comment */
-static void processCDATA(void);                                  /* process a CDATA node */
-static void processDoctype(void);                                /* process a DOCTYPE node */
-static void processDoctypeElement(void);                         /* process a DOCTYPE ELEMENT node */
+static int processElements(PrettyPrintingContext* ctx);         /* returns the number of elements processed */
+static void processElementAttribute(PrettyPrintingContext* ctx); /* process on attribute of a node */
+static void processElementAttributes(PrettyPrintingContext* ctx); /* process all the attributes of a node */
+static void processHeader(PrettyPrintingContext* ctx);          /* process the header <?xml version="..." ?> */
+static void processNode(PrettyPrintingContext* ctx);            /* process an XML node */
+static void processTextNode(PrettyPrintingContext* ctx);        /* process a text node */
+static void processComment(PrettyPrintingContext* ctx);         /* process a comment */
+static void processCDATA(PrettyPrintingContext* ctx);           /* process a CDATA node */
+static void processDoctype(PrettyPrintingContext* ctx);         /* process a DOCTYPE node */
+static void processDoctypeElement(PrettyPrintingContext* ctx);  /* process a DOCTYPE ELEMENT node */
 
 /* debug function */
-static void printError(const char *msg, ...) G_GNUC_PRINTF(1,2); /* just print a message like the printf method */
-static void printDebugStatus(void);                              /* just print some variables into the console for debugging */
-
-/*============================================ PRIVATE PROPERTIES ======================================*/
-
-/* those are variables that are shared by the functions and
- * shouldn't be altered. */
-
-static int result;                                                /* result of the pretty printing */
-static char* xmlPrettyPrinted;                                    /* new buffer for the formatted XML */
-static int xmlPrettyPrintedLength;                                /* buffer size */
-static int xmlPrettyPrintedIndex;                                 /* buffer index (position of the next char to insert) */
-static char* inputBuffer;                                         /* input buffer */
-static int inputBufferLength;                                     /* input buffer size */
-static int inputBufferIndex;                                      /* input buffer index (position of the next char to read into the input string) */
-static int currentDepth;                                          /* current depth (for indentation) */
-static char* currentNodeName;                                     /* current node name */
-static bool appendIndentation;                                /* if the indentation must be added (with a line break before) */
-static bool lastNodeOpen;                                     /* defines if the last action was a not opening or not */
-static PrettyPrintingOptions* options;                            /* options of PrettyPrinting */
+static void printError(PrettyPrintingContext* ctx, const char *msg, ...) G_GNUC_PRINTF(2,3); /* just print a message like the printf method */
+static void printDebugStatus(PrettyPrintingContext* ctx);       /* just print some variables into the console for debugging */
 
 /*============================================ GENERAL FUNCTIONS =======================================*/
 
 static void PP_ERROR(const char* fmt, ...)
 {
     va_list va;
-    
+
     va_start(va, fmt);
     vfprintf(stderr, fmt, va);
     putc('\n', stderr);
@@ -88,86 +113,111 @@ static void PP_ERROR(const char* fmt, ...)
 
 int processXMLPrettyPrinting(char** buffer, int* length, PrettyPrintingOptions* ppOptions)
 {
-    bool freeOptions;
+    PrettyPrintingContext context;
+    PrettyPrintingContext* ctx = &context;
     char* reallocated;
-    
+
     /* empty buffer, nothing to process */
     if (*length == 0) { return PRETTY_PRINTING_EMPTY_XML; }
     if (buffer == NULL || *buffer == NULL) { return PRETTY_PRINTING_EMPTY_XML; }
-    
-    /* initialize the variables */
-    result = PRETTY_PRINTING_SUCCESS;
-    freeOptions = FALSE;
-    if (ppOptions == NULL) 
-    { 
-        ppOptions = createDefaultPrettyPrintingOptions(); 
-        freeOptions = TRUE; 
+
+    /* process the pretty-printing, the whole result is kept in the buffer */
+    ctx->writer = NULL;
+    ctx->writerData = NULL;
+    if (prettyPrint(ctx, *buffer, *length, ppOptions, *length) == PRETTY_PRINTING_SYSTEM_ERROR &&
+        ctx->xmlPrettyPrinted == NULL)
+    {
+        return PRETTY_PRINTING_SYSTEM_ERROR;
     }
-    
-    options = ppOptions;
-    currentNodeName = NULL;
-    appendIndentation = FALSE;
-    lastNodeOpen = FALSE;
-    xmlPrettyPrintedIndex = 0;
-    inputBufferIndex = 0;
-    currentDepth = -1;
-    
-    inputBuffer = *buffer;
-    inputBufferLength = *length;
-    
-    xmlPrettyPrintedLength = *length;
-    xmlPrettyPrinted = (char*)malloc(sizeof(char)*(*length));
-    if (xmlPrettyPrinted == NULL) { PP_ERROR("Allocation error (initialisation)"); return PRETTY_PRINTING_SYSTEM_ERROR; }
-    
-    /* go to the first char */
-    readWhites(TRUE);
-
-    /* process the pretty-printing */
-    processElements();
-    
+
     /* close the buffer */
-    putCharInBuffer('\0');
-    
+    putCharInBuffer(ctx, '\0');
+
     /* adjust the final size */
-    reallocated = (char*)realloc(xmlPrettyPrinted, xmlPrettyPrintedIndex); 
-    if (reallocated == NULL) { PP_ERROR("Allocation error (reallocation size is %d)", xmlPrettyPrintedIndex); return PRETTY_PRINTING_SYSTEM_ERROR; }
-    xmlPrettyPrinted = reallocated;
-    
-    /* freeing the unused values */
-    if (freeOptions) { free(options); }
-    
+    reallocated = (char*)realloc(ctx->xmlPrettyPrinted, ctx->xmlPrettyPrintedIndex);
+    if (reallocated == NULL) { PP_ERROR("Allocation error (reallocation size is %d)", ctx->xmlPrettyPrintedIndex); return PRETTY_PRINTING_SYSTEM_ERROR; }
+    ctx->xmlPrettyPrinted = reallocated;
+
     /* if success, then update the values */
-    if (result == PRETTY_PRINTING_SUCCESS)
+    if (ctx->result == PRETTY_PRINTING_SUCCESS)
     {
         free(*buffer);
-        *buffer = xmlPrettyPrinted;
-        *length = xmlPrettyPrintedIndex-2; /* the '\0' is not in the length */
+        *buffer = ctx->xmlPrettyPrinted;
+        *length = ctx->xmlPrettyPrintedIndex-2; /* the '\0' is not in the length */
     }
     /* else clean the other values */
     else
     {
-        free(xmlPrettyPrinted);
+        free(ctx->xmlPrettyPrinted);
     }
-    
-    /* updating the pointers for the using into the caller function */
-    xmlPrettyPrinted = NULL; /* avoid reference */
-    inputBuffer = NULL; /* avoid reference */
-    currentNodeName = NULL; /* avoid reference */
-    options = NULL; /* avoid reference */
-    
+
     /* and finally the result */
+    return ctx->result;
+}
+
+int processXMLPrettyPrintingStream(const char* xml, int length, PrettyPrintingOptions* ppOptions, PrettyPrintingWriter writer, void* userData)
+{
+    PrettyPrintingContext context;
+    PrettyPrintingContext* ctx = &context;
+
+    /* empty buffer, nothing to process */
+    if (xml == NULL || length == 0) { return PRETTY_PRINTING_EMPTY_XML; }
+    if (writer == NULL) { PP_ERROR("No writer for the formatted XML"); return PRETTY_PRINTING_SYSTEM_ERROR; }
+
+    /* process the pretty-printing, the output only holds the chunk being formatted */
+    ctx->writer = writer;
+    ctx->writerData = userData;
+    prettyPrint(ctx, xml, length, ppOptions, PP_OUTPUT_CHUNK_SIZE*2);
+
+    /* write the end of the XML */
+    flushBuffer(ctx, TRUE);
+    free(ctx->xmlPrettyPrinted);
+
+    return ctx->result;
+}
+
+#ifdef HAVE_GLIB
+int processXMLPrettyPrintingFile(const char* fileName, PrettyPrintingOptions* ppOptions, PrettyPrintingWriter writer, void* userData)
+{
+    GMappedFile* file;
+    GError* error = NULL;
+    gsize length;
+    int result;
+
+    file = g_mapped_file_new(fileName, FALSE, &error);
+    if (file == NULL)
+    {
+        PP_ERROR("Unable to map the file %s (%s)", fileName, error->message);
+        g_error_free(error);
+        return PRETTY_PRINTING_SYSTEM_ERROR;
+    }
+
+    /* the indexes are stored as int */
+    length = g_mapped_file_get_length(file);
+    if (length > INT_MAX)
+    {
+        PP_ERROR("The file %s is too big (%lu bytes)", fileName, (unsigned long)length);
+        result = PRETTY_PRINTING_SYSTEM_ERROR;
+    }
+    else
+    {
+        result = processXMLPrettyPrintingStream(g_mapped_file_get_contents(file), length, ppOptions, writer, userData);
+    }
+
+    g_mapped_file_unref(file);
     return result;
 }
+#endif
 
 PrettyPrintingOptions* createDefaultPrettyPrintingOptions(void)
 {
     PrettyPrintingOptions* defaultOptions = (PrettyPrintingOptions*)malloc(sizeof(PrettyPrintingOptions));
-    if (defaultOptions == NULL) 
-    { 
+    if (defaultOptions == NULL)
+    {
         PP_ERROR("Unable to allocate memory for PrettyPrintingOptions");
         return NULL;
     }
-    
+
     defaultOptions->newLineChars = "\r\n";
     defaultOptions->indentChar = ' ';
     defaultOptions->indentLength = 2;
@@ -185,90 +235,213 @@ PrettyPrintingOptions* createDefaultPrettyPrintingOptions(void)
     defaultOptions->alignComment = TRUE;
     defaultOptions->alignText = TRUE;
     defaultOptions->alignCdata = TRUE;
-    
+
     return defaultOptions;
 }
 
-void putNextCharsInBuffer(int nbChars)
+int prettyPrint(PrettyPrintingContext* ctx, const char* xml, int length, PrettyPrintingOptions* ppOptions, int outputLength)
 {
-    int i;
-    for (i=0 ; i<nbChars ; ++i)
+    bool freeOptions;
+
+    /* initialize the variables */
+    ctx->result = PRETTY_PRINTING_SUCCESS;
+    freeOptions = FALSE;
+    if (ppOptions == NULL)
+    {
+        ppOptions = createDefaultPrettyPrintingOptions();
+        freeOptions = TRUE;
+    }
+
+    ctx->options = ppOptions;
+    ctx->currentNodeName = NULL;
+    ctx->appendIndentation = FALSE;
+    ctx->lastNodeOpen = FALSE;
+    ctx->xmlPrettyPrintedIndex = 0;
+    ctx->inputBufferIndex = 0;
+    ctx->currentDepth = -1;
+
+    ctx->inputBuffer = xml;
+    ctx->inputBufferLength = length;
+
+    ctx->xmlPrettyPrintedLength = outputLength;
+    ctx->xmlPrettyPrinted = (char*)malloc(sizeof(char)*outputLength);
+    if (ctx->xmlPrettyPrinted == NULL)
+    {
+        PP_ERROR("Allocation error (initialisation)");
+        ctx->result = PRETTY_PRINTING_SYSTEM_ERROR;
+    }
+    else
     {
-        char c = readNextChar();
-        putCharInBuffer(c);
+        /* go to the first char */
+        readWhites(ctx, TRUE);
+
+        /* process the pretty-printing */
+        processElements(ctx);
     }
+
+    /* freeing the unused values */
+    if (freeOptions) { free(ctx->options); }
+
+    /* updating the pointers, the output buffer is left to the caller */
+    ctx->inputBuffer = NULL; /* avoid reference */
+    ctx->currentNodeName = NULL; /* avoid reference */
+    ctx->options = NULL; /* avoid reference */
+
+    return ctx->result;
 }
 
-void putCharInBuffer(char charToAdd)
+bool ensureBufferSize(PrettyPrintingContext* ctx, int nbChars)
 {
     /* check if the buffer is full and reallocation if needed */
-    if (xmlPrettyPrintedIndex >= xmlPrettyPrintedLength)
+    if (ctx->xmlPrettyPrintedIndex+nbChars > ctx->xmlPrettyPrintedLength)
     {
         char* reallocated;
-        
-        if (charToAdd == '\0') { ++xmlPrettyPrintedLength; }
-        else { xmlPrettyPrintedLength += inputBufferLength; }
-        reallocated = (char*)realloc(xmlPrettyPrinted, xmlPrettyPrintedLength);
-        if (reallocated == NULL) { PP_ERROR("Allocation error (char was %c)", charToAdd); return; }
-        xmlPrettyPrinted = reallocated;
+        int newLength = ctx->xmlPrettyPrintedLength*2;
+
+        if (newLength < ctx->xmlPrettyPrintedIndex+nbChars) { newLength = ctx->xmlPrettyPrintedIndex+nbChars; }
+        reallocated = (char*)realloc(ctx->xmlPrettyPrinted, newLength);
+        if (reallocated == NULL)
+        {
+            PP_ERROR("Allocation error (reallocation size is %d)", newLength);
+            ctx->result = PRETTY_PRINTING_SYSTEM_ERROR;
+            return FALSE;
+        }
+        ctx->xmlPrettyPrinted = reallocated;
+        ctx->xmlPrettyPrintedLength = newLength;
     }
-    
-    /* putting the char and increase the index for the next one */
-    xmlPrettyPrinted[xmlPrettyPrintedIndex] = charToAdd;
-    ++xmlPrettyPrintedIndex;
+
+    return TRUE;
 }
 
-void putCharsInBuffer(const char* charsToAdd)
+void flushBuffer(PrettyPrintingContext* ctx, bool lastChunk)
 {
-    int currentIndex = 0;
-    while (charsToAdd[currentIndex] != '\0')
+    int length;
+
+    /* without writer, the whole XML stays into the buffer */
+    if (ctx->writer == NULL || ctx->result != PRETTY_PRINTING_SUCCESS) { return; }
+    if (!lastChunk && ctx->xmlPrettyPrintedIndex < PP_OUTPUT_CHUNK_SIZE) { return; }
+
+    /* the last chars are kept because they may still be read or replaced */
+    length = ctx->xmlPrettyPrintedIndex;
+    if (!lastChunk) { length -= PP_OUTPUT_KEEP; }
+
+    if (!ctx->writer(ctx->xmlPrettyPrinted, length, ctx->writerData))
     {
-        putCharInBuffer(charsToAdd[currentIndex]);
-        ++currentIndex;
+        PP_ERROR("Unable to write the formatted XML");
+        ctx->result = PRETTY_PRINTING_SYSTEM_ERROR;
+    }
+
+    memmove(ctx->xmlPrettyPrinted, ctx->xmlPrettyPrinted+length, ctx->xmlPrettyPrintedIndex-length);
+    ctx->xmlPrettyPrintedIndex -= length;
+}
+
+void putNextCharsInBuffer(PrettyPrintingContext* ctx, int nbChars)
+{
+    int available = ctx->inputBufferLength-ctx->inputBufferIndex;
+    if (nbChars > available)
+    {
+        /* the XML ends too early */
+        nbChars = available;
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
     }
+
+    if (nbChars <= 0 || !ensureBufferSize(ctx, nbChars)) { return; }
+
+    /* copy the chars at once */
+    memcpy(ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex, ctx->inputBuffer+ctx->inputBufferIndex, nbChars);
+    ctx->xmlPrettyPrintedIndex += nbChars;
+    ctx->inputBufferIndex += nbChars;
 }
 
-char getPreviousInsertedChar(void)
+void putCharInBuffer(PrettyPrintingContext* ctx, char charToAdd)
 {
-    return xmlPrettyPrinted[xmlPrettyPrintedIndex-1];
+    if (!ensureBufferSize(ctx, 1)) { return; }
+
+    /* putting the char and increase the index for the next one */
+    ctx->xmlPrettyPrinted[ctx->xmlPrettyPrintedIndex] = charToAdd;
+    ++ctx->xmlPrettyPrintedIndex;
 }
 
-int putNewLine(void)
+void putCharsInBuffer(PrettyPrintingContext* ctx, const char* charsToAdd)
+{
+    int length = strlen(charsToAdd);
+    if (!ensureBufferSize(ctx, length)) { return; }
+
+    memcpy(ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex, charsToAdd, length);
+    ctx->xmlPrettyPrintedIndex += length;
+}
+
+char getPreviousInsertedChar(PrettyPrintingContext* ctx)
+{
+    return ctx->xmlPrettyPrinted[ctx->xmlPrettyPrintedIndex-1];
+}
+
+int putNewLine(PrettyPrintingContext* ctx)
 {
     int spaces;
-    int i;
-    
-    putCharsInBuffer(options->newLineChars);
-    spaces = currentDepth*options->indentLength;
-    for(i=0 ; i<spaces ; ++i)
+
+    putCharsInBuffer(ctx, ctx->options->newLineChars);
+    spaces = ctx->currentDepth*ctx->options->indentLength;
+    if (spaces > 0 && ensureBufferSize(ctx, spaces))
     {
-        putCharInBuffer(options->indentChar);
+        memset(ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex, ctx->options->indentChar, spaces);
+        ctx->xmlPrettyPrintedIndex += spaces;
     }
-    
+
     return spaces;
 }
 
-char getNextChar(void)
+char getCharAt(PrettyPrintingContext* ctx, int index)
 {
-    return inputBuffer[inputBufferIndex];
+    /* the input buffer is not always NUL-terminated */
+    if (index < 0 || index >= ctx->inputBufferLength) { return '\0'; }
+    return ctx->inputBuffer[index];
 }
 
-char readNextChar(void)
-{   
-    return inputBuffer[inputBufferIndex++];
+char getNextChar(PrettyPrintingContext* ctx)
+{
+    return getCharAt(ctx, ctx->inputBufferIndex);
 }
 
-int readWhites(bool considerLineBreakAsWhite)
+char readNextChar(PrettyPrintingContext* ctx)
+{
+    if (ctx->inputBufferIndex >= ctx->inputBufferLength)
+    {
+        /* the XML ends too early */
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        return '\0';
+    }
+    return ctx->inputBuffer[ctx->inputBufferIndex++];
+}
+
+int countCharsUntil(PrettyPrintingContext* ctx, const char* stopChars)
+{
+    int index;
+    for (index = ctx->inputBufferIndex ; index < ctx->inputBufferLength ; ++index)
+    {
+        char c = ctx->inputBuffer[index];
+        const char* stop;
+
+        /* a '\0' stops too, as in a NUL-terminated input */
+        if (c == '\0') { break; }
+        for (stop = stopChars ; *stop != '\0' && *stop != c ; ++stop) {}
+        if (*stop != '\0') { break; }
+    }
+
+    return index-ctx->inputBufferIndex;
+}
+
+int readWhites(PrettyPrintingContext* ctx, bool considerLineBreakAsWhite)
 {
     int counter = 0;
-    while(isWhite(inputBuffer[inputBufferIndex]) && 
-          (!isLineBreak(inputBuffer[inputBufferIndex]) || 
+    while(isWhite(getNextChar(ctx)) &&
+          (!isLineBreak(getNextChar(ctx)) ||
            considerLineBreakAsWhite))
     {
         ++counter;
-        ++inputBufferIndex;
+        ++ctx->inputBufferIndex;
     }
-    
+
     return counter;
 }
 
@@ -292,68 +465,73 @@ bool isSpace(char c)
 
 bool isLineBreak(char c)
 {
-    return (c == '\n' || 
+    return (c == '\n' ||
             c == '\r');
 }
 
-bool isInlineNodeAllowed(void)
+bool isInlineNodeAllowed(PrettyPrintingContext* ctx)
 {
     int firstChar;
     int secondChar;
     int thirdChar;
     int currentIndex;
     char currentChar;
-    
+
     /* the last action was not an opening => inline not allowed */
-    if (!lastNodeOpen) { return FALSE; }
-    
-    firstChar = getNextChar(); /* should be '<' or we are in a text node */
-    secondChar = inputBuffer[inputBufferIndex+1]; /* should be '!' */
-    thirdChar = inputBuffer[inputBufferIndex+2]; /* should be '-' or '[' */
-    
+    if (!ctx->lastNodeOpen) { return FALSE; }
+
+    firstChar = getNextChar(ctx); /* should be '<' or we are in a text node */
+    secondChar = getCharAt(ctx, ctx->inputBufferIndex+1); /* should be '!' */
+    thirdChar = getCharAt(ctx, ctx->inputBufferIndex+2); /* should be '-' or '[' */
+
     /* loop through the content up to the next opening/closing node */
-    currentIndex = inputBufferIndex+1;
+    currentIndex = ctx->inputBufferIndex+1;
     if (firstChar == '<')
     {
         char closingComment = '-';
         char oldChar = ' ';
         bool loop = TRUE;
-        
+
         /* another node is being open ==> no inline ! */
         if (secondChar != '!') { return FALSE; }
-        
+
         /* okay we are in a comment/cdata node, so read until it is closed */
-        
+
         /* select the closing char */
         if (thirdChar == '[') { closingComment = ']'; }
-        
+
         /* read until closing */
         currentIndex += 3; /* that bypass meanless chars */
         while (loop)
         {
-            char current = inputBuffer[currentIndex];
+            char current = getCharAt(ctx, currentIndex);
+            if (current == '\0') { return FALSE; } /* end of the XML reached */
             if (current == closingComment && oldChar == closingComment) { loop = FALSE; } /* end of comment/cdata */
             oldChar = current;
             ++currentIndex;
         }
-        
+
         /* okay now avoid blanks */
         /*  inputBuffer[index] is now '>' */
         ++currentIndex;
-        while (isWhite(inputBuffer[currentIndex])) { ++currentIndex; }
+        while (isWhite(getCharAt(ctx, currentIndex))) { ++currentIndex; }
     }
     else
     {
         /* this is a text node. Simply loop to the next '<' */
-        while (inputBuffer[currentIndex] != '<') { ++currentIndex; }
+        while (getCharAt(ctx, currentIndex) != '<' &&
+               getCharAt(ctx, currentIndex) != '\0')
+        {
+            ++currentIndex;
+        }
     }
-    
+
     /* check what do we have now */
-    currentChar = inputBuffer[currentIndex];
+    currentChar = getCharAt(ctx, currentIndex);
     if (currentChar == '<')
     {
         /* check if that is a closing node */
-        currentChar = inputBuffer[currentIndex+1];
+        currentChar = getCharAt(ctx, currentIndex+1);
         if (currentChar == '/')
         {
             /* as we are in a correct XML (so far...), if the node is  */
@@ -361,26 +539,26 @@ bool isInlineNodeAllowed(void)
             return TRUE;
         }
     }
-    
+
     /* inline not allowed... */
     return FALSE;
 }
 
-bool isOnSingleLine(int skip, char stop1, char stop2)
+bool isOnSingleLine(PrettyPrintingContext* ctx, int skip, char stop1, char stop2)
 {
-    int currentIndex = inputBufferIndex+skip; /* skip the n first chars (in comment <!--) */
+    int currentIndex = ctx->inputBufferIndex+skip; /* skip the n first chars (in comment <!--) */
     bool onSingleLine = TRUE;
-    
-    char oldChar = inputBuffer[currentIndex];
-    char currentChar = inputBuffer[currentIndex+1];
-    while(onSingleLine && oldChar != stop1 && currentChar != stop2)
+
+    char oldChar = getCharAt(ctx, currentIndex);
+    char currentChar = getCharAt(ctx, currentIndex+1);
+    while(onSingleLine && oldChar != stop1 && currentChar != stop2 && oldChar != '\0')
     {
         onSingleLine = !isLineBreak(oldChar);
-        
+
         ++currentIndex;
         oldChar = currentChar;
-        currentChar = inputBuffer[currentIndex+1];
-        
+        currentChar = getCharAt(ctx, currentIndex+1);
+
         /**
          * A line break inside the node has been reached. But we should check
          * if there is something before the end of the node (otherwise, there
@@ -393,739 +571,767 @@ bool isOnSingleLine(int skip, char stop1, char stop2)
             {
                 /* okay there is something else => this is not on one line */
                 if (!isWhite(oldChar)) return FALSE;
-              
+
                 ++currentIndex;
                 oldChar = currentChar;
-                currentChar = inputBuffer[currentIndex+1];
+                currentChar = getCharAt(ctx, currentIndex+1);
             }
-            
+
             /* the end of the node has been reached with only whites. Then
              * the node can be considered being one single line */
             return TRUE;
         }
     }
-    
+
     return onSingleLine;
 }
 
-void resetBackwardIndentation(bool resetLineBreak)
+void resetBackwardIndentation(PrettyPrintingContext* ctx, bool resetLineBreak)
 {
-    xmlPrettyPrintedIndex -= (currentDepth*options->indentLength);
-    if (resetLineBreak) 
-    { 
-        int len = strlen(options->newLineChars);
-        xmlPrettyPrintedIndex -= len; 
+    ctx->xmlPrettyPrintedIndex -= (ctx->currentDepth*ctx->options->indentLength);
+    if (resetLineBreak)
+    {
+        int len = strlen(ctx->options->newLineChars);
+        ctx->xmlPrettyPrintedIndex -= len;
     }
 }
 
 /*#########################################################################################################################################*/
 /*-----------------------------------------------------------------------------------------------------------------------------------------*/
-                                                                                                
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------*/
 /*=============================================================== NODE FUNCTIONS ==========================================================*/
 /*-----------------------------------------------------------------------------------------------------------------------------------------*/
-                                                                                                
+
 /*-----------------------------------------------------------------------------------------------------------------------------------------*/
 /*#########################################################################################################################################*/
 
-int processElements(void)
+int processElements(PrettyPrintingContext* ctx)
 {
     int counter = 0;
     bool loop = TRUE;
-    ++currentDepth;
-    while (loop && result == PRETTY_PRINTING_SUCCESS)
+    ++ctx->currentDepth;
+    while (loop && ctx->result == PRETTY_PRINTING_SUCCESS)
     {
         bool indentBackward;
         char nextChar;
-        
+
         /* strip unused whites */
-        readWhites(TRUE);
-        
-        nextChar = getNextChar();
+        readWhites(ctx, TRUE);
+
+        nextChar = getNextChar(ctx);
         if (nextChar == '\0') { return 0; } /* no more data to read */
-        
+
+        /* the previous elements won't be modified anymore, they can be written
+         * (but not before the first one, the parent node may still be stripped) */
+        if (counter > 0) { flushBuffer(ctx, FALSE); }
+
         /* put a new line with indentation */
-        if (appendIndentation) { putNewLine(); }
-        
+        if (ctx->appendIndentation) { putNewLine(ctx); }
+
         /* always append indentation (but need to store the state) */
-        indentBackward = appendIndentation;
-        appendIndentation = TRUE; 
-        
+        indentBackward = ctx->appendIndentation;
+        ctx->appendIndentation = TRUE;
+
         /* okay what do we have now ? */
         if (nextChar != '<')
-        { 
+        {
             /* a simple text node */
-            processTextNode(); 
-            ++counter; 
-        } 
+            processTextNode(ctx);
+            ++counter;
+        }
         else /* some more check are needed */
         {
-            nextChar = inputBuffer[inputBufferIndex+1];
-            if (nextChar == '!') 
+            nextChar = getCharAt(ctx, ctx->inputBufferIndex+1);
+            if (nextChar == '!')
             {
-                char oneMore = inputBuffer[inputBufferIndex+2];
-                if (oneMore == '-') { processComment(); ++counter; } /* a comment */
-                else if (oneMore == '[') { processCDATA(); ++counter; } /* cdata */
-                else if (oneMore == 'D') { processDoctype(); ++counter; } /* doctype <!DOCTYPE ... > */
-                else if (oneMore == 'E') { processDoctypeElement(); ++counter; } /* doctype element <!ELEMENT ... > */
-                else 
-                { 
-                    printError("processElements : Invalid char '%c' afer '<!'", oneMore); 
-                    result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
+                char oneMore = getCharAt(ctx, ctx->inputBufferIndex+2);
+                if (oneMore == '-') { processComment(ctx); ++counter; } /* a comment */
+                else if (oneMore == '[') { processCDATA(ctx); ++counter; } /* cdata */
+                else if (oneMore == 'D') { processDoctype(ctx); ++counter; } /* doctype <!DOCTYPE ... > */
+                else if (oneMore == 'E') { processDoctypeElement(ctx); ++counter; } /* doctype element <!ELEMENT ... > */
+                else
+                {
+                    printError(ctx, "processElements : Invalid char '%c' afer '<!'", oneMore);
+                    ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
                 }
-            } 
+            }
             else if (nextChar == '/')
-            { 
+            {
                 /* close a node => stop the loop !! */
-                loop = FALSE; 
-                if (indentBackward) 
-                { 
+                loop = FALSE;
+                if (indentBackward)
+                {
                     /* INDEX HACKING */
-                    xmlPrettyPrintedIndex -= options->indentLength; 
-                } 
+                    ctx->xmlPrettyPrintedIndex -= ctx->options->indentLength;
+                }
             }
             else if (nextChar == '?')
             {
                 /* this is a header */
-                processHeader();
+                processHeader(ctx);
             }
-            else 
+            else
             {
                 /* a new node is open */
-                processNode();
+                processNode(ctx);
                 ++counter;
-            } 
+            }
         }
     }
-    
-    --currentDepth;
+
+    --ctx->currentDepth;
     return counter;
 }
 
-void processElementAttribute(void)
+void processElementAttribute(PrettyPrintingContext* ctx)
 {
     char quote;
-    char value;
+    char quoteChars[2];
+
     /* process the attribute name */
-    char nextChar = readNextChar();
-    while (nextChar != '=')
-    {
-        putCharInBuffer(nextChar);
-        nextChar = readNextChar();
-    }
-    
-    putCharInBuffer(nextChar); /* that's the '=' */
-    
+    putNextCharsInBuffer(ctx, countCharsUntil(ctx, "="));
+    putNextCharsInBuffer(ctx, 1); /* that's the '=' */
+
     /* read the simple quote or double quote and put it into the buffer */
-    quote = readNextChar();
-    putCharInBuffer(quote); 
-    
+    quote = readNextChar(ctx);
+    putCharInBuffer(ctx, quote);
+
     /* process until the last quote */
-    value = readNextChar();
-    while(value != quote)
-    {
-        putCharInBuffer(value);
-        value = readNextChar();
-    }
-    
+    quoteChars[0] = quote;
+    quoteChars[1] = '\0';
+    putNextCharsInBuffer(ctx, countCharsUntil(ctx, quoteChars));
+
     /* simply add the last quote */
-    putCharInBuffer(quote);
+    putNextCharsInBuffer(ctx, 1);
 }
 
-void processElementAttributes(void)
+void processElementAttributes(PrettyPrintingContext* ctx)
 {
     bool loop = TRUE;
-    char current = getNextChar(); /* should not be a white */
-    if (isWhite(current)) 
-    { 
-        printError("processElementAttributes : first char shouldn't be a white"); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
+    char current = getNextChar(ctx); /* should not be a white */
+    if (isWhite(current))
+    {
+        printError(ctx, "processElementAttributes : first char shouldn't be a white");
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        return;
     }
-    
-    while (loop)
+
+    while (loop && ctx->result == PRETTY_PRINTING_SUCCESS)
     {
         char next;
-        
-        readWhites(TRUE); /* strip the whites */
-        
-        next = getNextChar(); /* don't read the last char (processed afterwards) */
+
+        readWhites(ctx, TRUE); /* strip the whites */
+
+        next = getNextChar(ctx); /* don't read the last char (processed afterwards) */
         if (next == '/') { loop = FALSE; } /* end of node */
         else if (next == '>') { loop = FALSE; } /* end of tag */
         else if (next == '?') { loop = FALSE; } /* end of header */
-        else 
-        { 
-            putCharInBuffer(' '); /* put only one space to separate attributes */
-            processElementAttribute(); 
+        else
+        {
+            putCharInBuffer(ctx, ' '); /* put only one space to separate attributes */
+            processElementAttribute(ctx);
         }
     }
 }
 
-void processHeader(void)
+void processHeader(PrettyPrintingContext* ctx)
 {
-    int firstChar = inputBuffer[inputBufferIndex]; /* should be '<' */
-    int secondChar = inputBuffer[inputBufferIndex+1]; /* must be '?' */
-    
-    if (firstChar != '<') 
-    { 
-        /* what ?????? invalid xml !!! */ 
-        printError("processHeader : first char should be '<' (not '%c')", firstChar); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; return; 
+    int firstChar = getNextChar(ctx); /* should be '<' */
+    int secondChar = getCharAt(ctx, ctx->inputBufferIndex+1); /* must be '?' */
+
+    if (firstChar != '<')
+    {
+        /* what ?????? invalid xml !!! */
+        printError(ctx, "processHeader : first char should be '<' (not '%c')", firstChar);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR; return;
     }
-    
+
     if (secondChar == '?')
-    { 
+    {
         /* puts the '<' and '?' chars into the new buffer */
-        putNextCharsInBuffer(2); 
-        
-        while(!isWhite(getNextChar())) { putNextCharsInBuffer(1); }
-        
-        readWhites(TRUE);
-        processElementAttributes(); 
-        
+        putNextCharsInBuffer(ctx, 2);
+
+        putNextCharsInBuffer(ctx, countCharsUntil(ctx, " \t\r\n"));
+
+        readWhites(ctx, TRUE);
+        processElementAttributes(ctx);
+
         /* puts the '?' and '>' chars into the new buffer */
-        putNextCharsInBuffer(2); 
+        putNextCharsInBuffer(ctx, 2);
     }
 }
 
-void processNode(void)
+void processNode(PrettyPrintingContext* ctx)
 {
     char closeChar;
     int subElementsProcessed = 0;
     char nextChar;
     char* nodeName;
     int nodeNameLength = 0;
-    int i;
-    int opening = readNextChar();
-    if (opening != '<') 
-    { 
-        printError("processNode : The first char should be '<' (not '%c')", opening); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
-    }
-    
-    putCharInBuffer(opening);
-    
-    /* read the node name */
-    while (!isWhite(getNextChar()) && 
-           getNextChar() != '>' &&  /* end of the tag */
-           getNextChar() != '/') /* tag is being closed */
+    int opening = readNextChar(ctx);
+    if (opening != '<')
     {
-        putNextCharsInBuffer(1);
-        ++nodeNameLength;
+        printError(ctx, "processNode : The first char should be '<' (not '%c')", opening);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        return;
     }
 
+    putCharInBuffer(ctx, opening);
+
+    /* read the node name (up to a white, the end of the tag or the tag being closed) */
+    nodeNameLength = countCharsUntil(ctx, " \t\r\n>/");
+    putNextCharsInBuffer(ctx, nodeNameLength);
+    if (ctx->result != PRETTY_PRINTING_SUCCESS) { return; }
+
     /* store the name */
     nodeName = (char*)malloc(sizeof(char)*nodeNameLength+1);
     if (nodeName == NULL) { PP_ERROR("Allocation error (node name length is %d)", nodeNameLength); return ; }
     nodeName[nodeNameLength] = '\0';
-    for (i=0 ; i<nodeNameLength ; ++i)
-    {
-        int tempIndex = xmlPrettyPrintedIndex-nodeNameLength+i;
-        nodeName[i] = xmlPrettyPrinted[tempIndex];
-    }
-    
-    currentNodeName = nodeName; /* set the name for using in other methods */
-    lastNodeOpen = TRUE;
+    memcpy(nodeName, ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex-nodeNameLength, nodeNameLength);
+
+    ctx->currentNodeName = nodeName; /* set the name for using in other methods */
+    ctx->lastNodeOpen = TRUE;
 
     /* process the attributes     */
-    readWhites(TRUE);
-    processElementAttributes();
-    
+    readWhites(ctx, TRUE);
+    processElementAttributes(ctx);
+
     /* process the end of the tag */
     subElementsProcessed = 0;
-    nextChar = getNextChar(); /* should be either '/' or '>' */
+    nextChar = getNextChar(ctx); /* should be either '/' or '>' */
     if (nextChar == '/') /* the node is being closed immediatly */
-    { 
+    {
         /* closing node directly */
-        if (options->emptyNodeStripping || !options->forceEmptyNodeSplit)
+        if (ctx->options->emptyNodeStripping || !ctx->options->forceEmptyNodeSplit)
         {
-            if (options->emptyNodeStrippingSpace) { putCharInBuffer(' '); }
-            putNextCharsInBuffer(2); 
+            if (ctx->options->emptyNodeStrippingSpace) { putCharInBuffer(ctx, ' '); }
+            putNextCharsInBuffer(ctx, 2);
         }
         /* split the closing nodes */
         else
         {
-            readNextChar(); /* removing '/' */
-            readNextChar(); /* removing '>' */
-            
-            putCharInBuffer('>');
-            if (!options->inlineText) 
+            readNextChar(ctx); /* removing '/' */
+            readNextChar(ctx); /* removing '>' */
+
+            putCharInBuffer(ctx, '>');
+            if (!ctx->options->inlineText)
             {
                 /* no inline text => new line ! */
-                putNewLine(); 
-            } 
-            
-            putCharsInBuffer("</");
-            putCharsInBuffer(currentNodeName);
-            putCharInBuffer('>');
+                putNewLine(ctx);
+            }
+
+            putCharsInBuffer(ctx, "</");
+            putCharsInBuffer(ctx, ctx->currentNodeName);
+            putCharInBuffer(ctx, '>');
         }
-        
-        lastNodeOpen=FALSE; 
-        return; 
+
+        ctx->lastNodeOpen=FALSE;
+        free(nodeName);
+        ctx->currentNodeName = NULL;
+        return;
     }
-    else if (nextChar == '>') 
-    { 
+    else if (nextChar == '>')
+    {
         /* the tag is just closed (maybe some content) */
-        putNextCharsInBuffer(1); 
-        subElementsProcessed = processElements();
-    } 
-    else 
-    { 
-        printError("processNode : Invalid character '%c'", nextChar);
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
+        putNextCharsInBuffer(ctx, 1);
+        subElementsProcessed = processElements(ctx);
     }
-    
+    else
+    {
+        printError(ctx, "processNode : Invalid character '%c'", nextChar);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        free(nodeName);
+        ctx->currentNodeName = NULL;
+        return;
+    }
+
     /* if the code reaches this area, then the processElements has been called and we must
      * close the opening tag */
-    closeChar = getNextChar();
-    if (closeChar != '<') 
-    { 
-        printError("processNode : Invalid character '%c' for closing tag (should be '<')", closeChar); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
-    }
-    
-    do
+    closeChar = getNextChar(ctx);
+    if (closeChar != '<')
     {
-        closeChar = readNextChar();
-        putCharInBuffer(closeChar);
+        printError(ctx, "processNode : Invalid character '%c' for closing tag (should be '<')", closeChar);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        free(nodeName);
+        ctx->currentNodeName = NULL;
+        return;
     }
-    while(closeChar != '>');
-    
+
+    /* copy the closing tag up to the '>' */
+    putNextCharsInBuffer(ctx, countCharsUntil(ctx, ">")+1);
+
     /* there is no elements */
     if (subElementsProcessed == 0)
     {
         /* the node will be stripped */
-        if (options->emptyNodeStripping)
+        if (ctx->options->emptyNodeStripping)
         {
             /* because we have '<nodeName ...></nodeName>' */
-            xmlPrettyPrintedIndex -= nodeNameLength+4; 
-            resetBackwardIndentation(TRUE);
-            
-            if (options->emptyNodeStrippingSpace) { putCharInBuffer(' '); }
-            putCharsInBuffer("/>");
+            ctx->xmlPrettyPrintedIndex -= nodeNameLength+4;
+            resetBackwardIndentation(ctx, TRUE);
+
+            if (ctx->options->emptyNodeStrippingSpace) { putCharInBuffer(ctx, ' '); }
+            putCharsInBuffer(ctx, "/>");
         }
         /* the closing tag will be put on the same line */
-        else if (options->inlineText)
+        else if (ctx->options->inlineText)
         {
             /* correct the index because we have '</nodeName>' */
-            xmlPrettyPrintedIndex -= nodeNameLength+3; 
-            resetBackwardIndentation(TRUE);
-            
+            ctx->xmlPrettyPrintedIndex -= nodeNameLength+3;
+            resetBackwardIndentation(ctx, TRUE);
+
             /* rewrite the node name */
-            putCharsInBuffer("</");
-            putCharsInBuffer(currentNodeName);
-            putCharInBuffer('>');
+            putCharsInBuffer(ctx, "</");
+            putCharsInBuffer(ctx, ctx->currentNodeName);
+            putCharInBuffer(ctx, '>');
         }
     }
-    
+
     /* the node is closed */
-    lastNodeOpen = FALSE;
-    
+    ctx->lastNodeOpen = FALSE;
+
     /* freeeeeeee !!! */
     free(nodeName);
     nodeName = NULL;
-    currentNodeName = NULL;
+    ctx->currentNodeName = NULL;
 }
 
-void processComment(void)
+void processComment(PrettyPrintingContext* ctx)
 {
     char lastChar;
     bool loop = TRUE;
     char oldChar;
+    const char* specialChars;
     bool inlineAllowed = FALSE;
-    if (options->inlineComment) { inlineAllowed = isInlineNodeAllowed(); }
-    if (inlineAllowed && !options->oneLineComment) { inlineAllowed = isOnSingleLine(4, '-', '-'); }
-    if (inlineAllowed) { resetBackwardIndentation(TRUE); }
-    
-    putNextCharsInBuffer(4); /* add the chars '<!--' */
-    
+    if (ctx->options->inlineComment) { inlineAllowed = isInlineNodeAllowed(ctx); }
+    if (inlineAllowed && !ctx->options->oneLineComment) { inlineAllowed = isOnSingleLine(ctx, 4, '-', '-'); }
+    if (inlineAllowed) { resetBackwardIndentation(ctx, TRUE); }
+
+    putNextCharsInBuffer(ctx, 4); /* add the chars '<!--' */
+
+    /* the chars that are not simply copied */
+    specialChars = ctx->options->oneLineComment ? "- \t\r\n" : "-\r\n";
+
     oldChar = '-';
-    while (loop)
+    while (loop && ctx->result == PRETTY_PRINTING_SUCCESS)
     {
-        char nextChar = readNextChar();
+        char nextChar;
+        int textLength;
+
+        /* copy the content up to the next special char at once */
+        textLength = countCharsUntil(ctx, specialChars);
+        if (textLength > 0)
+        {
+            putNextCharsInBuffer(ctx, textLength);
+            oldChar = getPreviousInsertedChar(ctx);
+            continue;
+        }
+
+        nextChar = readNextChar(ctx);
         if (oldChar == '-' && nextChar == '-') /* comment is being closed */
         {
             loop = FALSE;
         }
-        
+
         if (!isLineBreak(nextChar)) /* the comment simply continues */
         {
-            if (options->oneLineComment && isSpace(nextChar))
+            if (ctx->options->oneLineComment && isSpace(nextChar))
             {
                 /* removes all the unecessary spaces */
-                while(isSpace(getNextChar()))
+                while(isSpace(getNextChar(ctx)))
                 {
-                    nextChar = readNextChar();
+                    nextChar = readNextChar(ctx);
                 }
-                putCharInBuffer(' ');
+                putCharInBuffer(ctx, ' ');
                 oldChar = ' ';
             }
             else
             {
                 /* comment is left untouched */
-                putCharInBuffer(nextChar);
+                putCharInBuffer(ctx, nextChar);
                 oldChar = nextChar;
             }
-            
-            if (!loop && options->alignComment) /* end of comment */
+
+            if (!loop && ctx->options->alignComment) /* end of comment */
             {
                 /* ensures the chars preceding the first '-' are all spaces (there are at least
                  * 5 spaces in front of the '-->' for the alignment with '<!--') */
-                bool onlySpaces = xmlPrettyPrinted[xmlPrettyPrintedIndex-3] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-4] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-5] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-6] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-7] == ' ';
-                
+                char* end = ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex;
+                bool onlySpaces = end[-3] == ' ' &&
+                                  end[-4] == ' ' &&
+                                  end[-5] == ' ' &&
+                                  end[-6] == ' ' &&
+                                  end[-7] == ' ';
+
                 /* if all the preceding chars are white, then go for replacement */
                 if (onlySpaces)
                 {
-                    xmlPrettyPrintedIndex -= 7; /* remove indentation spaces */
-                    putCharsInBuffer("--"); /* reset the first chars of '-->' */
+                    ctx->xmlPrettyPrintedIndex -= 7; /* remove indentation spaces */
+                    putCharsInBuffer(ctx, "--"); /* reset the first chars of '-->' */
                 }
             }
         }
-        else if (!options->oneLineComment && !inlineAllowed) /* oh ! there is a line break */
+        else if (!ctx->options->oneLineComment && !inlineAllowed) /* oh ! there is a line break */
         {
             /* if the comments need to be aligned, just add 5 spaces */
-            if (options->alignComment) 
+            if (ctx->options->alignComment)
             {
-                int read = readWhites(FALSE); /* strip the whites and new line */
-                if (nextChar == '\r' && read == 0 && getNextChar() == '\n') /* handles the \r\n return line */
+                int read = readWhites(ctx, FALSE); /* strip the whites and new line */
+                if (nextChar == '\r' && read == 0 && getNextChar(ctx) == '\n') /* handles the \r\n return line */
                 {
-                    readNextChar(); 
-                    readWhites(FALSE);
+                    readNextChar(ctx);
+                    readWhites(ctx, FALSE);
                 }
-              
-                putNewLine(); /* put a new indentation line */
-                putCharsInBuffer("     "); /* align with <!--  */
+
+                putNewLine(ctx); /* put a new indentation line */
+                putCharsInBuffer(ctx, "     "); /* align with <!--  */
                 oldChar = ' '; /* and update the last char */
             }
             else
             {
-                putCharInBuffer(nextChar);
+                putCharInBuffer(ctx, nextChar);
                 oldChar = nextChar;
             }
         }
         else /* the comments must be inlined */
         {
-            readWhites(TRUE); /* strip the whites and add a space if needed */
-            if (getPreviousInsertedChar() != ' ' &&
-                strncmp(xmlPrettyPrinted+xmlPrettyPrintedIndex-4, "<!--", 4) != 0) /* prevents adding a space at the beginning  */
-            { 
-                putCharInBuffer(' '); 
+            readWhites(ctx, TRUE); /* strip the whites and add a space if needed */
+            if (getPreviousInsertedChar(ctx) != ' ' &&
+                strncmp(ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex-4, "<!--", 4) != 0) /* prevents adding a space at the beginning  */
+            {
+                putCharInBuffer(ctx, ' ');
                 oldChar = ' ';
             }
         }
     }
-    
-    lastChar = readNextChar(); /* should be '>' */
-    if (lastChar != '>') 
-    { 
-        printError("processComment : last char must be '>' (not '%c')", lastChar); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
+
+    lastChar = readNextChar(ctx); /* should be '>' */
+    if (lastChar != '>')
+    {
+        printError(ctx, "processComment : last char must be '>' (not '%c')", lastChar);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        return;
     }
-    putCharInBuffer(lastChar);
-    
-    if (inlineAllowed) { appendIndentation = FALSE; }
-    
+    putCharInBuffer(ctx, lastChar);
+
+    if (inlineAllowed) { ctx->appendIndentation = FALSE; }
+
     /* there vas no node open */
-    lastNodeOpen = FALSE;
+    ctx->lastNodeOpen = FALSE;
 }
 
-void processTextNode(void)
+void processTextNode(PrettyPrintingContext* ctx)
 {
     /* checks if inline is allowed */
     bool inlineTextAllowed = FALSE;
-    if (options->inlineText) { inlineTextAllowed = isInlineNodeAllowed(); }
-    if (inlineTextAllowed && !options->oneLineText) { inlineTextAllowed = isOnSingleLine(0, '<', '/'); }
-    if (inlineTextAllowed || !options->alignText) 
-    { 
-        resetBackwardIndentation(TRUE); /* remove previous indentation */
-        if (!inlineTextAllowed) { putNewLine(); }
-    } 
-   
+    if (ctx->options->inlineText) { inlineTextAllowed = isInlineNodeAllowed(ctx); }
+    if (inlineTextAllowed && !ctx->options->oneLineText) { inlineTextAllowed = isOnSingleLine(ctx, 0, '<', '/'); }
+    if (inlineTextAllowed || !ctx->options->alignText)
+    {
+        resetBackwardIndentation(ctx, TRUE); /* remove previous indentation */
+        if (!inlineTextAllowed) { putNewLine(ctx); }
+    }
+
     /* the leading whites are automatically stripped. So we re-add it */
-    if (!options->trimLeadingWhites)
+    if (!ctx->options->trimLeadingWhites)
     {
-        int backwardIndex = inputBufferIndex-1;
-        while (isSpace(inputBuffer[backwardIndex])) 
-        { 
+        int backwardIndex = ctx->inputBufferIndex-1;
+        while (isSpace(getCharAt(ctx, backwardIndex)))
+        {
             --backwardIndex; /* backward rolling */
-        } 
-        
+        }
+
         /* now the input[backwardIndex] IS NOT a white. So we go to
          * the next char... */
         ++backwardIndex;
-        
+
         /* and then re-add the whites */
-        while (inputBuffer[backwardIndex] == ' ' || 
-               inputBuffer[backwardIndex] == '\t') 
+        while (getCharAt(ctx, backwardIndex) == ' ' ||
+               getCharAt(ctx, backwardIndex) == '\t')
         {
-            putCharInBuffer(inputBuffer[backwardIndex]);
+            putCharInBuffer(ctx, getCharAt(ctx, backwardIndex));
             ++backwardIndex;
         }
     }
-    
+
     /* process the text into the node */
-    while(getNextChar() != '<')
+    while(getNextChar(ctx) != '<' && getNextChar(ctx) != '\0')
     {
-        char nextChar = readNextChar();
-        if (isLineBreak(nextChar))
+        char nextChar;
+
+        /* copy the text up to the next line break at once */
+        int textLength = countCharsUntil(ctx, "<\r\n");
+        if (textLength > 0)
         {
-            if (options->oneLineText)
-            { 
-                readWhites(TRUE);
-              
-                /* as we can put text on one line, remove the line break 
-                 * and replace it by a space but only if the previous 
-                 * char wasn't a space */
-                if (getPreviousInsertedChar() != ' ') { putCharInBuffer(' '); }
-            }
-            else if (options->alignText)
+            putNextCharsInBuffer(ctx, textLength);
+            continue;
+        }
+
+        nextChar = readNextChar(ctx); /* that's a line break */
+        if (ctx->options->oneLineText)
+        {
+            readWhites(ctx, TRUE);
+
+            /* as we can put text on one line, remove the line break
+             * and replace it by a space but only if the previous
+             * char wasn't a space */
+            if (getPreviousInsertedChar(ctx) != ' ') { putCharInBuffer(ctx, ' '); }
+        }
+        else if (ctx->options->alignText)
+        {
+            int read = readWhites(ctx, FALSE);
+            if (nextChar == '\r' && read == 0 && getNextChar(ctx) == '\n') /* handles the '\r\n' */
             {
-                int read = readWhites(FALSE);
-                if (nextChar == '\r' && read == 0 && getNextChar() == '\n') /* handles the '\r\n' */
-                {
-                   nextChar = readNextChar();
-                   readWhites(FALSE);
-                }
-              
-                /* put a new line only if the closing tag is not reached */
-                if (getNextChar() != '<') 
-                {   
-                    putNewLine(); 
-                } 
+               nextChar = readNextChar(ctx);
+               readWhites(ctx, FALSE);
             }
-            else
+
+            /* put a new line only if the closing tag is not reached */
+            if (getNextChar(ctx) != '<')
             {
-                putCharInBuffer(nextChar);
+                putNewLine(ctx);
             }
         }
         else
         {
-            putCharInBuffer(nextChar);
+            putCharInBuffer(ctx, nextChar);
         }
     }
-    
+
     /* strip the trailing whites */
-    if (options->trimTrailingWhites)
+    if (ctx->options->trimTrailingWhites)
     {
-        while(getPreviousInsertedChar() == ' ' || 
-              getPreviousInsertedChar() == '\t')
+        while(getPreviousInsertedChar(ctx) == ' ' ||
+              getPreviousInsertedChar(ctx) == '\t')
         {
-            --xmlPrettyPrintedIndex;
+            --ctx->xmlPrettyPrintedIndex;
         }
     }
-    
+
     /* remove the indentation for the closing tag */
-    if (inlineTextAllowed) { appendIndentation = FALSE; }
-    
+    if (inlineTextAllowed) { ctx->appendIndentation = FALSE; }
+
     /* there vas no node open */
-    lastNodeOpen = FALSE;
+    ctx->lastNodeOpen = FALSE;
 }
 
-void processCDATA(void)
+void processCDATA(PrettyPrintingContext* ctx)
 {
     char lastChar;
     bool loop = TRUE;
     char oldChar;
+    const char* specialChars;
     bool inlineAllowed = FALSE;
-    if (options->inlineCdata) { inlineAllowed = isInlineNodeAllowed(); }
-    if (inlineAllowed && !options->oneLineCdata) { inlineAllowed = isOnSingleLine(9, ']', ']'); }
-    if (inlineAllowed) { resetBackwardIndentation(TRUE); }
-    
-    putNextCharsInBuffer(9); /* putting the '<![CDATA[' into the buffer */
-    
+    if (ctx->options->inlineCdata) { inlineAllowed = isInlineNodeAllowed(ctx); }
+    if (inlineAllowed && !ctx->options->oneLineCdata) { inlineAllowed = isOnSingleLine(ctx, 9, ']', ']'); }
+    if (inlineAllowed) { resetBackwardIndentation(ctx, TRUE); }
+
+    putNextCharsInBuffer(ctx, 9); /* putting the '<![CDATA[' into the buffer */
+
+    /* the chars that are not simply copied */
+    specialChars = ctx->options->oneLineCdata ? "] \t\r\n" : "]\r\n";
+
     oldChar = '[';
-    while(loop)
+    while(loop && ctx->result == PRETTY_PRINTING_SUCCESS)
     {
-        char nextChar = readNextChar();
-        char nextChar2 = getNextChar();
+        char nextChar;
+        char nextChar2;
+        int textLength;
+
+        /* copy the content up to the next special char at once */
+        textLength = countCharsUntil(ctx, specialChars);
+        if (textLength > 0)
+        {
+            putNextCharsInBuffer(ctx, textLength);
+            oldChar = getPreviousInsertedChar(ctx);
+            continue;
+        }
+
+        nextChar = readNextChar(ctx);
+        nextChar2 = getNextChar(ctx);
         if (oldChar == ']' && nextChar == ']' && nextChar2 == '>') { loop = FALSE; } /* end of cdata */
-        
+
         if (!isLineBreak(nextChar)) /* the cdata simply continues */
         {
-            if (options->oneLineCdata && isSpace(nextChar))
+            if (ctx->options->oneLineCdata && isSpace(nextChar))
             {
                 /* removes all the unecessary spaces */
                 while(isSpace(nextChar2))
                 {
-                    nextChar = readNextChar();
-                    nextChar2 = getNextChar();
+                    nextChar = readNextChar(ctx);
+                    nextChar2 = getNextChar(ctx);
                 }
-                
-                putCharInBuffer(' ');
+
+                putCharInBuffer(ctx, ' ');
                 oldChar = ' ';
             }
             else
             {
                 /* comment is left untouched */
-                putCharInBuffer(nextChar);
+                putCharInBuffer(ctx, nextChar);
                 oldChar = nextChar;
             }
-            
-            if (!loop && options->alignCdata) /* end of cdata */
+
+            if (!loop && ctx->options->alignCdata) /* end of cdata */
             {
                 /* ensures the chars preceding the first '-' are all spaces (there are at least
                  * 10 spaces in front of the ']]>' for the alignment with '<![CDATA[') */
-                bool onlySpaces = xmlPrettyPrinted[xmlPrettyPrintedIndex-3] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-4] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-5] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-6] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-7] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-8] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-9] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-10] == ' ' &&
-                                  xmlPrettyPrinted[xmlPrettyPrintedIndex-11] == ' ';
-                
+                char* end = ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex;
+                bool onlySpaces = end[-3] == ' ' &&
+                                  end[-4] == ' ' &&
+                                  end[-5] == ' ' &&
+                                  end[-6] == ' ' &&
+                                  end[-7] == ' ' &&
+                                  end[-8] == ' ' &&
+                                  end[-9] == ' ' &&
+                                  end[-10] == ' ' &&
+                                  end[-11] == ' ';
+
                 /* if all the preceding chars are white, then go for replacement */
                 if (onlySpaces)
                 {
-                    xmlPrettyPrintedIndex -= 11; /* remove indentation spaces */
-                    putCharsInBuffer("]]"); /* reset the first chars of '-->' */
+                    ctx->xmlPrettyPrintedIndex -= 11; /* remove indentation spaces */
+                    putCharsInBuffer(ctx, "]]"); /* reset the first chars of '-->' */
                 }
             }
         }
-        else if (!options->oneLineCdata && !inlineAllowed) /* line break */
+        else if (!ctx->options->oneLineCdata && !inlineAllowed) /* line break */
         {
             /* if the cdata need to be aligned, just add 9 spaces */
-            if (options->alignCdata) 
+            if (ctx->options->alignCdata)
             {
-                int read = readWhites(FALSE); /* strip the whites and new line */
-                if (nextChar == '\r' && read == 0 && getNextChar() == '\n') /* handles the \r\n return line */
+                int read = readWhites(ctx, FALSE); /* strip the whites and new line */
+                if (nextChar == '\r' && read == 0 && getNextChar(ctx) == '\n') /* handles the \r\n return line */
                 {
-                    readNextChar(); 
-                    readWhites(FALSE);
+                    readNextChar(ctx);
+                    readWhites(ctx, FALSE);
                 }
-              
-                putNewLine(); /* put a new indentation line */
-                putCharsInBuffer("         "); /* align with <![CDATA[ */
+
+                putNewLine(ctx); /* put a new indentation line */
+                putCharsInBuffer(ctx, "         "); /* align with <![CDATA[ */
                 oldChar = ' '; /* and update the last char */
             }
             else
             {
-                putCharInBuffer(nextChar);
+                putCharInBuffer(ctx, nextChar);
                 oldChar = nextChar;
             }
         }
         else /* cdata are inlined */
         {
-            readWhites(TRUE); /* strip the whites and add a space if necessary */
-            if(getPreviousInsertedChar() != ' ' &&
-               strncmp(xmlPrettyPrinted+xmlPrettyPrintedIndex-9, "<![CDATA[", 9) != 0) /* prevents adding a space at the beginning  */
-            { 
-                putCharInBuffer(' '); 
+            readWhites(ctx, TRUE); /* strip the whites and add a space if necessary */
+            if(getPreviousInsertedChar(ctx) != ' ' &&
+               strncmp(ctx->xmlPrettyPrinted+ctx->xmlPrettyPrintedIndex-9, "<![CDATA[", 9) != 0) /* prevents adding a space at the beginning  */
+            {
+                putCharInBuffer(ctx, ' ');
                 oldChar = ' ';
             }
         }
     }
-    
+
     /* if the cdata is inline, then all the trailing spaces are removed */
-    if (options->oneLineCdata)
+    if (ctx->options->oneLineCdata)
     {
-        xmlPrettyPrintedIndex -= 2; /* because of the last ']]' inserted */
-        while(isWhite(xmlPrettyPrinted[xmlPrettyPrintedIndex-1]))
+        ctx->xmlPrettyPrintedIndex -= 2; /* because of the last ']]' inserted */
+        while(isWhite(getPreviousInsertedChar(ctx)))
         {
-            --xmlPrettyPrintedIndex;
+            --ctx->xmlPrettyPrintedIndex;
         }
-        putCharsInBuffer("]]");
+        putCharsInBuffer(ctx, "]]");
     }
-    
+
     /* finalize the cdata */
-    lastChar = readNextChar(); /* should be '>' */
-    if (lastChar != '>') 
-    { 
-        printError("processCDATA : last char must be '>' (not '%c')", lastChar); 
-        result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-        return; 
+    lastChar = readNextChar(ctx); /* should be '>' */
+    if (lastChar != '>')
+    {
+        printError(ctx, "processCDATA : last char must be '>' (not '%c')", lastChar);
+        ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+        return;
     }
-    
-    putCharInBuffer(lastChar);
-    
-    if (inlineAllowed) { appendIndentation = FALSE; }
-    
+
+    putCharInBuffer(ctx, lastChar);
+
+    if (inlineAllowed) { ctx->appendIndentation = FALSE; }
+
     /* there was no node open */
-    lastNodeOpen = FALSE;
+    ctx->lastNodeOpen = FALSE;
 }
 
-void processDoctype(void)
+void processDoctype(PrettyPrintingContext* ctx)
 {
     bool loop = TRUE;
-    
-    putNextCharsInBuffer(9); /* put the '<!DOCTYPE' into the buffer */
-    
-    while(loop)
+
+    putNextCharsInBuffer(ctx, 9); /* put the '<!DOCTYPE' into the buffer */
+
+    while(loop && ctx->result == PRETTY_PRINTING_SUCCESS)
     {
         int nextChar;
-        
-        readWhites(TRUE);
-        putCharInBuffer(' '); /* only one space for the attributes */
-        
-        nextChar = readNextChar();
-        while(!isWhite(nextChar) && 
+
+        readWhites(ctx, TRUE);
+        putCharInBuffer(ctx, ' '); /* only one space for the attributes */
+
+        nextChar = readNextChar(ctx);
+        while(!isWhite(nextChar) &&
               !isQuote(nextChar) &&  /* begins a quoted text */
               nextChar != '=' && /* begins an attribute */
               nextChar != '>' &&  /* end of doctype */
-              nextChar != '[') /* inner <!ELEMENT> types */
+              nextChar != '[' && /* inner <!ELEMENT> types */
+              ctx->result == PRETTY_PRINTING_SUCCESS)
         {
-            putCharInBuffer(nextChar);
-            nextChar = readNextChar();
+            putCharInBuffer(ctx, nextChar);
+            nextChar = readNextChar(ctx);
         }
-        
-        if (isWhite(nextChar)) {} /* do nothing, just let the next loop do the job */
+
+        if (ctx->result != PRETTY_PRINTING_SUCCESS) {} /* the XML ends too early */
+        else if (isWhite(nextChar)) {} /* do nothing, just let the next loop do the job */
         else if (isQuote(nextChar) || nextChar == '=')
         {
             char quote;
-            
+            char quoteChars[2];
+
             if (nextChar == '=')
             {
-                putCharInBuffer(nextChar);
-                nextChar = readNextChar(); /* now we should have a quote */
-                
-                if (!isQuote(nextChar)) 
-                { 
-                    printError("processDoctype : the next char should be a quote (not '%c')", nextChar); 
-                    result = PRETTY_PRINTING_INVALID_CHAR_ERROR; 
-                    return; 
+                putCharInBuffer(ctx, nextChar);
+                nextChar = readNextChar(ctx); /* now we should have a quote */
+
+                if (!isQuote(nextChar))
+                {
+                    printError(ctx, "processDoctype : the next char should be a quote (not '%c')", nextChar);
+                    ctx->result = PRETTY_PRINTING_INVALID_CHAR_ERROR;
+                    return;
                 }
             }
-            
+
             /* simply process the content */
             quote = nextChar;
-            do
-            {
-                putCharInBuffer(nextChar);
-                nextChar = readNextChar();
-            }
-            while (nextChar != quote);
-            putCharInBuffer(nextChar); /* now the last char is the last quote */
+            quoteChars[0] = quote;
+            quoteChars[1] = '\0';
+            putCharInBuffer(ctx, quote);
+            putNextCharsInBuffer(ctx, countCharsUntil(ctx, quoteChars));
+            putNextCharsInBuffer(ctx, 1); /* now the last char is the last quote */
         }
         else if (nextChar == '>') /* end of doctype */
         {
-            putCharInBuffer(nextChar);
+            putCharInBuffer(ctx, nextChar);
             loop = FALSE;
         }
         else /* the char is a '[' => not supported yet */
         {
-            printError("DOCTYPE inner ELEMENT is currently not supported by PrettyPrinter\n");
-            result = PRETTY_PRINTING_NOT_SUPPORTED_YET;
+            printError(ctx, "DOCTYPE inner ELEMENT is currently not supported by PrettyPrinter\n");
+            ctx->result = PRETTY_PRINTING_NOT_SUPPORTED_YET;
             loop = FALSE;
         }
     }
 }
 
-void processDoctypeElement(void)
+void processDoctypeElement(PrettyPrintingContext* ctx)
 {
-    printError("ELEMENT is currently not supported by PrettyPrinter\n");
-    result = PRETTY_PRINTING_NOT_SUPPORTED_YET;
+    printError(ctx, "ELEMENT is currently not supported by PrettyPrinter\n");
+    ctx->result = PRETTY_PRINTING_NOT_SUPPORTED_YET;
 }
 
-void printError(const char *msg, ...)
+void printError(PrettyPrintingContext* ctx, const char *msg, ...)
 {
     va_list va;
     va_start(va, msg);
@@ -1137,24 +1343,32 @@ void printError(const char *msg, ...)
     #endif
     va_end(va);
 
-    printDebugStatus();
+    printDebugStatus(ctx);
 }
 
-void printDebugStatus(void)
+void printDebugStatus(PrettyPrintingContext* ctx)
 {
+    /* only show the input around the error, it may be huge (and is not always NUL-terminated) */
+    int start = ctx->inputBufferIndex > 80 ? ctx->inputBufferIndex-80 : 0;
+    int end = ctx->inputBufferIndex+80 < ctx->inputBufferLength ? ctx->inputBufferIndex+80 : ctx->inputBufferLength;
+
     #ifdef HAVE_GLIB
-    g_debug("\n===== INPUT =====\n%s\n=================\ninputLength = %d\ninputIndex = %d\noutputLength = %d\noutputIndex = %d\n", 
-            inputBuffer, 
-            inputBufferLength, 
-            inputBufferIndex,
-            xmlPrettyPrintedLength,
-            xmlPrettyPrintedIndex);
+    g_debug("\n===== INPUT (from %d) =====\n%.*s\n=================\ninputLength = %d\ninputIndex = %d\noutputLength = %d\noutputIndex = %d\n",
+            start,
+            end-start,
+            ctx->inputBuffer+start,
+            ctx->inputBufferLength,
+            ctx->inputBufferIndex,
+            ctx->xmlPrettyPrintedLength,
+            ctx->xmlPrettyPrintedIndex);
     #else
-    PP_ERROR("\n===== INPUT =====\n%s\n=================\ninputLength = %d\ninputIndex = %d\noutputLength = %d\noutputIndex = %d\n", 
-            inputBuffer, 
-            inputBufferLength, 
-            inputBufferIndex,
-            xmlPrettyPrintedLength,
-            xmlPrettyPrintedIndex);
+    PP_ERROR("\n===== INPUT (from %d) =====\n%.*s\n=================\ninputLength = %d\ninputIndex = %d\noutputLength = %d\noutputIndex = %d\n",
+            start,
+            end-start,
+            ctx->inputBuffer+start,
+            ctx->inputBufferLength,
+            ctx->inputBufferIndex,
+            ctx->xmlPrettyPrintedLength,
+            ctx->xmlPrettyPrintedIndex);
     #endif
 }
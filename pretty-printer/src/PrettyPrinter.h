@@ -82,9 +82,19 @@ typedef struct
 }
 PrettyPrintingOptions;
 
+/**
+ * Receives the formatted XML chunk by chunk (the data is not NUL-terminated). It
+ * must return FALSE if the data could not be written, which stops the pretty-printing.
+ */
+typedef bool (*PrettyPrintingWriter)(const char* data, int length, void* userData);
+
 /*========================================== FUNCTIONS =========================================================*/
 
 int processXMLPrettyPrinting(char** xml, int* length, PrettyPrintingOptions* ppOptions);    /* process the pretty-printing on a valid xml string (no check done !!!). The ppOptions ARE NOT FREE-ED after processing. The method returns 0 if the pretty-printing has been done. */
+int processXMLPrettyPrintingStream(const char* xml, int length, PrettyPrintingOptions* ppOptions, PrettyPrintingWriter writer, void* userData); /* same as above, but the xml is left untouched (it does not need to be NUL-terminated) and the result is given to the writer by chunks */
+#ifdef HAVE_GLIB
+int processXMLPrettyPrintingFile(const char* fileName, PrettyPrintingOptions* ppOptions, PrettyPrintingWriter writer, void* userData); /* same as above on a file, which is mapped into memory instead of being read */
+#endif
 PrettyPrintingOptions* createDefaultPrettyPrintingOptions(void);                            /* creates a default PrettyPrintingOptions object */
 
 #endif
@@ -0,0 +1,462 @@
+/**
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Line based diff (Myers' O(ND) algorithm in linear space), used to apply
+ * the formatted XML as a few replacements instead of replacing the whole text.
+ *
+ * The comparison (addHunk, compareLines, bisectLines) is adapted from
+ * geanyvc/src/linediff.c, as plugins can't share code: apply a fix made to
+ * one of them to the other one as well.
+ */
+
+#include <string.h>
+
+#include "TextDiff.h"
+
+/*======================= DEFINES ======================================================================*/
+
+#define TEXT_DIFF_MAX_COST 1024                                  /* parts differing by more lines are replaced at once (bounds the time spent on rewritten texts) */
+
+/*======================= STRUCTURES ===================================================================*/
+
+typedef struct
+{
+    const char* start;                                            /* first char of the line (not NUL-terminated) */
+    int length;                                                   /* length of the line, including its line break */
+}
+TextLine;
+
+typedef struct
+{
+    const char* text;                                             /* the whole text */
+    TextLine* lines;                                              /* lines of the text */
+    int* lineStarts;                                              /* offset of each line, plus the length of the text */
+    int* lineIds;                                                 /* equal lines have equal ids */
+    int lineCount;                                                /* number of lines */
+}
+TextLines;
+
+typedef struct
+{
+    const int* a;                                                 /* line ids of the old text */
+    const int* b;                                                 /* line ids of the new text */
+    GArray* hunks;                                                /* changed lines (TextDiffHunk with line numbers) */
+}
+LineDiff;
+
+/*======================= FUNCTIONS ====================================================================*/
+
+static void splitLines(TextLines* textLines, const char* text, int length); /* fills the lines of the text */
+static void setLineIds(TextLines* textLines, GHashTable* ids);   /* gives an id to each line */
+static guint hashLine(gconstpointer line);                       /* hash function of a TextLine */
+static gboolean equalLines(gconstpointer line1, gconstpointer line2); /* equality function of TextLine */
+static void addHunk(LineDiff* diff, int a0, int a1, int b0, int b1); /* adds the changed lines [a0, a1[ -> [b0, b1[ */
+static void compareLines(LineDiff* diff, int a0, int a1, int b0, int b1); /* compares the lines [a0, a1[ with [b0, b1[ */
+static void bisectLines(LineDiff* diff, int a0, int a1, int b0, int b1); /* splits the comparison at the middle of the shortest edit */
+
+/*============================================ PUBLIC FUNCTIONS ========================================*/
+
+GArray* computeTextDiff(const char* oldText, int oldLength, const char* newText, int newLength)
+{
+    GHashTable* ids = g_hash_table_new(hashLine, equalLines);
+    GArray* hunks = g_array_new(FALSE, FALSE, sizeof(TextDiffHunk));
+    TextLines oldLines;
+    TextLines newLines;
+    LineDiff diff;
+    guint i;
+
+    splitLines(&oldLines, oldText, oldLength);
+    splitLines(&newLines, newText, newLength);
+    setLineIds(&oldLines, ids);
+    setLineIds(&newLines, ids);
+
+    diff.a = oldLines.lineIds;
+    diff.b = newLines.lineIds;
+    diff.hunks = g_array_new(FALSE, FALSE, sizeof(TextDiffHunk));
+    compareLines(&diff, 0, oldLines.lineCount, 0, newLines.lineCount);
+
+    /* converts the lines into offsets, and only keep the chars that changed in the lines */
+    for (i=0 ; i<diff.hunks->len ; ++i)
+    {
+        TextDiffHunk* lineHunk = &g_array_index(diff.hunks, TextDiffHunk, i);
+        int oldStart = oldLines.lineStarts[lineHunk->oldStart];
+        int oldEnd = oldLines.lineStarts[lineHunk->oldStart+lineHunk->oldLength];
+        int newStart = newLines.lineStarts[lineHunk->newStart];
+        int newEnd = newLines.lineStarts[lineHunk->newStart+lineHunk->newLength];
+        TextDiffHunk hunk;
+
+        while (oldStart < oldEnd && newStart < newEnd && oldText[oldStart] == newText[newStart])
+        {
+            ++oldStart;
+            ++newStart;
+        }
+        while (oldStart < oldEnd && newStart < newEnd && oldText[oldEnd-1] == newText[newEnd-1])
+        {
+            --oldEnd;
+            --newEnd;
+        }
+
+        hunk.oldStart = oldStart;
+        hunk.oldLength = oldEnd-oldStart;
+        hunk.newStart = newStart;
+        hunk.newLength = newEnd-newStart;
+        g_array_append_val(hunks, hunk);
+    }
+
+    g_array_free(diff.hunks, TRUE);
+    g_hash_table_destroy(ids);
+    g_free(oldLines.lines);
+    g_free(oldLines.lineStarts);
+    g_free(oldLines.lineIds);
+    g_free(newLines.lines);
+    g_free(newLines.lineStarts);
+    g_free(newLines.lineIds);
+
+    return hunks;
+}
+
+/*============================================ PRIVATE FUNCTIONS =======================================*/
+
+void splitLines(TextLines* textLines, const char* text, int length)
+{
+    int i;
+    int line;
+    int lineCount = 1;
+
+    /* a line ends with '\n', '\r\n' or '\r' */
+    for (i=0 ; i<length ; ++i)
+    {
+        if (text[i] == '\n' || (text[i] == '\r' && (i+1 == length || text[i+1] != '\n'))) { ++lineCount; }
+    }
+
+    textLines->text = text;
+    textLines->lineCount = lineCount;
+    textLines->lines = g_new(TextLine, lineCount);
+    textLines->lineStarts = g_new(int, lineCount+1);
+    textLines->lineIds = g_new(int, lineCount);
+
+    line = 0;
+    textLines->lineStarts[0] = 0;
+    for (i=0 ; i<length ; ++i)
+    {
+        if (text[i] == '\n' || (text[i] == '\r' && (i+1 == length || text[i+1] != '\n')))
+        {
+            textLines->lineStarts[++line] = i+1;
+        }
+    }
+    textLines->lineStarts[lineCount] = length;
+
+    for (line=0 ; line<lineCount ; ++line)
+    {
+        textLines->lines[line].start = text+textLines->lineStarts[line];
+        textLines->lines[line].length = textLines->lineStarts[line+1]-textLines->lineStarts[line];
+    }
+}
+
+void setLineIds(TextLines* textLines, GHashTable* ids)
+{
+    int line;
+    for (line=0 ; line<textLines->lineCount ; ++line)
+    {
+        TextLine* textLine = &textLines->lines[line];
+        gpointer id = g_hash_table_lookup(ids, textLine);
+        if (id == NULL)
+        {
+            id = GINT_TO_POINTER(g_hash_table_size(ids)+1);
+            g_hash_table_insert(ids, textLine, id);
+        }
+        textLines->lineIds[line] = GPOINTER_TO_INT(id);
+    }
+}
+
+guint hashLine(gconstpointer line)
+{
+    const TextLine* textLine = line;
+    guint hash = 5381;
+    int i;
+
+    for (i=0 ; i<textLine->length ; ++i)
+    {
+        hash = (hash << 5) + hash + (guchar)textLine->start[i];
+    }
+
+    return hash;
+}
+
+gboolean equalLines(gconstpointer line1, gconstpointer line2)
+{
+    const TextLine* textLine1 = line1;
+    const TextLine* textLine2 = line2;
+
+    return textLine1->length == textLine2->length &&
+           memcmp(textLine1->start, textLine2->start, textLine1->length) == 0;
+}
+
+void addHunk(LineDiff* diff, int a0, int a1, int b0, int b1)
+{
+    TextDiffHunk hunk;
+
+    if (a0 == a1 && b0 == b1) { return; }
+
+    /* the halves of a bisection meet where a change ends and the next one begins */
+    if (diff->hunks->len > 0)
+    {
+        TextDiffHunk* last = &g_array_index(diff->hunks, TextDiffHunk, diff->hunks->len-1);
+        if (last->oldStart+last->oldLength == a0 && last->newStart+last->newLength == b0)
+        {
+            last->oldLength += a1-a0;
+            last->newLength += b1-b0;
+            return;
+        }
+    }
+
+    hunk.oldStart = a0;
+    hunk.oldLength = a1-a0;
+    hunk.newStart = b0;
+    hunk.newLength = b1-b0;
+    g_array_append_val(diff->hunks, hunk);
+}
+
+void compareLines(LineDiff* diff, int a0, int a1, int b0, int b1)
+{
+    /* the common lines at the beginning and at the end, usually most of them */
+    while (a0 < a1 && b0 < b1 && diff->a[a0] == diff->b[b0])
+    {
+        ++a0;
+        ++b0;
+    }
+    while (a0 < a1 && b0 < b1 && diff->a[a1-1] == diff->b[b1-1])
+    {
+        --a1;
+        --b1;
+    }
+
+    if (a0 == a1 || b0 == b1) { addHunk(diff, a0, a1, b0, b1); }
+    else { bisectLines(diff, a0, a1, b0, b1); }
+}
+
+void bisectLines(LineDiff* diff, int a0, int a1, int b0, int b1)
+{
+    const int* a = diff->a+a0;
+    const int* b = diff->b+b0;
+    int n = a1-a0;
+    int m = b1-b0;
+    int maxD = (n+m+1)/2;
+    int vOffset = maxD;
+    int vLength = 2*maxD+2;
+    int delta = n-m;
+    gboolean front = (delta%2 != 0);
+    int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+    int* v1;
+    int* v2;
+    int d, k1, k2, i;
+    int x1 = 0, y1 = 0, x2, y2;
+
+    /* searches the shortest edit from both ends at the same time, up to the middle */
+    v1 = g_new(int, vLength);
+    v2 = g_new(int, vLength);
+    for (i=0 ; i<vLength ; ++i)
+    {
+        v1[i] = -1;
+        v2[i] = -1;
+    }
+    v1[vOffset+1] = 0;
+    v2[vOffset+1] = 0;
+
+    for (d=0 ; d<maxD && d<TEXT_DIFF_MAX_COST ; ++d)
+    {
+        /* forward path */
+        for (k1=-d+k1start ; k1<=d-k1end ; k1+=2)
+        {
+            int k1Offset = vOffset+k1;
+
+            if (k1 == -d || (k1 != d && v1[k1Offset-1] < v1[k1Offset+1])) { x1 = v1[k1Offset+1]; }
+            else { x1 = v1[k1Offset-1]+1; }
+            y1 = x1-k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1])
+            {
+                ++x1;
+                ++y1;
+            }
+            v1[k1Offset] = x1;
+            if (x1 > n) { k1end += 2; }
+            else if (y1 > m) { k1start += 2; }
+            else if (front)
+            {
+                int k2Offset = vOffset+delta-k1;
+                if (k2Offset >= 0 && k2Offset < vLength && v2[k2Offset] != -1 && x1 >= n-v2[k2Offset])
+                {
+                    goto split;
+                }
+            }
+        }
+
+        /* reverse path */
+        for (k2=-d+k2start ; k2<=d-k2end ; k2+=2)
+        {
+            int k2Offset = vOffset+k2;
+
+            if (k2 == -d || (k2 != d && v2[k2Offset-1] < v2[k2Offset+1])) { x2 = v2[k2Offset+1]; }
+            else { x2 = v2[k2Offset-1]+1; }
+            y2 = x2-k2;
+            while (x2 < n && y2 < m && a[n-x2-1] == b[m-y2-1])
+            {
+                ++x2;
+                ++y2;
+            }
+            v2[k2Offset] = x2;
+            if (x2 > n) { k2end += 2; }
+            else if (y2 > m) { k2start += 2; }
+            else if (!front)
+            {
+                int k1Offset = vOffset+delta-k2;
+                if (k1Offset >= 0 && k1Offset < vLength && v1[k1Offset] != -1)
+                {
+                    x1 = v1[k1Offset];
+                    y1 = vOffset+x1-k1Offset;
+                    if (x1 >= n-x2) { goto split; }
+                }
+            }
+        }
+    }
+
+    /* no common line, or too many differences */
+    g_free(v1);
+    g_free(v2);
+    addHunk(diff, a0, a1, b0, b1);
+    return;
+
+split:
+    g_free(v1);
+    g_free(v2);
+    compareLines(diff, a0, a0+x1, b0, b0+y1);
+    compareLines(diff, a0+x1, a1, b0+y1, b1);
+}
+
+#ifdef UNITTESTS
+#include <check.h>
+
+/* applies the hunks to the old text, from the end like the plugin does */
+static void checkTextDiff(const char* oldText, const char* newText)
+{
+    int oldLength = strlen(oldText);
+    int newLength = strlen(newText);
+    GArray* hunks = computeTextDiff(oldText, oldLength, newText, newLength);
+    GString* text = g_string_new_len(oldText, oldLength);
+    int previousStart = oldLength;
+    guint i;
+
+    for (i=hunks->len ; i>0 ; --i)
+    {
+        TextDiffHunk* hunk = &g_array_index(hunks, TextDiffHunk, i-1);
+        fail_unless(hunk->oldStart+hunk->oldLength <= previousStart,
+                    "hunk %u overlaps the next one in \"%s\" -> \"%s\"\n", i-1, oldText, newText);
+        g_string_erase(text, hunk->oldStart, hunk->oldLength);
+        g_string_insert_len(text, hunk->oldStart, newText+hunk->newStart, hunk->newLength);
+        previousStart = hunk->oldStart;
+    }
+
+    fail_unless(text->len == (gsize)newLength && memcmp(text->str, newText, newLength) == 0,
+                "expected: \"%s\", get \"%s\" from \"%s\"\n", newText, text->str, oldText);
+    if (strcmp(oldText, newText) == 0)
+    {
+        fail_unless(hunks->len == 0, "expected: 0 hunks, get %u\n", hunks->len);
+    }
+
+    g_string_free(text, TRUE);
+    g_array_free(hunks, TRUE);
+}
+
+START_TEST(test_text_diff_compare)
+{
+    GArray* hunks;
+    TextDiffHunk* h;
+
+    /* only the changed chars of the changed lines are replaced */
+    hunks = computeTextDiff("<a>\n<b/>\n</a>\n", 14, "<a>\n  <b/>\n</a>\n", 16);
+    fail_unless(hunks->len == 1, "expected: 1 hunk, get %u\n", hunks->len);
+    h = &g_array_index(hunks, TextDiffHunk, 0);
+    fail_unless(h->oldStart == 4 && h->oldLength == 0 && h->newStart == 4 && h->newLength == 2,
+                "expected: 4,0 -> 4,2, get %d,%d -> %d,%d\n",
+                h->oldStart, h->oldLength, h->newStart, h->newLength);
+    g_array_free(hunks, TRUE);
+}
+
+END_TEST;
+
+START_TEST(test_text_diff_round_trip)
+{
+    static const char* lines[] = { "<a>\n", "  <b/>\r\n", "text\n", "\n", "x\r", "  <c>y</c>\n", "z" };
+    static const char* texts[][2] = {
+        { "", "" },
+        { "", "<a>\n</a>\n" },
+        { "<a>\n</a>\n", "" },
+        { "<a>\n</a>\n", "<a>\n</a>\n" },
+        { "<a>\n</a>", "<a>\n</a>\n" },
+        { "<a>\n<b/>\n</a>\n", "<a>\r\n  <b/>\r\n</a>\r\n" },
+        { "<a><b>x</b><c/></a>", "<a>\n  <b>x</b>\n  <c/>\n</a>" },
+        { "a\nb\nc\nd\n", "a\nB\nc\nd\ne\n" },
+        { "a\nb\na\nb\n", "b\na\nb\na\n" },
+        { "a\rb\r\nc\n", "a\nb\rc\r\n" },
+    };
+    guint32 seed = 1;
+    guint i;
+    int j;
+
+    for (i=0 ; i<G_N_ELEMENTS(texts) ; ++i)
+    {
+        checkTextDiff(texts[i][0], texts[i][1]);
+    }
+
+    /* texts made of a few lines, so that most of them have common parts */
+    for (i=0 ; i<1000 ; ++i)
+    {
+        GString* randomTexts[2];
+        int t;
+
+        for (t=0 ; t<2 ; ++t)
+        {
+            int count;
+            randomTexts[t] = g_string_new("");
+            seed = seed*1103515245+12345;
+            count = (seed >> 16)%12;
+            for (j=0 ; j<count ; ++j)
+            {
+                seed = seed*1103515245+12345;
+                g_string_append(randomTexts[t], lines[(seed >> 16)%G_N_ELEMENTS(lines)]);
+            }
+        }
+
+        checkTextDiff(randomTexts[0]->str, randomTexts[1]->str);
+        g_string_free(randomTexts[0], TRUE);
+        g_string_free(randomTexts[1], TRUE);
+    }
+}
+
+END_TEST;
+
+
+TCase* text_diff_test_case_create(void)
+{
+    TCase* tc_text_diff = tcase_create("textdiff");
+    tcase_add_test(tc_text_diff, test_text_diff_compare);
+    tcase_add_test(tc_text_diff, test_text_diff_round_trip);
+    return tc_text_diff;
+}
+
+
+#endif
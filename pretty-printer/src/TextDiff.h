@@ -0,0 +1,43 @@
+/**
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PP_TEXT_DIFF_H
+#define PP_TEXT_DIFF_H
+
+/*========================================== INCLUDES ==========================================================*/
+
+#include <glib.h>
+
+/*========================================== STRUCTURES =======================================================*/
+
+/**
+ * A part of the old text to replace by a part of the new text. The offsets
+ * are in bytes.
+ */
+typedef struct
+{
+      int oldStart;                                                                         /* offset of the replaced text into the old text */
+      int oldLength;                                                                        /* length of the replaced text */
+      int newStart;                                                                         /* offset of the replacement into the new text */
+      int newLength;                                                                        /* length of the replacement */
+}
+TextDiffHunk;
+
+/*========================================== FUNCTIONS =========================================================*/
+
+GArray* computeTextDiff(const char* oldText, int oldLength, const char* newText, int newLength); /* compares the texts line by line and returns the TextDiffHunk changing the old one into the new one, sorted by offset. The texts do not need to be NUL-terminated. */
+
+#endif
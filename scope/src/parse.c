@@ -108,6 +108,55 @@ static const ParseRoute parse_routes[] =
 	{ NULL, NULL, '\0', '\0', 0 }
 };
 
+/* The routes are indexed by record class ("^done") and, if the prefix names one, by the first
+   result ("^done,bkpt"). Each key maps to the index + 1 of its first route, parse_route_next
+   links the following routes with the same key in table order. */
+static GHashTable *parse_route_heads;
+static guint parse_route_next[G_N_ELEMENTS(parse_routes)];
+
+#define ROUTE_KEY_MAX 0x40
+
+static size_t parse_route_key_length(const char *text, size_t class_len)
+{
+	if (text[class_len] == ',')
+	{
+		const char *s = text + class_len + 1;
+
+		while (isalnum(*s) || (strchr("_-", *s) && *s))
+			s++;
+
+		if (*s == '=')
+			return s - text;
+	}
+
+	return class_len;
+}
+
+static const ParseRoute *parse_route_find(const char *message, size_t key_len, const char *token,
+	const ParseRoute *limit)
+{
+	char key[ROUTE_KEY_MAX];
+	guint index;
+
+	if (key_len >= ROUTE_KEY_MAX)
+		return limit;
+
+	memcpy(key, message, key_len);
+	key[key_len] = '\0';
+
+	for (index = GPOINTER_TO_UINT(g_hash_table_lookup(parse_route_heads, key));
+		index && parse_routes + index - 1 < limit; index = parse_route_next[index - 1])
+	{
+		const ParseRoute *route = parse_routes + index - 1;
+
+		if (g_str_has_prefix(message, route->prefix))
+			if (!route->mark || (token && (route->mark == '*' || route->mark == *token)))
+				return route;
+	}
+
+	return limit;
+}
+
 static void parse_array_append(GArray *nodes, const char *name, ParseNodeType type, void *value)
 {
 	ParseNode *node = (ParseNode *) array_append(nodes);
@@ -225,13 +274,18 @@ static char *parse_text(GArray *nodes, char *text, char end, char newline)
 
 void parse_message(char *message, const char *token)
 {
-	const ParseRoute *route;
+	size_t class_len = strcspn(message, ",");
+	size_t key_len = parse_route_key_length(message, class_len);
+	const ParseRoute *route = parse_routes + G_N_ELEMENTS(parse_routes) - 1;
 
-	for (route = parse_routes; route->prefix; route++)
-		if (g_str_has_prefix(message, route->prefix))
-			if (!route->mark || (token && (route->mark == '*' || route->mark == *token)))
-				break;
+	/* the first matching route in table order, as with a linear scan */
+	if (key_len > class_len)
+		route = parse_route_find(message, key_len, token, route);
+	route = parse_route_find(message, class_len, token, route);
 
+	/* The whole record is parsed before the callback runs: the callbacks walk node->value
+	   directly, so a lazy parser would have to change all of them. parse_text() works in
+	   place without copying the strings, and unrouted records are never parsed. */
 	if (route->callback)
 	{
 		GArray *nodes = array_new(ParseNode, 0x10);
@@ -609,12 +663,26 @@ void parse_save(GKeyFile *config)
 
 void parse_init(void)
 {
+	guint i;
+
 	errors = g_string_sized_new(MAXLEN);
 	parse_modes = array_new(ParseMode, 0x10);
+	parse_route_heads = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	for (i = G_N_ELEMENTS(parse_routes) - 1; i > 0; i--)
+	{
+		const char *prefix = parse_routes[i - 1].prefix;
+		size_t class_len = strcspn(prefix, ",");
+		char *key = g_strndup(prefix, parse_route_key_length(prefix, class_len));
+
+		parse_route_next[i - 1] = GPOINTER_TO_UINT(g_hash_table_lookup(parse_route_heads, key));
+		g_hash_table_insert(parse_route_heads, key, GUINT_TO_POINTER(i));
+	}
 }
 
 void parse_finalize(void)
 {
+	g_hash_table_destroy(parse_route_heads);
 	g_string_free(errors, TRUE);
 	array_free(parse_modes, (GFreeFunc) parse_mode_free);
 }
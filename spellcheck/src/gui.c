@@ -47,11 +47,13 @@ typedef struct
 } SpellClickInfo;
 static SpellClickInfo clickinfo;
 
+/* The range of a document modified since the last check while typing, it grows with
+ * every modification until it is checked */
 typedef struct
 {
 	GeanyDocument *doc;
-	gint line_number;
-	gint line_count;
+	gint start;
+	gint end;
 	guint check_while_typing_idle_source_id;
 } CheckLineData;
 static CheckLineData check_line_data;
@@ -396,38 +398,25 @@ void sc_gui_update_editor_menu_cb(GObject *obj, const gchar *word, gint pos,
 }
 
 
-static void indicator_clear_on_line(GeanyDocument *doc, gint line_number)
+static void check_pending_range(void)
 {
-	gint start_pos, length;
-
-	g_return_if_fail(doc != NULL);
+	GeanyDocument *doc = check_line_data.doc;
 
-	start_pos = sci_get_position_from_line(doc->editor->sci, line_number);
-	length = sci_get_line_length(doc->editor->sci, line_number);
+	check_line_data.doc = NULL;
+	if (! DOC_VALID(doc))
+		return;
 
-	sci_indicator_clear(doc->editor->sci, start_pos, length);
+	if (sc_speller_process_range(doc, check_line_data.start, check_line_data.end) != 0)
+	{
+		if (sc_info->use_msgwin)
+			msgwin_switch_tab(MSG_MESSAGE, FALSE);
+	}
 }
 
 
 static gboolean check_lines(gpointer data)
 {
-	GeanyDocument *doc = check_line_data.doc;
-	gchar *line;
-	gint line_number = check_line_data.line_number;
-	gint line_count = check_line_data.line_count;
-	gint i;
-
-	for (i = 0; i < line_count; i++)
-	{
-		line = sci_get_line(doc->editor->sci, line_number);
-		indicator_clear_on_line(doc, line_number);
-		if (sc_speller_process_line(doc, line_number, line) != 0)
-		{
-			if (sc_info->use_msgwin)
-				msgwin_switch_tab(MSG_MESSAGE, FALSE);
-		}
-		g_free(line);
-	}
+	check_pending_range();
 	check_line_data.check_while_typing_idle_source_id = 0;
 	return FALSE;
 }
@@ -460,46 +449,81 @@ static gboolean need_delay(void)
 }
 
 
-static void check_on_text_changed(GeanyDocument *doc, gint position, gint lines_added)
+/* Maps a position from before the deletion of length bytes at position to after it */
+static gint position_after_delete(gint pos, gint position, gint length)
+{
+	if (pos <= position)
+		return pos;
+	if (pos >= position + length)
+		return pos - length;
+	return position;
+}
+
+
+static void check_on_text_changed(GeanyDocument *doc, gint modification_type,
+								  gint position, gint length)
 {
-	gint line_number;
-	gint line_count;
-
-	/* Iterating over all lines which changed as indicated by lines_added. lines_added is 0
-	 * if only a lines has changed, in this case set it to 1. Otherwise, iterating over all
-	 * new lines makes spell checking work for pasted text. */
-	line_count = MAX(1, lines_added);
-
-	line_number = sci_get_line_from_position(doc->editor->sci, position);
-	/* TODO: storing these information in the global check_line_data struct isn't that good.
-	 * The data gets overwritten when a new line is inserted and so there is a chance that thep
-	 * previous line is not checked to the end. One solution could be to simple maintain a list
-	 * of line numbers which needs to be checked and do this is the timeout handler. */
-	check_line_data.doc = doc;
-	check_line_data.line_number = line_number;
-	check_line_data.line_count = line_count;
+	/* a pending range of another document is checked right away */
+	if (check_line_data.doc != NULL && check_line_data.doc != doc)
+		check_pending_range();
+
+	if (check_line_data.doc == NULL)
+	{
+		check_line_data.doc = doc;
+		check_line_data.start = position;
+		check_line_data.end = position;
+	}
+
+	/* keep the pending range in sync with the text and add the modified range to it */
+	if (modification_type & SC_MOD_INSERTTEXT)
+	{
+		if (position < check_line_data.start)
+			check_line_data.start += length;
+		if (position <= check_line_data.end)
+			check_line_data.end += length;
+		check_line_data.start = MIN(check_line_data.start, position);
+		check_line_data.end = MAX(check_line_data.end, position + length);
+	}
+	else
+	{
+		check_line_data.start = position_after_delete(check_line_data.start, position, length);
+		check_line_data.end = position_after_delete(check_line_data.end, position, length);
+		check_line_data.start = MIN(check_line_data.start, position);
+		check_line_data.end = MAX(check_line_data.end, position);
+	}
 
 	/* check only once in a while */
 	if (! need_delay())
-		check_lines(NULL);
+		check_pending_range();
 }
 
 
 gboolean sc_gui_editor_notify(GObject *object, GeanyEditor *editor,
 							  SCNotification *nt, gpointer data)
 {
-	if (! sc_info->check_while_typing)
-		return FALSE;
-
 	if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
 	{
-		check_on_text_changed(editor->document, nt->position, nt->linesAdded);
+		/* a running check of the document is working on outdated positions */
+		sc_speller_check_document_cancel(editor->document);
+
+		if (sc_info->check_while_typing)
+			check_on_text_changed(editor->document, nt->modificationType,
+				nt->position, nt->length);
 	}
 
 	return FALSE;
 }
 
 
+void sc_gui_document_close_cb(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	sc_speller_check_document_cancel(doc);
+
+	if (check_line_data.doc == doc)
+		check_line_data.doc = NULL;
+}
+
+
 #if ! GTK_CHECK_VERSION(2, 16, 0)
 static void gtk_menu_item_set_label(GtkMenuItem *menu_item, const gchar *label)
 {
@@ -39,6 +39,8 @@ void sc_gui_update_editor_menu_cb(GObject *obj, const gchar *word, gint pos,
 gboolean sc_gui_editor_notify(GObject *object, GeanyEditor *editor,
 							  SCNotification *nt, gpointer data);
 
+void sc_gui_document_close_cb(GObject *obj, GeanyDocument *doc, gpointer user_data);
+
 void sc_gui_update_toolbar(void);
 
 void sc_gui_update_menu(void);
@@ -70,6 +70,7 @@ PluginCallback plugin_callbacks[] =
 {
 	{ "update-editor-menu", (GCallback) &sc_gui_update_editor_menu_cb, FALSE, NULL },
 	{ "editor-notify", (GCallback) &sc_gui_editor_notify, FALSE, NULL },
+	{ "document-close", (GCallback) &sc_gui_document_close_cb, FALSE, NULL },
 	{ NULL, NULL, FALSE, NULL }
 };
 
@@ -52,7 +52,94 @@ static void dict_describe(const gchar* const lang, const gchar* const name,
 }
 
 
-static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gchar *word,
+/* A document check runs in idle callbacks, each working for at most SC_CHECK_TIME_SLICE
+ * seconds, so checking large documents doesn't block the GUI. */
+#define SC_CHECK_TIME_SLICE		0.02
+/* how many words are checked between two looks at the clock */
+#define SC_CHECK_WORDS_PER_STEP	64
+
+typedef struct
+{
+	GeanyDocument *doc;
+	gint pos;
+	gint end;
+	gint suggestions_found;
+	gboolean cancelled;
+} SpellCheckJob;
+
+static SpellCheckJob *sc_speller_check_job = NULL;
+
+/* Most recently used verdicts of enchant_dict_check() for the current dictionary.
+ * The hash table maps the words to their links in the LRU queue, the most recently used
+ * word being at the head. */
+#define SC_VERDICT_CACHE_SIZE	8192
+
+typedef struct
+{
+	gchar *word;
+	gint verdict;
+} VerdictCacheEntry;
+
+static GHashTable *sc_verdict_cache = NULL;
+static GQueue sc_verdict_queue = G_QUEUE_INIT;
+static guint sc_verdict_cache_hits = 0;
+static guint sc_verdict_cache_misses = 0;
+
+
+static void verdict_cache_clear(void)
+{
+	VerdictCacheEntry *entry;
+
+	if (sc_verdict_cache != NULL)
+		g_hash_table_remove_all(sc_verdict_cache);
+
+	while ((entry = g_queue_pop_head(&sc_verdict_queue)) != NULL)
+	{
+		g_free(entry->word);
+		g_free(entry);
+	}
+}
+
+
+static gint verdict_cache_lookup(const gchar *word)
+{
+	VerdictCacheEntry *entry;
+	GList *link;
+
+	if (sc_verdict_cache == NULL)
+		sc_verdict_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+	link = g_hash_table_lookup(sc_verdict_cache, word);
+	if (link != NULL)
+	{
+		sc_verdict_cache_hits++;
+		g_queue_unlink(&sc_verdict_queue, link);
+		g_queue_push_head_link(&sc_verdict_queue, link);
+		return ((VerdictCacheEntry *) link->data)->verdict;
+	}
+
+	sc_verdict_cache_misses++;
+
+	/* drop the least recently used word if the cache is full */
+	if (g_queue_get_length(&sc_verdict_queue) >= SC_VERDICT_CACHE_SIZE)
+	{
+		entry = g_queue_pop_tail(&sc_verdict_queue);
+		g_hash_table_remove(sc_verdict_cache, entry->word);
+		g_free(entry->word);
+		g_free(entry);
+	}
+
+	entry = g_new(VerdictCacheEntry, 1);
+	entry->word = g_strdup(word);
+	entry->verdict = enchant_dict_check(sc_speller_dict, word, -1);
+	g_queue_push_head(&sc_verdict_queue, entry);
+	g_hash_table_insert(sc_verdict_cache, entry->word, sc_verdict_queue.head);
+
+	return entry->verdict;
+}
+
+
+static gint sc_speller_check_word(GeanyDocument *doc, const gchar *word,
 						   gint start_pos, gint end_pos)
 {
 	gsize n_suggs = 0;
@@ -74,16 +161,17 @@ static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gc
 		return 0;
 
 	/* early out if the word is spelled correctly */
-	if (enchant_dict_check(sc_speller_dict, word, -1) == 0)
+	if (verdict_cache_lookup(word) == 0)
 		return 0;
 
 	editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_ERROR, start_pos, end_pos);
 
-	if (sc_info->use_msgwin && line_number != -1)
+	if (sc_info->use_msgwin)
 	{
 		gsize j;
 		gchar **suggs;
 		GString *str;
+		gint line_number = sci_get_line_from_position(doc->editor->sci, start_pos);
 
 		str = g_string_sized_new(256);
 		suggs = enchant_dict_suggest(sc_speller_dict, word, -1, &n_suggs);
@@ -112,74 +200,173 @@ static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gc
 }
 
 
+/* Checks at most max_words words starting in the range [start, end[. The words are delimited
+ * by Scintilla, so the word characters of the document's filetype are used, and their text is
+ * read directly from the Scintilla buffer. start must not be inside a word.
+ * Returns the position where the next check should start, >= end if the range is done. */
+static gint sc_speller_check_range(GeanyDocument *doc, gint start, gint end, gint max_words,
+						   gint *suggestions_found)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	const gchar *text;
+	GString *str;
+	gint pos = start;
+	gint wend;
+	gint n_words = 0;
+
+	end = MIN(end, sci_get_length(sci));
+	text = (const gchar *) scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	str = g_string_sized_new(256);
+
+	while (n_words < max_words && pos < end)
+	{
+		/* a word starting in the range is checked up to its end */
+		wend = scintilla_send_message(sci, SCI_WORDENDPOSITION, pos, TRUE);
+		if (wend == pos)
+		{
+			/* skip the run of spaces or punctuation */
+			wend = scintilla_send_message(sci, SCI_WORDENDPOSITION, pos, FALSE);
+			pos = MAX(wend, pos + 1);
+			continue;
+		}
+
+		/* words starting with a punctuation word character (e.g. "$var") are not checked */
+		if (! ispunct((guchar) text[pos]))
+		{
+			g_string_truncate(str, 0);
+			g_string_append_len(str, text + pos, wend - pos);
+			*suggestions_found += sc_speller_check_word(doc, str->str, pos, wend);
+		}
+		n_words++;
+		pos = wend;
+	}
+
+	g_string_free(str, TRUE);
+	return pos;
+}
+
+
 gint sc_speller_process_line(GeanyDocument *doc, gint line_number, const gchar *line)
 {
 	gint pos_start, pos_end;
-	gint wstart, wend;
-	GString *str;
 	gint suggestions_found = 0;
-	gchar c;
 
 	g_return_val_if_fail(sc_speller_dict != NULL, 0);
 	g_return_val_if_fail(doc != NULL, 0);
 	g_return_val_if_fail(line != NULL, 0);
 
-	str = g_string_sized_new(256);
-
 	pos_start = sci_get_position_from_line(doc->editor->sci, line_number);
 	pos_end = sci_get_position_from_line(doc->editor->sci, line_number + 1);
 
-	while (pos_start < pos_end)
-	{
-		wstart = scintilla_send_message(doc->editor->sci, SCI_WORDSTARTPOSITION, pos_start, TRUE);
-		wend = scintilla_send_message(doc->editor->sci, SCI_WORDENDPOSITION, wstart, FALSE);
-		if (wstart == wend)
-			break;
-		c = sci_get_char_at(doc->editor->sci, wstart);
-		/* hopefully it's enough to check for these both */
-		if (ispunct(c) || isspace(c))
-		{
-			pos_start++;
-			continue;
-		}
+	sc_speller_check_range(doc, pos_start, pos_end, G_MAXINT, &suggestions_found);
 
-		/* ensure the string has enough allocated memory */
-		if (str->len < (guint)(wend - wstart))
-			g_string_set_size(str, wend - wstart);
+	return suggestions_found;
+}
 
-		sci_get_text_range(doc->editor->sci, wstart, wend, str->str);
 
-		suggestions_found += sc_speller_check_word(doc, line_number, str->str, wstart, wend);
+/* Checks the words touching the range [start, end[, e.g. after the range has been edited. */
+gint sc_speller_process_range(GeanyDocument *doc, gint start, gint end)
+{
+	gint suggestions_found = 0;
 
-		pos_start = wend + 1;
-	}
+	g_return_val_if_fail(sc_speller_dict != NULL, 0);
+	g_return_val_if_fail(doc != NULL, 0);
+
+	start = scintilla_send_message(doc->editor->sci, SCI_WORDSTARTPOSITION, start, TRUE);
+	end = scintilla_send_message(doc->editor->sci, SCI_WORDENDPOSITION, end, TRUE);
+
+	sci_indicator_set(doc->editor->sci, GEANY_INDICATOR_ERROR);
+	sci_indicator_clear(doc->editor->sci, start, end - start);
+
+	sc_speller_check_range(doc, start, end, G_MAXINT, &suggestions_found);
 
-	g_string_free(str, TRUE);
 	return suggestions_found;
 }
 
 
+static void sc_speller_check_job_finish(SpellCheckJob *job)
+{
+	if (job->suggestions_found == 0 && sc_info->use_msgwin)
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("The checked text is spelled correctly."));
+
+	g_debug("Spell check verdict cache: %u hits, %u misses, %u words",
+		sc_verdict_cache_hits, sc_verdict_cache_misses, g_queue_get_length(&sc_verdict_queue));
+
+	ui_progress_bar_stop();
+}
+
+
+static gboolean sc_speller_check_document_idle(gpointer data)
+{
+	SpellCheckJob *job = data;
+	GTimer *timer;
+
+	if (job->cancelled)
+	{
+		g_free(job);
+		return FALSE;
+	}
+
+	timer = g_timer_new();
+	do
+	{
+		job->pos = sc_speller_check_range(job->doc, job->pos, job->end,
+			SC_CHECK_WORDS_PER_STEP, &job->suggestions_found);
+	}
+	while (job->pos < job->end && g_timer_elapsed(timer, NULL) < SC_CHECK_TIME_SLICE);
+	g_timer_destroy(timer);
+
+	if (job->pos < job->end)
+		return TRUE;
+
+	sc_speller_check_job_finish(job);
+	sc_speller_check_job = NULL;
+	g_free(job);
+
+	return FALSE;
+}
+
+
+/* Stops a running check of doc, or of any document if doc is NULL. */
+void sc_speller_check_document_cancel(GeanyDocument *doc)
+{
+	if (sc_speller_check_job == NULL)
+		return;
+	if (doc != NULL && sc_speller_check_job->doc != doc)
+		return;
+
+	/* the job is freed by its idle callback */
+	sc_speller_check_job->cancelled = TRUE;
+	sc_speller_check_job = NULL;
+
+	if (sc_info->use_msgwin)
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("The spell check was interrupted."));
+	ui_progress_bar_stop();
+}
+
+
 void sc_speller_check_document(GeanyDocument *doc)
 {
-	gchar *line;
-	gint i;
 	gint first_line, last_line;
+	gint start, end;
 	gchar *dict_string = NULL;
-	gint suggestions_found = 0;
+	SpellCheckJob *job;
 
 	g_return_if_fail(sc_speller_dict != NULL);
 	g_return_if_fail(doc != NULL);
 
+	sc_speller_check_document_cancel(NULL);
+
 	ui_progress_bar_start(_("Checking"));
 
 	enchant_dict_describe(sc_speller_dict, dict_describe, &dict_string);
 
 	if (sci_has_selection(doc->editor->sci))
 	{
-		first_line = sci_get_line_from_position(
-			doc->editor->sci, sci_get_selection_start(doc->editor->sci));
-		last_line = sci_get_line_from_position(
-			doc->editor->sci, sci_get_selection_end(doc->editor->sci));
+		start = sci_get_selection_start(doc->editor->sci);
+		end = sci_get_selection_end(doc->editor->sci);
+		first_line = sci_get_line_from_position(doc->editor->sci, start);
+		last_line = sci_get_line_from_position(doc->editor->sci, end);
 
 		if (sc_info->use_msgwin)
 			msgwin_msg_add(COLOR_BLUE, -1, NULL,
@@ -187,11 +374,14 @@ void sc_speller_check_document(GeanyDocument *doc)
 				DOC_FILENAME(doc), first_line + 1, last_line + 1, dict_string);
 		g_message("Checking file \"%s\" (lines %d to %d using %s):",
 			DOC_FILENAME(doc), first_line + 1, last_line + 1, dict_string);
+
+		/* include a word the selection starts in */
+		start = scintilla_send_message(doc->editor->sci, SCI_WORDSTARTPOSITION, start, TRUE);
 	}
 	else
 	{
-		first_line = 0;
-		last_line = sci_get_line_count(doc->editor->sci);
+		start = 0;
+		end = sci_get_length(doc->editor->sci);
 		if (sc_info->use_msgwin)
 			msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Checking file \"%s\" (using %s):"),
 				DOC_FILENAME(doc), dict_string);
@@ -199,30 +389,13 @@ void sc_speller_check_document(GeanyDocument *doc)
 	}
 	g_free(dict_string);
 
-	if (first_line == last_line)
-	{
-		line = sci_get_selection_contents(doc->editor->sci);
-		suggestions_found += sc_speller_process_line(doc, first_line, line);
-		g_free(line);
-	}
-	else
-	{
-		for (i = first_line; i < last_line; i++)
-		{
-			line = sci_get_line(doc->editor->sci, i);
-
-			suggestions_found += sc_speller_process_line(doc, i, line);
-
-			/* process other GTK events to keep the GUI being responsive */
-			while (g_main_context_iteration(NULL, FALSE));
+	job = g_new0(SpellCheckJob, 1);
+	job->doc = doc;
+	job->pos = start;
+	job->end = end;
+	sc_speller_check_job = job;
 
-			g_free(line);
-		}
-	}
-	if (suggestions_found == 0 && sc_info->use_msgwin)
-		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("The checked text is spelled correctly."));
-
-	ui_progress_bar_stop();
+	plugin_idle_add(geany_plugin, sc_speller_check_document_idle, job);
 }
 
 
@@ -349,6 +522,7 @@ void sc_speller_add_word(const gchar *word)
 	g_return_if_fail(word != NULL);
 
 	enchant_dict_add_to_pwl(sc_speller_dict, word, -1);
+	verdict_cache_clear();
 }
 
 gboolean sc_speller_dict_check(const gchar *word)
@@ -356,7 +530,7 @@ gboolean sc_speller_dict_check(const gchar *word)
 	g_return_val_if_fail(sc_speller_dict != NULL, FALSE);
 	g_return_val_if_fail(word != NULL, FALSE);
 
-	return enchant_dict_check(sc_speller_dict, word, -1);
+	return verdict_cache_lookup(word);
 }
 
 
@@ -375,6 +549,7 @@ void sc_speller_add_word_to_session(const gchar *word)
 	g_return_if_fail(word != NULL);
 
 	enchant_dict_add_to_session(sc_speller_dict, word, -1);
+	verdict_cache_clear();
 }
 
 
@@ -395,6 +570,8 @@ void sc_speller_reinit_enchant_dict(void)
 	/* Release a previous dict object */
 	if (sc_speller_dict != NULL)
 		enchant_broker_free_dict(sc_speller_broker, sc_speller_dict);
+	/* the cached verdicts belong to the previous dict */
+	verdict_cache_clear();
 
 #if HAVE_ENCHANT_1_5
 	{
@@ -457,6 +634,11 @@ void sc_speller_init(void)
 
 void sc_speller_free(void)
 {
+	sc_speller_check_document_cancel(NULL);
+	verdict_cache_clear();
+	if (sc_verdict_cache != NULL)
+		g_hash_table_destroy(sc_verdict_cache);
+	sc_verdict_cache = NULL;
 	sc_speller_dicts_free();
 	if (sc_speller_dict != NULL)
 		enchant_broker_free_dict(sc_speller_broker, sc_speller_dict);
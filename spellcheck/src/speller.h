@@ -29,8 +29,12 @@
 
 gint sc_speller_process_line(GeanyDocument *doc, gint line_number, const gchar *line);
 
+gint sc_speller_process_range(GeanyDocument *doc, gint start, gint end);
+
 void sc_speller_check_document(GeanyDocument *doc);
 
+void sc_speller_check_document_cancel(GeanyDocument *doc);
+
 void sc_speller_reinit_enchant_dict(void);
 
 gchar *sc_speller_get_default_lang(void);
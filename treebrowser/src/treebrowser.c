@@ -52,6 +52,7 @@ static GtkCellRenderer 		*render_icon, *render_text;
  * ------------------ */
 
 static gboolean 			flag_on_expand_refresh 		= FALSE;
+static gboolean 			flag_browse_sync 			= FALSE;
 
 /* ------------------
  *  CONFIG VARS
@@ -91,7 +92,8 @@ enum
 	TREEBROWSER_RENDER_ICON 							= 0,
 	TREEBROWSER_RENDER_TEXT 							= 1,
 
-	TREEBROWSER_FLAGS_SEPARATOR 						= -1
+	TREEBROWSER_FLAGS_SEPARATOR 						= -1,
+	TREEBROWSER_FLAGS_PLACEHOLDER 						= -2
 };
 
 
@@ -146,6 +148,12 @@ _gtk_cell_layout_get_cells(GtkTreeViewColumn *column)
 
 static void 	project_change_cb(G_GNUC_UNUSED GObject *obj, G_GNUC_UNUSED GKeyFile *config, G_GNUC_UNUSED gpointer data);
 static void 	treebrowser_browse(gchar *directory, gpointer parent);
+static void 	treebrowser_browse_full(gchar *directory, gpointer parent, gboolean sync);
+static void 	treebrowser_cancel_loading(GtkTreeIter *parent);
+static void 	treebrowser_cancel_all_loading(void);
+static void 	treebrowser_watch(const gchar *directory, GtkTreeIter *parent);
+static void 	treebrowser_unwatch(GtkTreeIter *parent);
+static void 	treebrowser_unwatch_all(void);
 static void 	treebrowser_bookmarks_set_state(void);
 static void 	treebrowser_load_bookmarks(void);
 static void 	gtk_tree_store_iter_clear_nodes(gpointer iter, gboolean delete_root);
@@ -184,6 +192,20 @@ tree_view_row_expanded_iter(GtkTreeView *tree_view, GtkTreeIter *iter)
 	return expanded;
 }
 
+/* Expands iter without triggering a refresh from the "row-expanded" handler */
+static void
+treebrowser_expand_iter_silently(GtkTreeIter *iter)
+{
+	GtkTreePath *tree_path;
+	gboolean 	flag = flag_on_expand_refresh;
+
+	tree_path = gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), iter);
+	flag_on_expand_refresh = TRUE;
+	gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), tree_path, FALSE);
+	flag_on_expand_refresh = flag;
+	gtk_tree_path_free(tree_path);
+}
+
 static GdkPixbuf *
 utils_pixbuf_from_stock(const gchar *stock_id)
 {
@@ -198,19 +220,60 @@ utils_pixbuf_from_stock(const gchar *stock_id)
 	return NULL;
 }
 
+#if defined(HAVE_GIO) && GTK_CHECK_VERSION(2, 14, 0)
+/* Content-type icons are memoized by content type, so browsing a directory only
+ * looks up each distinct type in the icon theme once. The type itself is guessed
+ * for each file: globs such as "Makefile.*" or "*.tar.gz" depend on the whole
+ * name, so no part of it is a safe key. The cache is dropped when the icon
+ * theme changes. */
+static GHashTable 			*icon_cache_icons 			= NULL;
+static gulong 				icon_cache_theme_handler 	= 0;
+static guint 				icon_cache_hits 			= 0;
+static guint 				icon_cache_misses 			= 0;
+
+static void
+icon_cache_clear(void)
+{
+	if (icon_cache_icons != NULL)
+	{
+		g_debug("TreeBrowser: icon cache cleared (%u hits, %u misses)", icon_cache_hits, icon_cache_misses);
+		g_hash_table_destroy(icon_cache_icons);
+		icon_cache_icons = NULL;
+	}
+	icon_cache_hits 	= 0;
+	icon_cache_misses 	= 0;
+}
+
+static void
+icon_cache_icon_free(gpointer icon)
+{
+	if (icon != NULL)
+		g_object_unref(icon);
+}
+
+static void
+on_icon_theme_changed(GtkIconTheme *icon_theme, gpointer user_data)
+{
+	icon_cache_clear();
+}
+
+static void
+icon_cache_debug_stats(void)
+{
+	if (icon_cache_icons != NULL)
+		g_debug("TreeBrowser: icon cache: %u icons, %u hits, %u misses",
+			g_hash_table_size(icon_cache_icons), icon_cache_hits, icon_cache_misses);
+}
+
 static GdkPixbuf *
-utils_pixbuf_from_path(gchar *path)
+icon_cache_load(const gchar *ctype)
 {
-#if defined(HAVE_GIO) && GTK_CHECK_VERSION(2, 14, 0)
 	GIcon 		*icon;
 	GdkPixbuf 	*ret = NULL;
 	GtkIconInfo *info;
-	gchar 		*ctype;
 	gint 		width;
 
-	ctype = g_content_type_guess(path, NULL, 0, NULL);
 	icon = g_content_type_get_icon(ctype);
-	g_free(ctype);
 
 	if (icon != NULL)
 	{
@@ -223,6 +286,38 @@ utils_pixbuf_from_path(gchar *path)
 		gtk_icon_info_free(info);
 	}
 	return ret;
+}
+#endif
+
+static GdkPixbuf *
+utils_pixbuf_from_path(gchar *path)
+{
+#if defined(HAVE_GIO) && GTK_CHECK_VERSION(2, 14, 0)
+	GdkPixbuf 	*ret = NULL;
+	gchar 		*ctype;
+
+	if (icon_cache_icons == NULL)
+		icon_cache_icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, icon_cache_icon_free);
+	if (icon_cache_theme_handler == 0)
+		icon_cache_theme_handler = g_signal_connect(gtk_icon_theme_get_default(), "changed",
+			G_CALLBACK(on_icon_theme_changed), NULL);
+
+	ctype = g_content_type_guess(path, NULL, 0, NULL);
+
+	/* a NULL icon is cached too, for types the theme has no icon for */
+	if (g_hash_table_lookup_extended(icon_cache_icons, ctype, NULL, (gpointer *) &ret))
+	{
+		icon_cache_hits++;
+		g_free(ctype);
+	}
+	else
+	{
+		icon_cache_misses++;
+		ret = icon_cache_load(ctype);
+		g_hash_table_insert(icon_cache_icons, ctype, ret);
+	}
+
+	return ret ? g_object_ref(ret) : NULL;
 #else
 	return utils_pixbuf_from_stock(g_file_test(path, G_FILE_TEST_IS_DIR)
 									? GTK_STOCK_DIRECTORY
@@ -337,28 +432,32 @@ static gboolean
 check_hidden(const gchar *filename)
 {
 	gsize len;
-	const gchar *base_name = NULL;
-	base_name = g_path_get_basename(filename);
-
-	if (! NZV(base_name))
-		return FALSE;
+	gchar *base_name;
+	gboolean hidden = FALSE;
 
 	if (CONFIG_SHOW_HIDDEN_FILES)
 		return FALSE;
 
+	base_name = g_path_get_basename(filename);
+
+	if (! NZV(base_name))
+		hidden = FALSE;
 #ifdef G_OS_WIN32
-	if (win32_check_hidden(filename))
-		return TRUE;
+	else if (win32_check_hidden(filename))
+		hidden = TRUE;
 #else
-	if (base_name[0] == '.')
-		return TRUE;
+	else if (base_name[0] == '.')
+		hidden = TRUE;
 #endif
+	else
+	{
+		len = strlen(base_name);
+		hidden = base_name[len - 1] == '~';
+	}
 
-	len = strlen(base_name);
-	if (base_name[len - 1] == '~')
-		return TRUE;
+	g_free(base_name);
 
-	return FALSE;
+	return hidden;
 }
 
 static gchar*
@@ -451,6 +550,8 @@ treebrowser_chroot(gchar *directory)
 
 	treebrowser_bookmarks_set_state();
 
+	treebrowser_cancel_all_loading();
+	treebrowser_unwatch_all();
 	gtk_tree_store_clear(treestore);
 	setptr(addressbar_last_address, g_strdup(directory));
 
@@ -458,19 +559,461 @@ treebrowser_chroot(gchar *directory)
 	treebrowser_load_bookmarks();
 }
 
-static void
-treebrowser_browse(gchar *directory, gpointer parent)
+/* ------------------
+ * DIRECTORY LOADING
+ * ------------------ */
+
+/* Directory loading is split in two steps: the entries are collected (off the main
+ * thread when GIO is available), and then inserted in the tree store a batch per
+ * idle callback, so expanding a huge directory doesn't freeze the UI. */
+
+#define BROWSE_ENUMERATE_BATCH 		256
+#define BROWSE_INSERT_BATCH 		200
+
+typedef struct
 {
-	GtkTreeIter 	iter, iter_empty, *last_dir_iter = NULL;
+	gchar 			*name;
+	gchar 			*uri;
 	gboolean 		is_dir;
+} BrowseEntry;
+
+typedef struct
+{
+	gchar 			*directory;		/* with trailing separator */
+	GtkTreeIter 	parent;
+	gboolean 		has_parent;
+	gboolean 		expanded;
+	GtkTreeIter 	placeholder;	/* the "(Loading...)" row */
+	gboolean 		has_placeholder;
+	GtkTreeIter 	last;			/* last inserted row, new rows go after it */
+	gboolean 		has_last;
+	GPtrArray 		*entries;
+	guint 			n_inserted;
+	guint 			idle_id;
+#ifdef HAVE_GIO
+	GFile 			*file;
+	GCancellable 	*cancellable;
+#endif
+} BrowseJob;
+
+/* running asynchronous loads */
+static GSList 				*browse_jobs 				= NULL;
+
+static BrowseJob*
+browse_job_new(const gchar *directory, GtkTreeIter *parent)
+{
+	BrowseJob *job = g_new0(BrowseJob, 1);
+
+	job->directory 	= g_strconcat(directory, G_DIR_SEPARATOR_S, NULL);
+	job->entries 	= g_ptr_array_new();
+	if (parent)
+	{
+		job->parent 	= *parent;
+		job->has_parent = TRUE;
+	}
+
+	return job;
+}
+
+static void
+browse_entry_free(BrowseEntry *entry)
+{
+	g_free(entry->name);
+	g_free(entry->uri);
+	g_free(entry);
+}
+
+static void
+browse_job_free(BrowseJob *job)
+{
+	/* every load ends by removing its "(Loading...)" row, or replacing it */
+	g_warn_if_fail(! job->has_placeholder);
+
+	g_ptr_array_foreach(job->entries, (GFunc) browse_entry_free, NULL);
+	g_ptr_array_free(job->entries, TRUE);
+#ifdef HAVE_GIO
+	if (job->cancellable)
+		g_object_unref(job->cancellable);
+	if (job->file)
+		g_object_unref(job->file);
+#endif
+	g_free(job->directory);
+	g_free(job);
+}
+
+/* Takes ownership of fname and uri */
+static void
+browse_job_add_entry(BrowseJob *job, gchar *fname, gchar *uri, gboolean is_dir)
+{
+	gboolean show = FALSE;
+
+	if (!check_hidden(uri))
+	{
+		if (is_dir)
+			show = TRUE;
+		else
+		{
+			gchar *utf8_name = utils_get_utf8_from_locale(fname);
+
+			show = check_filtered(utf8_name);
+			g_free(utf8_name);
+		}
+	}
+
+	if (show)
+	{
+		BrowseEntry *entry = g_new(BrowseEntry, 1);
+
+		entry->name 	= fname;
+		entry->uri 		= uri;
+		entry->is_dir 	= is_dir;
+		g_ptr_array_add(job->entries, entry);
+	}
+	else
+	{
+		g_free(fname);
+		g_free(uri);
+	}
+}
+
+/* Directories first, then files, both sorted by name */
+static gint
+browse_entry_cmp(const BrowseEntry *entry_a, const BrowseEntry *entry_b)
+{
+	if (entry_a->is_dir != entry_b->is_dir)
+		return entry_a->is_dir ? -1 : 1;
+
+	return utils_str_casecmp(entry_a->name, entry_b->name);
+}
+
+static gint
+browse_entry_compare(gconstpointer a, gconstpointer b)
+{
+	return browse_entry_cmp(*(const BrowseEntry **) a, *(const BrowseEntry **) b);
+}
+
+static void
+browse_job_insert_entry(BrowseJob *job, BrowseEntry *entry)
+{
+	GtkTreeIter 	iter, iter_empty;
+	GtkTreeIter 	*parent 	= job->has_parent ? &job->parent : NULL;
+	GdkPixbuf 		*icon 		= NULL;
+
+	/* inserting after the last row is O(1), while appending walks all the siblings */
+	if (job->has_last)
+		gtk_tree_store_insert_after(treestore, &iter, parent, &job->last);
+	else
+		gtk_tree_store_prepend(treestore, &iter, parent);
+	job->last 		= iter;
+	job->has_last 	= TRUE;
+
+	if (entry->is_dir)
+		icon = CONFIG_SHOW_ICONS ? utils_pixbuf_from_stock(GTK_STOCK_DIRECTORY) : NULL;
+	else
+		icon = CONFIG_SHOW_ICONS == 2
+					? utils_pixbuf_from_path(entry->uri)
+					: CONFIG_SHOW_ICONS
+						? utils_pixbuf_from_stock(GTK_STOCK_FILE)
+						: NULL;
+
+	gtk_tree_store_set(treestore, &iter,
+					TREEBROWSER_COLUMN_ICON, 	icon,
+					TREEBROWSER_COLUMN_NAME, 	entry->name,
+					TREEBROWSER_COLUMN_URI, 	entry->uri,
+					-1);
+
+	if (entry->is_dir)
+	{
+		gtk_tree_store_prepend(treestore, &iter_empty, &iter);
+		gtk_tree_store_set(treestore, &iter_empty,
+						TREEBROWSER_COLUMN_ICON, 	NULL,
+						TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
+						TREEBROWSER_COLUMN_URI, 	NULL,
+						TREEBROWSER_COLUMN_FLAG, 	TREEBROWSER_FLAGS_PLACEHOLDER,
+						-1);
+	}
+
+	if (icon)
+		g_object_unref(icon);
+}
+
+static void
+browse_job_finish(BrowseJob *job)
+{
+	GtkTreeIter 	iter_empty;
+	GtkTreeIter 	*parent 	= job->has_parent ? &job->parent : NULL;
+
+	if (job->entries->len == 0)
+	{
+		if (job->has_placeholder)
+			iter_empty = job->placeholder;
+		else
+			gtk_tree_store_prepend(treestore, &iter_empty, parent);
+		gtk_tree_store_set(treestore, &iter_empty,
+						TREEBROWSER_COLUMN_ICON, 	NULL,
+						TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
+						TREEBROWSER_COLUMN_URI, 	NULL,
+						TREEBROWSER_COLUMN_FLAG, 	TREEBROWSER_FLAGS_PLACEHOLDER,
+						-1);
+	}
+	else if (job->has_placeholder)
+		gtk_tree_store_remove(treestore, &job->placeholder);
+	job->has_placeholder = FALSE;
+
+	if (job->has_parent)
+	{
+		if (job->expanded && ! tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), parent))
+			treebrowser_expand_iter_silently(parent);
+	}
+	else
+		treebrowser_load_bookmarks();
+
+	if (! job->has_parent || tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), parent))
+		treebrowser_watch(job->directory, parent);
+
+#if defined(HAVE_GIO) && GTK_CHECK_VERSION(2, 14, 0)
+	if (CONFIG_SHOW_ICONS == 2)
+		icon_cache_debug_stats();
+#endif
+}
+
+static void
+browse_job_cancel(BrowseJob *job)
+{
+	browse_jobs = g_slist_remove(browse_jobs, job);
+
+#ifdef HAVE_GIO
+	g_cancellable_cancel(job->cancellable);
+#endif
+	/* while I/O is pending, the job is freed by its callback */
+	if (job->idle_id)
+	{
+		g_source_remove(job->idle_id);
+		browse_job_free(job);
+	}
+}
+
+/* GtkTreeStore iters persist, and identify their row by user_data */
+static gboolean
+tree_store_iter_is_within(GtkTreeIter *ancestor, GtkTreeIter *iter)
+{
+	return ancestor->user_data == iter->user_data || gtk_tree_store_is_ancestor(treestore, ancestor, iter);
+}
+
+/* Ends the "(Loading...)" row of a cancelled load: the rows already inserted are kept, or the
+ * directory is left with the placeholder of a directory that isn't loaded */
+static void
+browse_job_drop_placeholder(BrowseJob *job)
+{
+	GtkTreeIter *parent = job->has_parent ? &job->parent : NULL;
+
+	if (! job->has_placeholder)
+		return;
+
+	if (gtk_tree_model_iter_n_children(GTK_TREE_MODEL(treestore), parent) > 1)
+		gtk_tree_store_remove(treestore, &job->placeholder);
+	else
+		gtk_tree_store_set(treestore, &job->placeholder,
+						TREEBROWSER_COLUMN_ICON, 	NULL,
+						TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
+						TREEBROWSER_COLUMN_URI, 	NULL,
+						TREEBROWSER_COLUMN_FLAG, 	TREEBROWSER_FLAGS_PLACEHOLDER,
+						-1);
+	job->has_placeholder = FALSE;
+}
+
+/* Cancels loading of the children of parent and of its descendants, or of the root if parent is NULL */
+static void
+treebrowser_cancel_loading(GtkTreeIter *parent)
+{
+	GSList *node, *next;
+
+	for (node = browse_jobs; node != NULL; node = next)
+	{
+		BrowseJob *job = node->data;
+
+		next = node->next;
+		if (parent == NULL ? ! job->has_parent : job->has_parent && tree_store_iter_is_within(parent, &job->parent))
+		{
+			browse_job_drop_placeholder(job);
+			browse_job_cancel(job);
+		}
+	}
+}
+
+/* Cancels all loads, the rows being dropped along with the whole tree */
+static void
+treebrowser_cancel_all_loading(void)
+{
+	while (browse_jobs != NULL)
+	{
+		BrowseJob *job = browse_jobs->data;
+
+		job->has_placeholder = FALSE;
+		browse_job_cancel(job);
+	}
+}
+
+/* Moves the loads that insert their next rows after row to the row before it, as row is about
+ * to be removed */
+static void
+treebrowser_loading_forget_row(GtkTreeIter *row)
+{
+	GSList *node;
+
+	for (node = browse_jobs; node != NULL; node = node->next)
+	{
+		BrowseJob *job = node->data;
+
+		if (job->has_last && job->last.user_data == row->user_data)
+		{
+			GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), row);
+
+			if (gtk_tree_path_prev(path))
+				gtk_tree_model_get_iter(GTK_TREE_MODEL(treestore), &job->last, path);
+			else
+				job->has_last = FALSE;
+			gtk_tree_path_free(path);
+		}
+	}
+}
+
+#ifdef HAVE_GIO
+static gboolean
+browse_job_insert_idle(gpointer data)
+{
+	BrowseJob 	*job = data;
+	guint 		end;
+
+	end = MIN(job->n_inserted + BROWSE_INSERT_BATCH, job->entries->len);
+	for (; job->n_inserted < end; job->n_inserted++)
+		browse_job_insert_entry(job, g_ptr_array_index(job->entries, job->n_inserted));
+
+	if (job->n_inserted < job->entries->len)
+		return TRUE;
+
+	job->idle_id = 0;
+	browse_jobs = g_slist_remove(browse_jobs, job);
+	browse_job_finish(job);
+	browse_job_free(job);
+
+	return FALSE;
+}
+
+static void
+browse_job_entries_ready(BrowseJob *job)
+{
+	g_ptr_array_sort(job->entries, browse_entry_compare);
+	job->idle_id = g_idle_add(browse_job_insert_idle, job);
+}
+
+static void
+on_browse_next_files_ready(GObject *source, GAsyncResult *result, gpointer data)
+{
+	BrowseJob 			*job 		= data;
+	GFileEnumerator 	*enumerator = G_FILE_ENUMERATOR(source);
+	GList 				*infos, *node;
+
+	infos = g_file_enumerator_next_files_finish(enumerator, result, NULL);
+
+	if (g_cancellable_is_cancelled(job->cancellable))
+	{
+		g_list_foreach(infos, (GFunc) g_object_unref, NULL);
+		g_list_free(infos);
+		g_object_unref(enumerator);
+		browse_job_free(job);
+		return;
+	}
+
+	for (node = infos; node != NULL; node = node->next)
+	{
+		GFileInfo 	*info 	= node->data;
+		gchar 		*fname 	= g_strdup(g_file_info_get_name(info));
+
+		browse_job_add_entry(job, fname, g_strconcat(job->directory, fname, NULL),
+			g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY);
+		g_object_unref(info);
+	}
+
+	if (infos == NULL)
+	{
+		/* end of the directory (or read error) */
+		g_object_unref(enumerator);
+		browse_job_entries_ready(job);
+	}
+	else
+	{
+		g_list_free(infos);
+		g_file_enumerator_next_files_async(enumerator, BROWSE_ENUMERATE_BATCH, G_PRIORITY_DEFAULT,
+			job->cancellable, on_browse_next_files_ready, job);
+	}
+}
+
+static void
+on_browse_enumerate_ready(GObject *source, GAsyncResult *result, gpointer data)
+{
+	BrowseJob 			*job = data;
+	GFileEnumerator 	*enumerator;
+
+	enumerator = g_file_enumerate_children_finish(G_FILE(source), result, NULL);
+
+	if (g_cancellable_is_cancelled(job->cancellable))
+	{
+		if (enumerator)
+			g_object_unref(enumerator);
+		browse_job_free(job);
+		return;
+	}
+
+	if (enumerator == NULL)
+		/* unreadable directory, show it as empty */
+		browse_job_entries_ready(job);
+	else
+		g_file_enumerator_next_files_async(enumerator, BROWSE_ENUMERATE_BATCH, G_PRIORITY_DEFAULT,
+			job->cancellable, on_browse_next_files_ready, job);
+}
+
+static void
+browse_job_start(BrowseJob *job)
+{
+	GtkTreeIter *parent = job->has_parent ? &job->parent : NULL;
+
+	gtk_tree_store_prepend(treestore, &job->placeholder, parent);
+	gtk_tree_store_set(treestore, &job->placeholder,
+					TREEBROWSER_COLUMN_ICON, 	NULL,
+					TREEBROWSER_COLUMN_NAME, 	_("(Loading...)"),
+					TREEBROWSER_COLUMN_URI, 	NULL,
+					TREEBROWSER_COLUMN_FLAG, 	TREEBROWSER_FLAGS_PLACEHOLDER,
+					-1);
+	job->has_placeholder 	= TRUE;
+	job->last 				= job->placeholder;
+	job->has_last 			= TRUE;
+
+	if (job->expanded)
+		treebrowser_expand_iter_silently(parent);
+
+	job->cancellable 	= g_cancellable_new();
+	job->file 			= g_file_new_for_path(job->directory);
+	browse_jobs 		= g_slist_prepend(browse_jobs, job);
+
+	/* requesting only the name and the type lets GIO use d_type from readdir()
+	 * instead of stat()ing each entry */
+	g_file_enumerate_children_async(job->file,
+		G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE,
+		G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, job->cancellable,
+		on_browse_enumerate_ready, job);
+}
+#endif
+
+static void
+treebrowser_browse_full(gchar *directory, gpointer parent, gboolean sync)
+{
+	BrowseJob 		*job;
 	gboolean 		expanded = FALSE, has_parent;
-	gchar 			*utf8_name;
 	GSList 			*list, *node;
-
 	gchar 			*fname;
 	gchar 			*uri;
-
-	directory 		= g_strconcat(directory, G_DIR_SEPARATOR_S, NULL);
+	guint 			i;
 
 	has_parent = parent ? gtk_tree_store_iter_is_valid(treestore, parent) : FALSE;
 	if (has_parent)
@@ -487,92 +1030,358 @@ treebrowser_browse(gchar *directory, gpointer parent)
 		treebrowser_bookmarks_set_state();
 	}
 
+	treebrowser_cancel_loading(parent);
+	treebrowser_unwatch(parent);
 	if (parent)
 		gtk_tree_store_iter_clear_nodes(parent, FALSE);
 
-	list = utils_get_file_list(directory, NULL, NULL);
+	job = browse_job_new(directory, parent);
+	job->expanded = expanded;
+
+#ifdef HAVE_GIO
+	if (! sync)
+	{
+		browse_job_start(job);
+		return;
+	}
+#endif
+
+	list = utils_get_file_list(job->directory, NULL, NULL);
 	if (list != NULL)
 	{
 		foreach_slist_free(node, list)
 		{
-			fname 		= node->data;
-			uri 		= g_strconcat(directory, fname, NULL);
-			is_dir 		= g_file_test (uri, G_FILE_TEST_IS_DIR);
-			utf8_name 	= utils_get_utf8_from_locale(fname);
+			fname 	= node->data;
+			uri 	= g_strconcat(job->directory, fname, NULL);
+			browse_job_add_entry(job, fname, uri, g_file_test(uri, G_FILE_TEST_IS_DIR));
+		}
+	}
+	g_ptr_array_sort(job->entries, browse_entry_compare);
 
-			if (!check_hidden(uri))
-			{
-				GdkPixbuf *icon = NULL;
+	for (i = 0; i < job->entries->len; i++)
+		browse_job_insert_entry(job, g_ptr_array_index(job->entries, i));
 
-				if (is_dir)
-				{
-					if (last_dir_iter == NULL)
-						gtk_tree_store_prepend(treestore, &iter, parent);
-					else
-					{
-						gtk_tree_store_insert_after(treestore, &iter, parent, last_dir_iter);
-						gtk_tree_iter_free(last_dir_iter);
-					}
-					last_dir_iter = gtk_tree_iter_copy(&iter);
-					icon = CONFIG_SHOW_ICONS ? utils_pixbuf_from_stock(GTK_STOCK_DIRECTORY) : NULL;
-					gtk_tree_store_set(treestore, &iter,
-										TREEBROWSER_COLUMN_ICON, 	icon,
-										TREEBROWSER_COLUMN_NAME, 	fname,
-										TREEBROWSER_COLUMN_URI, 	uri,
-										-1);
-					gtk_tree_store_prepend(treestore, &iter_empty, &iter);
-					gtk_tree_store_set(treestore, &iter_empty,
-									TREEBROWSER_COLUMN_ICON, 	NULL,
-									TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
-									TREEBROWSER_COLUMN_URI, 	NULL,
-									-1);
-				}
-				else
-				{
-					if (check_filtered(utf8_name))
-					{
-						icon = CONFIG_SHOW_ICONS == 2
-									? utils_pixbuf_from_path(uri)
-									: CONFIG_SHOW_ICONS
-										? utils_pixbuf_from_stock(GTK_STOCK_FILE)
-										: NULL;
-						gtk_tree_store_append(treestore, &iter, parent);
-						gtk_tree_store_set(treestore, &iter,
-										TREEBROWSER_COLUMN_ICON, 	icon,
-										TREEBROWSER_COLUMN_NAME, 	fname,
-										TREEBROWSER_COLUMN_URI, 	uri,
-										-1);
-					}
-				}
+	browse_job_finish(job);
+	browse_job_free(job);
+}
+
+static void
+treebrowser_browse(gchar *directory, gpointer parent)
+{
+	treebrowser_browse_full(directory, parent, flag_browse_sync);
+}
+
+/* ------------------
+ * DIRECTORY MONITORING
+ * ------------------ */
+
+/* Loaded directories that are expanded (and the root) are monitored, and changes
+ * are applied to their existing rows instead of reloading them. Events are
+ * collected per name and applied together, so a burst of changes (e.g. a VCS
+ * checkout) results in a single update. */
+
+#define WATCH_COALESCE_DELAY 		250
+
+#ifdef HAVE_GIO
+typedef struct
+{
+	gchar 			*directory;		/* with trailing separator */
+	GtkTreeIter 	parent;
+	gboolean 		has_parent;
+	GFile 			*file;
+	GFileMonitor 	*monitor;
+	GHashTable 		*pending;		/* name -> last GFileMonitorEvent */
+} DirWatch;
+
+static GSList 				*dir_watches 				= NULL;
+static guint 				dir_watches_flush_id 		= 0;
+
+static void
+dir_watch_free(DirWatch *watch)
+{
+	g_file_monitor_cancel(watch->monitor);
+	g_object_unref(watch->monitor);
+	g_object_unref(watch->file);
+	g_hash_table_destroy(watch->pending);
+	g_free(watch->directory);
+	g_free(watch);
+}
+
+static DirWatch*
+dir_watch_find(GtkTreeIter *parent)
+{
+	GSList *node;
+
+	for (node = dir_watches; node != NULL; node = node->next)
+	{
+		DirWatch *watch = node->data;
+
+		if (parent == NULL ? ! watch->has_parent : watch->has_parent && watch->parent.user_data == parent->user_data)
+			return watch;
+	}
+	return NULL;
+}
+
+/* Returns: how a row sorts relatively to entry, rows that aren't entries (placeholders,
+ * bookmarks) sorting first */
+static gint
+dir_watch_compare_row(GtkTreeIter *iter, BrowseEntry *entry)
+{
+	BrowseEntry row;
+	gchar 		*uri;
+	gint 		ret;
+
+	gtk_tree_model_get(GTK_TREE_MODEL(treestore), iter,
+						TREEBROWSER_COLUMN_NAME, &row.name,
+						TREEBROWSER_COLUMN_URI, &uri,
+						-1);
+	if (uri == NULL)
+		ret = -1;
+	else
+	{
+		/* directories always have at least a placeholder child */
+		row.is_dir = gtk_tree_model_iter_has_child(GTK_TREE_MODEL(treestore), iter);
+		ret = browse_entry_cmp(&row, entry);
+	}
+	g_free(row.name);
+	g_free(uri);
+
+	return ret;
+}
+
+static void
+dir_watch_apply(DirWatch *watch)
+{
+	GtkTreeIter 	*parent 	= watch->has_parent ? &watch->parent : NULL;
+	GtkTreeIter 	iter, placeholder;
+	gboolean 		has_placeholder = FALSE, valid;
+	GHashTable 		*rows;
+	GHashTableIter 	pending_iter;
+	gpointer 		key, value;
+	BrowseJob 		*job;
+	guint 			n_rows, i;
+
+	/* index the current rows by name */
+	rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+	valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(treestore), &iter, parent);
+	while (valid)
+	{
+		gchar 	*name, *uri;
+		gint 	flag;
 
-				if (icon)
-					g_object_unref(icon);
+		gtk_tree_model_get(GTK_TREE_MODEL(treestore), &iter,
+							TREEBROWSER_COLUMN_NAME, &name,
+							TREEBROWSER_COLUMN_URI, &uri,
+							TREEBROWSER_COLUMN_FLAG, &flag,
+							-1);
+		if (flag == TREEBROWSER_FLAGS_PLACEHOLDER)
+		{
+			placeholder 	= iter;
+			has_placeholder = TRUE;
+			g_free(name);
+		}
+		else if (uri != NULL)
+			g_hash_table_insert(rows, name, gtk_tree_iter_copy(&iter));
+		else
+			g_free(name);
+		g_free(uri);
+
+		valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(treestore), &iter);
+	}
+	n_rows = g_hash_table_size(rows);
+
+	/* the new entries are collected the way a directory load does, and merged in */
+	job = browse_job_new(watch->directory, parent);
+
+	g_hash_table_iter_init(&pending_iter, watch->pending);
+	while (g_hash_table_iter_next(&pending_iter, &key, &value))
+	{
+		const gchar *name 	= key;
+		GtkTreeIter *row 	= g_hash_table_lookup(rows, name);
+
+		if (GPOINTER_TO_INT(value) == G_FILE_MONITOR_EVENT_DELETED)
+		{
+			if (row != NULL)
+			{
+				treebrowser_cancel_loading(row);
+				treebrowser_unwatch(row);
+				gtk_tree_store_iter_clear_nodes(row, TRUE);
+				n_rows--;
 			}
-			g_free(utf8_name);
-			g_free(uri);
-			g_free(fname);
+		}
+		else if (row == NULL)
+		{
+			gchar *uri = g_strconcat(watch->directory, name, NULL);
+
+			browse_job_add_entry(job, g_strdup(name), uri, g_file_test(uri, G_FILE_TEST_IS_DIR));
 		}
 	}
-	else
+	g_hash_table_remove_all(watch->pending);
+	g_hash_table_destroy(rows);
+
+	g_ptr_array_sort(job->entries, browse_entry_compare);
+	valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(treestore), &iter, parent);
+	for (i = 0; i < job->entries->len; i++)
 	{
-		gtk_tree_store_prepend(treestore, &iter_empty, parent);
-		gtk_tree_store_set(treestore, &iter_empty,
+		BrowseEntry *entry = g_ptr_array_index(job->entries, i);
+
+		while (valid && dir_watch_compare_row(&iter, entry) < 0)
+		{
+			job->last 		= iter;
+			job->has_last 	= TRUE;
+			valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(treestore), &iter);
+		}
+		browse_job_insert_entry(job, entry);
+	}
+	n_rows += job->entries->len;
+
+	if (n_rows > 0 && has_placeholder)
+		gtk_tree_store_remove(treestore, &placeholder);
+	else if (n_rows == 0 && ! has_placeholder)
+	{
+		gtk_tree_store_prepend(treestore, &placeholder, parent);
+		gtk_tree_store_set(treestore, &placeholder,
 						TREEBROWSER_COLUMN_ICON, 	NULL,
 						TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
 						TREEBROWSER_COLUMN_URI, 	NULL,
+						TREEBROWSER_COLUMN_FLAG, 	TREEBROWSER_FLAGS_PLACEHOLDER,
 						-1);
 	}
 
-	if (has_parent)
+	browse_job_free(job);
+}
+
+static gboolean
+dir_watches_flush(gpointer data)
+{
+	gboolean flushed;
+
+	dir_watches_flush_id = 0;
+
+	/* applying changes may drop watches of removed directories, so restart the
+	 * lookup after each of them */
+	do
 	{
-		if (expanded)
-			gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), parent), FALSE);
+		GSList *node;
+
+		flushed = FALSE;
+		for (node = dir_watches; node != NULL; node = node->next)
+		{
+			DirWatch *watch = node->data;
+
+			if (g_hash_table_size(watch->pending) > 0)
+			{
+				dir_watch_apply(watch);
+				flushed = TRUE;
+				break;
+			}
+		}
 	}
-	else
-		treebrowser_load_bookmarks();
+	while (flushed);
+
+	return FALSE;
+}
+
+static void
+on_dir_watch_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer data)
+{
+	DirWatch *watch = data;
+
+	if (event_type != G_FILE_MONITOR_EVENT_CREATED && event_type != G_FILE_MONITOR_EVENT_DELETED)
+		return;
+	/* the directory itself is handled by the watch of its parent */
+	if (g_file_equal(file, watch->file))
+		return;
+
+	g_hash_table_insert(watch->pending, g_file_get_basename(file), GINT_TO_POINTER(event_type));
+
+	if (dir_watches_flush_id == 0)
+		dir_watches_flush_id = g_timeout_add(WATCH_COALESCE_DELAY, dir_watches_flush, NULL);
+}
+#endif
+
+static void
+treebrowser_watch(const gchar *directory, GtkTreeIter *parent)
+{
+#ifdef HAVE_GIO
+	DirWatch 		*watch;
+	GFile 			*file;
+	GFileMonitor 	*monitor;
+
+	if (dir_watch_find(parent) != NULL)
+		return;
+
+	file 	= g_file_new_for_path(directory);
+	monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	if (monitor == NULL)
+	{
+		g_object_unref(file);
+		return;
+	}
+
+	watch 				= g_new0(DirWatch, 1);
+	watch->directory 	= g_str_has_suffix(directory, G_DIR_SEPARATOR_S)
+							? g_strdup(directory)
+							: g_strconcat(directory, G_DIR_SEPARATOR_S, NULL);
+	watch->file 		= file;
+	watch->monitor 		= monitor;
+	watch->pending 		= g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	if (parent)
+	{
+		watch->parent 		= *parent;
+		watch->has_parent 	= TRUE;
+	}
+	g_signal_connect(monitor, "changed", G_CALLBACK(on_dir_watch_changed), watch);
+
+	dir_watches = g_slist_prepend(dir_watches, watch);
+#endif
+}
+
+static gboolean
+treebrowser_is_watched(GtkTreeIter *iter)
+{
+#ifdef HAVE_GIO
+	return dir_watch_find(iter) != NULL;
+#else
+	return FALSE;
+#endif
+}
+
+/* Stops monitoring parent and its descendants, or the root if parent is NULL */
+static void
+treebrowser_unwatch(GtkTreeIter *parent)
+{
+#ifdef HAVE_GIO
+	GSList *node, *next;
+
+	for (node = dir_watches; node != NULL; node = next)
+	{
+		DirWatch *watch = node->data;
+
+		next = node->next;
+		if (parent == NULL ? ! watch->has_parent : watch->has_parent && tree_store_iter_is_within(parent, &watch->parent))
+		{
+			dir_watches = g_slist_delete_link(dir_watches, node);
+			dir_watch_free(watch);
+		}
+	}
+#endif
+}
 
-	g_free(directory);
+static void
+treebrowser_unwatch_all(void)
+{
+#ifdef HAVE_GIO
+	g_slist_foreach(dir_watches, (GFunc) dir_watch_free, NULL);
+	g_slist_free(dir_watches);
+	dir_watches = NULL;
 
+	if (dir_watches_flush_id != 0)
+	{
+		g_source_remove(dir_watches_flush_id);
+		dir_watches_flush_id = 0;
+	}
+#endif
 }
 
 static void
@@ -604,6 +1413,8 @@ treebrowser_load_bookmarks(void)
 		if (gtk_tree_store_iter_is_valid(treestore, &bookmarks_iter))
 		{
 			bookmarks_expanded = tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), &bookmarks_iter);
+			treebrowser_cancel_loading(&bookmarks_iter);
+			treebrowser_unwatch(&bookmarks_iter);
 			gtk_tree_store_iter_clear_nodes(&bookmarks_iter, FALSE);
 		}
 		else
@@ -842,6 +1653,9 @@ treebrowser_track_current(void)
 	{
 		path_current = utils_get_locale_from_utf8(doc->file_name);
 
+		/* searching the document needs the directories to be loaded right away */
+		flag_browse_sync = TRUE;
+
 		/*
 		 * Checking if the document is in the expanded or collapsed files
 		 */
@@ -862,6 +1676,8 @@ treebrowser_track_current(void)
 			treebrowser_expand_to_path(froot, path_current);
 		}
 
+		flag_browse_sync = FALSE;
+
 		g_strfreev(path_segments);
 		g_free(froot);
 		g_free(path_current);
@@ -1055,7 +1871,7 @@ on_menu_create_new_object(GtkMenuItem *menuitem, const gchar *type)
 
 			if (creation_success)
 			{
-				treebrowser_browse(uri, refresh_root ? NULL : &iter);
+				treebrowser_browse_full(uri, refresh_root ? NULL : &iter, TRUE);
 				if (treebrowser_search(uri_new, NULL))
 					treebrowser_rename_current();
 			}
@@ -1465,13 +2281,23 @@ on_treeview_changed(GtkWidget *widget, gpointer user_data)
 		if (g_file_test(uri, G_FILE_TEST_EXISTS))
 		{
 			if (g_file_test(uri, G_FILE_TEST_IS_DIR))
-				treebrowser_browse(uri, &iter);
+			{
+				/* monitored directories are already up to date */
+				if (! treebrowser_is_watched(&iter))
+					treebrowser_browse(uri, &iter);
+			}
 			else
 				if (CONFIG_ONE_CLICK_CHDOC)
 					document_open_file(uri, FALSE, NULL, NULL);
 		}
 		else
+		{
+			treebrowser_cancel_loading(&iter);
+			treebrowser_unwatch(&iter);
+			/* a load of the parent may be inserting its rows after this one */
+			treebrowser_loading_forget_row(&iter);
 			gtk_tree_store_iter_clear_nodes(&iter, TRUE);
+		}
 
 		g_free(uri);
 	}
@@ -1537,6 +2363,8 @@ on_treeview_row_collapsed(GtkWidget *widget, GtkTreeIter *iter, GtkTreePath *pat
 	gtk_tree_model_get(GTK_TREE_MODEL(treestore), iter, TREEBROWSER_COLUMN_URI, &uri, -1);
 	if (uri == NULL)
 		return;
+	treebrowser_cancel_loading(iter);
+	treebrowser_unwatch(iter);
 	if (CONFIG_SHOW_ICONS)
 	{
 		GdkPixbuf *icon = utils_pixbuf_from_stock(GTK_STOCK_DIRECTORY);
@@ -2039,6 +2867,11 @@ plugin_init(GeanyData *data)
 
 	flag_on_expand_refresh = FALSE;
 
+#ifdef HAVE_GIO
+	/* pending directory loads may still call back after unloading */
+	plugin_module_make_resident(geany_plugin);
+#endif
+
 	load_settings();
 	create_sidebar();
 	treebrowser_chroot(get_default_dir());
@@ -2066,6 +2899,13 @@ plugin_init(GeanyData *data)
 void
 plugin_cleanup(void)
 {
+	treebrowser_cancel_all_loading();
+	treebrowser_unwatch_all();
+#if defined(HAVE_GIO) && GTK_CHECK_VERSION(2, 14, 0)
+	if (icon_cache_theme_handler != 0)
+		g_signal_handler_disconnect(gtk_icon_theme_get_default(), icon_cache_theme_handler);
+	icon_cache_clear();
+#endif
 	g_free(addressbar_last_address);
 	g_free(CONFIG_FILE);
 	g_free(CONFIG_OPEN_EXTERNAL_CMD);